@@ -415,6 +415,9 @@ static bool fs_supports(struct fsal_export *export_pub,
 
 	case fso_reopen_method:
 		return false;
+
+	case fso_readahead_buffer:
+		return false;
 	}
 
 	return false;
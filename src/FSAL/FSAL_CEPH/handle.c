@@ -184,6 +184,120 @@ static fsal_status_t fsal_readdir(struct fsal_obj_handle *dir_pub,
 	return fsal_status;
 }
 
+/**
+ * @brief Read a directory with handles and attributes
+ *
+ * This function reads the contents of a directory like fsal_readdir,
+ * but looks up each entry as it goes and passes handles and
+ * attributes to the supplied callback in batches.  The MDS returns
+ * inodes along with the names, so the lookups are answered from the
+ * client cache rather than costing a round trip each.
+ *
+ * @param[in]  dir_pub     The directory to read
+ * @param[in]  whence      The cookie indicating resumption, NULL to start
+ * @param[in]  dir_state   Opaque, passed to cb
+ * @param[in]  cb          Callback that receives batches of entries
+ * @param[out] eof         True if there are no more entries
+ *
+ * @return FSAL status.
+ */
+
+static fsal_status_t fsal_readdir_plus(struct fsal_obj_handle *dir_pub,
+				       fsal_cookie_t *whence, void *dir_state,
+				       fsal_readdir_plus_cb cb, bool *eof)
+{
+	/* Generic status return */
+	int rc = 0;
+	/* The private 'full' export */
+	struct export *export =
+	    container_of(op_ctx->fsal_export, struct export, export);
+	/* The private 'full' directory handle */
+	struct handle *dir = container_of(dir_pub, struct handle, handle);
+	/* The director descriptor */
+	struct ceph_dir_result *dir_desc = NULL;
+	/* Cookie marking the start of the readdir */
+	uint64_t start = 0;
+	/* Entries waiting to be passed to cb */
+	struct fsal_readdir_batch *batch;
+	/* Return status */
+	fsal_status_t fsal_status = { ERR_FSAL_NO_ERROR, 0 };
+
+	batch = fsal_readdir_batch_alloc(cb, dir_state);
+	if (batch == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	rc = ceph_ll_opendir(export->cmount, dir->i, &dir_desc, 0, 0);
+	if (rc < 0) {
+		fsal_readdir_batch_free(batch);
+		return ceph2fsal_error(rc);
+	}
+
+	if (whence != NULL)
+		start = *whence;
+
+	ceph_seekdir(export->cmount, dir_desc, start);
+
+	while (!(*eof)) {
+		struct stat st;
+		struct dirent de;
+		struct Inode *i = NULL;
+		struct handle *obj = NULL;
+		fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+		rc = ceph_readdir_r(export->cmount, dir_desc, &de);
+		if (rc < 0) {
+			fsal_status = ceph2fsal_error(rc);
+			goto closedir;
+		} else if (rc == 1) {
+			/* skip . and .. */
+			if ((strcmp(de.d_name, ".") == 0)
+			    || (strcmp(de.d_name, "..") == 0)) {
+				continue;
+			}
+
+			rc = ceph_ll_lookup(export->cmount, dir->i, de.d_name,
+					    &st, &i, 0, 0);
+			if (rc == -ENOENT) {
+				/* removed since it was listed */
+				continue;
+			} else if (rc < 0) {
+				status = ceph2fsal_error(rc);
+			} else {
+				rc = construct_handle(&st, i, export, &obj);
+				if (rc < 0) {
+					ceph_ll_put(export->cmount, i);
+					status = ceph2fsal_error(rc);
+				}
+			}
+
+			if (!fsal_readdir_batch_add(batch, de.d_name, de.d_off,
+						    status,
+						    obj ? &obj->handle : NULL))
+				goto closedir;
+
+		} else if (rc == 0) {
+			if (fsal_readdir_batch_flush(batch))
+				*eof = true;
+			else
+				goto closedir;
+		} else {
+			/* Can't happen */
+			abort();
+		}
+	}
+
+ closedir:
+
+	fsal_readdir_batch_free(batch);
+
+	rc = ceph_ll_releasedir(export->cmount, dir_desc);
+
+	if (rc < 0)
+		fsal_status = ceph2fsal_error(rc);
+
+	return fsal_status;
+}
+
 /**
  * @brief Create a regular file
  *
@@ -927,6 +1041,7 @@ void handle_ops_init(struct fsal_obj_ops *ops)
 	ops->create = fsal_create;
 	ops->mkdir = fsal_mkdir;
 	ops->readdir = fsal_readdir;
+	ops->readdir_plus = fsal_readdir_plus;
 	ops->symlink = fsal_symlink;
 	ops->readlink = fsal_readlink;
 	ops->getattrs = getattrs;
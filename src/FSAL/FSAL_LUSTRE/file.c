@@ -384,7 +384,7 @@ fsal_status_t lustre_lru_cleanup(struct fsal_obj_handle *obj_hdl,
 
 	myself =
 	    container_of(obj_hdl, struct lustre_fsal_obj_handle, obj_handle);
-	if (myself->u.file.fd >= 0) {
+	if (obj_hdl->type == REGULAR_FILE && myself->u.file.fd >= 0) {
 		rc = close(myself->u.file.fd);
 		myself->u.file.fd = -1;
 		myself->u.file.openflags = FSAL_O_CLOSED;
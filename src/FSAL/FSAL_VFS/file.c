@@ -38,9 +38,187 @@
 #include "fsal_convert.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <string.h>
 #include "FSAL/fsal_commonlib.h"
 #include "vfs_methods.h"
 
+struct fsal_staticfsinfo_t *vfs_staticinfo(struct fsal_module *hdl);
+
+/* vfs_unstable_init
+ * set up unstable extent tracking for a regular file handle
+ */
+
+void vfs_unstable_init(struct vfs_unstable *unstable)
+{
+	memset(unstable, 0, sizeof(*unstable));
+	pthread_mutex_init(&unstable->lock, NULL);
+}
+
+void vfs_unstable_destroy(struct vfs_unstable *unstable)
+{
+	pthread_mutex_destroy(&unstable->lock);
+}
+
+/* vfs_unstable_add
+ * note that [start, end) was written unstable.  Overlapping and
+ * adjacent extents are merged; once the table is full the range is
+ * folded into the nearest extent, which only makes a later commit
+ * flush a little more than it has to.
+ */
+
+static void vfs_unstable_add(struct vfs_unstable *unstable,
+			     uint64_t start, uint64_t end)
+{
+	struct vfs_extent *ext = unstable->ext;
+	uint64_t gap, best_gap = UINT64_MAX;
+	uint32_t ix, best = 0;
+
+	if (end <= start)
+		return;
+
+	PTHREAD_MUTEX_lock(&unstable->lock);
+	unstable->seq++;
+
+	for (ix = 0; ix < unstable->nr;) {
+		if (ext[ix].end >= start && ext[ix].start <= end) {
+			if (ext[ix].start < start)
+				start = ext[ix].start;
+			if (ext[ix].end > end)
+				end = ext[ix].end;
+			ext[ix] = ext[--unstable->nr];
+			continue;
+		}
+		ix++;
+	}
+
+	if (unstable->nr == VFS_UNSTABLE_EXTENTS) {
+		for (ix = 0; ix < unstable->nr; ix++) {
+			gap = ext[ix].end < start ? start - ext[ix].end
+						  : ext[ix].start - end;
+			if (gap < best_gap) {
+				best_gap = gap;
+				best = ix;
+			}
+		}
+		if (ext[best].start < start)
+			start = ext[best].start;
+		if (ext[best].end > end)
+			end = ext[best].end;
+		ext[best] = ext[--unstable->nr];
+	}
+
+	ext[unstable->nr].start = start;
+	ext[unstable->nr].end = end;
+	ext[unstable->nr].seq = unstable->seq;
+	unstable->nr++;
+	PTHREAD_MUTEX_unlock(&unstable->lock);
+}
+
+/* vfs_unstable_clear
+ * forget [start, end) for extents last written no later than write
+ * number seq, which a flush that began after it has made stable.
+ * Called with the lock held.
+ */
+
+static void vfs_unstable_clear(struct vfs_unstable *unstable,
+			       uint64_t start, uint64_t end, uint64_t seq)
+{
+	struct vfs_extent *ext = unstable->ext;
+	uint32_t ix;
+
+	for (ix = 0; ix < unstable->nr;) {
+		if (ext[ix].seq > seq ||
+		    ext[ix].end <= start || ext[ix].start >= end) {
+			ix++;
+			continue;
+		}
+		if (ext[ix].start >= start && ext[ix].end <= end) {
+			/* all of it */
+			ext[ix] = ext[--unstable->nr];
+			continue;
+		}
+		if (ext[ix].start < start && ext[ix].end > end) {
+			/* the middle, which splits it if there is room */
+			if (unstable->nr == VFS_UNSTABLE_EXTENTS) {
+				ix++;
+				continue;
+			}
+			ext[unstable->nr] = ext[ix];
+			ext[unstable->nr].start = end;
+			unstable->nr++;
+			ext[ix].end = start;
+		} else if (ext[ix].start < start) {
+			ext[ix].end = start;
+		} else {
+			ext[ix].start = end;
+		}
+		ix++;
+	}
+}
+
+/* vfs_commit_range
+ * make the unstable writes in [offset, offset + len) stable, len 0
+ * meaning to the end of the file.  If this handle knows nothing in the
+ * range is unstable it returns at once.  Otherwise, with range commits
+ * enabled, writeback of the unstable extents in the range is started
+ * first with sync_file_range; either way the file is then fdatasync'ed,
+ * since only that flushes the device cache and any allocation changes.
+ * Returns 0 or an errno.
+ */
+
+static int vfs_commit_range(struct vfs_fsal_obj_handle *myself,
+			    uint64_t offset, uint64_t len)
+{
+	struct vfs_unstable *unstable = &myself->u.file.unstable;
+	struct fsal_obj_handle *obj_hdl = &myself->obj_handle;
+	int fd = myself->u.file.fd;
+	uint64_t end = (len == 0 || offset + len < offset)
+				? UINT64_MAX : offset + len;
+	struct vfs_extent todo[VFS_UNSTABLE_EXTENTS];
+	uint32_t ntodo = 0, ix;
+	bool known;
+	uint64_t seq;
+
+	PTHREAD_MUTEX_lock(&unstable->lock);
+	known = unstable->known;
+	seq = unstable->seq;
+	for (ix = 0; ix < unstable->nr; ix++) {
+		if (unstable->ext[ix].end <= offset ||
+		    unstable->ext[ix].start >= end)
+			continue;
+		todo[ntodo].start = unstable->ext[ix].start > offset
+					? unstable->ext[ix].start : offset;
+		todo[ntodo].end = unstable->ext[ix].end < end
+					? unstable->ext[ix].end : end;
+		ntodo++;
+	}
+	PTHREAD_MUTEX_unlock(&unstable->lock);
+
+	if (known && ntodo == 0)
+		return 0;	/* already stable */
+
+	if (known && vfs_staticinfo(obj_hdl->fsal)->range_commit) {
+		/* Only a head start for the fdatasync below, which
+		 * then has just the metadata and the cache flush left */
+		for (ix = 0; ix < ntodo; ix++) {
+			if (vfs_io_sync_file_range(fd, todo[ix].start,
+					todo[ix].end - todo[ix].start,
+					SYNC_FILE_RANGE_WRITE) < 0)
+				return errno;
+		}
+	}
+
+	if (vfs_io_fdatasync(fd) < 0)
+		return errno;
+
+	PTHREAD_MUTEX_lock(&unstable->lock);
+	vfs_unstable_clear(unstable, 0, UINT64_MAX, seq);
+	unstable->known = true;
+	PTHREAD_MUTEX_unlock(&unstable->lock);
+	return 0;
+}
+
 /** vfs_open
  * called with appropriate locks taken at the cache inode level
  */
@@ -122,7 +300,8 @@ fsal_status_t vfs_read(struct fsal_obj_handle *obj_hdl,
 	assert(myself->u.file.fd >= 0
 	       && myself->u.file.openflags != FSAL_O_CLOSED);
 
-	nb_read = pread(myself->u.file.fd, buffer, buffer_size, offset);
+	nb_read = vfs_io_pread(myself->u.file.fd, buffer, buffer_size,
+			       offset);
 
 	if (offset == -1 || nb_read == -1) {
 		retval = errno;
@@ -170,7 +349,8 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	       && myself->u.file.openflags != FSAL_O_CLOSED);
 
 	fsal_set_credentials(op_ctx->creds);
-	nb_written = pwrite(myself->u.file.fd, buffer, buffer_size, offset);
+	nb_written = vfs_io_pwrite(myself->u.file.fd, buffer, buffer_size,
+				   offset);
 
 	if (offset == -1 || nb_written == -1) {
 		retval = errno;
@@ -179,14 +359,69 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	}
 
 	*write_amount = nb_written;
+	vfs_unstable_add(&myself->u.file.unstable, offset,
+			 offset + nb_written);
 
 	/* attempt stability */
 	if (fsal_stable != NULL && *fsal_stable) {
-		retval = fsync(myself->u.file.fd);
-		if (retval == -1) {
-			retval = errno;
+		retval = vfs_commit_range(myself, offset, nb_written);
+		if (retval != 0)
+			fsal_error = posix2fsal_error(retval);
+		*fsal_stable = true;
+	}
+
+ out:
+	fsal_restore_ganesha_credentials();
+	return fsalstat(fsal_error, retval);
+}
+
+/* vfs_write_iov
+ * Gathered write, one pwritev for the whole vector.
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t vfs_write_iov(struct fsal_obj_handle *obj_hdl,
+			    uint64_t offset,
+			    const struct iovec *iov, int iovcnt,
+			    size_t *write_amount, bool *fsal_stable)
+{
+	struct vfs_fsal_obj_handle *myself;
+	ssize_t nb_written;
+	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
+	int retval = 0;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+		retval = EXDEV;
+		fsal_error = posix2fsal_error(retval);
+		return fsalstat(fsal_error, retval);
+	}
+
+	assert(myself->u.file.fd >= 0
+	       && myself->u.file.openflags != FSAL_O_CLOSED);
+
+	fsal_set_credentials(op_ctx->creds);
+	nb_written = vfs_io_pwritev(myself->u.file.fd, iov, iovcnt, offset);
+
+	if (nb_written == -1) {
+		retval = errno;
+		fsal_error = posix2fsal_error(retval);
+		goto out;
+	}
+
+	*write_amount = nb_written;
+	vfs_unstable_add(&myself->u.file.unstable, offset,
+			 offset + nb_written);
+
+	/* attempt stability */
+	if (fsal_stable != NULL && *fsal_stable) {
+		retval = vfs_commit_range(myself, offset, nb_written);
+		if (retval != 0)
 			fsal_error = posix2fsal_error(retval);
-		}
 		*fsal_stable = true;
 	}
 
@@ -197,7 +432,6 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 
 /* vfs_commit
  * Commit a file range to storage.
- * for right now, fsync will have to do.
  */
 
 fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
@@ -221,14 +455,58 @@ fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 	assert(myself->u.file.fd >= 0
 	       && myself->u.file.openflags != FSAL_O_CLOSED);
 
-	retval = fsync(myself->u.file.fd);
-	if (retval == -1) {
-		retval = errno;
+	retval = vfs_commit_range(myself, offset, len);
+	if (retval != 0)
 		fsal_error = posix2fsal_error(retval);
-	}
 	return fsalstat(fsal_error, retval);
 }
 
+/* vfs_io_advise
+ * Pass the hints the kernel has an equivalent for on to it, and
+ * report back those it took.
+ */
+
+fsal_status_t vfs_io_advise(struct fsal_obj_handle *obj_hdl,
+			    struct io_hints *hints)
+{
+	static const struct {
+		uint32_t hint;
+		int advice;
+	} fadv[] = {
+		{ 1 << IO_ADVISE4_NORMAL, POSIX_FADV_NORMAL },
+		{ 1 << IO_ADVISE4_SEQUENTIAL, POSIX_FADV_SEQUENTIAL },
+		{ 1 << IO_ADVISE4_RANDOM, POSIX_FADV_RANDOM },
+		{ 1 << IO_ADVISE4_WILLNEED, POSIX_FADV_WILLNEED },
+		{ 1 << IO_ADVISE4_DONTNEED, POSIX_FADV_DONTNEED },
+		{ 1 << IO_ADVISE4_NOREUSE, POSIX_FADV_NOREUSE },
+	};
+	struct vfs_fsal_obj_handle *myself;
+	uint32_t taken = 0;
+	size_t i;
+	int retval;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal ||
+	    myself->u.file.fd < 0 ||
+	    myself->u.file.openflags == FSAL_O_CLOSED) {
+		hints->hints = 0;
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+	}
+
+	for (i = 0; i < sizeof(fadv) / sizeof(fadv[0]); i++) {
+		if (!(hints->hints & fadv[i].hint))
+			continue;
+		retval = posix_fadvise(myself->u.file.fd, hints->offset,
+				       hints->count, fadv[i].advice);
+		if (retval == 0)
+			taken |= fadv[i].hint;
+	}
+
+	hints->hints = taken;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /* vfs_lock_op
  * lock a region of the file
  * throw an error if the fd is not open.  The old fsal didn't
@@ -410,6 +688,9 @@ fsal_status_t vfs_lru_cleanup(struct fsal_obj_handle *obj_hdl,
 		retval = close(myself->u.file.fd);
 		myself->u.file.fd = -1;
 		myself->u.file.openflags = FSAL_O_CLOSED;
+	} else if (obj_hdl->type == DIRECTORY &&
+		   (requests & LRU_CLOSE_FILES)) {
+		vfs_dir_fd_close(myself);
 	}
 	if (retval == -1) {
 		retval = errno;
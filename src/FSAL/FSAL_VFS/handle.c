@@ -56,6 +56,80 @@ int vfs_fsal_open(struct vfs_fsal_obj_handle *hdl,
 	return vfs_open_by_handle(vfs_fs, hdl->handle, openflags, fsal_error);
 }
 
+/* vfs_dir_fd_get
+ * get a descriptor open on a directory, with the directory's fd lock
+ * held, shared unless the caller is going to move the offset.
+ * The descriptor is kept on the handle for the next caller while
+ * cache_inode's fd limits leave room for it, and counts against them
+ * until the LRU reclaims it.  Otherwise it is the caller's own and
+ * vfs_dir_fd_put closes it.
+ */
+
+static struct closefd vfs_dir_fd_get(struct vfs_fsal_obj_handle *myself,
+				     bool excl, fsal_errors_t *fsal_error)
+{
+	struct closefd cfd = { .fd = -1, .close_fd = false };
+
+	if (!excl) {
+		PTHREAD_RWLOCK_rdlock(&myself->u.dir.lock);
+		if (myself->u.dir.fd >= 0) {
+			cfd.fd = myself->u.dir.fd;
+			return cfd;
+		}
+		PTHREAD_RWLOCK_unlock(&myself->u.dir.lock);
+	}
+
+	/* Open under the exclusive lock so only one thread does */
+	PTHREAD_RWLOCK_wrlock(&myself->u.dir.lock);
+	if (myself->u.dir.fd >= 0) {
+		cfd.fd = myself->u.dir.fd;
+		return cfd;
+	}
+
+	cfd.fd = vfs_fsal_open(myself, O_RDONLY | O_DIRECTORY, fsal_error);
+	if (cfd.fd < 0) {
+		PTHREAD_RWLOCK_unlock(&myself->u.dir.lock);
+		return cfd;
+	}
+
+	if (cache_inode_lru_fds_spare()) {
+		myself->u.dir.fd = cfd.fd;
+		myself->u.dir.pos = 0;
+		atomic_inc_size_t(&open_fd_count);
+	} else {
+		cfd.close_fd = true;
+	}
+	return cfd;
+}
+
+/* vfs_dir_fd_put
+ * done with a descriptor from vfs_dir_fd_get
+ */
+
+static void vfs_dir_fd_put(struct vfs_fsal_obj_handle *myself,
+			   struct closefd cfd)
+{
+	PTHREAD_RWLOCK_unlock(&myself->u.dir.lock);
+	if (cfd.close_fd)
+		close(cfd.fd);
+}
+
+/* vfs_dir_fd_close
+ * drop a directory's cached descriptor, if it has one
+ */
+
+void vfs_dir_fd_close(struct vfs_fsal_obj_handle *myself)
+{
+	PTHREAD_RWLOCK_wrlock(&myself->u.dir.lock);
+	if (myself->u.dir.fd >= 0) {
+		close(myself->u.dir.fd);
+		myself->u.dir.fd = -1;
+		myself->u.dir.pos = -1;
+		atomic_dec_size_t(&open_fd_count);
+	}
+	PTHREAD_RWLOCK_unlock(&myself->u.dir.lock);
+}
+
 /* alloc_handle
  * allocate and fill in a handle
  */
@@ -86,6 +160,11 @@ static struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	if (hdl->obj_handle.type == REGULAR_FILE) {
 		hdl->u.file.fd = -1;	/* no open on this yet */
 		hdl->u.file.openflags = FSAL_O_CLOSED;
+		vfs_unstable_init(&hdl->u.file.unstable);
+	} else if (hdl->obj_handle.type == DIRECTORY) {
+		pthread_rwlock_init(&hdl->u.dir.lock, NULL);
+		hdl->u.dir.fd = -1;
+		hdl->u.dir.pos = -1;
 	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		ssize_t retlink;
 		size_t len = stat->st_size + 1;
@@ -132,7 +211,11 @@ static struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 	return hdl;
 
  spcerr:
-	if (hdl->obj_handle.type == SYMBOLIC_LINK) {
+	if (hdl->obj_handle.type == REGULAR_FILE) {
+		vfs_unstable_destroy(&hdl->u.file.unstable);
+	} else if (hdl->obj_handle.type == DIRECTORY) {
+		pthread_rwlock_destroy(&hdl->u.dir.lock);
+	} else if (hdl->obj_handle.type == SYMBOLIC_LINK) {
 		if (hdl->u.symlink.link_content != NULL)
 			gsh_free(hdl->u.symlink.link_content);
 	} else if (vfs_unopenable_type(hdl->obj_handle.type)) {
@@ -148,54 +231,33 @@ static struct vfs_fsal_obj_handle *alloc_handle(int dirfd,
 /* handle methods
  */
 
-/* lookup
- * deprecated NULL parent && NULL path implies root handle
+/* lookup_at
+ * look a name up relative to a descriptor open on its parent
  */
 
-static fsal_status_t lookup(struct fsal_obj_handle *parent,
-			    const char *path, struct fsal_obj_handle **handle)
+static fsal_status_t lookup_at(struct fsal_obj_handle *parent, int dirfd,
+			       const char *path,
+			       struct fsal_obj_handle **handle)
 {
 	struct vfs_fsal_obj_handle *parent_hdl, *hdl;
 	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
-	int retval, dirfd;
+	int retval;
 	struct stat stat;
 	vfs_file_handle_t *fh = NULL;
 	vfs_alloc_handle(fh);
 	fsal_dev_t dev;
-	struct fsal_filesystem *fs;
+	struct fsal_filesystem *fs = parent->fs;
 	bool xfsal = false;
 
 	*handle = NULL;		/* poison it first */
 	parent_hdl =
 	    container_of(parent, struct vfs_fsal_obj_handle, obj_handle);
-	if (!parent->ops->handle_is(parent, DIRECTORY)) {
-		LogCrit(COMPONENT_FSAL,
-			"Parent handle is not a directory. hdl = 0x%p", parent);
-		return fsalstat(ERR_FSAL_NOTDIR, 0);
-	}
-
-	if (parent->fsal != parent->fs->fsal) {
-		LogDebug(COMPONENT_FSAL,
-			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
-			 parent->fsal->name,
-			 parent->fs->fsal != NULL
-				? parent->fs->fsal->name
-				: "(none)");
-		retval = EXDEV;
-		goto hdlerr;
-	}
-
-	fs = parent->fs;
-	dirfd = vfs_fsal_open(parent_hdl, O_PATH | O_NOACCESS, &fsal_error);
-
-	if (dirfd < 0)
-		return fsalstat(fsal_error, -dirfd);
 
 	retval = fstatat(dirfd, path, &stat, AT_SYMLINK_NOFOLLOW);
 
 	if (retval < 0) {
 		retval = errno;
-		goto direrr;
+		goto err;
 	}
 
 	dev = posix2fsal_devt(stat.st_dev);
@@ -210,7 +272,7 @@ static fsal_status_t lookup(struct fsal_obj_handle *parent,
 				 "unknown file system dev=%"PRIu64".%"PRIu64,
 				 path, dev.major, dev.minor);
 			retval = EXDEV;
-			goto direrr;
+			goto err;
 		}
 
 		if (fs->fsal != parent->fsal) {
@@ -255,34 +317,75 @@ static fsal_status_t lookup(struct fsal_obj_handle *parent,
 
 			if (retval < 0) {
 				retval = errno;
-				goto direrr;
+				goto err;
 			}
 
 			retval = 0;
 		} else {
 			/* Some other error */
-			goto direrr;
+			goto err;
 		}
 	}
 
 	/* allocate an obj_handle and fill it up */
 	hdl = alloc_handle(dirfd, fh, fs, &stat, parent_hdl->handle, path,
 			   op_ctx->fsal_export);
-	close(dirfd);
 	if (hdl == NULL) {
 		retval = ENOMEM;
-		goto hdlerr;
+		goto err;
 	}
 	*handle = &hdl->obj_handle;
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 
- direrr:
-	close(dirfd);
- hdlerr:
+ err:
 	fsal_error = posix2fsal_error(retval);
 	return fsalstat(fsal_error, retval);
 }
 
+/* lookup
+ * deprecated NULL parent && NULL path implies root handle
+ */
+
+static fsal_status_t lookup(struct fsal_obj_handle *parent,
+			    const char *path, struct fsal_obj_handle **handle)
+{
+	struct vfs_fsal_obj_handle *parent_hdl;
+	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
+	fsal_status_t status;
+	struct closefd cfd;
+	int retval;
+
+	*handle = NULL;		/* poison it first */
+	parent_hdl =
+	    container_of(parent, struct vfs_fsal_obj_handle, obj_handle);
+	if (!parent->ops->handle_is(parent, DIRECTORY)) {
+		LogCrit(COMPONENT_FSAL,
+			"Parent handle is not a directory. hdl = 0x%p", parent);
+		return fsalstat(ERR_FSAL_NOTDIR, 0);
+	}
+
+	if (parent->fsal != parent->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 parent->fsal->name,
+			 parent->fs->fsal != NULL
+				? parent->fs->fsal->name
+				: "(none)");
+		retval = EXDEV;
+		fsal_error = posix2fsal_error(retval);
+		return fsalstat(fsal_error, retval);
+	}
+
+	/* The parent's cached descriptor saves an open_by_handle_at */
+	cfd = vfs_dir_fd_get(parent_hdl, false, &fsal_error);
+	if (cfd.fd < 0)
+		return fsalstat(fsal_error, -cfd.fd);
+
+	status = lookup_at(parent, cfd.fd, path, handle);
+	vfs_dir_fd_put(parent_hdl, cfd);
+	return status;
+}
+
 /* make_file_safe
  * the file/dir got created mode 0, uid root (me)
  * which leaves it inaccessible. Set ownership first
@@ -837,7 +940,8 @@ static fsal_status_t linkfile(struct fsal_obj_handle *obj_hdl,
 /**
  * read_dirents
  * read the directory and call through the callback function for
- * each entry.
+ * each entry.  A cached descriptor left where this call starts is
+ * read on without seeking.
  * @param dir_hdl [IN] the directory to read
  * @param whence [IN] where to start (next)
  * @param dir_state [IN] pass thru of state to callback
@@ -850,11 +954,13 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				  fsal_readdir_cb cb, bool *eof)
 {
 	struct vfs_fsal_obj_handle *myself;
+	struct closefd cfd;
 	int dirfd;
 	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
 	int retval = 0;
 	off_t seekloc = 0;
 	off_t baseloc = 0;
+	off_t dirpos;
 	unsigned int bpos;
 	int nread;
 	struct vfs_dirent dentry, *dentryp = &dentry;
@@ -874,16 +980,21 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 		fsal_error = posix2fsal_error(retval);
 		goto out;
 	}
-	dirfd = vfs_fsal_open(myself, O_RDONLY | O_DIRECTORY, &fsal_error);
+	cfd = vfs_dir_fd_get(myself, true, &fsal_error);
+	dirfd = cfd.fd;
 	if (dirfd < 0) {
 		retval = -dirfd;
 		goto out;
 	}
-	seekloc = lseek(dirfd, seekloc, SEEK_SET);
-	if (seekloc < 0) {
-		retval = errno;
-		fsal_error = posix2fsal_error(retval);
-		goto done;
+	dirpos = cfd.close_fd ? 0 : myself->u.dir.pos;
+	if (seekloc != dirpos) {
+		seekloc = lseek(dirfd, seekloc, SEEK_SET);
+		if (seekloc < 0) {
+			retval = errno;
+			fsal_error = posix2fsal_error(retval);
+			dirpos = -1;
+			goto done;
+		}
 	}
 
 	do {
@@ -892,10 +1003,12 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 		if (nread < 0) {
 			retval = errno;
 			fsal_error = posix2fsal_error(retval);
+			dirpos = -1;
 			goto done;
 		}
 		if (nread == 0)
 			break;
+		dirpos = -1;	/* until we have used the whole buffer */
 		for (bpos = 0; bpos < nread;) {
 			if (!to_vfs_dirent(buf, bpos, dentryp, baseloc)
 			    || strcmp(dentryp->vd_name, ".") == 0
@@ -910,11 +1023,133 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
  skip:
 			bpos += dentryp->vd_reclen;
 		}
+		/* the descriptor is now just past the buffer's last entry */
+		dirpos = dentryp->vd_offset;
 	} while (nread > 0);
 
 	*eof = true;
  done:
-	close(dirfd);
+	if (!cfd.close_fd)
+		myself->u.dir.pos = dirpos;
+	vfs_dir_fd_put(myself, cfd);
+
+ out:
+	return fsalstat(fsal_error, retval);
+}
+
+/**
+ * read_dirents_plus
+ * read the directory, look up each entry against the open directory,
+ * each an fstatat and a name_to_handle_at on a descriptor we already
+ * hold, and pass names, handles and attributes to the callback in
+ * batches.
+ * Entries removed while we read are skipped.
+ * @param dir_hdl [IN] the directory to read
+ * @param whence [IN] where to start (next)
+ * @param dir_state [IN] pass thru of state to callback
+ * @param cb [IN] callback function
+ * @param eof [OUT] eof marker true == end of dir
+ */
+
+static fsal_status_t read_dirents_plus(struct fsal_obj_handle *dir_hdl,
+				       fsal_cookie_t *whence, void *dir_state,
+				       fsal_readdir_plus_cb cb, bool *eof)
+{
+	struct vfs_fsal_obj_handle *myself;
+	struct fsal_readdir_batch *batch;
+	struct fsal_obj_handle *entry_hdl;
+	fsal_status_t status;
+	struct closefd cfd;
+	int dirfd;
+	fsal_errors_t fsal_error = ERR_FSAL_NO_ERROR;
+	int retval = 0;
+	off_t seekloc = 0;
+	off_t baseloc = 0;
+	off_t dirpos;
+	unsigned int bpos;
+	int nread;
+	struct vfs_dirent dentry, *dentryp = &dentry;
+	char buf[BUF_SIZE];
+
+	if (whence != NULL)
+		seekloc = (off_t) *whence;
+	myself = container_of(dir_hdl, struct vfs_fsal_obj_handle, obj_handle);
+	if (dir_hdl->fsal != dir_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 dir_hdl->fsal->name,
+			 dir_hdl->fs->fsal != NULL
+				? dir_hdl->fs->fsal->name
+				: "(none)");
+		retval = EXDEV;
+		fsal_error = posix2fsal_error(retval);
+		goto out;
+	}
+	batch = fsal_readdir_batch_alloc(cb, dir_state);
+	if (batch == NULL) {
+		retval = ENOMEM;
+		fsal_error = ERR_FSAL_NOMEM;
+		goto out;
+	}
+	cfd = vfs_dir_fd_get(myself, true, &fsal_error);
+	dirfd = cfd.fd;
+	if (dirfd < 0) {
+		retval = -dirfd;
+		goto release;
+	}
+	dirpos = cfd.close_fd ? 0 : myself->u.dir.pos;
+	if (seekloc != dirpos) {
+		seekloc = lseek(dirfd, seekloc, SEEK_SET);
+		if (seekloc < 0) {
+			retval = errno;
+			fsal_error = posix2fsal_error(retval);
+			dirpos = -1;
+			goto done;
+		}
+	}
+
+	do {
+		baseloc = seekloc;
+		nread = vfs_readents(dirfd, buf, BUF_SIZE, &seekloc);
+		if (nread < 0) {
+			retval = errno;
+			fsal_error = posix2fsal_error(retval);
+			dirpos = -1;
+			goto done;
+		}
+		if (nread == 0)
+			break;
+		dirpos = -1;	/* until we have used the whole buffer */
+		for (bpos = 0; bpos < nread;) {
+			if (!to_vfs_dirent(buf, bpos, dentryp, baseloc)
+			    || strcmp(dentryp->vd_name, ".") == 0
+			    || strcmp(dentryp->vd_name, "..") == 0)
+				goto skip;	/* must skip '.' and '..' */
+
+			status = lookup_at(dir_hdl, dirfd, dentryp->vd_name,
+					   &entry_hdl);
+			if (status.major == ERR_FSAL_NOENT)
+				goto skip;	/* unlinked under us */
+
+			if (!fsal_readdir_batch_add(batch, dentryp->vd_name,
+					(fsal_cookie_t) dentryp->vd_offset,
+					status, entry_hdl))
+				goto done;
+ skip:
+			bpos += dentryp->vd_reclen;
+		}
+		/* the descriptor is now just past the buffer's last entry */
+		dirpos = dentryp->vd_offset;
+	} while (nread > 0);
+
+	if (fsal_readdir_batch_flush(batch))
+		*eof = true;
+ done:
+	if (!cfd.close_fd)
+		myself->u.dir.pos = dirpos;
+	vfs_dir_fd_put(myself, cfd);
+ release:
+	fsal_readdir_batch_free(batch);
 
  out:
 	return fsalstat(fsal_error, retval);
@@ -1032,7 +1267,7 @@ static struct closefd vfs_fsal_open_and_stat(struct fsal_export *exp,
 		} else {
 			cfd.fd = myself->u.file.fd;
 		}
-		retval = fstat(cfd.fd, stat);
+		retval = vfs_io_fstat(cfd.fd, stat);
 		func = "fstat";
 		break;
 	case DIRECTORY:
@@ -1485,6 +1720,10 @@ static void release(struct fsal_obj_handle *obj_hdl)
 				"Could not close hdl 0x%p, error %s(%d)",
 				obj_hdl, strerror(st.minor), st.minor);
 		}
+		vfs_unstable_destroy(&myself->u.file.unstable);
+	} else if (type == DIRECTORY) {
+		vfs_dir_fd_close(myself);
+		pthread_rwlock_destroy(&myself->u.dir.lock);
 	}
 
 	fsal_obj_handle_uninit(obj_hdl);
@@ -1507,6 +1746,7 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->release = release;
 	ops->lookup = lookup;
 	ops->readdir = read_dirents;
+	ops->readdir_plus = read_dirents_plus;
 	ops->create = create;
 	ops->mkdir = makedir;
 	ops->mknode = makenode;
@@ -1522,7 +1762,9 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->status = vfs_status;
 	ops->read = vfs_read;
 	ops->write = vfs_write;
+	ops->write_iov = vfs_write_iov;
 	ops->commit = vfs_commit;
+	ops->io_advise = vfs_io_advise;
 	ops->lock_op = vfs_lock_op;
 	ops->close = vfs_close;
 	ops->lru_cleanup = vfs_lru_cleanup;
@@ -39,6 +39,7 @@
 #include <sys/types.h>
 #include "ganesha_list.h"
 #include "FSAL/fsal_init.h"
+#include "vfs_methods.h"
 
 /* VFS FSAL module private storage
  */
@@ -100,6 +101,12 @@ static struct config_item vfs_params[] = {
 		       fsal_staticfsinfo_t, auth_exportpath_xdev),
 	CONF_ITEM_MODE("xattr_access_rights", 0, 0777, 0400,
 		       fsal_staticfsinfo_t, xattr_access_rights),
+	CONF_ITEM_UI32("io_uring_depth", 0, 4096, 0,
+		       fsal_staticfsinfo_t, io_uring_depth),
+	CONF_ITEM_UI32("io_uring_rings", 1, 64, 4,
+		       fsal_staticfsinfo_t, io_uring_rings),
+	CONF_ITEM_BOOL("range_commit", false,
+		       fsal_staticfsinfo_t, range_commit),
 	CONFIG_EOL
 };
 
@@ -155,6 +162,8 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 	LogDebug(COMPONENT_FSAL,
 		 "FSAL INIT: Supported attributes mask = 0x%" PRIx64,
 		 vfs_me->fs_info.supported_attrs);
+	vfs_uring_init(vfs_me->fs_info.io_uring_depth,
+		       vfs_me->fs_info.io_uring_rings);
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
@@ -197,6 +206,8 @@ MODULE_FINI void vfs_unload(void)
 {
 	int retval;
 
+	vfs_uring_shutdown();
+
 	retval = unregister_fsal(&VFS.fsal);
 	if (retval != 0) {
 		fprintf(stderr, "VFS module failed to unregister");
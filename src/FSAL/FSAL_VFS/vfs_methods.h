@@ -100,6 +100,29 @@ fsal_status_t vfs_create_handle(struct fsal_export *exp_hdl,
  * this, we save the args that were used to mknod or lookup the socket.
  */
 
+/*
+ * Byte ranges of a file written UNSTABLE and not yet committed, so
+ * that COMMIT can skip files with nothing left to flush.  Until the
+ * first commit a handle does not know what earlier handles for the
+ * same file left unstable, and commits the whole file.
+ */
+
+#define VFS_UNSTABLE_EXTENTS 8
+
+struct vfs_extent {
+	uint64_t start;
+	uint64_t end;		/*< exclusive */
+	uint64_t seq;		/*< Write that last grew it */
+};
+
+struct vfs_unstable {
+	pthread_mutex_t lock;
+	bool known;		/*< Every unstable write is in ext[] */
+	uint64_t seq;		/*< Unstable writes so far */
+	uint32_t nr;		/*< Extents in use */
+	struct vfs_extent ext[VFS_UNSTABLE_EXTENTS];
+};
+
 struct vfs_fsal_obj_handle {
 	struct fsal_obj_handle obj_handle;
 	fsal_dev_t dev;
@@ -109,7 +132,13 @@ struct vfs_fsal_obj_handle {
 		struct {
 			int fd;
 			fsal_openflags_t openflags;
+			struct vfs_unstable unstable;
 		} file;
+		struct {
+			pthread_rwlock_t lock;	/*< Exclusive to move fd */
+			int fd;			/*< Cached descriptor or -1 */
+			off_t pos;		/*< Cookie fd is at, -1 unknown */
+		} dir;
 		struct {
 			unsigned char *link_content;
 			int link_size;
@@ -181,6 +210,8 @@ int vfs_fsal_open(struct vfs_fsal_obj_handle *hdl,
 		  int openflags,
 		  fsal_errors_t *fsal_error);
 
+void vfs_dir_fd_close(struct vfs_fsal_obj_handle *hdl);
+
 static inline bool vfs_unopenable_type(object_file_type_t type)
 {
 	if ((type == SOCKET_FILE) || (type == CHARACTER_FILE)
@@ -191,6 +222,9 @@ static inline bool vfs_unopenable_type(object_file_type_t type)
 	}
 }
 
+void vfs_unstable_init(struct vfs_unstable *unstable);
+void vfs_unstable_destroy(struct vfs_unstable *unstable);
+
 	/* I/O management */
 fsal_status_t vfs_open(struct fsal_obj_handle *obj_hdl,
 		       fsal_openflags_t openflags);
@@ -203,8 +237,14 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 			uint64_t offset,
 			size_t buffer_size, void *buffer, size_t *write_amount,
 			bool *fsal_stable);
+fsal_status_t vfs_write_iov(struct fsal_obj_handle *obj_hdl,
+			    uint64_t offset,
+			    const struct iovec *iov, int iovcnt,
+			    size_t *write_amount, bool *fsal_stable);
 fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 			 off_t offset, size_t len);
+fsal_status_t vfs_io_advise(struct fsal_obj_handle *obj_hdl,
+			    struct io_hints *hints);
 fsal_status_t vfs_lock_op(struct fsal_obj_handle *obj_hdl,
 			  void *p_owner,
 			  fsal_lock_op_t lock_op,
@@ -250,4 +290,73 @@ fsal_status_t vfs_remove_extattr_by_id(struct fsal_obj_handle *obj_hdl,
 fsal_status_t vfs_remove_extattr_by_name(struct fsal_obj_handle *obj_hdl,
 					 const char *xattr_name);
 
+/* File I/O.  Reads, syncs and stats may go through the optional
+ * io_uring backend when it is configured; writes always stay
+ * synchronous, see vfs_uring.c.
+ */
+#define vfs_io_pwrite pwrite
+#define vfs_io_pwritev pwritev
+
+#ifdef USE_IO_URING
+void vfs_uring_init(uint32_t depth, uint32_t nrings);
+void vfs_uring_shutdown(void);
+bool vfs_uring_enabled(void);
+ssize_t vfs_uring_pread(int fd, void *buf, size_t count, off_t offset);
+int vfs_uring_fsync(int fd, bool datasync);
+int vfs_uring_sync_file_range(int fd, off_t offset, off_t nbytes,
+			      unsigned int flags);
+int vfs_uring_fstat(int fd, struct stat *st);
+
+static inline ssize_t vfs_io_pread(int fd, void *buf, size_t count,
+				   off_t offset)
+{
+	if (vfs_uring_enabled())
+		return vfs_uring_pread(fd, buf, count, offset);
+	return pread(fd, buf, count, offset);
+}
+
+static inline int vfs_io_fsync(int fd)
+{
+	if (vfs_uring_enabled())
+		return vfs_uring_fsync(fd, false);
+	return fsync(fd);
+}
+
+static inline int vfs_io_fdatasync(int fd)
+{
+	if (vfs_uring_enabled())
+		return vfs_uring_fsync(fd, true);
+	return fdatasync(fd);
+}
+
+static inline int vfs_io_sync_file_range(int fd, off_t offset, off_t nbytes,
+					 unsigned int flags)
+{
+	if (vfs_uring_enabled())
+		return vfs_uring_sync_file_range(fd, offset, nbytes, flags);
+	return sync_file_range(fd, offset, nbytes, flags);
+}
+
+static inline int vfs_io_fstat(int fd, struct stat *st)
+{
+	if (vfs_uring_enabled())
+		return vfs_uring_fstat(fd, st);
+	return fstat(fd, st);
+}
+#else
+static inline void vfs_uring_init(uint32_t depth, uint32_t nrings)
+{
+}
+
+static inline void vfs_uring_shutdown(void)
+{
+}
+
+#define vfs_io_pread pread
+#define vfs_io_fsync fsync
+#define vfs_io_fdatasync fdatasync
+#define vfs_io_sync_file_range sync_file_range
+#define vfs_io_fstat fstat
+#endif
+
 #endif			/* VFS_METHODS_H */
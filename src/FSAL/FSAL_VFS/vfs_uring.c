@@ -0,0 +1,502 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* vfs_uring.c
+ * Optional io_uring backend for VFS reads, syncs and stats
+ *
+ * Workers put their read, fsync and statx requests on one of a
+ * few shared rings and park on a futex until a reaper thread, one per
+ * ring, posts the completion.  The worker still waits for the whole
+ * I/O, exactly as it would in pread, so this frees no worker for
+ * other requests; what it changes is that the kernel sees every
+ * worker's I/O on a few queues it can keep deep.  Whether that beats
+ * pread depends on the storage, hence it is off unless configured.
+ *
+ * If a reaper fails, the requests on its ring fail with EIO and the
+ * ring is given up, later requests going straight to the system
+ * calls.
+ *
+ * The kernel runs an entry with the credentials of the thread that
+ * submits it.  Each worker therefore submits its own entry while
+ * holding the ring's submission lock, so no entry ever goes in under
+ * another worker's fsuid/fsgid.  Writes, whose effect (clearing
+ * setuid/setgid bits) depends on the caller's credentials, are not
+ * routed here at all.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <liburing.h>
+#include "fsal.h"
+#include "gsh_futex.h"
+#include "ganesha_list.h"
+#include "vfs_methods.h"
+
+struct vfs_uring {
+	struct io_uring ring;
+	pthread_mutex_t sq_lock;	/*< Serializes the submission queue */
+	pthread_t reaper;		/*< Posts completions */
+	bool dead;			/*< Reaper gone, protected by
+					    sq_lock */
+	pthread_mutex_t op_lock;	/*< Protects inflight */
+	struct glist_head inflight;	/*< Submitted, not yet completed */
+};
+
+/**
+ * @brief One request in flight, on its submitter's stack
+ */
+
+struct vfs_uring_op {
+	struct glist_head list;	/*< On the ring's inflight */
+	int32_t res;		/*< Result, -errno on failure */
+	uint32_t done;		/*< Futex word, set on completion */
+};
+
+static struct vfs_uring *vfs_rings;
+static uint32_t vfs_nrings;
+
+/* Spread submitters over the rings */
+static uint32_t vfs_ring_next;
+static __thread struct vfs_uring *vfs_my_ring;
+
+/**
+ * @brief Wake a submitter with its result
+ *
+ * The op is gone once done is set, so it leaves inflight first.
+ */
+
+static void vfs_uring_post(struct vfs_uring *vr, struct vfs_uring_op *op,
+			   int32_t res)
+{
+	pthread_mutex_lock(&vr->op_lock);
+	glist_del(&op->list);
+	pthread_mutex_unlock(&vr->op_lock);
+
+	op->res = res;
+	__atomic_store_n(&op->done, 1, __ATOMIC_RELEASE);
+	gsh_futex_wake(&op->done, 1);
+}
+
+/**
+ * @brief Give up a ring whose reaper cannot go on
+ *
+ * Once dead is set under the submission lock nothing more is added
+ * to inflight, so failing what is there releases every submitter.
+ */
+
+static void vfs_uring_kill(struct vfs_uring *vr)
+{
+	struct vfs_uring_op *op;
+
+	pthread_mutex_lock(&vr->sq_lock);
+	vr->dead = true;
+	pthread_mutex_unlock(&vr->sq_lock);
+
+	pthread_mutex_lock(&vr->op_lock);
+	while ((op = glist_first_entry(&vr->inflight, struct vfs_uring_op,
+				       list)) != NULL) {
+		glist_del(&op->list);
+		op->res = -EIO;
+		__atomic_store_n(&op->done, 1, __ATOMIC_RELEASE);
+		gsh_futex_wake(&op->done, 1);
+	}
+	pthread_mutex_unlock(&vr->op_lock);
+}
+
+/**
+ * @brief Post completions to their parked submitters
+ */
+
+static void *vfs_uring_reaper(void *arg)
+{
+	struct vfs_uring *vr = arg;
+	struct io_uring_cqe *cqe;
+	struct vfs_uring_op *op;
+	int32_t res;
+	int rc;
+
+	SetNameFunction("vfs_uring");
+
+	for (;;) {
+		rc = io_uring_wait_cqe(&vr->ring, &cqe);
+		if (rc == -EINTR)
+			continue;
+		if (rc < 0) {
+			LogCrit(COMPONENT_FSAL,
+				"io_uring_wait_cqe failed: %s, failing its I/O and using synchronous I/O",
+				strerror(-rc));
+			vfs_uring_kill(vr);
+			break;
+		}
+
+		op = io_uring_cqe_get_data(cqe);
+		if (op == NULL) {
+			/* shutdown marker */
+			io_uring_cqe_seen(&vr->ring, cqe);
+			break;
+		}
+		res = cqe->res;
+		io_uring_cqe_seen(&vr->ring, cqe);
+		vfs_uring_post(vr, op, res);
+	}
+	return NULL;
+}
+
+/* Operations the engine issues */
+static const int vfs_uring_ops[] = {
+	IORING_OP_NOP,
+	IORING_OP_READ,
+	IORING_OP_FSYNC,
+	IORING_OP_SYNC_FILE_RANGE,
+	IORING_OP_STATX,
+};
+
+/**
+ * @brief Check that the kernel supports every operation we issue
+ *
+ * Kernels before 5.6 have no probe, and lack IORING_OP_READ and
+ * IORING_OP_STATX anyway.
+ *
+ * @param[in] ring A ring set up on this kernel
+ *
+ * @return true if all are supported.
+ */
+
+static bool vfs_uring_probe(struct io_uring *ring)
+{
+	struct io_uring_probe *probe = io_uring_get_probe_ring(ring);
+	bool ok = probe != NULL;
+	size_t ix;
+
+	for (ix = 0; ok && ix < sizeof(vfs_uring_ops) / sizeof(vfs_uring_ops[0]);
+	     ix++) {
+		if (!io_uring_opcode_supported(probe, vfs_uring_ops[ix])) {
+			LogWarn(COMPONENT_FSAL,
+				"io_uring opcode %d not supported, using synchronous I/O",
+				vfs_uring_ops[ix]);
+			ok = false;
+		}
+	}
+
+	if (probe == NULL)
+		LogWarn(COMPONENT_FSAL,
+			"io_uring cannot be probed, using synchronous I/O");
+	else
+		io_uring_free_probe(probe);
+
+	return ok;
+}
+
+/**
+ * @brief Start the engine
+ *
+ * Failure to set up io_uring, for instance on a kernel without it or
+ * without the operations we need, is not fatal: I/O then stays
+ * synchronous.
+ *
+ * @param[in] depth Submission queue entries per ring, 0 to disable
+ * @param[in] nrings Number of rings
+ */
+
+void vfs_uring_init(uint32_t depth, uint32_t nrings)
+{
+	uint32_t ix;
+	int rc;
+
+	if (depth == 0 || nrings == 0 || vfs_rings != NULL)
+		return;
+
+	vfs_rings = gsh_calloc(nrings, sizeof(struct vfs_uring));
+	if (vfs_rings == NULL) {
+		LogCrit(COMPONENT_FSAL,
+			"Could not allocate io_uring rings, using synchronous I/O");
+		return;
+	}
+
+	for (ix = 0; ix < nrings; ix++) {
+		struct vfs_uring *vr = &vfs_rings[ix];
+
+		rc = io_uring_queue_init(depth, &vr->ring, 0);
+		if (rc < 0) {
+			LogWarn(COMPONENT_FSAL,
+				"io_uring_queue_init failed: %s, using synchronous I/O",
+				strerror(-rc));
+			break;
+		}
+		if (ix == 0 && !vfs_uring_probe(&vr->ring)) {
+			io_uring_queue_exit(&vr->ring);
+			break;
+		}
+		pthread_mutex_init(&vr->sq_lock, NULL);
+		pthread_mutex_init(&vr->op_lock, NULL);
+		glist_init(&vr->inflight);
+		rc = pthread_create(&vr->reaper, NULL, vfs_uring_reaper, vr);
+		if (rc != 0) {
+			LogCrit(COMPONENT_FSAL,
+				"Could not start io_uring reaper: %s, using synchronous I/O",
+				strerror(rc));
+			pthread_mutex_destroy(&vr->op_lock);
+			pthread_mutex_destroy(&vr->sq_lock);
+			io_uring_queue_exit(&vr->ring);
+			break;
+		}
+	}
+
+	if (ix < nrings) {
+		/* tear down what did start */
+		vfs_nrings = ix;
+		vfs_uring_shutdown();
+		return;
+	}
+
+	vfs_nrings = nrings;
+	LogInfo(COMPONENT_FSAL,
+		"io_uring I/O enabled, %" PRIu32 " rings of depth %" PRIu32,
+		nrings, depth);
+}
+
+/**
+ * @brief Stop the engine
+ *
+ * There must be no I/O in flight.
+ */
+
+void vfs_uring_shutdown(void)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t ix;
+
+	for (ix = 0; ix < vfs_nrings; ix++) {
+		struct vfs_uring *vr = &vfs_rings[ix];
+
+		pthread_mutex_lock(&vr->sq_lock);
+		if (!vr->dead) {
+			sqe = io_uring_get_sqe(&vr->ring);
+			while (sqe == NULL) {
+				io_uring_submit(&vr->ring);
+				sqe = io_uring_get_sqe(&vr->ring);
+			}
+			io_uring_prep_nop(sqe);
+			io_uring_sqe_set_data(sqe, NULL);
+			io_uring_submit(&vr->ring);
+		}
+		pthread_mutex_unlock(&vr->sq_lock);
+
+		pthread_join(vr->reaper, NULL);
+		pthread_mutex_destroy(&vr->op_lock);
+		pthread_mutex_destroy(&vr->sq_lock);
+		io_uring_queue_exit(&vr->ring);
+	}
+
+	vfs_nrings = 0;
+	gsh_free(vfs_rings);
+	vfs_rings = NULL;
+}
+
+/**
+ * @brief Is the engine running?
+ */
+
+bool vfs_uring_enabled(void)
+{
+	return vfs_nrings != 0;
+}
+
+/**
+ * @brief Get a submission entry on this thread's ring
+ *
+ * Returns with the ring's submission lock held, or NULL without it
+ * if the ring has been given up.
+ */
+
+static struct io_uring_sqe *vfs_uring_get_sqe(struct vfs_uring **vrp)
+{
+	struct vfs_uring *vr = vfs_my_ring;
+	struct io_uring_sqe *sqe;
+
+	if (vr == NULL) {
+		vr = &vfs_rings[__atomic_fetch_add(&vfs_ring_next, 1,
+						   __ATOMIC_RELAXED)
+				% vfs_nrings];
+		vfs_my_ring = vr;
+	}
+
+	pthread_mutex_lock(&vr->sq_lock);
+	if (vr->dead) {
+		pthread_mutex_unlock(&vr->sq_lock);
+		return NULL;
+	}
+	sqe = io_uring_get_sqe(&vr->ring);
+	while (sqe == NULL) {
+		/* submission queue full, push it to the kernel */
+		io_uring_submit(&vr->ring);
+		sqe = io_uring_get_sqe(&vr->ring);
+	}
+	*vrp = vr;
+	return sqe;
+}
+
+/**
+ * @brief Submit a prepared entry and park until it completes
+ *
+ * @return The operation's result, -errno on failure.
+ */
+
+static int vfs_uring_submit_wait(struct vfs_uring *vr,
+				 struct io_uring_sqe *sqe)
+{
+	struct vfs_uring_op op = { .res = 0, .done = 0 };
+	int rc;
+
+	io_uring_sqe_set_data(sqe, &op);
+
+	pthread_mutex_lock(&vr->op_lock);
+	glist_add_tail(&vr->inflight, &op.list);
+	pthread_mutex_unlock(&vr->op_lock);
+
+	/* Once queued the entry points at op whatever happens, so it has
+	 * to reach the kernel and complete before we can return.  It
+	 * must also reach it from this thread, with our credentials, so
+	 * the lock is held until the kernel has taken it.
+	 */
+	for (;;) {
+		rc = io_uring_submit(&vr->ring);
+		if (rc > 0)
+			break;
+		if (rc < 0 && rc != -EAGAIN && rc != -EBUSY && rc != -EINTR)
+			LogFatal(COMPONENT_FSAL,
+				 "io_uring_submit failed: %s",
+				 strerror(-rc));
+		sched_yield();
+	}
+	pthread_mutex_unlock(&vr->sq_lock);
+
+	while (__atomic_load_n(&op.done, __ATOMIC_ACQUIRE) == 0)
+		gsh_futex_wait(&op.done, 0, NULL);
+
+	return op.res;
+}
+
+/* The wrappers below follow their system call counterparts: -1 with
+ * errno set on failure.  On a ring that has been given up they make
+ * the system call.
+ */
+
+ssize_t vfs_uring_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	struct vfs_uring *vr;
+	struct io_uring_sqe *sqe = vfs_uring_get_sqe(&vr);
+	int rc;
+
+	if (sqe == NULL)
+		return pread(fd, buf, count, offset);
+
+	io_uring_prep_read(sqe, fd, buf, count, offset);
+	rc = vfs_uring_submit_wait(vr, sqe);
+	if (rc < 0) {
+		errno = -rc;
+		return -1;
+	}
+	return rc;
+}
+
+int vfs_uring_fsync(int fd, bool datasync)
+{
+	struct vfs_uring *vr;
+	struct io_uring_sqe *sqe = vfs_uring_get_sqe(&vr);
+	int rc;
+
+	if (sqe == NULL)
+		return datasync ? fdatasync(fd) : fsync(fd);
+
+	io_uring_prep_fsync(sqe, fd, datasync ? IORING_FSYNC_DATASYNC : 0);
+	rc = vfs_uring_submit_wait(vr, sqe);
+	if (rc < 0) {
+		errno = -rc;
+		return -1;
+	}
+	return 0;
+}
+
+int vfs_uring_sync_file_range(int fd, off_t offset, off_t nbytes,
+			      unsigned int flags)
+{
+	struct vfs_uring *vr;
+	struct io_uring_sqe *sqe = vfs_uring_get_sqe(&vr);
+	int rc;
+
+	if (sqe == NULL)
+		return sync_file_range(fd, offset, nbytes, flags);
+
+	io_uring_prep_sync_file_range(sqe, fd, nbytes, offset, flags);
+	rc = vfs_uring_submit_wait(vr, sqe);
+	if (rc < 0) {
+		errno = -rc;
+		return -1;
+	}
+	return 0;
+}
+
+int vfs_uring_fstat(int fd, struct stat *st)
+{
+	struct vfs_uring *vr;
+	struct io_uring_sqe *sqe;
+	struct statx stx;
+	int rc;
+
+	sqe = vfs_uring_get_sqe(&vr);
+	if (sqe == NULL)
+		return fstat(fd, st);
+
+	io_uring_prep_statx(sqe, fd, "", AT_EMPTY_PATH | AT_SYMLINK_NOFOLLOW,
+			    STATX_BASIC_STATS, &stx);
+	rc = vfs_uring_submit_wait(vr, sqe);
+	if (rc < 0) {
+		errno = -rc;
+		return -1;
+	}
+
+	memset(st, 0, sizeof(*st));
+	st->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+	st->st_ino = stx.stx_ino;
+	st->st_mode = stx.stx_mode;
+	st->st_nlink = stx.stx_nlink;
+	st->st_uid = stx.stx_uid;
+	st->st_gid = stx.stx_gid;
+	st->st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+	st->st_size = stx.stx_size;
+	st->st_blksize = stx.stx_blksize;
+	st->st_blocks = stx.stx_blocks;
+	st->st_atim.tv_sec = stx.stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+	return 0;
+}
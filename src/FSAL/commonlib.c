@@ -232,6 +232,108 @@ void fsal_ds_handle_uninit(struct fsal_ds_handle *ds)
 	ds->fsal = NULL;
 }
 
+/**
+ * @brief Allocate a batch for a readdir_plus implementation
+ *
+ * Free it with fsal_readdir_batch_free.
+ *
+ * @param[in] cb        Callback passed to readdir_plus
+ * @param[in] dir_state Opaque state passed to readdir_plus
+ *
+ * @return The batch, or NULL on allocation failure.
+ */
+
+struct fsal_readdir_batch *fsal_readdir_batch_alloc(fsal_readdir_plus_cb cb,
+						    void *dir_state)
+{
+	struct fsal_readdir_batch *batch =
+		gsh_malloc(sizeof(struct fsal_readdir_batch));
+
+	if (batch == NULL)
+		return NULL;
+
+	batch->cb = cb;
+	batch->dir_state = dir_state;
+	batch->count = 0;
+	return batch;
+}
+
+/**
+ * @brief Hand the pending entries of a batch to the callback
+ *
+ * @param[in] batch Batch
+ *
+ * @return false if the callback wants no more entries.
+ */
+
+bool fsal_readdir_batch_flush(struct fsal_readdir_batch *batch)
+{
+	unsigned int count = batch->count;
+
+	if (count == 0)
+		return true;
+
+	batch->count = 0;
+	return batch->cb(batch->entries, count, batch->dir_state);
+}
+
+/**
+ * @brief Add an entry to a batch, flushing it when full
+ *
+ * The name is copied; the handle passes to the batch, and from it
+ * to the callback.
+ *
+ * @param[in] batch  Batch
+ * @param[in] name   Entry name
+ * @param[in] cookie Cookie to resume after the entry
+ * @param[in] status Result of looking the entry up
+ * @param[in] hdl    Handle, or NULL if @c status is an error
+ *
+ * @return false if the callback wants no more entries.
+ */
+
+bool fsal_readdir_batch_add(struct fsal_readdir_batch *batch,
+			    const char *name, fsal_cookie_t cookie,
+			    fsal_status_t status,
+			    struct fsal_obj_handle *hdl)
+{
+	struct fsal_readdir_entry *entry = &batch->entries[batch->count];
+	char *copy = batch->names[batch->count];
+
+	strncpy(copy, name, MAXNAMLEN);
+	copy[MAXNAMLEN] = '\0';
+	entry->name = copy;
+	entry->cookie = cookie;
+	entry->status = status;
+	entry->hdl = hdl;
+
+	if (++batch->count < FSAL_READDIR_BATCH)
+		return true;
+
+	return fsal_readdir_batch_flush(batch);
+}
+
+/**
+ * @brief Free a batch
+ *
+ * Handles in entries that were never flushed, because reading the
+ * directory failed part way, are released.
+ *
+ * @param[in] batch Batch
+ */
+
+void fsal_readdir_batch_free(struct fsal_readdir_batch *batch)
+{
+	unsigned int ix;
+
+	for (ix = 0; ix < batch->count; ix++) {
+		if (batch->entries[ix].hdl != NULL)
+			batch->entries[ix].hdl->ops->release(
+						batch->entries[ix].hdl);
+	}
+	gsh_free(batch);
+}
+
 /**
  * @brief FSAL error code to error message
  *
@@ -552,6 +552,17 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+/* read_dirents_plus
+ * default case not supported, callers fall back on readdir and lookup
+ */
+
+static fsal_status_t read_dirents_plus(struct fsal_obj_handle *dir_hdl,
+				       fsal_cookie_t *whence, void *dir_state,
+				       fsal_readdir_plus_cb cb, bool *eof)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, 0);
+}
+
 /* create
  * default case not supported
  */
@@ -738,6 +749,45 @@ static fsal_status_t file_write_plus(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+/* file_write_iov
+ * default case falls back on write, one segment at a time.  With more
+ * than one segment nothing is written stable, leaving the caller to
+ * commit the whole range.
+ */
+
+static fsal_status_t file_write_iov(struct fsal_obj_handle *obj_hdl,
+				    uint64_t seek_descriptor,
+				    const struct iovec *iov, int iovcnt,
+				    size_t *write_amount, bool *fsal_stable)
+{
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	size_t written;
+	bool stable;
+	int i;
+
+	if (iovcnt == 1)
+		return obj_hdl->ops->write(obj_hdl, seek_descriptor,
+					   iov[0].iov_len, iov[0].iov_base,
+					   write_amount, fsal_stable);
+
+	*write_amount = 0;
+	for (i = 0; i < iovcnt; i++) {
+		stable = false;
+		written = 0;
+		status = obj_hdl->ops->write(obj_hdl, seek_descriptor,
+					     iov[i].iov_len, iov[i].iov_base,
+					     &written, &stable);
+		if (FSAL_IS_ERROR(status))
+			break;
+		*write_amount += written;
+		seek_descriptor += written;
+		if (written < iov[i].iov_len)
+			break;
+	}
+	*fsal_stable = false;
+	return status;
+}
+
 /* seek
  * default case not supported
  */
@@ -1053,7 +1103,9 @@ struct fsal_obj_ops def_handle_ops = {
 	.handle_to_key = handle_to_key,
 	.layoutget = layoutget,
 	.layoutreturn = layoutreturn,
-	.layoutcommit = layoutcommit
+	.layoutcommit = layoutcommit,
+	.write_iov = file_write_iov,
+	.readdir_plus = read_dirents_plus
 };
 
 /* fsal_ds_handle common methods */
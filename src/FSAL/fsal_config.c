@@ -98,6 +98,8 @@ bool fsal_supports(struct fsal_staticfsinfo_t *info,
 		return !!info->share_support_owner;
 	case fso_reopen_method:
 		return !!info->reopen_method;
+	case fso_readahead_buffer:
+		return !!info->readahead_buffer;
 	default:
 		return false;	/* whatever I don't know about,
 				 * you can't do
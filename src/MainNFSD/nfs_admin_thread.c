@@ -41,6 +41,8 @@
 #include "idmapper.h"
 #include "delayed_exec.h"
 #include "export_mgr.h"
+#include "nfs_exports.h"
+#include "nlm_async.h"
 #ifdef USE_DBUS
 #include "ganesha_dbus.h"
 #endif
@@ -224,10 +226,50 @@ static struct gsh_dbus_method method_purge_gids = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Dbus method for rereading the exports
+ *
+ * @param[in]  args
+ * @param[out] reply
+ */
+static bool admin_dbus_reload_exports(DBusMessageIter *args,
+				      DBusMessage *reply,
+				      DBusError *error)
+{
+	char *errormsg = "Exports reloaded";
+	bool success = true;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Reload takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+
+	if (!admin_replace_exports()) {
+		errormsg = "Exports reloaded with errors";
+		success = false;
+	}
+
+ out:
+	dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_reload_exports = {
+	.name = "reload",
+	.method = admin_dbus_reload_exports,
+	.args = {STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *admin_methods[] = {
 	&method_shutdown,
 	&method_grace_period,
 	&method_purge_gids,
+	&method_reload_exports,
 	NULL
 };
 
@@ -278,12 +320,32 @@ static void admin_issue_command(admin_command_t command)
 }
 
 /**
- * @brief Signal the admin thread to replace the exports
+ * @brief Reread the exports from the configuration file
+ *
+ * Exports are updated in place where they can be, see
+ * reload_exports.
+ *
+ * @return true if the whole file was applied.
  */
 
-void admin_replace_exports(void)
+bool admin_replace_exports(void)
 {
-	admin_issue_command(admin_command);
+	struct config_error_type err_type;
+	config_file_t config_struct;
+	int rc;
+
+	config_struct = config_ParseFile(config_path, &err_type);
+	if (!config_error_is_harmless(&err_type)) {
+		LogCrit(COMPONENT_CONFIG,
+			"Error while parsing %s, exports not reloaded",
+			config_path);
+		config_Free(config_struct);
+		return false;
+	}
+
+	rc = reload_exports(config_struct);
+	config_Free(config_struct);
+	return rc >= 0;
 }
 
 /**
@@ -318,6 +380,16 @@ static void do_shutdown(void)
 			 "State asynchronous request system shut down.");
 	}
 
+	LogEvent(COMPONENT_MAIN, "Stopping NLM callback threads");
+	rc = nlm_async_callback_shutdown();
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Error shutting down NLM callback threads: %d", rc);
+		disorderly = true;
+	} else {
+		LogEvent(COMPONENT_THREAD, "NLM callback threads shut down.");
+	}
+
 	LogEvent(COMPONENT_MAIN, "Stopping request listener threads.");
 	nfs_rpc_dispatch_stop();
 
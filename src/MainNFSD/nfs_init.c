@@ -68,6 +68,7 @@
 #include "delayed_exec.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "buffer_pool.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
@@ -477,6 +478,7 @@ static void nfs_Start_threads(void)
 static void nfs_Init(const nfs_start_info_t *p_start_info)
 {
 	int rc = 0;
+	struct timespec start, end;
 #ifdef _HAVE_GSSAPI
 	gss_buffer_desc gss_service_buf;
 	OM_uint32 maj_stat, min_stat;
@@ -540,6 +542,9 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 		LogFatal(COMPONENT_INIT,
 			"Error while allocating duplicate request pool");
 
+	/* READ, READDIR and fattr4 encoding buffers */
+	gsh_buf_pkginit();
+
 	/* If rpcsec_gss is used, set the path to the keytab */
 #ifdef _HAVE_GSSAPI
 #ifdef HAVE_KRB5
@@ -684,10 +689,13 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Creates the pseudo fs */
 	LogDebug(COMPONENT_INIT, "Now building pseudo fs");
 
+	now(&start);
 	create_pseudofs();
+	now(&end);
 
-	LogInfo(COMPONENT_INIT,
-		"NFSv4 pseudo file system successfully initialized");
+	LogEvent(COMPONENT_INIT,
+		 "NFSv4 pseudo file system built in %" PRIu64 " ms",
+		 timespec_diff(&start, &end) / NS_PER_MSEC);
 
 	/* Save Ganesha thread credentials with Frank's routine for later use */
 	fsal_save_ganesha_credentials();
@@ -695,7 +703,7 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Create stable storage directory, this needs to be done before
 	 * starting the recovery thread.
 	 */
-	nfs4_create_recov_dir();
+	nfs4_recovery_init();
 
 	/* initialize grace and read in the client IDs */
 	nfs4_init_grace();
@@ -788,6 +796,8 @@ static void lower_my_caps(void)
  */
 void nfs_start(nfs_start_info_t *p_start_info)
 {
+	struct timespec ready;
+
 	/* store the start info so it is available for all layers */
 	nfs_start_info = *p_start_info;
 
@@ -836,6 +846,10 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	LogEvent(COMPONENT_INIT,
 		 "-------------------------------------------------");
 
+	now(&ready);
+	LogEvent(COMPONENT_INIT, "Startup took %" PRIu64 " ms",
+		 timespec_diff(&ServerBootTime, &ready) / NS_PER_MSEC);
+
 	/* Wait for dispatcher to exit */
 	LogDebug(COMPONENT_THREAD, "Wait for admin thread to exit");
 	pthread_join(admin_thrid, NULL);
@@ -845,7 +859,9 @@ void nfs_start(nfs_start_info_t *p_start_info)
 
 	/* if not in grace period, clean up the old state directory */
 	if (!nfs_in_grace())
-		nfs4_clean_old_recov_dir(v4_old_dir);
+		nfs4_end_grace();
+
+	nfs4_recovery_shutdown();
 
 	Cleanup();
 
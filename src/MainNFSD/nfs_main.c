@@ -102,6 +102,7 @@ int main(int argc, char *argv[])
 #endif
 	sigset_t signals_to_block;
 	struct config_error_type err_type;
+	struct timespec start, end;
 
 	/* Set the server's boot time and epoch */
 	now(&ServerBootTime);
@@ -411,13 +412,19 @@ int main(int argc, char *argv[])
 	/* Load export entries from parsed file
 	 * returns the number of export entries.
 	 */
+	now(&start);
 	rc = ReadExports(config_struct);
+	now(&end);
 	if (rc < 0)
 		LogFatal(COMPONENT_INIT,
 			  "Error while parsing export entries");
 	else if (rc == 0)
 		LogWarn(COMPONENT_INIT,
 			"No export entries found in configuration file !!!");
+	else
+		LogEvent(COMPONENT_INIT,
+			 "Created %d exports in %" PRIu64 " ms",
+			 rc, timespec_diff(&start, &end) / NS_PER_MSEC);
 
 	/* freeing syntax tree : */
 
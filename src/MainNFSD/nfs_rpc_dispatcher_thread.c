@@ -30,13 +30,18 @@
  */
 #include "config.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <fcntl.h>
 #include <sys/file.h>		/* for having FNDELAY */
 #include <sys/select.h>
 #include <poll.h>
 #include <assert.h>
+#include <errno.h>
 #include "hashtable.h"
 #include "log.h"
 #include "ganesha_rpc.h"
@@ -55,7 +60,9 @@
 #include "nfs_req_queue.h"
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
+#include "export_mgr.h"
 #include "fridgethr.h"
+#include "client_mgr.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -65,6 +72,7 @@
 struct rpc_evchan {
 	uint32_t chan_id;	/*< Channel ID */
 	pthread_t thread_id;	/*< POSIX thread ID */
+	uint32_t node;		/*< NUMA node served (TCP channels) */
 };
 
 #define N_TCP_EVENT_CHAN  3	/*< We don't really want to have too many,
@@ -72,9 +80,11 @@ struct rpc_evchan {
 #define UDP_EVENT_CHAN    0	/*< Put UDP on a dedicated channel */
 #define TCP_RDVS_CHAN     1	/*< Accepts new tcp connections */
 #define TCP_EVCHAN_0      2
-#define N_EVENT_CHAN (N_TCP_EVENT_CHAN + 2)
+/* With NUMA_Affinity, every node gets at least one TCP channel */
+#define N_EVENT_CHAN_MAX (REQ_MAX_NODES + 2)
 
-static struct rpc_evchan rpc_evchan[N_EVENT_CHAN];
+static struct rpc_evchan rpc_evchan[N_EVENT_CHAN_MAX];
+static uint32_t n_event_chan;	/*< Channels in use */
 
 struct fridgethr *req_fridge;	/*< Decoder thread pool */
 struct nfs_req_st nfs_req_st;	/*< Shared request queues */
@@ -473,8 +483,16 @@ void nfs_Init_svc()
 		LogCrit(COMPONENT_INIT, "Failed redirecting TI-RPC __free");
 #endif				/* TIRPC_SET_ALLOCATORS */
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	n_event_chan = TCP_EVCHAN_0 + N_TCP_EVENT_CHAN;
+	if (nfs_req_st.n_nodes > N_TCP_EVENT_CHAN)
+		n_event_chan = TCP_EVCHAN_0 + nfs_req_st.n_nodes;
+
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		rpc_evchan[ix].chan_id = 0;
+		/* TCP channels are dealt out to the nodes in turn */
+		if (ix >= TCP_EVCHAN_0)
+			rpc_evchan[ix].node =
+			    (ix - TCP_EVCHAN_0) % nfs_req_st.n_nodes;
 		code = svc_rqst_new_evchan(&rpc_evchan[ix].chan_id,
 					   NULL /* u_data */,
 					   SVC_RQST_FLAG_NONE);
@@ -657,7 +675,7 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	int ix, code = 0;
 
 	/* Start event channel service threads */
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		code = pthread_create(&rpc_evchan[ix].thread_id, attr_thr,
 				      rpc_dispatcher_thread,
 				      (void *)&rpc_evchan[ix].chan_id);
@@ -668,19 +686,47 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	}
 	LogInfo(COMPONENT_THREAD,
 		"%d rpc dispatcher threads were started successfully",
-		N_EVENT_CHAN);
+		n_event_chan);
 }
 
 void nfs_rpc_dispatch_stop(void)
 {
 	int ix;
 
-	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
+	for (ix = 0; ix < n_event_chan; ++ix) {
 		svc_rqst_thrd_signal(rpc_evchan[ix].chan_id,
 				     SVC_RQST_SIGNAL_SHUTDOWN);
 	}
 }
 
+/**
+ * @brief Choose the NUMA node to serve a new connection
+ *
+ * That of the CPU which processed its incoming packets, where the
+ * kernel can tell us, otherwise the nodes in turn.
+ *
+ * @param[in] xprt Newly accepted transport
+ *
+ * @return Node index.
+ */
+static uint32_t nfs_rpc_xprt_node(SVCXPRT *xprt)
+{
+	static uint32_t next_node;
+	int cpu = -1;
+	socklen_t len = sizeof(cpu);
+
+	if (nfs_req_st.n_nodes == 1)
+		return 0;
+
+#ifdef SO_INCOMING_CPU
+	if (getsockopt(xprt->xp_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu,
+		       &len) == 0 && cpu >= 0)
+		return nfs_rpc_cpu_node(cpu);
+#endif
+
+	return atomic_inc_uint32_t(&next_node) % nfs_req_st.n_nodes;
+}
+
 /**
  * @brief Rendezvous callout.  This routine will be called by TI-RPC
  *        after newxprt has been accepted.
@@ -689,6 +735,16 @@ void nfs_rpc_dispatch_stop(void)
  * could become involved.  To start with, just cycle through them as
  * new connections are accepted.
  *
+ * The peer address of a connection never changes, so its client
+ * block is looked up here, once, and pinned in the private data for
+ * nfs_rpc_execute to use.  The reference is held until the
+ * connection is destroyed, so a client cannot be removed (see
+ * remove_gsh_client) while it has connections open.
+ *
+ * With NUMA_Affinity, the connection is assigned to the node of the
+ * CPU that received its traffic, and only that node's channels and
+ * workers serve it.
+ *
  * @param[in] xprt    Transport
  * @param[in] newxprt Newly created transport
  * @param[in] flags   Unused
@@ -699,20 +755,28 @@ void nfs_rpc_dispatch_stop(void)
 static u_int nfs_rpc_rdvs(SVCXPRT *xprt, SVCXPRT *newxprt, const u_int flags,
 			  void *u_data)
 {
-	static uint32_t next_chan = TCP_EVCHAN_0;
+	static uint32_t next_chan[REQ_MAX_NODES];
 	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
-	uint32_t tchan;
+	uint32_t n_nodes = nfs_req_st.n_nodes;
+	gsh_xprt_private_t *xu;
+	uint32_t tchan, nchan;
 
-	pthread_mutex_lock(&mtx);
+	/* setup private data (freed when xprt is destroyed) */
+	xu = alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+	if (copy_xprt_addr(&xu->addr, newxprt))
+		xu->client = get_gsh_client(&xu->addr, false);
+	xu->node = nfs_rpc_xprt_node(newxprt);
+	newxprt->xp_u1 = xu;
 
-	tchan = next_chan;
-	assert((next_chan >= TCP_EVCHAN_0) && (next_chan < N_EVENT_CHAN));
-	if (++next_chan >= N_EVENT_CHAN)
-		next_chan = TCP_EVCHAN_0;
+	/* cycle through the channels of the node */
+	nchan = (n_event_chan - TCP_EVCHAN_0 - xu->node + n_nodes - 1) /
+		n_nodes;
 
-	/* setup private data (freed when xprt is destroyed) */
-	newxprt->xp_u1 =
-	    alloc_gsh_xprt_private(newxprt, XPRT_PRIVATE_FLAG_NONE);
+	pthread_mutex_lock(&mtx);
+
+	tchan = TCP_EVCHAN_0 + xu->node +
+		(next_chan[xu->node]++ % nchan) * n_nodes;
+	assert((tchan >= TCP_EVCHAN_0) && (tchan < n_event_chan));
 
 	/* NB: xu->drc is allocated on first request--we need shared
 	 * TCP DRC for v3, but per-connection for v4 */
@@ -755,18 +819,19 @@ uint32_t nfs_rpc_outstanding_reqs_est(void)
 {
 	static uint32_t ctr;
 	static uint32_t nreqs;
-	struct req_q_pair *qpair;
-	uint32_t treqs;
+	struct req_q *q;
+	uint32_t treqs, node;
 	int ix;
 
 	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
 		return atomic_fetch_uint32_t(&nreqs);
 
 	treqs = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		treqs += atomic_fetch_uint32_t(&qpair->producer.size);
-		treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
+	for (node = 0; node < nfs_req_st.n_nodes; ++node) {
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			q = &(nfs_req_st.reqs[node].nfs_request_q.qset[ix]);
+			treqs += nfs_rpc_q_size(q);
+		}
 	}
 
 	atomic_store_uint32_t(&nreqs, treqs);
@@ -887,12 +952,207 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	return TRUE;
 }
 
+/** Node of each CPU, filled in by nfs_rpc_numa_init */
+static uint8_t cpu_node[CPU_SETSIZE];
+/** CPUs of each node */
+static cpu_set_t node_cpus[REQ_MAX_NODES];
+
+/**
+ * @brief Parse a sysfs list such as "0-7,16-23" into a CPU set
+ *
+ * @param[in]  list List to parse
+ * @param[out] set  Members of the list
+ *
+ * @return true if the list was well formed.
+ */
+static bool nfs_rpc_parse_list(const char *list, cpu_set_t *set)
+{
+	const char *p = list;
+	char *end;
+	long lo, hi;
+
+	CPU_ZERO(set);
+	while (*p != '\0' && *p != '\n') {
+		lo = strtol(p, &end, 10);
+		if (end == p || lo < 0)
+			return false;
+		hi = lo;
+		p = end;
+		if (*p == '-') {
+			hi = strtol(p + 1, &end, 10);
+			if (end == p + 1 || hi < lo)
+				return false;
+			p = end;
+		}
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, set);
+		if (*p == ',')
+			p++;
+	}
+	return true;
+}
+
+/**
+ * @brief Read a sysfs list file into a CPU set
+ *
+ * @param[in]  path File to read
+ * @param[out] set  Members of the list
+ *
+ * @return true if the file could be read and parsed.
+ */
+static bool nfs_rpc_read_list(const char *path, cpu_set_t *set)
+{
+	char buf[1024];
+	FILE *fp;
+	bool ok;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+	ok = fgets(buf, sizeof(buf), fp) != NULL &&
+	     nfs_rpc_parse_list(buf, set);
+	fclose(fp);
+	return ok;
+}
+
+/**
+ * @brief Discover the NUMA nodes to split workers and queues across
+ *
+ * Nodes without CPUs are skipped, and beyond REQ_MAX_NODES the CPUs
+ * of further nodes are folded onto the first ones.
+ */
+static void nfs_rpc_numa_init(void)
+{
+	char path[64];
+	cpu_set_t online, cpus;
+	uint32_t found = 0, node;
+	int id, cpu;
+
+	nfs_req_st.n_nodes = 1;
+	for (node = 0; node < REQ_MAX_NODES; ++node)
+		CPU_ZERO(&node_cpus[node]);
+
+	if (!nfs_param.core_param.numa_affinity)
+		return;
+
+	if (!nfs_rpc_read_list("/sys/devices/system/node/online", &online)) {
+		LogWarn(COMPONENT_DISPATCH,
+			"NUMA_Affinity set but node topology is unavailable");
+		return;
+	}
+
+	for (id = 0; id < CPU_SETSIZE; ++id) {
+		if (!CPU_ISSET(id, &online))
+			continue;
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", id);
+		if (!nfs_rpc_read_list(path, &cpus) || CPU_COUNT(&cpus) == 0)
+			continue;
+		node = found++ % REQ_MAX_NODES;
+		CPU_OR(&node_cpus[node], &node_cpus[node], &cpus);
+		for (cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			if (CPU_ISSET(cpu, &cpus))
+				cpu_node[cpu] = node;
+	}
+
+	if (found > 1)
+		nfs_req_st.n_nodes =
+		    found < REQ_MAX_NODES ? found : REQ_MAX_NODES;
+
+	LogEvent(COMPONENT_DISPATCH,
+		 "NUMA_Affinity: %u node(s) found, using %u",
+		 found, nfs_req_st.n_nodes);
+}
+
+/**
+ * @brief Find the node a CPU belongs to
+ *
+ * @param[in] cpu CPU number, as from sched_getcpu
+ *
+ * @return Node index, 0 when unknown.
+ */
+uint32_t nfs_rpc_cpu_node(int cpu)
+{
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return 0;
+	return cpu_node[cpu];
+}
+
+/**
+ * @brief Restrict the calling thread to the CPUs of a node
+ *
+ * Does nothing unless there are several nodes.
+ *
+ * @param[in] node Node index
+ *
+ * @return 0 on success, an error code otherwise.
+ */
+int nfs_rpc_bind_node(uint32_t node)
+{
+	if (nfs_req_st.n_nodes == 1)
+		return 0;
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+				      &node_cpus[node]);
+}
+
+/**
+ * @brief Earliest time a request this thread was refused may go
+ *
+ * In CLOCK_MONOTONIC microseconds, UINT64_MAX if none was refused.
+ * Admission runs in the dequeuing worker, so each worker learns how
+ * long it may sleep from its own last look at the queues.
+ */
+static __thread uint64_t nfs_rpc_qos_ready;
+
+/**
+ * @brief Check a request against its export's rate limits
+ *
+ * @param[in] owner Export of the request's flow
+ * @param[in] item  Request
+ *
+ * @return true if it may be handed to a worker now.
+ */
+static bool nfs_rpc_admit(void *owner, struct fq_item *item)
+{
+	struct gsh_export *export = owner;
+	uint64_t ready;
+
+	if (export_qos_admit(&export->qos, item->io, item->rbytes,
+			     item->wbytes, &ready))
+		return true;
+
+	if (ready < nfs_rpc_qos_ready)
+		nfs_rpc_qos_ready = ready;
+	return false;
+}
+
+/**
+ * @brief Count the CPUs a node's workers run on
+ *
+ * @param[in] node Node index
+ *
+ * @return Number of CPUs, at least 1.
+ */
+uint32_t nfs_rpc_node_ncpus(uint32_t node)
+{
+	long ncpus;
+
+	if (nfs_req_st.n_nodes == 1) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		return ncpus > 0 ? ncpus : 1;
+	}
+	ncpus = CPU_COUNT(&node_cpus[node]);
+	return ncpus > 0 ? ncpus : 1;
+}
+
 void nfs_rpc_queue_init(void)
 {
 	struct fridgethr_params reqparams;
-	struct req_q_pair *qpair;
+	struct req_node_st *st;
+	struct req_q *q;
 	int rc = 0;
 	int ix;
+	uint32_t node;
 
 	memset(&reqparams, 0, sizeof(struct fridgethr_params));
     /**
@@ -912,19 +1172,27 @@ void nfs_rpc_queue_init(void)
 		LogFatal(COMPONENT_DISPATCH,
 			 "Unable to initialize decoder thread pool: %d", rc);
 
-	/* queues */
-	pthread_spin_init(&nfs_req_st.reqs.sp, PTHREAD_PROCESS_PRIVATE);
-	nfs_req_st.reqs.size = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		qpair->s = req_q_s[ix];
-		nfs_rpc_q_init(&qpair->producer);
-		nfs_rpc_q_init(&qpair->consumer);
-	}
+	nfs_rpc_numa_init();
+
+	for (node = 0; node < nfs_req_st.n_nodes; ++node) {
+		st = &nfs_req_st.reqs[node];
 
-	/* waitq */
-	glist_init(&nfs_req_st.reqs.wait_list);
-	nfs_req_st.reqs.waiters = 0;
+		/* queues */
+		st->size = 0;
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			q = &(st->nfs_request_q.qset[ix]);
+			q->s = req_q_s[ix];
+			rc = nfs_rpc_q_init(q, nfs_rpc_admit);
+			if (rc != 0)
+				LogFatal(COMPONENT_DISPATCH,
+					 "Unable to initialize request queue: %d",
+					 rc);
+		}
+
+		/* parked workers */
+		st->wake_seq = 0;
+		st->parked = 0;
+	}
 
 	/* stallq */
 	gsh_mutex_init(&nfs_req_st.stallq.mtx, NULL);
@@ -936,13 +1204,212 @@ void nfs_rpc_queue_init(void)
 static uint32_t enqueued_reqs;
 static uint32_t dequeued_reqs;
 
+/**
+ * @brief Choose the node whose queues a request goes on
+ *
+ * TCP requests follow their connection, anything else stays on the
+ * node of the decoder that received it.
+ *
+ * @param[in] req Request
+ *
+ * @return Node index.
+ */
+static inline uint32_t nfs_rpc_req_node(request_data_t *req)
+{
+	gsh_xprt_private_t *xu;
+
+	if (nfs_req_st.n_nodes == 1)
+		return 0;
+
+	if (req->rtype == NFS_REQUEST &&
+	    req->r_u.nfs->xprt->xp_type == XPRT_TCP) {
+		xu = (gsh_xprt_private_t *) req->r_u.nfs->xprt->xp_u1;
+		if (xu != NULL)
+			return xu->node;
+	}
+
+	return nfs_rpc_cpu_node(sched_getcpu());
+}
+
+/**
+ * @brief Wake one worker parked on a node, if there is one
+ *
+ * The caller has just queued a request.  A worker parks by counting
+ * itself in @c parked, then looking at the queues once more, then
+ * sleeping on @c wake_seq; the fence orders our queueing before our
+ * look at @c parked, so either it sees the request or we see it.
+ *
+ * @param[in] st Node
+ * @param[in] q  Queue just appended to, for logging
+ *
+ * @return true if a worker was woken.
+ */
+static bool nfs_rpc_wake_node(struct req_node_st *st, struct req_q *q)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (atomic_fetch_uint32_t(&st->parked) == 0)
+		return false;
+
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "node parked %u wake one (for q %p)",
+		     st->parked, q);
+
+	atomic_inc_uint32_t(&st->wake_seq);
+	gsh_futex_wake(&st->wake_seq, 1);
+	return true;
+}
+
+/**
+ * @brief Find the export an NFS request is for, without decoding it
+ *
+ * NFSv3 arguments all start with a handle; for NFSv4 the first
+ * PUTFH of the compound is used.
+ *
+ * @param[in] reqnfs Decoded request
+ *
+ * @return Export id, or -1 if it cannot be told.
+ */
+static int32_t nfs_rpc_req_export_id(nfs_request_data_t *reqnfs)
+{
+	struct svc_req *req = &reqnfs->req;
+	COMPOUND4args *compound;
+	file_handle_v4_t *fh;
+	nfs_fh4 *fh4;
+	u_int ix;
+
+	if (req->rq_prog != nfs_param.core_param.program[P_NFS] ||
+	    req->rq_proc == NFSPROC_NULL ||
+	    reqnfs->funcdesc == &invalid_funcdesc)
+		return -1;
+
+	if (req->rq_vers == NFS_V3)
+		return nfs3_FhandleToExportId((nfs_fh3 *) &reqnfs->arg_nfs);
+
+	compound = &reqnfs->arg_nfs.arg_compound4;
+	for (ix = 0; ix < compound->argarray.argarray_len; ++ix) {
+		switch (compound->argarray.argarray_val[ix].argop) {
+		case NFS4_OP_PUTFH:
+			fh4 = &compound->argarray.argarray_val[ix].nfs_argop4_u.
+			    opputfh.object;
+			fh = (file_handle_v4_t *) fh4->nfs_fh4_val;
+			if (fh == NULL ||
+			    fh4->nfs_fh4_len <
+				offsetof(struct file_handle_v4, fsopaque) ||
+			    fh->fhversion != GANESHA_FH_VERSION)
+				return -1;
+			return fh->exportid;
+		case NFS4_OP_PUTROOTFH:
+		case NFS4_OP_PUTPUBFH:
+			return -1;
+		default:
+			break;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Work out the I/O an NFS request does and what it costs
+ *
+ * Every request costs one unit, plus one per FQ_COST_BYTES of data
+ * read or written.
+ *
+ * @param[in]  reqnfs Decoded request
+ * @param[out] item   Its queue item, cost and I/O filled in
+ */
+static void nfs_rpc_req_io(nfs_request_data_t *reqnfs, struct fq_item *item)
+{
+	struct svc_req *req = &reqnfs->req;
+	COMPOUND4args *compound;
+	nfs_argop4 *op;
+	u_int ix;
+
+	item->io = 0;
+	item->rbytes = 0;
+	item->wbytes = 0;
+
+	if (req->rq_prog != nfs_param.core_param.program[P_NFS] ||
+	    reqnfs->funcdesc == &invalid_funcdesc)
+		goto out;
+
+	if (req->rq_vers == NFS_V3) {
+		if (req->rq_proc == NFSPROC3_READ) {
+			item->io = FQ_IO_READ;
+			item->rbytes = reqnfs->arg_nfs.arg_read3.count;
+		} else if (req->rq_proc == NFSPROC3_WRITE) {
+			item->io = FQ_IO_WRITE;
+			item->wbytes = reqnfs->arg_nfs.arg_write3.count;
+		}
+	} else if (req->rq_proc == NFSPROC4_COMPOUND) {
+		compound = &reqnfs->arg_nfs.arg_compound4;
+		for (ix = 0; ix < compound->argarray.argarray_len; ++ix) {
+			op = &compound->argarray.argarray_val[ix];
+			if (op->argop == NFS4_OP_READ) {
+				item->io |= FQ_IO_READ;
+				item->rbytes += op->nfs_argop4_u.opread.count;
+			} else if (op->argop == NFS4_OP_WRITE) {
+				item->io |= FQ_IO_WRITE;
+				item->wbytes +=
+				    op->nfs_argop4_u.opwrite.data.data_len;
+			}
+		}
+	}
+
+ out:
+	item->cost = fq_cost((uint64_t) item->rbytes + item->wbytes);
+}
+
+/**
+ * @brief Queue a request that found no flow, setting one up
+ *
+ * The flow is allocated with the queue unlocked, and holds a
+ * reference on its export, if there is one, for its weight and rate
+ * limits.
+ *
+ * @param[in] q    Queue
+ * @param[in] item Request, with its flow key set
+ */
+static void nfs_rpc_enqueue_flow(struct req_q *q, struct fq_item *item)
+{
+	struct gsh_export *export = NULL;
+	struct fq_flow *flow;
+	bool queued;
+
+	if (item->export_id >= 0)
+		export = get_gsh_export(item->export_id);
+
+	flow = fq_flow_alloc(item->client, item->export_id,
+			     export != NULL ? export->sched_weight : 1,
+			     export);
+	if (flow == NULL) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to allocate request flow. Exiting...");
+		Fatal();
+	}
+
+	pthread_spin_lock(&q->sp);
+	queued = fq_enqueue_flow(&q->fq, item, flow);
+	pthread_spin_unlock(&q->sp);
+
+	/* raced with another request of the flow */
+	if (!queued && export != NULL)
+		put_gsh_export(export);
+}
+
 void nfs_rpc_enqueue_req(request_data_t *req)
 {
+	struct req_node_st *st;
 	struct req_q_set *nfs_request_q;
-	struct req_q_pair *qpair;
 	struct req_q *q;
+	const void *client = NULL;
+	int32_t export_id = -1;
+	gsh_xprt_private_t *xu;
+	uint32_t node, ix;
+	bool queued;
 
-	nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	node = nfs_rpc_req_node(req);
+	st = &nfs_req_st.reqs[node];
+	nfs_request_q = &st->nfs_request_q;
 
 	switch (req->rtype) {
 	case NFS_REQUEST:
@@ -950,23 +1417,35 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 			     "enter rq_xid=%u lookahead.flags=%u",
 			     req->r_u.nfs->req.rq_xid,
 			     req->r_u.nfs->lookahead.flags);
+		/* flow is the client pinned on the connection, if any,
+		 * and the export */
+		xu = (gsh_xprt_private_t *) req->r_u.nfs->xprt->xp_u1;
+		if (xu != NULL)
+			client = xu->client;
+		export_id = nfs_rpc_req_export_id(req->r_u.nfs);
+		nfs_rpc_req_io(req->r_u.nfs, &req->req_q);
 		if (req->r_u.nfs->lookahead.flags & NFS_LOOKAHEAD_MOUNT) {
-			qpair = &(nfs_request_q->qset[REQ_Q_MOUNT]);
+			q = &(nfs_request_q->qset[REQ_Q_MOUNT]);
 			break;
 		}
 		if (NFS_LOOKAHEAD_HIGH_LATENCY(req->r_u.nfs->lookahead))
-			qpair = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
+			q = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
 		else
-			qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+			q = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
 		break;
 	case NFS_CALL:
-		qpair = &(nfs_request_q->qset[REQ_Q_CALL]);
+		req->req_q.io = 0;
+		req->req_q.cost = fq_cost(0);
+		q = &(nfs_request_q->qset[REQ_Q_CALL]);
 		break;
 #ifdef _USE_9P
 	case _9P_REQUEST:
 		/* XXX identify high-latency requests and allocate
 		 * to the high-latency queue, as above */
-		qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+		client = req->r_u._9p.pconn;
+		req->req_q.io = 0;
+		req->req_q.cost = fq_cost(0);
+		q = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
 		break;
 #endif
 	default:
@@ -977,147 +1456,136 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 	/* this one is real, timestamp it
 	 */
 	now(&req->time_queued);
-	/* always append to producer queue */
-	q = &qpair->producer;
-	pthread_spin_lock(&q->sp);
-	glist_add_tail(&q->q, &req->req_q);
-	++(q->size);
-	pthread_spin_unlock(&q->sp);
-
-	atomic_inc_uint32_t(&enqueued_reqs);
 
-	LogDebug(COMPONENT_DISPATCH,
-		 "enqueued req, q %p (%s %p:%p) " "size is %d (enq %u deq %u)",
-		 q, qpair->s, &qpair->producer, &qpair->consumer, q->size,
-		 enqueued_reqs, dequeued_reqs);
+	req->req_q.client = client;
+	req->req_q.export_id = export_id;
 
-	/* potentially wakeup some thread */
+	/* workers put it on its flow, unless the ring is full */
+	if (!mpmc_ring_push(&q->intake, &req->req_q)) {
+		pthread_spin_lock(&q->sp);
+		queued = fq_enqueue(&q->fq, &req->req_q, client, export_id);
+		pthread_spin_unlock(&q->sp);
 
-	/* global waitq */
-	{
-		wait_q_entry_t *wqe;
+		if (!queued)
+			nfs_rpc_enqueue_flow(q, &req->req_q);
+	}
 
-		/* SPIN LOCKED */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		if (nfs_req_st.reqs.waiters) {
-			wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
-						wait_q_entry_t, waitq);
+	atomic_inc_uint32_t(&enqueued_reqs);
+	atomic_inc_uint64_t(&st->enqueued);
 
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
-
-			/* release 1 waiter */
-			glist_del(&wqe->waitq);
-			--(nfs_req_st.reqs.waiters);
-			--(wqe->waiters);
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-			pthread_mutex_lock(&wqe->lwe.mtx);
-			/* XXX reliable handoff */
-			wqe->flags |= Wqe_LFlag_SyncDone;
-			if (wqe->flags & Wqe_LFlag_WaitSync)
-				pthread_cond_signal(&wqe->lwe.cv);
-			pthread_mutex_unlock(&wqe->lwe.mtx);
-		} else
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
+	LogDebug(COMPONENT_DISPATCH,
+		 "enqueued req, q %p (%s) size is %d flows %d (enq %u deq %u) node %u",
+		 q, q->s, q->fq.size, q->fq.nflows,
+		 enqueued_reqs, dequeued_reqs, node);
+
+	/* potentially wakeup some thread, one of the node's own if
+	 * any is idle, else one that will steal the request */
+	for (ix = 0; ix < nfs_req_st.n_nodes; ++ix) {
+		if (nfs_rpc_wake_node(
+			&nfs_req_st.reqs[(node + ix) % nfs_req_st.n_nodes], q))
+			break;
 	}
 
  out:
 	return;
 }
 
-/* static inline */
-request_data_t *nfs_rpc_consume_req(struct req_q_pair *qpair)
+/**
+ * @brief Take the next request from one class
+ *
+ * Whatever decoders left on the intake ring is first moved onto its
+ * flows; requests whose flows must be set up are set aside and dealt
+ * with after dropping the lock.
+ *
+ * Every dequeue thus takes the class's spinlock.  That is deliberate:
+ * the deficit round robin of the fair queue needs one consistent view
+ * of all flows to pick the next request, and handing the draining to
+ * a single consumer would only move the lock to the hand-off.  What
+ * the ring buys is that decoders never take the lock and workers
+ * take it once per request, draining in batches.  test_req_queue
+ * measures the dequeue side of this against a plain ring.
+ *
+ * @param[in] q Queue
+ *
+ * @return A request, or NULL if there is none to serve now.
+ */
+request_data_t *nfs_rpc_consume_req(struct req_q *q)
 {
-	request_data_t *nfsreq = NULL;
+	struct glist_head fresh, *g, *n;
+	struct fq_item *item;
+	void *owner;
 
-	pthread_spin_lock(&qpair->consumer.sp);
-	if (qpair->consumer.size > 0) {
-		nfsreq =
-		    glist_first_entry(&qpair->consumer.q, request_data_t,
-				      req_q);
-		glist_del(&nfsreq->req_q);
-		--(qpair->consumer.size);
-		pthread_spin_unlock(&qpair->consumer.sp);
-		goto out;
-	} else {
-		char *s = NULL;
-		uint32_t csize = ~0U;
-		uint32_t psize = ~0U;
-
-		pthread_spin_lock(&qpair->producer.sp);
-		if (isFullDebug(COMPONENT_DISPATCH)) {
-			s = (char *)qpair->s;
-			csize = qpair->consumer.size;
-			psize = qpair->producer.size;
-		}
-		if (qpair->producer.size > 0) {
-			/* splice */
-			glist_splice_tail(&qpair->consumer.q,
-					  &qpair->producer.q);
-			qpair->consumer.size = qpair->producer.size;
-			qpair->producer.size = 0;
-			/* consumer.size > 0 */
-			pthread_spin_unlock(&qpair->producer.sp);
-			nfsreq =
-			    glist_first_entry(&qpair->consumer.q,
-					      request_data_t, req_q);
-			glist_del(&nfsreq->req_q);
-			--(qpair->consumer.size);
-			pthread_spin_unlock(&qpair->consumer.sp);
-			if (s)
-				LogFullDebug(COMPONENT_DISPATCH,
-					     "try splice, qpair %s consumer qsize=%u "
-					     "producer qsize=%u", s, csize,
-					     psize);
-			goto out;
-		}
+	/* nothing here, do not bother with the lock */
+	if (mpmc_ring_count(&q->intake) == 0 &&
+	    atomic_fetch_uint32_t(&q->fq.size) == 0)
+		return NULL;
 
-		pthread_spin_unlock(&qpair->producer.sp);
-		pthread_spin_unlock(&qpair->consumer.sp);
+	glist_init(&fresh);
+	pthread_spin_lock(&q->sp);
+	while ((item = mpmc_ring_pop(&q->intake)) != NULL) {
+		if (!fq_enqueue(&q->fq, item, item->client, item->export_id))
+			glist_add_tail(&fresh, &item->q);
+	}
 
-		if (s)
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "try splice, qpair %s consumer qsize=%u "
-				     "producer qsize=%u", s, csize, psize);
+	if (!glist_empty(&fresh)) {
+		pthread_spin_unlock(&q->sp);
+		glist_for_each_safe(g, n, &fresh) {
+			item = glist_entry(g, struct fq_item, q);
+			glist_del(&item->q);
+			nfs_rpc_enqueue_flow(q, item);
+		}
+		pthread_spin_lock(&q->sp);
 	}
- out:
-	return nfsreq;
+
+	item = fq_dequeue(&q->fq, &owner);
+	pthread_spin_unlock(&q->sp);
+
+	/* the flow emptied, drop its export */
+	if (owner != NULL)
+		put_gsh_export(owner);
+
+	if (item == NULL)
+		return NULL;
+
+	return container_of(item, request_data_t, req_q);
 }
 
-request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+/**
+ * @brief Take the next request from one node's queues
+ *
+ * @param[in] st Node
+ *
+ * @return A request, or NULL if all the node's queues are empty.
+ */
+static request_data_t *nfs_rpc_dequeue_node(struct req_node_st *st)
 {
 	request_data_t *nfsreq = NULL;
-	struct req_q_set *nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
-	struct req_q_pair *qpair;
+	struct req_q_set *nfs_request_q = &st->nfs_request_q;
+	struct req_q *q;
 	uint32_t ix, slot;
-	struct timespec timeout;
 
 	/* XXX: the following stands in for a more robust/flexible
 	 * weighting function */
 
 	/* slot in 1..4 */
- retry_deq:
-	slot = (nfs_rpc_q_next_slot() % 4);
+	slot = (nfs_rpc_q_next_slot(st) % 4);
 	for (ix = 0; ix < 4; ++ix) {
 		switch (slot) {
 		case 0:
 			/* MOUNT */
-			qpair = &(nfs_request_q->qset[REQ_Q_MOUNT]);
+			q = &(nfs_request_q->qset[REQ_Q_MOUNT]);
 			break;
 		case 1:
 			/* NFS_CALL */
-			qpair = &(nfs_request_q->qset[REQ_Q_CALL]);
+			q = &(nfs_request_q->qset[REQ_Q_CALL]);
 			break;
 		case 2:
 			/* LL */
-			qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+			q = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
 			break;
 		case 3:
 			/* HL */
-			qpair = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
+			q = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
 			break;
 		default:
 			/* not here */
@@ -1126,13 +1594,13 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 		}
 
 		LogFullDebug(COMPONENT_DISPATCH,
-			     "dequeue_req try qpair %s %p:%p", qpair->s,
-			     &qpair->producer, &qpair->consumer);
+			     "dequeue_req try q %s %p", q->s, q);
 
 		/* anything? */
-		nfsreq = nfs_rpc_consume_req(qpair);
+		nfsreq = nfs_rpc_consume_req(q);
 		if (nfsreq) {
 			atomic_inc_uint32_t(&dequeued_reqs);
+			atomic_inc_uint64_t(&st->dequeued);
 			break;
 		}
 
@@ -1141,54 +1609,178 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 
 	}			/* for */
 
-	/* wait */
-	if (!nfsreq) {
-		wait_q_entry_t *wqe = &worker->wqe;
-		assert(wqe->waiters == 0); /* wqe is not on any wait queue */
-		pthread_mutex_lock(&wqe->lwe.mtx);
-		wqe->flags = Wqe_LFlag_WaitSync;
-		wqe->waiters = 1;
-		/* XXX functionalize */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		glist_add_tail(&nfs_req_st.reqs.wait_list, &wqe->waitq);
-		++(nfs_req_st.reqs.waiters);
-		pthread_spin_unlock(&nfs_req_st.reqs.sp);
-		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
-			timeout.tv_sec = time(NULL) + 5;
-			timeout.tv_nsec = 0;
-			pthread_cond_timedwait(&wqe->lwe.cv, &wqe->lwe.mtx,
-					       &timeout);
-			if (fridgethr_you_should_break(worker->ctx)) {
-				/* We are returning;
-				 * so take us out of the waitq */
-				pthread_spin_lock(&nfs_req_st.reqs.sp);
-				if (wqe->waitq.next != NULL
-				    || wqe->waitq.prev != NULL) {
-					/* Element is still in wqitq,
-					 * remove it */
-					glist_del(&wqe->waitq);
-					--(nfs_req_st.reqs.waiters);
-					--(wqe->waiters);
-					wqe->flags &=
-					    ~(Wqe_LFlag_WaitSync |
-					      Wqe_LFlag_SyncDone);
-				}
-				pthread_spin_unlock(&nfs_req_st.reqs.sp);
-				pthread_mutex_unlock(&wqe->lwe.mtx);
-				return NULL;
+	return nfsreq;
+}
+
+/** How long a worker sleeps with nothing queued */
+#define NFS_RPC_PARK_TIME 5
+
+/**
+ * @brief Count the requests queued on all nodes
+ *
+ * @return Requests queued.
+ */
+static uint32_t nfs_rpc_queued(void)
+{
+	uint32_t node, ix, queued = 0;
+
+	for (node = 0; node < nfs_req_st.n_nodes; ++node)
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix)
+			queued += nfs_rpc_q_size(
+			    &nfs_req_st.reqs[node].nfs_request_q.qset[ix]);
+	return queued;
+}
+
+/**
+ * @brief Take a request from our node, or else from another
+ *
+ * @param[in] worker The worker
+ * @param[in] st     Its node
+ *
+ * @return A request, or NULL if none could be had.
+ */
+static request_data_t *nfs_rpc_dequeue_any(nfs_worker_data_t *worker,
+					   struct req_node_st *st)
+{
+	request_data_t *nfsreq = nfs_rpc_dequeue_node(st);
+	uint32_t n_nodes = nfs_req_st.n_nodes;
+	uint32_t ix;
+
+	/* nothing on our own node, steal from the others */
+	for (ix = 1; !nfsreq && ix < n_nodes; ++ix) {
+		nfsreq = nfs_rpc_dequeue_node(
+			&nfs_req_st.reqs[(worker->node + ix) % n_nodes]);
+		if (nfsreq)
+			atomic_inc_uint64_t(&st->steals);
+	}
+	return nfsreq;
+}
+
+/**
+ * @brief Get a request for a worker, parking it until there is one
+ *
+ * An idle worker looks at the queues Worker_Spins more times before
+ * parking on its node's futex.  If requests are queued but held back
+ * by rate limits, it sleeps only until the first of them may go.
+ *
+ * @param[in] worker The worker
+ *
+ * @return A request, or NULL if the worker should return to its
+ *         fridge.
+ */
+request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+{
+	request_data_t *nfsreq;
+	struct req_node_st *st = &nfs_req_st.reqs[worker->node];
+	struct timespec timeout, ts;
+	uint32_t seq, spins = 0;
+	uint64_t usec;
+
+	for (;;) {
+		nfsreq = nfs_rpc_dequeue_any(worker, st);
+		if (nfsreq)
+			return nfsreq;
+
+		if (spins++ < nfs_param.core_param.worker_spins) {
+			sched_yield();
+			continue;
+		}
+		spins = 0;
+
+		if (fridgethr_you_should_break(worker->ctx))
+			return NULL;
+
+		/* count ourselves parked before the last look, so a
+		 * decoder queueing after it will see us */
+		atomic_inc_uint32_t(&st->parked);
+		seq = atomic_fetch_uint32_t(&st->wake_seq);
+		nfs_rpc_qos_ready = UINT64_MAX;
+		nfsreq = nfs_rpc_dequeue_any(worker, st);
+		if (nfsreq) {
+			atomic_dec_uint32_t(&st->parked);
+			return nfsreq;
+		}
+
+		timeout.tv_sec = NFS_RPC_PARK_TIME;
+		timeout.tv_nsec = 0;
+
+		/* anything still queued is held back by rate limits,
+		 * and nobody will wake us when the buckets refill */
+		if (nfs_rpc_qos_ready != UINT64_MAX &&
+		    nfs_rpc_queued() != 0) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			usec = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+			if (nfs_rpc_qos_ready <= usec) {
+				atomic_dec_uint32_t(&st->parked);
+				continue;
+			}
+			usec = nfs_rpc_qos_ready - usec;
+			if (usec < NFS_RPC_PARK_TIME * 1000000ULL) {
+				timeout.tv_sec = usec / 1000000;
+				timeout.tv_nsec = (usec % 1000000) * 1000;
 			}
 		}
+		gsh_futex_wait(&st->wake_seq, seq, &timeout);
+		atomic_dec_uint32_t(&st->parked);
+		LogFullDebug(COMPONENT_DISPATCH, "worker %u unparked",
+			     worker->worker_index);
 
-		/* XXX wqe was removed from nfs_req_st.waitq
-		 * (by signalling thread) */
-		wqe->flags &= ~(Wqe_LFlag_WaitSync | Wqe_LFlag_SyncDone);
-		pthread_mutex_unlock(&wqe->lwe.mtx);
-		LogFullDebug(COMPONENT_DISPATCH, "wqe wakeup %p", wqe);
-		goto retry_deq;
+		if (fridgethr_you_should_break(worker->ctx))
+			return NULL;
 	}
+}
 
-	return nfsreq;
+#ifdef USE_DBUS
+/**
+ * @brief Report per-node queue depth, arrivals, departures and steals
+ * over DBus
+ *
+ * Each entry is (node, depth, enqueued, dequeued, steals).
+ *
+ * @param[in,out] iter Reply being built
+ */
+void nfs_rpc_dbus_show_nodes(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	struct req_node_st *st;
+	struct req_q *q;
+	uint64_t depth, val;
+	uint32_t node;
+	int ix;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(utttt)",
+					 &array_iter);
+	for (node = 0; node < nfs_req_st.n_nodes; ++node) {
+		st = &nfs_req_st.reqs[node];
+		depth = 0;
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			q = &(st->nfs_request_q.qset[ix]);
+			depth += nfs_rpc_q_size(q);
+		}
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+					       &node);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &depth);
+		val = atomic_fetch_uint64_t(&st->enqueued);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&st->dequeued);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&st->steals);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
 }
+#endif				/* USE_DBUS */
 
 /**
  * @brief Allocate a new request
@@ -1805,9 +2397,21 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 void *rpc_dispatcher_thread(void *arg)
 {
 	int32_t chan_id = *((int32_t *) arg);
+	struct rpc_evchan *evchan = container_of(arg, struct rpc_evchan,
+						 chan_id);
 
 	SetNameFunction("disp");
 
+	/* TCP channels run on the CPUs of the node they serve */
+	if (evchan - rpc_evchan >= TCP_EVCHAN_0) {
+		int rc = nfs_rpc_bind_node(evchan->node);
+
+		if (rc != 0)
+			LogWarn(COMPONENT_DISPATCH,
+				"Could not bind channel %u to node %u: %d",
+				evchan->chan_id, evchan->node, rc);
+	}
+
 	/* Calling dispatcher main loop */
 	LogInfo(COMPONENT_DISPATCH, "Entering nfs/rpc dispatcher");
 
@@ -64,12 +64,28 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "delayed_exec.h"
 
 pool_t *request_pool;
 pool_t *request_data_pool;
 pool_t *dupreq_pool;
 
-static struct fridgethr *worker_fridge;
+/* One pool per NUMA node, just the first without NUMA_Affinity */
+static struct fridgethr *worker_fridge[REQ_MAX_NODES];
+
+/** How often Worker_Autotune looks at the pools */
+#define WORKER_TUNE_INTERVAL NS_PER_SEC
+
+/* Counters of each node as last seen by worker_tune */
+static struct worker_tune_snap {
+	uint64_t served;
+	uint64_t waited;
+	uint64_t wait_ns;
+	uint64_t busy_ns;
+	uint64_t cpu_ns;
+} worker_tune_last[REQ_MAX_NODES];
+
+static bool worker_tune_stop;
 
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
@@ -710,6 +726,7 @@ static void nfs_rpc_execute(request_data_t *req,
 	int exportid = -1;
 	struct svc_req *svcreq = &reqnfs->req;
 	SVCXPRT *xprt = reqnfs->xprt;
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
 	struct export_perms export_perms;
 	int protocol_options = 0;
 	struct user_cred user_credentials;
@@ -749,10 +766,12 @@ static void nfs_rpc_execute(request_data_t *req,
 	 * this, we should sprint a buffer once, in when we're setting up
 	 * xprt private data. */
 
-/* can I change this to be call by ref instead of copy?
- * the xprt is valid for the lifetime here
- */
-	if (copy_xprt_addr(op_ctx->caller_addr, xprt) == 0) {
+	/* TCP connections have their client pinned at accept time */
+	if (xu != NULL && xu->client != NULL) {
+		memcpy(op_ctx->caller_addr, &xu->addr, sizeof(sockaddr_t));
+		inc_gsh_client_refcount(xu->client);
+		op_ctx->client = xu->client;
+	} else if (copy_xprt_addr(op_ctx->caller_addr, xprt) == 0) {
 		LogDebug(COMPONENT_DISPATCH,
 			 "copy_xprt_addr failed for Program %d, Version %d, "
 			 "Function %d", (int)svcreq->rq_prog,
@@ -762,10 +781,11 @@ static void nfs_rpc_execute(request_data_t *req,
 		svcerr_systemerr(xprt, svcreq);
 		DISP_SUNLOCK(xprt);
 		goto out;
+	} else {
+		op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
 	}
 
 	port = get_port(op_ctx->caller_addr);
-	op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
 	if (op_ctx->client == NULL) {
 		LogDebug(COMPONENT_DISPATCH,
 			 "Cannot get client block for Program %d, Version %d, "
@@ -1135,6 +1155,12 @@ static void nfs_rpc_execute(request_data_t *req,
 			auth_rc = AUTH_TOOWEAK;
 			goto auth_failure;
 		}
+
+		/* The request crosses into the export by handle, so its
+		 * root must be known before anything is looked up
+		 * relative to it.
+		 */
+		init_export_root_lazy(op_ctx->export);
 	}
 
 	/*
@@ -1429,13 +1455,19 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 	struct nfs_worker_data *wd =
 	    gsh_calloc(sizeof(struct nfs_worker_data), 1);
 	char thr_name[32];
+	int rc;
 
 	wd->worker_index = atomic_inc_uint32_t(&worker_indexer);
+	wd->node = (uintptr_t) ctx->arg;
 	snprintf(thr_name, sizeof(thr_name), "work-%u", wd->worker_index);
 	SetNameFunction(thr_name);
 
-	/* Initalize thr waitq */
-	init_wait_q_entry(&wd->wqe);
+	rc = nfs_rpc_bind_node(wd->node);
+	if (rc != 0)
+		LogWarn(COMPONENT_DISPATCH,
+			"Could not bind %s to node %u: %d",
+			thr_name, wd->node, rc);
+
 	wd->ctx = ctx;
 	ctx->thread_info = wd;
 }
@@ -1466,6 +1498,9 @@ static void worker_thread_finalizer(struct fridgethr_context *ctx)
 static void worker_run(struct fridgethr_context *ctx)
 {
 	struct nfs_worker_data *worker_data = ctx->thread_info;
+	struct req_node_st *st = &nfs_req_st.reqs[worker_data->node];
+	bool autotune = nfs_param.core_param.worker_autotune;
+	struct timespec start, cpu_start, end, cpu_end;
 	request_data_t *nfsreq;
 	gsh_xprt_private_t *xu = NULL;
 	uint32_t reqcnt;
@@ -1477,6 +1512,21 @@ static void worker_run(struct fridgethr_context *ctx)
 		if (!nfsreq)
 			continue;
 
+		if (autotune) {
+			now(&start);
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+			atomic_inc_uint32_t(&st->running);
+			/* time spent held back by an export's rate limit
+			 * says nothing about the size of the pool */
+			if (!nfsreq->req_q.held) {
+				atomic_add_uint64_t(&st->wait_ns,
+						    timespec_diff(&nfsreq->
+								  time_queued,
+								  &start));
+				atomic_inc_uint64_t(&st->waited);
+			}
+		}
+
 /* need to do a getpeername(2) on the socket fd before we dive into the
  * rpc_execute.  9p is messy but we do have the fd....
  */
@@ -1547,35 +1597,238 @@ static void worker_run(struct fridgethr_context *ctx)
 			     "Invalidating processed entry");
 
 		pool_free(request_pool, nfsreq);
+
+		if (autotune) {
+			now(&end);
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+			atomic_add_uint64_t(&st->busy_ns,
+					    timespec_diff(&start, &end));
+			atomic_add_uint64_t(&st->cpu_ns,
+					    timespec_diff(&cpu_start,
+							  &cpu_end));
+			atomic_inc_uint64_t(&st->served);
+			atomic_dec_uint32_t(&st->running);
+		}
+	}
+}
+
+/**
+ * @brief Resize one node's worker pool
+ *
+ * Over the last interval, the busy time of the workers divided by
+ * the interval is how many of them were in use, and the CPU time
+ * they used divided by their busy time tells whether they were
+ * computing or waiting on the FSAL.  Workers are added when
+ * requests wait longer than Worker_Wait_Target and either the
+ * workers are mostly blocked or fewer are busy than there are CPUs;
+ * they are removed when fewer than half are in use, or when CPU
+ * bound work has more workers busy than there are CPUs.  A pool
+ * whose workers completed nothing while requests are queued is
+ * taken to be blocked, but only if every worker is executing one.
+ *
+ * Requests that an export's rate limit holds back are neither
+ * counted as queued nor in the wait average: more workers would
+ * not serve them any sooner.  Nor is a pool grown while less than
+ * three quarters of it is in use, however long requests wait.
+ *
+ * @param[in] node Node index
+ */
+
+static void worker_tune_node(uint32_t node)
+{
+	struct fridgethr *fr = worker_fridge[node];
+	struct req_node_st *st = &nfs_req_st.reqs[node];
+	struct worker_tune_snap cur, *last = &worker_tune_last[node];
+	uint64_t served, waited, wait_us, busy_ns, cpu_pct, in_use;
+	uint32_t nthr, ncpus, step, ix, size, held, depth = 0;
+
+	cur.served = atomic_fetch_uint64_t(&st->served);
+	cur.waited = atomic_fetch_uint64_t(&st->waited);
+	cur.wait_ns = atomic_fetch_uint64_t(&st->wait_ns);
+	cur.busy_ns = atomic_fetch_uint64_t(&st->busy_ns);
+	cur.cpu_ns = atomic_fetch_uint64_t(&st->cpu_ns);
+	served = cur.served - last->served;
+	waited = cur.waited - last->waited;
+	busy_ns = cur.busy_ns - last->busy_ns;
+
+	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+		size = nfs_rpc_q_size(&st->nfs_request_q.qset[ix]);
+		held = nfs_rpc_q_held(&st->nfs_request_q.qset[ix]);
+		depth += size > held ? size - held : 0;
+	}
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	nthr = fr->nthreads - fr->retiring;
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+	ncpus = nfs_rpc_node_ncpus(node);
+	step = nthr / 8 ? nthr / 8 : 1;
+
+	if (served == 0) {
+		if (depth != 0 &&
+		    atomic_fetch_uint32_t(&st->running) >= nthr) {
+			/* everybody is stuck in the FSAL */
+			step = nthr / 4 ? nthr / 4 : 1;
+			fridgethr_grow(fr, step, worker_run,
+				       (void *)(uintptr_t) node);
+			LogDebug(COMPONENT_DISPATCH,
+				 "node %u: %u workers blocked, %u queued, adding %u",
+				 node, nthr, depth, step);
+		} else if (fridgethr_shrink(fr, step)) {
+			LogDebug(COMPONENT_DISPATCH,
+				 "node %u: %u workers idle, removing %u",
+				 node, nthr, step);
+		}
+		*last = cur;
+		return;
+	}
+
+	wait_us = waited ? (cur.wait_ns - last->wait_ns) / waited / NS_PER_USEC
+			 : 0;
+	cpu_pct = busy_ns ? (cur.cpu_ns - last->cpu_ns) * 100 / busy_ns : 0;
+	in_use = busy_ns / WORKER_TUNE_INTERVAL;
+	*last = cur;
+
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "node %u: %u workers, %"PRIu64" in use, %"PRIu64
+		     "%% cpu, %"PRIu64" requests waited %"PRIu64"us",
+		     node, nthr, in_use, cpu_pct, served, wait_us);
+
+	if (wait_us > nfs_param.core_param.worker_wait_target &&
+	    in_use * 4 >= nthr * 3 && (cpu_pct < 50 || in_use < ncpus)) {
+		step = nthr / 4 ? nthr / 4 : 1;
+		fridgethr_grow(fr, step, worker_run,
+			       (void *)(uintptr_t) node);
+		LogDebug(COMPONENT_DISPATCH,
+			 "node %u: requests wait %"PRIu64
+			 "us with %u workers, adding %u",
+			 node, wait_us, nthr, step);
+	} else if (in_use * 2 < nthr) {
+		if (fridgethr_shrink(fr, step))
+			LogDebug(COMPONENT_DISPATCH,
+				 "node %u: %"PRIu64" of %u workers in use, removing %u",
+				 node, in_use, nthr, step);
+	} else if (cpu_pct > 80 && in_use > ncpus && nthr > ncpus) {
+		if (step > nthr - ncpus)
+			step = nthr - ncpus;
+		if (fridgethr_shrink(fr, step))
+			LogDebug(COMPONENT_DISPATCH,
+				 "node %u: CPU bound on %u CPUs with %u workers, removing %u",
+				 node, ncpus, nthr, step);
 	}
 }
 
+/**
+ * @brief Periodic Worker_Autotune pass over all pools
+ *
+ * @param[in] arg Unused
+ */
+
+static void worker_tune(void *arg)
+{
+	uint32_t node;
+
+	if (worker_tune_stop)
+		return;
+
+	for (node = 0; node < nfs_req_st.n_nodes; ++node)
+		if (worker_fridge[node] != NULL)
+			worker_tune_node(node);
+
+	if (delayed_submit(worker_tune, NULL, WORKER_TUNE_INTERVAL) != 0)
+		LogCrit(COMPONENT_DISPATCH,
+			"Unable to reschedule worker tuning, pools stay at their current size");
+}
+
+/**
+ * @brief Start the worker pools
+ *
+ * Nb_Worker threads are shared out evenly between the NUMA nodes.  A
+ * node left without workers has its requests stolen by the others.
+ * With Worker_Autotune, Nb_Worker_Min and Nb_Worker_Max are shared
+ * out likewise, every node getting at least one worker, and
+ * worker_tune is started.
+ *
+ * @return 0 on success, an error code otherwise.
+ */
+
 int worker_init(void)
 {
 	struct fridgethr_params frp;
+	struct nfs_core_param *core = &nfs_param.core_param;
+	bool autotune = core->worker_autotune;
+	uint32_t n_nodes = nfs_req_st.n_nodes;
+	uint32_t nb_worker = core->nb_worker;
+	uint32_t node, nthr, nmin = 0, nmax = 0;
+	char name[16];
 	int rc = 0;
 
-	memset(&frp, 0, sizeof(struct fridgethr_params));
-	frp.thr_max = nfs_param.core_param.nb_worker;
-	frp.thr_min = nfs_param.core_param.nb_worker;
-	frp.flavor = fridgethr_flavor_looper;
-	frp.thread_initialize = worker_thread_initializer;
-	frp.thread_finalize = worker_thread_finalizer;
-	frp.wake_threads = nfs_rpc_queue_awaken;
-	frp.wake_threads_arg = &nfs_req_st;
-
-	rc = fridgethr_init(&worker_fridge, "Wrk", &frp);
-	if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Unable to initialize worker fridge: %d", rc);
-		return rc;
+	if (autotune && core->nb_worker_max < core->nb_worker_min) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Nb_Worker_Max %u is below Nb_Worker_Min %u, using %u",
+			core->nb_worker_max, core->nb_worker_min,
+			core->nb_worker_min);
+		core->nb_worker_max = core->nb_worker_min;
 	}
 
-	rc = fridgethr_populate(worker_fridge, worker_run, NULL);
+	for (node = 0; node < n_nodes; ++node) {
+		nthr = nb_worker / n_nodes + (node < nb_worker % n_nodes);
+		if (autotune) {
+			nmin = core->nb_worker_min / n_nodes;
+			if (nmin == 0)
+				nmin = 1;
+			nmax = core->nb_worker_max / n_nodes;
+			if (nmax < nmin)
+				nmax = nmin;
+			if (nthr < nmin)
+				nthr = nmin;
+			if (nthr > nmax)
+				nthr = nmax;
+		}
+		if (nthr == 0)
+			continue;
+
+		memset(&frp, 0, sizeof(struct fridgethr_params));
+		frp.thr_max = autotune ? nmax : nthr;
+		frp.thr_min = autotune ? nmin : nthr;
+		frp.flavor = fridgethr_flavor_looper;
+		frp.thread_initialize = worker_thread_initializer;
+		frp.thread_finalize = worker_thread_finalizer;
+		frp.wake_threads = nfs_rpc_queue_awaken;
+		frp.wake_threads_arg = &nfs_req_st.reqs[node];
+
+		if (n_nodes == 1)
+			snprintf(name, sizeof(name), "Wrk");
+		else
+			snprintf(name, sizeof(name), "Wrk%u", node);
+
+		rc = fridgethr_init(&worker_fridge[node], name, &frp);
+		if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Unable to initialize worker fridge: %d", rc);
+			return rc;
+		}
+
+		rc = fridgethr_populate(worker_fridge[node], worker_run,
+					(void *)(uintptr_t) node);
+
+		/* populate starts the minimum */
+		if (rc == 0 && nthr > frp.thr_min)
+			rc = fridgethr_grow(worker_fridge[node],
+					    nthr - frp.thr_min, worker_run,
+					    (void *)(uintptr_t) node);
+
+		if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Unable to populate worker fridge: %d", rc);
+			return rc;
+		}
+	}
 
-	if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Unable to populate worker fridge: %d", rc);
+	if (autotune) {
+		rc = delayed_submit(worker_tune, NULL, WORKER_TUNE_INTERVAL);
+		if (rc != 0)
+			LogMajor(COMPONENT_DISPATCH,
+				 "Unable to start worker tuning: %d", rc);
 	}
 
 	return rc;
@@ -1583,17 +1836,29 @@ int worker_init(void)
 
 int worker_shutdown(void)
 {
-	int rc = fridgethr_sync_command(worker_fridge,
-					fridgethr_comm_stop,
-					120);
-
-	if (rc == ETIMEDOUT) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Shutdown timed out, cancelling threads.");
-		fridgethr_cancel(worker_fridge);
-	} else if (rc != 0) {
-		LogMajor(COMPONENT_DISPATCH,
-			 "Failed shutting down worker threads: %d", rc);
+	uint32_t node;
+	int rc, ret = 0;
+
+	worker_tune_stop = true;
+
+	for (node = 0; node < REQ_MAX_NODES; ++node) {
+		if (worker_fridge[node] == NULL)
+			continue;
+
+		rc = fridgethr_sync_command(worker_fridge[node],
+					    fridgethr_comm_stop,
+					    120);
+
+		if (rc == ETIMEDOUT) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Shutdown timed out, cancelling threads.");
+			fridgethr_cancel(worker_fridge[node]);
+		} else if (rc != 0) {
+			LogMajor(COMPONENT_DISPATCH,
+				 "Failed shutting down worker threads: %d", rc);
+		}
+		if (rc != 0)
+			ret = rc;
 	}
-	return rc;
+	return ret;
 }
@@ -74,6 +74,9 @@ static bool proc_export(struct gsh_export *export, void *arg)
 		return true;
 	}
 
+	/* The client list may be swapped by reload_exports */
+	PTHREAD_RWLOCK_rdlock(&export->clients_lock);
+
 	new_expnode = gsh_calloc(1, sizeof(struct exportnode));
 	if (new_expnode == NULL)
 		goto nomem;
@@ -132,6 +135,8 @@ static bool proc_export(struct gsh_export *export, void *arg)
 			goto nomem;
 	}
 
+	PTHREAD_RWLOCK_unlock(&export->clients_lock);
+
 	if (state->head == NULL)
 		state->head = new_expnode;
 	else
@@ -141,6 +146,7 @@ static bool proc_export(struct gsh_export *export, void *arg)
 	return true;
 
  nomem:
+	PTHREAD_RWLOCK_unlock(&export->clients_lock);
 	if (new_expnode != NULL) {
 		if (new_expnode->ex_dir != NULL)
 			gsh_free(new_expnode->ex_dir);
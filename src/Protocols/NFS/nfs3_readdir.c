@@ -48,6 +48,7 @@
 #include "nfs_proto_functions.h"
 #include "nfs_convert.h"
 #include "nfs_proto_tools.h"
+#include "buffer_pool.h"
 #include <assert.h>
 
 cache_inode_status_t nfs3_readdir_callback(void *opaque,
@@ -230,7 +231,7 @@ int nfs3_readdir(nfs_arg_t *arg,
 		}
 	}
 
-	tracker.entries = gsh_calloc(estimated_num_entries, sizeof(entry3));
+	tracker.entries = gsh_buf_calloc(estimated_num_entries, sizeof(entry3));
 
 	if (tracker.entries == NULL) {
 		rc = NFS_REQ_DROP;
@@ -447,7 +448,7 @@ static void free_entry3s(entry3 *entry3s)
 	for (entry = entry3s; entry != NULL; entry = entry->nextentry)
 		gsh_free(entry->name);
 
-	gsh_free(entry3s);
+	gsh_buf_free(entry3s);
 
 	return;
 }				/* free_entry3s */
@@ -48,6 +48,7 @@
 #include "nfs_convert.h"
 #include "nfs_file_handle.h"
 #include "nfs_proto_tools.h"
+#include "buffer_pool.h"
 #include <assert.h>
 
 cache_inode_status_t nfs3_readdirplus_callback(void *opaque,
@@ -232,7 +233,7 @@ int nfs3_readdirplus(nfs_arg_t *arg,
 		cache_inode_cookie = 0;
 
 	/* Allocate space for entries */
-	tracker.entries = gsh_calloc(estimated_num_entries, sizeof(entryplus3));
+	tracker.entries = gsh_buf_calloc(estimated_num_entries, sizeof(entryplus3));
 
 	if (tracker.entries == NULL) {
 		rc = NFS_REQ_DROP;
@@ -512,7 +513,7 @@ static void free_entryplus3s(entryplus3 *entryplus3s)
 		gsh_free(entry->name_handle.post_op_fh3_u.handle.data.data_val);
 	}
 
-	gsh_free(entryplus3s);
+	gsh_buf_free(entryplus3s);
 
 	return;
 }				/* free_entryplus3s */
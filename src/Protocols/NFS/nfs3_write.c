@@ -81,7 +81,6 @@ int nfs3_write(nfs_arg_t *arg,
 	size_t written_size = 0;
 	uint64_t offset = 0;
 	void *data = NULL;
-	bool eof_met = false;
 	bool sync = false;
 	int rc = NFS_REQ_OK;
 	fsal_status_t fsal_status;
@@ -222,9 +221,14 @@ int nfs3_write(nfs_arg_t *arg,
 		written_size = 0;
 	} else {
 		/* An actual write is to be made, prepare it */
+		struct iovec iov = {
+			.iov_base = data,
+			.iov_len = size
+		};
+
 		cache_status =
-		    cache_inode_rdwr(entry, CACHE_INODE_WRITE, offset, size,
-				     &written_size, data, &eof_met, &sync);
+		    cache_inode_write_iov(entry, offset, &iov, 1, size,
+					  &written_size, &sync);
 		if (cache_status == CACHE_INODE_SUCCESS) {
 			/* Build Weak Cache Coherency data */
 			nfs_SetWccData(NULL, entry,
@@ -130,6 +130,9 @@ int nfs4_op_putfh(struct nfs_argop4 *op, compound_data_t *data,
 			return res_PUTFH4->status;
 	}
 
+	/* Look up the root if that was left to first use */
+	init_export_root_lazy(op_ctx->export);
+
 	export = op_ctx->fsal_export;
 
 	/* The export and fsalid should be updated, but DS handles
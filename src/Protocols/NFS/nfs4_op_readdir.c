@@ -35,6 +35,7 @@
 #include "nfs_file_handle.h"
 #include "nfs_convert.h"
 #include "export_mgr.h"
+#include "buffer_pool.h"
 
 /**
  * @brief Opaque bookkeeping structure for NFSv4 readdir
@@ -410,7 +411,7 @@ cache_inode_status_t nfs4_readdir_callback(void *opaque,
  failure:
 
 	if (tracker_entry->attrs.attr_vals.attrlist4_val != NULL) {
-		gsh_free(tracker_entry->attrs.attr_vals.attrlist4_val);
+		gsh_buf_free(tracker_entry->attrs.attr_vals.attrlist4_val);
 		tracker_entry->attrs.attr_vals.attrlist4_val = NULL;
 	}
 
@@ -447,12 +448,12 @@ static void free_entries(entry4 *entries)
 
 	for (entry = entries; entry != NULL; entry = entry->nextentry) {
 		if (entry->attrs.attr_vals.attrlist4_val != NULL)
-			gsh_free(entry->attrs.attr_vals.attrlist4_val);
+			gsh_buf_free(entry->attrs.attr_vals.attrlist4_val);
 
 		if (entry->name.utf8string_val != NULL)
 			gsh_free(entry->name.utf8string_val);
 	}
-	gsh_free(entries);
+	gsh_buf_free(entries);
 
 	return;
 }				/* free_entries */
@@ -580,7 +581,7 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Prepare to read the entries */
 
-	entries = gsh_calloc(estimated_num_entries, sizeof(entry4));
+	entries = gsh_buf_calloc(estimated_num_entries, sizeof(entry4));
 	tracker.entries = entries;
 	tracker.mem_left = maxcount - sizeof(READDIR4resok);
 	tracker.count = 0;
@@ -632,7 +633,7 @@ int nfs4_op_readdir(struct nfs_argop4 *op, compound_data_t *data,
 		 */
 		res_READDIR4->READDIR4res_u.resok4.reply.entries = entries;
 	} else {
-		gsh_free(entries);
+		gsh_buf_free(entries);
 		entries = NULL;
 		res_READDIR4->READDIR4res_u.resok4.reply.entries = NULL;
 	}
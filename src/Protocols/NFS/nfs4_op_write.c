@@ -404,15 +404,26 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 		    so_clientid;
 	}
 
-	cache_status = cache_inode_rdwr_plus(entry,
-					io,
-					offset,
-					size,
-					&written_size,
-					bufferdata,
-					&eof_met,
-					&sync,
-					info);
+	if (io == CACHE_INODE_WRITE) {
+		struct iovec iov = {
+			.iov_base = bufferdata,
+			.iov_len = size
+		};
+
+		cache_status = cache_inode_write_iov(entry, offset, &iov, 1,
+						     size, &written_size,
+						     &sync);
+	} else {
+		cache_status = cache_inode_rdwr_plus(entry,
+						io,
+						offset,
+						size,
+						&written_size,
+						bufferdata,
+						&eof_met,
+						&sync,
+						info);
+	}
 
 	if (cache_status != CACHE_INODE_SUCCESS) {
 		LogDebug(COMPONENT_NFS_V4,
@@ -37,6 +37,7 @@
 #include "nfs_proto_tools.h"
 #include "idmapper.h"
 #include "export_mgr.h"
+#include "buffer_pool.h"
 
 /* Define mapping of NFS4 who name and type. */
 static struct {
@@ -3049,7 +3050,7 @@ static nfsstat4 path_filter(const char *name, utf8_scantype_t scan)
 void nfs4_Fattr_Free(fattr4 *fattr)
 {
 	if (fattr->attr_vals.attrlist4_val != NULL) {
-		gsh_free(fattr->attr_vals.attrlist4_val);
+		gsh_buf_free(fattr->attr_vals.attrlist4_val);
 		fattr->attr_vals.attrlist4_val = NULL;
 	}
 }
@@ -3165,7 +3166,7 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 	/* basic init */
 	memset(&Fattr->attrmask, 0, sizeof(Fattr->attrmask));
 	Fattr->attr_vals.attrlist4_val =
-	    gsh_malloc(fattr4tab[FATTR4_RDATTR_ERROR].size_fattr4);
+	    gsh_buf_alloc(fattr4tab[FATTR4_RDATTR_ERROR].size_fattr4);
 
 	if (Fattr->attr_vals.attrlist4_val == NULL)
 		return -1;
@@ -3194,7 +3195,7 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 
 		if (LastOffset == 0) {	/* no supported attrs so we can free */
 			assert(Fattr->attrmask.bitmap4_len == 0);
-			gsh_free(Fattr->attr_vals.attrlist4_val);
+			gsh_buf_free(Fattr->attr_vals.attrlist4_val);
 			Fattr->attr_vals.attrlist4_val = NULL;
 		}
 		Fattr->attr_vals.attrlist4_len = LastOffset;
@@ -3206,7 +3207,7 @@ int nfs4_Fattr_Fill_Error(fattr4 *Fattr, nfsstat4 rdattr_error)
 			     fattr4tab[FATTR4_RDATTR_ERROR].name);
 		/* signal fail so if(LastOffset > 0) works right */
 
-		gsh_free(Fattr->attr_vals.attrlist4_val);
+		gsh_buf_free(Fattr->attr_vals.attrlist4_val);
 		Fattr->attr_vals.attrlist4_val = NULL;
 		return -1;
 	}
@@ -3243,7 +3244,7 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 	if (Bitmap->bitmap4_len == 0)
 		return 0;	/* they ask for nothing, they get nothing */
 
-	Fattr->attr_vals.attrlist4_val = gsh_malloc(NFS4_ATTRVALS_BUFFLEN);
+	Fattr->attr_vals.attrlist4_val = gsh_buf_alloc(NFS4_ATTRVALS_BUFFLEN);
 
 	if (Fattr->attr_vals.attrlist4_val == NULL)
 		return -1;
@@ -3295,14 +3296,14 @@ int nfs4_FSALattr_To_Fattr(struct xdr_attrs_args *args, struct bitmap4 *Bitmap,
 
 	if (LastOffset == 0) {	/* no supported attrs so we can free */
 		assert(Fattr->attrmask.bitmap4_len == 0);
-		gsh_free(Fattr->attr_vals.attrlist4_val);
+		gsh_buf_free(Fattr->attr_vals.attrlist4_val);
 		Fattr->attr_vals.attrlist4_val = NULL;
 	}
 	Fattr->attr_vals.attrlist4_len = LastOffset;
 	return 0;
 
  err:
-	gsh_free(Fattr->attr_vals.attrlist4_val);
+	gsh_buf_free(Fattr->attr_vals.attrlist4_val);
 	Fattr->attr_vals.attrlist4_val = NULL;
 	return -1;
 }
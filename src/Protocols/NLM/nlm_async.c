@@ -24,6 +24,7 @@
 
 #include "config.h"
 #include <stdio.h>
+#include <errno.h>
 #include <pthread.h>
 #include <rpc/types.h>
 #include <rpc/nettype.h>
@@ -32,10 +33,96 @@
 #include "nlm4.h"
 #include "nlm_util.h"
 #include "nlm_async.h"
+#include "nfs_core.h"
+#include "fridgethr.h"
 
 pthread_mutex_t nlm_async_resp_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t nlm_async_resp_cond = PTHREAD_COND_INITIALIZER;
 
+/* Threads sending callbacks, so that a client slow to answer one
+ * GRANTED does not hold up the callbacks to everyone else.
+ */
+static struct fridgethr *nlm_async_fridge;
+
+static void nlm_async_func_caller(struct fridgethr_context *ctx)
+{
+	state_async_queue_t *entry = ctx->arg;
+
+	entry->state_async_func(entry);
+}
+
+/**
+ * @brief Start the NLM callback threads
+ *
+ * @return 0 on success, -1 on failure.
+ */
+
+int nlm_async_callback_init(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = nfs_param.core_param.nlm_callback_threads;
+	frp.deferment = fridgethr_defer_queue;
+	rc = fridgethr_init(&nlm_async_fridge, "NLM_Async", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_NLM,
+			 "Unable to initialize NLM callback thread fridge: %d",
+			 rc);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Stop the NLM callback threads
+ *
+ * @return 0 on success, an errno otherwise.
+ */
+
+int nlm_async_callback_shutdown(void)
+{
+	int rc;
+
+	if (nlm_async_fridge == NULL)
+		return 0;
+
+	rc = fridgethr_sync_command(nlm_async_fridge, fridgethr_comm_stop,
+				    120);
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_NLM,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(nlm_async_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_NLM,
+			 "Failed shutting down NLM callback threads: %d", rc);
+	}
+	return rc;
+}
+
+/**
+ * @brief Queue a callback to be sent by the NLM callback threads
+ *
+ * @param[in] arg The callback, state_async_func sends it
+ *
+ * @return STATE_SUCCESS or STATE_SIGNAL_ERROR.
+ */
+
+state_status_t nlm_async_schedule(state_async_queue_t *arg)
+{
+	int rc;
+
+	LogFullDebug(COMPONENT_NLM, "Schedule %p", arg);
+
+	rc = fridgethr_submit(nlm_async_fridge, nlm_async_func_caller, arg);
+
+	if (rc != 0)
+		LogCrit(COMPONENT_NLM, "Unable to schedule callback: %d", rc);
+
+	return rc == 0 ? STATE_SUCCESS : STATE_SIGNAL_ERROR;
+}
+
 int nlm_send_async_res_nlm4(state_nlm_client_t *host, state_async_func_t func,
 			    nfs_res_t *pres)
 {
@@ -62,7 +149,7 @@ int nlm_send_async_res_nlm4(state_nlm_client_t *host, state_async_func_t func,
 		return NFS_REQ_DROP;
 	}
 
-	status = state_async_schedule(arg);
+	status = nlm_async_schedule(arg);
 
 	if (status != STATE_SUCCESS) {
 		gsh_free(arg);
@@ -111,7 +198,7 @@ int nlm_send_async_res_nlm4test(state_nlm_client_t *host,
 		return NFS_REQ_DROP;
 	}
 
-	status = state_async_schedule(arg);
+	status = nlm_async_schedule(arg);
 
 	if (status != STATE_SUCCESS) {
 		netobj_free(
@@ -135,134 +222,204 @@ xdrproc_t nlm_reply_proc[] = {
 	[NLMPROC4_UNLOCK_RES] = (xdrproc_t) xdr_nlm4_res,
 };
 
-static void *resp_key;
+/* A sender waiting for the _RES to its callback.  The key is
+ * cleared by nlm_signal_async_resp when the _RES comes in.
+ */
+struct nlm_async_waiter {
+	struct glist_head list;
+	void *key;
+};
+
+/* Senders waiting, protected by nlm_async_resp_mutex */
+static struct glist_head nlm_async_waiters =
+	GLIST_HEAD_INIT(nlm_async_waiters);
 
 static const int MAX_ASYNC_RETRY = 2;
 
+/**
+ * @brief Create the callback client to a host
+ *
+ * Called with the host's slc_callback_lock held for write.
+ *
+ * @param[in,out] host The host
+ *
+ * @return 0 on success, -1 on failure.
+ */
+
+static int nlm_create_callback_clnt(state_nlm_client_t *host)
+{
+	LogFullDebug(COMPONENT_NLM,
+		     "gsh_clnt_create %s",
+		     host->slc_nsm_client->ssc_nlm_caller_name);
+
+	if (host->slc_client_type == XPRT_TCP) {
+		int fd;
+		struct sockaddr_in6 server_addr;
+		struct netbuf *buf, local_buf;
+		struct addrinfo *result;
+		struct addrinfo hints;
+		char port_str[20];
+
+		fd = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
+		if (fd < 0)
+			return -1;
+
+		memcpy(&server_addr,
+		       &(host->slc_server_addr),
+		       sizeof(struct sockaddr_in6));
+		server_addr.sin6_port = 0;
+
+		if (bind(fd,
+			 (struct sockaddr *)&server_addr,
+			  sizeof(server_addr)) == -1) {
+			LogMajor(COMPONENT_NLM, "Cannot bind");
+			close(fd);
+			return -1;
+		}
+
+		buf = rpcb_find_mapped_addr(
+		     (char *) xprt_type_to_str(host->slc_client_type),
+		     NLMPROG, NLM4_VERS,
+		     host->slc_nsm_client->ssc_nlm_caller_name);
+		/* handle error here, for example,
+		 * client side blocking rpc call
+		 */
+		if (buf == NULL) {
+			LogMajor(COMPONENT_NLM,
+				 "Cannot create NLM async %s connection to client %s",
+				 xprt_type_to_str(host->slc_client_type),
+				 host->slc_nsm_client->ssc_nlm_caller_name);
+			close(fd);
+			return -1;
+		}
+
+		memset(&hints, 0, sizeof(struct addrinfo));
+		hints.ai_family = AF_INET6;	/* only INET6 */
+		hints.ai_socktype = SOCK_STREAM; /* TCP */
+		hints.ai_protocol = 0;	/* Any protocol */
+		hints.ai_canonname = NULL;
+		hints.ai_addr = NULL;
+		hints.ai_next = NULL;
+
+		/* convert port to string format */
+		sprintf(port_str, "%d",
+			htons(((struct sockaddr_in *) buf->buf)->sin_port));
+
+		/* buf with inet is only needed for the port */
+		gsh_free(buf->buf);
+		gsh_free(buf);
+
+		/* get the IPv4 mapped IPv6 address */
+		getaddrinfo(host->slc_nsm_client->ssc_nlm_caller_name,
+			    port_str,
+			    &hints,
+			    &result);
+
+		/* setup the netbuf with in6 address */
+		local_buf.buf = result->ai_addr;
+		local_buf.len = local_buf.maxlen = result->ai_addrlen;
+
+		host->slc_callback_clnt =
+		    clnt_vc_ncreate(fd, &local_buf, NLMPROG,
+				    NLM4_VERS, 0, 0);
+		freeaddrinfo(result);
+	} else {
+
+		host->slc_callback_clnt = gsh_clnt_create(
+		    host->slc_nsm_client->ssc_nlm_caller_name,
+		    NLMPROG,
+		    NLM4_VERS,
+		    (char *) xprt_type_to_str(host->slc_client_type));
+	}
+
+	if (host->slc_callback_clnt == NULL) {
+		LogMajor(COMPONENT_NLM,
+			 "Cannot create NLM async %s connection to client %s",
+			 xprt_type_to_str(host->slc_client_type),
+			 host->slc_nsm_client->ssc_nlm_caller_name);
+		return -1;
+	}
+
+	/* split auth (for authnone, idempotent) */
+	host->slc_callback_auth = authnone_create();
+	return 0;
+}
+
+/**
+ * @brief Drop a host's callback client after a failed call
+ *
+ * Another sender may already have replaced it, so only clnt itself
+ * is destroyed.
+ *
+ * @param[in,out] host The host
+ * @param[in]     clnt The client the call failed on
+ */
+
+static void nlm_destroy_callback_clnt(state_nlm_client_t *host,
+				      CLIENT *clnt)
+{
+	PTHREAD_RWLOCK_wrlock(&host->slc_callback_lock);
+
+	if (host->slc_callback_clnt == clnt) {
+		gsh_clnt_destroy(host->slc_callback_clnt);
+		host->slc_callback_clnt = NULL;
+		if (host->slc_callback_auth != NULL) {
+			AUTH_DESTROY(host->slc_callback_auth);
+			host->slc_callback_auth = NULL;
+		}
+	}
+
+	PTHREAD_RWLOCK_unlock(&host->slc_callback_lock);
+}
+
 /* Client routine  to send the asynchrnous response,
  * key is used to wait for a response
+ *
+ * The callback client to each host is created on first use and
+ * shared by every sender to that host, so callbacks from the NLM
+ * callback threads go out side by side on one connection.
  */
 int nlm_send_async(int proc, state_nlm_client_t *host, void *inarg, void *key)
 {
 	struct timeval tout = { 0, 10 };
 	int retval, retry;
-	struct timeval start, now;
+	struct timeval start;
 	struct timespec timeout;
+	struct nlm_async_waiter waiter;
+	CLIENT *clnt;
 
-	for (retry = 1; retry <= MAX_ASYNC_RETRY; retry++) {
-		if (host->slc_callback_clnt == NULL) {
-			LogFullDebug(COMPONENT_NLM,
-				     "gsh_clnt_create %s",
-				     host->slc_nsm_client->ssc_nlm_caller_name);
-
-			if (host->slc_client_type == XPRT_TCP) {
-				int fd;
-				struct sockaddr_in6 server_addr;
-				struct netbuf *buf, local_buf;
-				struct addrinfo *result;
-				struct addrinfo hints;
-				char port_str[20];
-
-				fd = socket(PF_INET6, SOCK_STREAM, IPPROTO_TCP);
-				if (fd < 0)
-					return -1;
-
-				memcpy(&server_addr,
-				       &(host->slc_server_addr),
-				       sizeof(struct sockaddr_in6));
-				server_addr.sin6_port = 0;
-
-				if (bind(fd,
-					 (struct sockaddr *)&server_addr,
-					  sizeof(server_addr)) == -1) {
-					LogMajor(COMPONENT_NLM, "Cannot bind");
-					close(fd);
-					return -1;
-				}
-
-				buf = rpcb_find_mapped_addr(
-				     (char *) xprt_type_to_str(
-							host->slc_client_type),
-				     NLMPROG, NLM4_VERS,
-				     host->slc_nsm_client->ssc_nlm_caller_name);
-				/* handle error here, for example,
-				 * client side blocking rpc call
-				 */
-				if (buf == NULL) {
-					LogMajor(COMPONENT_NLM,
-						 "Cannot create NLM async %s connection to client %s",
-						 xprt_type_to_str(
-							host->slc_client_type),
-						 host->slc_nsm_client->
-						 ssc_nlm_caller_name);
-					close(fd);
-					return -1;
-				}
-
-				memset(&hints, 0, sizeof(struct addrinfo));
-				hints.ai_family = AF_INET6;	/* only INET6 */
-				hints.ai_socktype = SOCK_STREAM; /* TCP */
-				hints.ai_protocol = 0;	/* Any protocol */
-				hints.ai_canonname = NULL;
-				hints.ai_addr = NULL;
-				hints.ai_next = NULL;
-
-				/* convert port to string format */
-				sprintf(port_str, "%d",
-					htons(((struct sockaddr_in *)
-						buf->buf)->sin_port));
-
-				/* buf with inet is only needed for the port */
-				gsh_free(buf->buf);
-				gsh_free(buf);
-
-				/* get the IPv4 mapped IPv6 address */
-				getaddrinfo(host->slc_nsm_client->
-					    ssc_nlm_caller_name,
-					    port_str,
-					    &hints,
-					    &result);
-
-				/* setup the netbuf with in6 address */
-				local_buf.buf = result->ai_addr;
-				local_buf.len = local_buf.maxlen =
-				    result->ai_addrlen;
-
-				host->slc_callback_clnt =
-				    clnt_vc_ncreate(fd, &local_buf, NLMPROG,
-						    NLM4_VERS, 0, 0);
-				freeaddrinfo(result);
-			} else {
-
-				host->slc_callback_clnt = gsh_clnt_create(
-				    host->slc_nsm_client->ssc_nlm_caller_name,
-				    NLMPROG,
-				    NLM4_VERS,
-				    (char *) xprt_type_to_str(
-						host->slc_client_type));
-			}
+	/* Wait from before the call, the _RES may beat clnt_call back */
+	waiter.key = key;
+	if (key != NULL) {
+		pthread_mutex_lock(&nlm_async_resp_mutex);
+		glist_add_tail(&nlm_async_waiters, &waiter.list);
+		pthread_mutex_unlock(&nlm_async_resp_mutex);
+	}
 
-			if (host->slc_callback_clnt == NULL) {
-				LogMajor(COMPONENT_NLM,
-					 "Cannot create NLM async %s connection to client %s",
-					 xprt_type_to_str(host->
-							  slc_client_type),
-					 host->slc_nsm_client->
-					 ssc_nlm_caller_name);
-				return -1;
+	for (retry = 1; retry <= MAX_ASYNC_RETRY; retry++) {
+		PTHREAD_RWLOCK_rdlock(&host->slc_callback_lock);
+
+		while (host->slc_callback_clnt == NULL) {
+			PTHREAD_RWLOCK_unlock(&host->slc_callback_lock);
+			PTHREAD_RWLOCK_wrlock(&host->slc_callback_lock);
+
+			if (host->slc_callback_clnt == NULL &&
+			    nlm_create_callback_clnt(host) != 0) {
+				PTHREAD_RWLOCK_unlock(
+					&host->slc_callback_lock);
+				retval = -1;
+				goto out;
 			}
 
-			/* split auth (for authnone, idempotent) */
-			host->slc_callback_auth = authnone_create();
+			PTHREAD_RWLOCK_unlock(&host->slc_callback_lock);
+			PTHREAD_RWLOCK_rdlock(&host->slc_callback_lock);
 		}
 
-		pthread_mutex_lock(&nlm_async_resp_mutex);
-		resp_key = key;
-		pthread_mutex_unlock(&nlm_async_resp_mutex);
+		clnt = host->slc_callback_clnt;
 
 		LogFullDebug(COMPONENT_NLM, "About to make clnt_call");
 
-		retval = clnt_call(host->slc_callback_clnt,
+		retval = clnt_call(clnt,
 				   host->slc_callback_auth,
 				   proc,
 				   nlm_reply_proc[proc],
@@ -274,6 +431,7 @@ int nlm_send_async(int proc, state_nlm_client_t *host, void *inarg, void *key)
 		LogFullDebug(COMPONENT_NLM, "Done with clnt_call");
 
 		if (retval == RPC_TIMEDOUT || retval == RPC_SUCCESS) {
+			PTHREAD_RWLOCK_unlock(&host->slc_callback_lock);
 			retval = RPC_SUCCESS;
 			break;
 		}
@@ -281,63 +439,83 @@ int nlm_send_async(int proc, state_nlm_client_t *host, void *inarg, void *key)
 		LogCrit(COMPONENT_NLM,
 			"NLM async Client procedure call %d failed with return code %d %s",
 			proc, retval,
-			clnt_sperror(host->slc_callback_clnt, ""));
+			clnt_sperror(clnt, ""));
 
-		gsh_clnt_destroy(host->slc_callback_clnt);
-		host->slc_callback_clnt = NULL;
+		PTHREAD_RWLOCK_unlock(&host->slc_callback_lock);
+
+		nlm_destroy_callback_clnt(host, clnt);
 
 		if (retry == MAX_ASYNC_RETRY) {
 			LogMajor(COMPONENT_NLM,
 				 "NLM async Client exceeded retry count %d",
 				 MAX_ASYNC_RETRY);
-			pthread_mutex_lock(&nlm_async_resp_mutex);
-			resp_key = NULL;
-			pthread_mutex_unlock(&nlm_async_resp_mutex);
-			return retval;
+			goto out;
 		}
 	}
 
+	if (key == NULL)
+		return retval;
+
 	pthread_mutex_lock(&nlm_async_resp_mutex);
 
-	if (resp_key != NULL) {
+	if (waiter.key != NULL) {
 		/* Wait for 5 seconds or a signal */
 		gettimeofday(&start, NULL);
-		gettimeofday(&now, NULL);
 		timeout.tv_sec = 5 + start.tv_sec;
-		timeout.tv_nsec = 0;
+		timeout.tv_nsec = start.tv_usec * 1000;
 
 		LogFullDebug(COMPONENT_NLM,
-			     "About to wait for signal for key %p", resp_key);
+			     "About to wait for signal for key %p", key);
 
-		while (resp_key != NULL && now.tv_sec < (start.tv_sec + 5)) {
+		while (waiter.key != NULL) {
 			int rc;
+
 			rc = pthread_cond_timedwait(&nlm_async_resp_cond,
 						    &nlm_async_resp_mutex,
 						    &timeout);
 			LogFullDebug(COMPONENT_NLM,
 				     "pthread_cond_timedwait returned %d",
 				     rc);
-			gettimeofday(&now, NULL);
+			if (rc == ETIMEDOUT)
+				break;
 		}
 		LogFullDebug(COMPONENT_NLM, "Done waiting");
 	}
 
 	pthread_mutex_unlock(&nlm_async_resp_mutex);
 
+ out:
+	if (key != NULL) {
+		pthread_mutex_lock(&nlm_async_resp_mutex);
+		if (waiter.key != NULL)
+			glist_del(&waiter.list);
+		pthread_mutex_unlock(&nlm_async_resp_mutex);
+	}
+
 	return retval;
 }
 
 void nlm_signal_async_resp(void *key)
 {
+	struct glist_head *glist;
+	struct nlm_async_waiter *waiter;
+
 	pthread_mutex_lock(&nlm_async_resp_mutex);
 
-	if (resp_key == key) {
-		resp_key = NULL;
-		pthread_cond_signal(&nlm_async_resp_cond);
-		LogFullDebug(COMPONENT_NLM, "Signaled condition variable");
-	} else {
-		LogFullDebug(COMPONENT_NLM, "Didn't signal condition variable");
+	glist_for_each(glist, &nlm_async_waiters) {
+		waiter = glist_entry(glist, struct nlm_async_waiter, list);
+		if (waiter->key == key) {
+			glist_del(&waiter->list);
+			waiter->key = NULL;
+			pthread_cond_broadcast(&nlm_async_resp_cond);
+			LogFullDebug(COMPONENT_NLM,
+				     "Signaled condition variable");
+			pthread_mutex_unlock(&nlm_async_resp_mutex);
+			return;
+		}
 	}
 
+	LogFullDebug(COMPONENT_NLM, "Didn't signal condition variable");
+
 	pthread_mutex_unlock(&nlm_async_resp_mutex);
 }
@@ -158,6 +158,10 @@ void nlm_init(void)
 	granted_cookie.gc_seconds = (unsigned long)nlm_grace_tv.tv_sec;
 	granted_cookie.gc_microseconds = (unsigned long)nlm_grace_tv.tv_usec;
 	granted_cookie.gc_cookie = 0;
+
+	if (nlm_async_callback_init() != 0)
+		LogFatal(COMPONENT_NLM,
+			 "Could not start the NLM callback threads");
 }
 
 void free_grant_arg(state_async_queue_t *arg)
@@ -634,7 +638,7 @@ state_status_t nlm_granted_callback(cache_entry_t *pentry,
 	}
 
 	/* Now try to schedule NLMPROC4_GRANTED_MSG call */
-	state_status = state_async_schedule(arg);
+	state_status = nlm_async_schedule(arg);
 
 	if (state_status != STATE_SUCCESS)
 		goto grant_fail;
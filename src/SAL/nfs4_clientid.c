@@ -1015,7 +1015,7 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid)
 	}
 
 	if (clientid->cid_recov_dir != NULL) {
-		nfs4_rm_clid(clientid->cid_recov_dir, v4_recov_dir, 0);
+		nfs4_rm_clid(clientid);
 		gsh_free(clientid->cid_recov_dir);
 		clientid->cid_recov_dir = NULL;
 	}
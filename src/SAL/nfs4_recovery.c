@@ -39,18 +39,16 @@
 #include <fcntl.h>
 #include <ctype.h>
 
-#define NFS_V4_RECOV_ROOT "/var/lib/nfs/ganesha"
-#define NFS_V4_RECOV_DIR "v4recov"
-#define NFS_V4_OLD_DIR "v4old"
-
-char v4_recov_dir[PATH_MAX + 1];
-char v4_old_dir[PATH_MAX + 1];
-
 /**
  * @brief Grace period control data
  */
 static grace_t grace;
 
+/**
+ * @brief Stable storage for client records
+ */
+static struct nfs4_recovery_backend *recovery_backend;
+
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp);
 static void nfs_release_nlm_state();
 static void nfs_release_v4_client(char *ip);
@@ -308,7 +306,7 @@ void nfs4_create_clid_name41(nfs_client_record_t *cl_rec,
 }
 
 /**
- * @brief Create an entry in the recovery directory
+ * @brief Record a client in stable storage
  *
  * This entry alows the client to reclaim state after a server
  * reboot/restart.
@@ -317,10 +315,6 @@ void nfs4_create_clid_name41(nfs_client_record_t *cl_rec,
  */
 void nfs4_add_clid(nfs_client_id_t *clientid)
 {
-	int err = 0;
-	char path[PATH_MAX + 1] = {0}, segment[NAME_MAX + 1] = {0};
-	int length, position = 0;
-
 	if (clientid->cid_minorversion > 0)
 		nfs4_create_clid_name41(clientid->cid_client_record, clientid);
 
@@ -330,146 +324,22 @@ void nfs4_add_clid(nfs_client_id_t *clientid)
 		return;
 	}
 
-	/* break clientid down if it is greater than max dir name */
-	/* and create a directory hierachy to represent the clientid. */
-	snprintf(path, sizeof(path), "%s", v4_recov_dir);
-
-	length = strlen(clientid->cid_recov_dir);
-	while (position < length) {
-		/* if the (remaining) clientid is shorter than 255 */
-		/* create the last level of dir and break out */
-		int len = strlen(&clientid->cid_recov_dir[position]);
-		if (len <= NAME_MAX) {
-			strcat(path, "/");
-			strncat(path, &clientid->cid_recov_dir[position], len);
-			err = mkdir(path, 0700);
-			break;
-		}
-		/* if (remaining) clientid is longer than 255, */
-		/* get the next 255 bytes and create a subdir */
-		strncpy(segment, &clientid->cid_recov_dir[position], NAME_MAX);
-		strcat(path, "/");
-		strncat(path, segment, NAME_MAX);
-		err = mkdir(path, 0700);
-		if (err == -1 && errno != EEXIST)
-			break;
-		position += NAME_MAX;
-	}
-
-	if (err == -1 && errno != EEXIST) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create client in recovery dir (%s), errno=%d",
-			 path, errno);
-	} else {
-		LogDebug(COMPONENT_CLIENTID, "Created client dir [%s]", path);
-	}
+	recovery_backend->add_clid(clientid);
 }
 
 /**
- * @brief Remove the revoked file handles created under a specific
- * client-id path on the stable storage.
- *
- * @param[in] path Path of the client-id on the stable storage.
- */
-
-void nfs4_rm_revoked_handles(char *path)
-{
-	DIR *dp;
-	struct dirent *dentp;
-	char del_path[PATH_MAX];
-
-	dp = opendir(path);
-	if (dp == NULL) {
-		LogEvent(COMPONENT_CLIENTID, "opendir %s failed errno=%d",
-			path, errno);
-		return;
-	}
-	for (dentp = readdir(dp); dentp != NULL; dentp = readdir(dp)) {
-		if (!strcmp(dentp->d_name, ".") ||
-				!strcmp(dentp->d_name, "..") ||
-				dentp->d_name[0] != '.') {
-			continue;
-		}
-		sprintf(del_path, "%s/%s", path, dentp->d_name);
-		if (unlink(del_path) < 0) {
-			LogEvent(COMPONENT_CLIENTID,
-					"unlink of %s failed errno: %d",
-					del_path,
-					errno);
-		}
-	}
-	(void)closedir(dp);
-}
-
-/**
- * @brief Remove a client entry from the recovery directory
+ * @brief Remove a client from stable storage
  *
  * This function would be called when a client expires.
  *
- * @param[in] recov_dir Recovery directory
+ * @param[in] clientid Client record
  */
-void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
+void nfs4_rm_clid(nfs_client_id_t *clientid)
 {
-	int err;
-	char *path;
-	char *segment;
-	int len, segment_len;
-	int total_len;
-
-	if (recov_dir == NULL)
-		return;
-
-	len = strlen(recov_dir);
-	if (position == len) {
-		/* We are at the tail directory of the clid,
-		 * remove revoked handles, if any.
-		 */
-		nfs4_rm_revoked_handles(parent_path);
-		return;
-	}
-	segment = gsh_malloc(NAME_MAX+1);
-	if (segment == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client in recovery dir (%s), ENOMEM",
-			  recov_dir);
-		return;
-	}
-
-	memset(segment, 0, NAME_MAX+1);
-	strncpy(segment, &recov_dir[position], NAME_MAX);
-	segment_len = strlen(segment);
-
-	/* allocate enough memory for the new part of the string */
-	/* which is parent path + '/' + new segment */
-	total_len = strlen(parent_path) + segment_len + 2;
-	path = gsh_malloc(total_len);
-	if (path == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client in recovery dir (%s), ENOMEM",
-			  recov_dir);
-		gsh_free(segment);
+	if (clientid->cid_recov_dir == NULL)
 		return;
-	}
-	memset(path, 0, total_len);
-	(void) snprintf(path, total_len, "%s/%s",
-			parent_path, segment);
-	/* free setment as it has no use now */
-	gsh_free(segment);
-
-	/* recursively remove the directory hirerchy which represent the
-	 *clientid
-	 */
-	nfs4_rm_clid(recov_dir, path, position+segment_len);
 
-	err = rmdir(path);
-	if (err == -1) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to remove client recovery dir (%s), errno=%d",
-			 path, errno);
-	} else {
-		LogDebug(COMPONENT_CLIENTID, "Removed client dir [%s]", path);
-	}
-	gsh_free(path);
+	recovery_backend->rm_clid(clientid);
 }
 
 /**
@@ -535,350 +405,67 @@ void  nfs4_chk_clid(nfs_client_id_t *clientid)
 	return;
 }
 
-static void free_heap(char *path, char *new_path, char *build_clid)
-{
-	if (path)
-		gsh_free(path);
-	if (new_path)
-		gsh_free(new_path);
-	if (build_clid)
-		gsh_free(build_clid);
-}
-
 /**
- * @brief Copy and Populate revoked delegations for this client.
+ * @brief Add a client to the list of those allowed to reclaim
  *
- * Even after delegation revoke, it is possible for the client to
- * contiue its leas and other operatoins. Sever saves revoked delegations
- * in the memory so client will not be granted same delegation with
- * DELEG_CUR ; but it is possible that the server might reboot and has
- * no record of the delegatin. This list helps to reject delegations
- * client is obtaining through DELEG_PREV.
+ * Called by the recovery backend for each client it loads.
  *
- * @param[in] clientid Clientid that is being created.
- * @param[in] path Path of the directory structure.
- * @param[in] Target dir to copy.
- * @param[in] del Delete after populating
+ * @param[in] cl_name Client name
+ *
+ * @return The new entry, or NULL on failure.
  */
-
-void nfs4_cp_pop_revoked_delegs(clid_entry_t *clid_ent,
-				char *path,
-				char *tgtdir,
-				bool del)
+static clid_entry_t *nfs4_add_clid_entry(char *cl_name)
 {
-	struct dirent *dentp;
-	DIR *dp;
-	rdel_fh_t *new_ent;
-	char *clid_str;
-	int len;
-
-	glist_init(&clid_ent->cl_rfh_list);
-	/* Read the contents from recov dir of this clientid. */
-	dp = opendir(path);
-	if (dp == NULL) {
-		LogEvent(COMPONENT_CLIENTID, "opendir %s failed errno=%d",
-			path, errno);
-		return;
+	clid_entry_t *new_ent;
+
+	new_ent = gsh_malloc(sizeof(clid_entry_t));
+	if (new_ent == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		return NULL;
 	}
 
-	dentp = readdir(dp);
-	while (dentp != NULL) {
-		if (!strcmp(dentp->d_name, ".") || !strcmp(dentp->d_name, ".."))
-			goto read_next;
-		/* All the revoked filehandles stored as hidden files */
-		if (dentp->d_name[0] != '.') {
-			/* Something wrong; it should not happen */
-			LogMidDebug(COMPONENT_CLIENTID,
-				"%s showed up along with revoked FHs. Skipping",
-				dentp->d_name);
-			goto read_next;
-		}
-		if (tgtdir) {
-			char lopath[PATH_MAX + 1];
-			int fd;
-			sprintf(lopath, "%s/", tgtdir);
-			strncat(lopath, dentp->d_name, strlen(dentp->d_name));
-			fd = creat(lopath, 0700);
-			if (fd < 0) {
-				LogEvent(COMPONENT_CLIENTID,
-					"Failed to copy revoked handle file %s to %s errno:%d\n",
-				dentp->d_name, tgtdir, errno);
-			} else {
-				close(fd);
-			}
-		}
-		new_ent = gsh_malloc(sizeof(rdel_fh_t));
-		if (new_ent == NULL) {
-			LogEvent(COMPONENT_CLIENTID, "Alloc Failed: rdel_fh_t");
-			goto read_next;
-		}
+	glist_init(&new_ent->cl_rfh_list);
+	strmaxcpy(new_ent->cl_name, cl_name, sizeof(new_ent->cl_name));
+	glist_add(&grace.g_clid_list, &new_ent->cl_list);
+	LogDebug(COMPONENT_CLIENTID, "added %s to clid list",
+		 new_ent->cl_name);
 
-		len = strlen(dentp->d_name);
-		/* Use the first . space for terminating NULL */
-		new_ent->rdfh_handle_str = gsh_malloc(len);
-		if (new_ent->rdfh_handle_str == NULL) {
-			gsh_free(new_ent);
-			LogEvent(COMPONENT_CLIENTID,
-				"Alloc Failed: rdel_fh_t->rdfh_handle_str");
-			goto read_next;
-		}
-		clid_str = dentp->d_name + 1;
-		strcpy(new_ent->rdfh_handle_str, clid_str);
-		glist_init(&new_ent->rdfh_list);
-		glist_add(&clid_ent->cl_rfh_list, &new_ent->rdfh_list);
-		LogFullDebug(COMPONENT_CLIENTID,
-			"revoked handle: %s",
-			new_ent->rdfh_handle_str);
-read_next:
-		/* Since the handle is loaded into memory, go ahead and
-		 * delete it from the stable storage.
-		 */
-		if (del) {
-			char del_path[PATH_MAX];
-			sprintf(del_path, "%s/%s", path, dentp->d_name);
-			if (unlink(del_path) < 0) {
-				LogEvent(COMPONENT_CLIENTID,
-						"unlink of %s failed errno: %d",
-						del_path,
-						errno);
-			}
-		}
-		dentp = readdir(dp);
-	}
-	(void)closedir(dp);
+	return new_ent;
 }
 
-
 /**
- * @brief Create the client reclaim list
+ * @brief Add a revoked filehandle to a client allowed to reclaim
  *
- * When not doing a take over, first open the old state dir and read
- * in those entries.  The reason for the two directories is in case of
- * a reboot/restart during grace period.  Next, read in entries from
- * the recovery directory and then move them into the old state
- * directory.  if called due to a take over, nodeid will be nonzero.
- * in this case, add that node's clientids to the existing list.  Then
- * move those entries into the old state directory.
+ * Called by the recovery backend for each revoked handle it loads.
  *
- * @param[in] dp       Recovery directory
- * @param[in] srcdir   Path to the source directory on failover
- * @param[in] takeover Whether this is a takeover.
+ * @param[in,out] clid_ent Client entry
+ * @param[in]     rfh_name Revoked handle, as a string
  *
- * @return POSIX error codes.
+ * @return The new entry, or NULL on failure.
  */
-static int nfs4_read_recov_clids(DIR *dp,
-				 const char *parent_path,
-				 char *clid_str,
-				 char *tgtdir,
-				 int takeover)
+static rdel_fh_t *nfs4_add_rfh_entry(clid_entry_t *clid_ent, char *rfh_name)
 {
-	struct dirent *dentp;
-	DIR *subdp;
-	clid_entry_t *new_ent;
-	char *path = NULL;
-	char *new_path = NULL;
-	char *build_clid = NULL;
-	int rc = 0;
-	int num = 0;
-	char *ptr, *ptr2;
-	char temp[10];
-	int cid_len, len;
-	int segment_len;
-	int total_len;
-	int total_tgt_len;
-	int total_clid_len;
-
-	for (dentp = readdir(dp); dentp != NULL; dentp = readdir(dp)) {
-		/* don't add '.' and '..' entry */
-		if (!strcmp(dentp->d_name, ".") || !strcmp(dentp->d_name, ".."))
-			continue;
-
-		if (dentp->d_name[0] != '.') {
-			num++;
-			new_path = NULL;
-
-			/* construct the path by appending the subdir for the
-			 * next readdir. This recursion keeps reading the
-			 * subdirectory until reaching the end.
-			 */
-			segment_len = strlen(dentp->d_name);
-			total_len = segment_len + 2 + strlen(parent_path);
-			path = gsh_malloc(total_len);
-			/* if failed on this subdirectory, move to next */
-			/* we might be lucky */
-			if (path == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "malloc faied errno=%d", errno);
-				continue;
-			}
-			memset(path, 0, total_len);
-
-			strcpy(path, parent_path);
-			strcat(path, "/");
-			strncat(path, dentp->d_name, segment_len);
-			/* if tgtdir is not NULL, we need to build
-			 * nfs4old/currentnode
-			 */
-			if (tgtdir) {
-				total_tgt_len = segment_len + 2 +
-						strlen(tgtdir);
-				new_path = gsh_malloc(total_tgt_len);
-				if (new_path == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "malloc faied errno=%d",
-						 errno);
-					gsh_free(path);
-					continue;
-				}
-				memset(new_path, 0, total_tgt_len);
-				strcpy(new_path, tgtdir);
-				strcat(new_path, "/");
-				strncat(new_path, dentp->d_name, segment_len);
-				rc = mkdir(new_path, 0700);
-				if ((rc == -1) && (errno != EEXIST)) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "mkdir %s faied errno=%d",
-						 new_path, errno);
-				}
-			}
-			/* keep building the clientid str by cursively */
-			/* reading the directory structure */
-			if (clid_str)
-				total_clid_len = segment_len + 1 +
-						 strlen(clid_str);
-			else
-				total_clid_len = segment_len + 1;
-			build_clid = gsh_malloc(total_clid_len);
-			if (build_clid == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "malloc faied errno=%d", errno);
-				free_heap(path, new_path, NULL);
-				continue;
-			}
-			memset(build_clid, 0, total_clid_len);
-			if (clid_str)
-				strcpy(build_clid, clid_str);
-			strncat(build_clid, dentp->d_name, segment_len);
-			subdp = opendir(path);
-			if (subdp == NULL) {
-				LogEvent(COMPONENT_CLIENTID,
-					 "opendir %s failed errno=%d",
-					 dentp->d_name, errno);
-				free_heap(path, new_path, build_clid);
-				/* this shouldn't happen, but we should skip
-				 * the entry to avoid infinite loops
-				 */
-				continue;
-			}
+	rdel_fh_t *new_ent;
 
-			if (tgtdir)
-				rc = nfs4_read_recov_clids(subdp,
-							   path,
-							   build_clid,
-							   new_path,
-							   takeover);
-			else
-				rc = nfs4_read_recov_clids(subdp,
-							   path,
-							   build_clid,
-							   NULL,
-							   takeover);
-
-			/* close the sub directory */
-			(void)closedir(subdp);
-
-			if (new_path)
-				gsh_free(new_path);
-
-			/* after recursion, if the subdir has no non-hidden
-			 * directory this is the end of this clientid str. Add
-			 * the clientstr to the list.
-			 */
-			if (rc == 0) {
-				/* the clid format is
-				 * <IP>-(clid-len:long-form-clid-in-string-form)
-				 * make sure this reconstructed string is valid
-				 * by comparing clid-len and the actual
-				 * long-form-clid length in the string. This is
-				 * to prevent getting incompleted strings that
-				 * might exist due to program crash.
-				 */
-				if (strlen(build_clid) >= PATH_MAX) {
-					LogEvent(COMPONENT_CLIENTID,
-						"invalid clid format: %s, too long",
-						build_clid);
-					free_heap(path, NULL, build_clid);
-					continue;
-				}
-				ptr = strchr(build_clid, '(');
-				if (ptr == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					continue;
-				}
-				ptr2 = strchr(ptr, ':');
-				if (ptr2 == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					continue;
-				}
-				len = ptr2-ptr-1;
-				if (len >= 9) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "invalid clid format: %s",
-						 build_clid);
-					free_heap(path, NULL, build_clid);
-					continue;
-				}
-				strncpy(temp, ptr+1, len);
-				temp[len] = 0;
-				cid_len = atoi(temp);
-				len = strlen(ptr2);
-				if ((len == (cid_len+2)) &&
-				    (ptr2[len-1] == ')')) {
-					new_ent =
-					    gsh_malloc(sizeof(clid_entry_t));
-					if (new_ent == NULL) {
-						LogEvent(COMPONENT_CLIENTID,
-							 "Unable to allocate memory.");
-						free_heap(path,
-							  NULL,
-							  build_clid);
-						continue;
-					}
-					nfs4_cp_pop_revoked_delegs(new_ent,
-								path,
-								tgtdir,
-								!takeover);
-					strcpy(new_ent->cl_name, build_clid);
-					glist_add(&grace.g_clid_list,
-						  &new_ent->cl_list);
-					LogDebug(COMPONENT_CLIENTID,
-						 "added %s to clid list",
-						 new_ent->cl_name);
-				}
-			}
-			gsh_free(build_clid);
-			/* If this is not for takeover, remove the directory
-			 * hierarchy  that represent the current clientid
-			 */
-			if (!takeover) {
-				rc = rmdir(path);
-				if (rc == -1) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "Failed to rmdir (%s), errno=%d",
-						 path, errno);
-				}
-			}
-			gsh_free(path);
-		}
+	new_ent = gsh_malloc(sizeof(rdel_fh_t));
+	if (new_ent == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Alloc Failed: rdel_fh_t");
+		return NULL;
 	}
 
-	return num;
+	new_ent->rdfh_handle_str = gsh_strdup(rfh_name);
+	if (new_ent->rdfh_handle_str == NULL) {
+		gsh_free(new_ent);
+		LogEvent(COMPONENT_CLIENTID,
+			 "Alloc Failed: rdel_fh_t->rdfh_handle_str");
+		return NULL;
+	}
+
+	glist_add(&clid_ent->cl_rfh_list, &new_ent->rdfh_list);
+	LogFullDebug(COMPONENT_CLIENTID, "revoked handle: %s",
+		     new_ent->rdfh_handle_str);
+
+	return new_ent;
 }
 
 /**
@@ -888,11 +475,8 @@ static int nfs4_read_recov_clids(DIR *dp,
  */
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 {
-	DIR *dp;
 	struct glist_head *node;
 	clid_entry_t *clid_entry;
-	int rc;
-	char path[PATH_MAX + 1];
 
 	LogDebug(COMPONENT_STATE, "Load recovery cli %p", gsp);
 
@@ -906,90 +490,10 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 				gsh_free(clid_entry);
 			}
 		}
-
-		dp = opendir(v4_old_dir);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 v4_old_dir, errno);
-			return;
-		}
-		rc = nfs4_read_recov_clids(dp, v4_old_dir, NULL, NULL, 0);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)",
-				 v4_old_dir);
-			return;
-		}
-		(void)closedir(dp);
-
-		dp = opendir(v4_recov_dir);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 v4_recov_dir, errno);
-			return;
-		}
-
-		rc = nfs4_read_recov_clids(dp, v4_recov_dir,
-					   NULL, v4_old_dir, 0);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)",
-				 v4_recov_dir);
-			return;
-		}
-		rc = closedir(dp);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to close v4 recovery dir (%s), errno=%d",
-				 v4_recov_dir, errno);
-		}
-
-	} else {
-		if (gsp->event == EVENT_UPDATE_CLIENTS)
-			snprintf(path, sizeof(path), "%s", v4_recov_dir);
-
-		else if (gsp->event == EVENT_TAKE_IP)
-			snprintf(path, sizeof(path), "%s/%s/%s",
-				 NFS_V4_RECOV_ROOT, gsp->ipaddr,
-				 NFS_V4_RECOV_DIR);
-
-		else if (gsp->event == EVENT_TAKE_NODEID)
-			snprintf(path, sizeof(path), "%s/%s/node%d",
-				 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR,
-				 gsp->nodeid);
-
-		else
-			return;
-
-		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d dir (%s)",
-			 gsp->nodeid, path);
-
-		dp = opendir(path);
-		if (dp == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to open v4 recovery dir (%s), errno=%d",
-				 path, errno);
-			return;
-		}
-
-		rc = nfs4_read_recov_clids(dp, path, NULL, v4_old_dir, 1);
-		if (rc == -1) {
-			(void)closedir(dp);
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to read v4 recovery dir (%s)", path);
-			return;
-		}
-		rc = closedir(dp);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to close v4 recovery dir (%s), errno=%d",
-				 path, errno);
-		}
 	}
+
+	recovery_backend->recovery_read_clids(gsp, nfs4_add_clid_entry,
+					      nfs4_add_rfh_entry);
 }
 
 /**
@@ -1007,124 +511,42 @@ void nfs4_load_recov_clids(nfs_grace_start_t *gsp)
 }
 
 /**
- * @brief Clean up recovery directory
+ * @brief Forget the clients of the previous server instance
+ *
+ * Called once the grace period is over.
  */
-void nfs4_clean_old_recov_dir(char *parent_path)
+void nfs4_end_grace(void)
 {
-	DIR *dp;
-	struct dirent *dentp;
-	char *path = NULL;
-	int rc;
-	int segment_len;
-	int total_len;
-
-	dp = opendir(parent_path);
-	if (dp == NULL) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to open old v4 recovery dir (%s), errno=%d",
-			 v4_old_dir, errno);
-		return;
-	}
-
-	for (dentp = readdir(dp); dentp != NULL; dentp = readdir(dp)) {
-		/* don't remove '.' and '..' entry */
-		if (!strcmp(dentp->d_name, ".") || !strcmp(dentp->d_name, ".."))
-			continue;
-
-		/* If there is a .<file name> then it is a revoked handle
-		 * go ahead and remove it.
-		 */
-		if (dentp->d_name[0] == '.') {
-			char del_path[PATH_MAX];
-
-			sprintf(del_path, "%s/%s", parent_path, dentp->d_name);
-			if (unlink(del_path) < 0) {
-				LogEvent(COMPONENT_CLIENTID,
-						"unlink of %s failed errno: %d",
-						del_path,
-						errno);
-			}
-		}
-		segment_len = strlen(dentp->d_name);
-		total_len = strlen(parent_path) + 2 + segment_len;
-		path = gsh_malloc(total_len);
-		if (path == NULL) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Unable to allocate memory.");
-			continue;
-		}
-		memset(path, 0, total_len);
-
-		snprintf(path, total_len, "%s/%s", parent_path,
-			 dentp->d_name);
-
-		nfs4_clean_old_recov_dir(path);
-		rc = rmdir(path);
-		if (rc == -1) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to remove %s, errno=%d", path, errno);
-		}
-		gsh_free(path);
-	}
-	(void)closedir(dp);
+	recovery_backend->end_grace();
 }
 
 /**
- * @brief Create the recovery directory
+ * @brief Set up stable storage for client records
  *
- * The recovery directory may not exist yet, so create it.  This
- * should only need to be done once (if at all).  Also, the location
- * of the directory could be configurable.
+ * This needs to be done before the client list is loaded.
  */
-void nfs4_create_recov_dir(void)
+void nfs4_recovery_init(void)
 {
-	int err;
-
-	err = mkdir(NFS_V4_RECOV_ROOT, 0755);
-	if (err == -1 && errno != EEXIST) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create v4 recovery dir (%s), errno=%d",
-			 NFS_V4_RECOV_ROOT, errno);
+	switch (nfs_param.nfsv4_param.recovery_backend) {
+	case RECOVERY_BACKEND_JOURNAL:
+		journal_backend_init(&recovery_backend);
+		break;
+	case RECOVERY_BACKEND_FS:
+	default:
+		fs_backend_init(&recovery_backend);
+		break;
 	}
 
-	snprintf(v4_recov_dir, sizeof(v4_recov_dir), "%s/%s", NFS_V4_RECOV_ROOT,
-		 NFS_V4_RECOV_DIR);
-	err = mkdir(v4_recov_dir, 0755);
-	if (err == -1 && errno != EEXIST) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create v4 recovery dir(%s), errno=%d",
-			 v4_recov_dir, errno);
-	}
-
-	snprintf(v4_old_dir, sizeof(v4_old_dir), "%s/%s", NFS_V4_RECOV_ROOT,
-		 NFS_V4_OLD_DIR);
-	err = mkdir(v4_old_dir, 0755);
-	if (err == -1 && errno != EEXIST) {
-		LogEvent(COMPONENT_CLIENTID,
-			 "Failed to create v4 recovery dir(%s), errno=%d",
-			 v4_old_dir, errno);
-	}
-	if (nfs_param.core_param.clustered) {
-		snprintf(v4_recov_dir, sizeof(v4_recov_dir), "%s/%s/node%d",
-			 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR, g_nodeid);
-
-		err = mkdir(v4_recov_dir, 0755);
-		if (err == -1 && errno != EEXIST) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to create v4 recovery dir(%s), errno=%d",
-				 v4_recov_dir, errno);
-		}
-
-		snprintf(v4_old_dir, sizeof(v4_old_dir), "%s/%s/node%d",
-			 NFS_V4_RECOV_ROOT, NFS_V4_OLD_DIR, g_nodeid);
+	recovery_backend->recovery_init();
+}
 
-		err = mkdir(v4_old_dir, 0755);
-		if (err == -1 && errno != EEXIST) {
-			LogEvent(COMPONENT_CLIENTID,
-				 "Failed to create v4 recovery dir(%s), errno=%d",
-				 v4_old_dir, errno);
-		}
-	}
+/**
+ * @brief Flush and close stable storage for client records
+ */
+void nfs4_recovery_shutdown(void)
+{
+	if (recovery_backend != NULL)
+		recovery_backend->recovery_shutdown();
 }
 
 /**
@@ -1137,9 +559,6 @@ void nfs4_record_revoke(nfs_client_id_t *delr_clid, nfs_fh4 *delr_handle)
 {
 	char rhdlstr[NAME_MAX];
 	struct display_buffer dspbuf = {sizeof(rhdlstr), rhdlstr, rhdlstr};
-	char path[PATH_MAX + 1] = {0}, segment[NAME_MAX + 1] = {0};
-	int length, position = 0;
-	int fd;
 
 	/* Make sure that handle size is not greather than NAME_MAX */
 	assert(2 * delr_handle->nfs_fh4_len < NAME_MAX);
@@ -1165,33 +584,9 @@ void nfs4_record_revoke(nfs_client_id_t *delr_clid, nfs_fh4 *delr_handle)
 	}
 	pthread_mutex_unlock(&delr_clid->cid_mutex);
 
-	/* Parse through the clientid directory structure */
 	assert(delr_clid->cid_recov_dir != NULL);
 
-	snprintf(path, sizeof(path), "%s", v4_recov_dir);
-	length = strlen(delr_clid->cid_recov_dir);
-	while (position < length) {
-		int len = strlen(&delr_clid->cid_recov_dir[position]);
-		if (len <= NAME_MAX) {
-			strcat(path, "/");
-			strncat(path, &delr_clid->cid_recov_dir[position], len);
-			strcat(path, "/.");
-			strncat(path, rhdlstr, strlen(rhdlstr));
-			fd = creat(path, 0700);
-			if (fd < 0) {
-				LogEvent(COMPONENT_CLIENTID,
-					"Failed to record revoke errno:%d\n",
-					errno);
-			} else {
-				close(fd);
-			}
-			return;
-		}
-		strncpy(segment, &delr_clid->cid_recov_dir[position], NAME_MAX);
-		strcat(path, "/");
-		strncat(path, segment, NAME_MAX);
-		position += NAME_MAX;
-	}
+	recovery_backend->add_revoke_fh(delr_clid, rhdlstr);
 }
 
 bool nfs4_can_deleg_reclaim_prev(nfs_client_id_t *clid, nfs_fh4 *fhandle)
@@ -0,0 +1,1189 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup SAL
+ * @{
+ */
+
+/**
+ * @file nfs4_recovery_journal.c
+ * @brief NFSv4 recovery in an append-only journal
+ *
+ * Client records go to a single file as a sequence of add, remove
+ * and revoke records.  Writers append to a buffer, and whichever
+ * finds no write in progress writes out and syncs everything
+ * buffered so far, so clients confirmed together share one
+ * fdatasync.  A failed write cuts the journal back to the last
+ * batch synced and stops journalling.  A background thread rewrites
+ * the journal with just the live clients once removed ones make up
+ * most of it.
+ *
+ * At grace start the journal and the clients of the instance before
+ * (the .old file) are each read in one go.  Their union becomes the
+ * new .old file, kept until grace ends, and the journal starts over;
+ * if the .old file cannot be written, both are kept as they are.
+ */
+
+#include "config.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "log.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+#include "avltree.h"
+#include "murmur3.h"
+
+#define JOURNAL_NAME "v4journal"
+#define JOURNAL_MAGIC "GSHJRNL1"
+#define JOURNAL_MAGIC_LEN 8
+
+/* Don't bother compacting a journal with fewer records than this */
+#define JOURNAL_COMPACT_MIN 1024
+
+enum jrec_type {
+	JREC_ADD = 1,		/*< Client confirmed */
+	JREC_RM = 2,		/*< Client expired */
+	JREC_REVOKE = 3		/*< Delegation revoked from client */
+};
+
+/**
+ * @brief On-disk record header, followed by the name and handle
+ */
+struct jrec {
+	uint32_t crc;		/*< Of the rest of the record */
+	uint8_t type;
+	uint8_t pad;
+	uint16_t name_len;
+	uint16_t fh_len;
+	uint16_t pad2;
+};
+
+/**
+ * @brief A client in a set of client records
+ */
+struct jclient {
+	struct avltree_node node;
+	struct glist_head revokes;	/*< Of struct jrevoke */
+	char name[];
+};
+
+struct jrevoke {
+	struct glist_head list;
+	char fh[];
+};
+
+struct jbuf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+/**
+ * @brief Journal state
+ */
+static struct journal {
+	pthread_mutex_t mtx;
+	pthread_cond_t done_cv;	/*< Signalled when a write completes */
+	pthread_cond_t work_cv;	/*< Wakes the background thread */
+	int fd;			/*< The journal, -1 if unusable */
+	struct avltree live;	/*< Clients recorded in the journal */
+	uint64_t records;	/*< Records in the journal */
+	uint64_t compact_after;	/*< Don't compact below this many */
+	struct jbuf bufs[2];
+	struct jbuf *pending;	/*< Records not yet written */
+	struct jbuf *spare;
+	uint64_t appended;	/*< Last record appended */
+	uint64_t durable;	/*< Last record on stable storage */
+	off_t size;		/*< Length of the journal up to durable */
+	int error;		/*< Why the journal was given up, or 0 */
+	bool flushing;		/*< A write is in progress */
+	struct jbuf *tail;	/*< While compacting, records to carry over */
+	bool shutdown;
+	bool running;		/*< Background thread started */
+	pthread_t thread;
+	char path[PATH_MAX];
+	char old_path[PATH_MAX];
+} jr = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.done_cv = PTHREAD_COND_INITIALIZER,
+	.work_cv = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+};
+
+/*
+ * Sets of client records
+ */
+
+static int jclient_cmpf(const struct avltree_node *lhs,
+			const struct avltree_node *rhs)
+{
+	struct jclient *lk = avltree_container_of(lhs, struct jclient, node);
+	struct jclient *rk = avltree_container_of(rhs, struct jclient, node);
+
+	return strcmp(lk->name, rk->name);
+}
+
+static void jmap_init(struct avltree *map)
+{
+	avltree_init(map, jclient_cmpf, 0);
+}
+
+static struct jclient *jmap_lookup(struct avltree *map, const char *name,
+				   size_t name_len)
+{
+	struct jclient *key;
+	struct avltree_node *node;
+
+	key = alloca(sizeof(*key) + name_len + 1);
+	memcpy(key->name, name, name_len);
+	key->name[name_len] = '\0';
+
+	node = avltree_lookup(&key->node, map);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct jclient, node);
+}
+
+static struct jclient *jmap_add(struct avltree *map, const char *name,
+				size_t name_len)
+{
+	struct jclient *jc = jmap_lookup(map, name, name_len);
+
+	if (jc != NULL)
+		return jc;
+
+	jc = gsh_malloc(sizeof(*jc) + name_len + 1);
+	if (jc == NULL)
+		return NULL;
+
+	glist_init(&jc->revokes);
+	memcpy(jc->name, name, name_len);
+	jc->name[name_len] = '\0';
+	avltree_insert(&jc->node, map);
+
+	return jc;
+}
+
+static void jclient_free(struct jclient *jc)
+{
+	struct glist_head *glist, *glistn;
+
+	glist_for_each_safe(glist, glistn, &jc->revokes) {
+		glist_del(glist);
+		gsh_free(glist_entry(glist, struct jrevoke, list));
+	}
+	gsh_free(jc);
+}
+
+static void jmap_rm(struct avltree *map, const char *name, size_t name_len)
+{
+	struct jclient *jc = jmap_lookup(map, name, name_len);
+
+	if (jc == NULL)
+		return;
+
+	avltree_remove(&jc->node, map);
+	jclient_free(jc);
+}
+
+static bool jclient_revoke(struct jclient *jc, const char *fh, size_t fh_len)
+{
+	struct jrevoke *rv;
+	struct glist_head *glist;
+
+	glist_for_each(glist, &jc->revokes) {
+		rv = glist_entry(glist, struct jrevoke, list);
+		if (strlen(rv->fh) == fh_len && !memcmp(rv->fh, fh, fh_len))
+			return true;
+	}
+
+	rv = gsh_malloc(sizeof(*rv) + fh_len + 1);
+	if (rv == NULL)
+		return false;
+
+	memcpy(rv->fh, fh, fh_len);
+	rv->fh[fh_len] = '\0';
+	glist_add_tail(&jc->revokes, &rv->list);
+
+	return true;
+}
+
+static void jmap_free(struct avltree *map)
+{
+	struct avltree_node *node;
+
+	while ((node = avltree_first(map)) != NULL) {
+		avltree_remove(node, map);
+		jclient_free(avltree_container_of(node, struct jclient, node));
+	}
+}
+
+/**
+ * @brief Add every client of one set, with its revokes, to another
+ */
+static bool jmap_merge(struct avltree *dst, struct avltree *src)
+{
+	struct avltree_node *node;
+	struct glist_head *glist;
+	struct jclient *jc, *dc;
+	struct jrevoke *rv;
+
+	for (node = avltree_first(src); node != NULL;
+	     node = avltree_next(node)) {
+		jc = avltree_container_of(node, struct jclient, node);
+		dc = jmap_add(dst, jc->name, strlen(jc->name));
+		if (dc == NULL)
+			return false;
+
+		glist_for_each(glist, &jc->revokes) {
+			rv = glist_entry(glist, struct jrevoke, list);
+			if (!jclient_revoke(dc, rv->fh, strlen(rv->fh)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Record encoding
+ */
+
+static uint32_t jrec_crc(const struct jrec *rec)
+{
+	uint32_t crc;
+
+	MurmurHash3_x86_32((const char *)rec + sizeof(rec->crc),
+			   sizeof(*rec) - sizeof(rec->crc) + rec->name_len +
+			   rec->fh_len, 0, &crc);
+
+	return crc;
+}
+
+static bool jbuf_add(struct jbuf *buf, enum jrec_type type,
+		     const char *name, size_t name_len,
+		     const char *fh, size_t fh_len)
+{
+	size_t need = sizeof(struct jrec) + name_len + fh_len;
+	struct jrec *rec;
+	char *data;
+
+	if (name_len > UINT16_MAX || fh_len > UINT16_MAX)
+		return false;
+
+	if (buf->len + need > buf->size) {
+		size_t size = buf->size ? buf->size : 4096;
+
+		while (size < buf->len + need)
+			size *= 2;
+
+		data = gsh_realloc(buf->data, size);
+		if (data == NULL)
+			return false;
+
+		buf->data = data;
+		buf->size = size;
+	}
+
+	rec = (struct jrec *)(buf->data + buf->len);
+	memset(rec, 0, sizeof(*rec));
+	rec->type = type;
+	rec->name_len = name_len;
+	rec->fh_len = fh_len;
+	memcpy(rec + 1, name, name_len);
+	if (fh_len != 0)
+		memcpy((char *)(rec + 1) + name_len, fh, fh_len);
+	rec->crc = jrec_crc(rec);
+
+	buf->len += need;
+	return true;
+}
+
+static void jbuf_free(struct jbuf *buf)
+{
+	gsh_free(buf->data);
+	buf->data = NULL;
+	buf->len = 0;
+	buf->size = 0;
+}
+
+/**
+ * @brief Encode a set of clients as add and revoke records
+ *
+ * @return Number of records, or -1 on failure.
+ */
+static int64_t jmap_encode(struct avltree *map, struct jbuf *buf)
+{
+	struct avltree_node *node;
+	struct glist_head *glist;
+	struct jclient *jc;
+	struct jrevoke *rv;
+	size_t name_len;
+	int64_t records = 0;
+
+	for (node = avltree_first(map); node != NULL;
+	     node = avltree_next(node)) {
+		jc = avltree_container_of(node, struct jclient, node);
+		name_len = strlen(jc->name);
+
+		if (!jbuf_add(buf, JREC_ADD, jc->name, name_len, NULL, 0))
+			return -1;
+		records++;
+
+		glist_for_each(glist, &jc->revokes) {
+			rv = glist_entry(glist, struct jrevoke, list);
+			if (!jbuf_add(buf, JREC_REVOKE, jc->name, name_len,
+				      rv->fh, strlen(rv->fh)))
+				return -1;
+			records++;
+		}
+	}
+
+	return records;
+}
+
+/**
+ * @brief Apply journal contents to a set of clients
+ *
+ * Stops at the first record that is truncated or fails its check,
+ * as left by a crash in the middle of a write.
+ *
+ * @param[in,out] map     Set of clients
+ * @param[in]     data    Journal contents, after the magic
+ * @param[in]     len     Their length
+ * @param[out]    records Number of records applied
+ *
+ * @return Length of the valid records.
+ */
+static size_t jmap_replay(struct avltree *map, const char *data, size_t len,
+			  uint64_t *records)
+{
+	struct jrec rec;
+	const char *name, *fh;
+	struct jclient *jc;
+	size_t pos = 0;
+
+	*records = 0;
+
+	while (len - pos >= sizeof(rec)) {
+		memcpy(&rec, data + pos, sizeof(rec));
+		if (len - pos - sizeof(rec) < rec.name_len + rec.fh_len)
+			break;
+		if (jrec_crc((const struct jrec *)(data + pos)) != rec.crc)
+			break;
+
+		name = data + pos + sizeof(rec);
+		fh = name + rec.name_len;
+
+		switch (rec.type) {
+		case JREC_ADD:
+			if (jmap_add(map, name, rec.name_len) == NULL)
+				LogCrit(COMPONENT_CLIENTID,
+					"Unable to allocate memory.");
+			break;
+		case JREC_RM:
+			jmap_rm(map, name, rec.name_len);
+			break;
+		case JREC_REVOKE:
+			jc = jmap_lookup(map, name, rec.name_len);
+			if (jc != NULL && !jclient_revoke(jc, fh, rec.fh_len))
+				LogCrit(COMPONENT_CLIENTID,
+					"Unable to allocate memory.");
+			break;
+		default:
+			LogCrit(COMPONENT_CLIENTID,
+				"Unknown record type %d in recovery journal",
+				rec.type);
+			return pos;
+		}
+
+		pos += sizeof(rec) + rec.name_len + rec.fh_len;
+		(*records)++;
+	}
+
+	return pos;
+}
+
+/*
+ * Files
+ */
+
+static int write_all(int fd, const char *data, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void sync_dir(void)
+{
+	int fd = open(NFS_V4_RECOV_ROOT, O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0)
+		return;
+
+	if (fsync(fd) < 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to sync recovery dir (%s), errno=%d",
+			 NFS_V4_RECOV_ROOT, errno);
+	close(fd);
+}
+
+/**
+ * @brief Read a whole journal file in one go
+ *
+ * @param[in]  path Journal
+ * @param[out] len  Length of the contents after the magic
+ *
+ * @return The contents, after the magic; NULL with len 0 if the file
+ *         does not exist or is not a journal.
+ */
+static char *journal_read_file(const char *path, size_t *len)
+{
+	struct stat st;
+	char *data;
+	ssize_t n;
+	size_t got = 0;
+	int fd;
+
+	*len = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to open recovery journal (%s), errno=%d",
+				 path, errno);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < JOURNAL_MAGIC_LEN) {
+		close(fd);
+		return NULL;
+	}
+
+	data = gsh_malloc(st.st_size);
+	if (data == NULL) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Unable to allocate memory to read %s", path);
+		close(fd);
+		return NULL;
+	}
+
+	while (got < st.st_size) {
+		n = read(fd, data + got, st.st_size - got);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		got += n;
+	}
+	close(fd);
+
+	if (got < JOURNAL_MAGIC_LEN
+	    || memcmp(data, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"%s is not a recovery journal, ignoring it", path);
+		gsh_free(data);
+		return NULL;
+	}
+
+	*len = got - JOURNAL_MAGIC_LEN;
+	return data;
+}
+
+/**
+ * @brief Load a journal file into a set of clients
+ */
+static void journal_load(const char *path, struct avltree *map,
+			 uint64_t *records, size_t *valid)
+{
+	size_t len;
+	char *data = journal_read_file(path, &len);
+
+	*records = 0;
+	*valid = 0;
+
+	if (data == NULL)
+		return;
+
+	*valid = jmap_replay(map, data + JOURNAL_MAGIC_LEN, len, records);
+	if (*valid != len)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Ignoring %zu bytes of incomplete records at the end of %s",
+			 len - *valid, path);
+
+	gsh_free(data);
+}
+
+/**
+ * @brief Write a journal file through a temporary and rename
+ *
+ * @param[in] path File to replace
+ * @param[in] data Records, NULL for none
+ * @param[in] len  Their length
+ *
+ * @return Open descriptor on the new file, or -1.
+ */
+static int journal_write_file(const char *path, const char *data,
+			      size_t len)
+{
+	char tmp[PATH_MAX];
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+		return -1;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		goto err;
+
+	if (write_all(fd, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) < 0
+	    || write_all(fd, data, len) < 0
+	    || fdatasync(fd) < 0
+	    || rename(tmp, path) < 0)
+		goto err;
+
+	sync_dir();
+	return fd;
+
+ err:
+	LogCrit(COMPONENT_CLIENTID,
+		"Failed to write recovery journal (%s), errno=%d",
+		path, errno);
+	if (fd >= 0) {
+		close(fd);
+		unlink(tmp);
+	}
+	return -1;
+}
+
+/*
+ * Appending
+ */
+
+/**
+ * @brief Append a record
+ *
+ * Called with jr.mtx held.
+ *
+ * @return Sequence number of the record, 0 if it could not be added.
+ */
+static uint64_t journal_append(enum jrec_type type, const char *name,
+			       const char *fh)
+{
+	size_t name_len = strlen(name);
+	size_t fh_len = fh ? strlen(fh) : 0;
+
+	if (jr.fd < 0)
+		return 0;
+
+	if (!jbuf_add(jr.pending, type, name, name_len, fh, fh_len)) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Unable to add record for %s to recovery journal",
+			name);
+		return 0;
+	}
+
+	if (jr.tail != NULL
+	    && !jbuf_add(jr.tail, type, name, name_len, fh, fh_len)) {
+		/* The compaction will notice and give up */
+		jbuf_free(jr.tail);
+		jr.tail = NULL;
+	}
+
+	jr.records++;
+	return ++jr.appended;
+}
+
+/**
+ * @brief Wait for a record to reach stable storage
+ *
+ * If no write is in progress, this thread writes out everything
+ * appended so far, its own record and those of anyone else waiting;
+ * otherwise it waits for the write in progress and checks again.
+ * Called, and returns, with jr.mtx held.
+ *
+ * If the write or the sync fails, the journal is cut back to the end
+ * of the last batch known to be on disk and given up for the rest of
+ * this instance; nothing after that is ever reported durable.
+ *
+ * @param[in] seq Record to wait for
+ *
+ * @return 0 once the record is durable, or an errno.
+ */
+static int journal_commit(uint64_t seq)
+{
+	struct jbuf *batch;
+	uint64_t target;
+	int fd, rc;
+
+	while (jr.durable < seq) {
+		if (jr.fd < 0)
+			return jr.error ? jr.error : EIO;
+
+		if (jr.flushing) {
+			pthread_cond_wait(&jr.done_cv, &jr.mtx);
+			continue;
+		}
+
+		jr.flushing = true;
+		batch = jr.pending;
+		jr.pending = jr.spare;
+		jr.spare = batch;
+		target = jr.appended;
+		fd = jr.fd;
+
+		pthread_mutex_unlock(&jr.mtx);
+
+		rc = write_all(fd, batch->data, batch->len);
+		if (rc == 0)
+			rc = fdatasync(fd);
+		if (rc < 0)
+			rc = errno;
+
+		pthread_mutex_lock(&jr.mtx);
+
+		if (rc != 0) {
+			LogCrit(COMPONENT_CLIENTID,
+				"Failed to write recovery journal (%s), errno=%d, clients confirmed from now on will not be able to reclaim after a restart",
+				jr.path, rc);
+			/* Don't leave part of the batch for replay */
+			if (ftruncate(fd, jr.size) < 0)
+				LogCrit(COMPONENT_CLIENTID,
+					"Failed to truncate recovery journal (%s) to %lld bytes, errno=%d",
+					jr.path, (long long)jr.size, errno);
+			close(fd);
+			jr.fd = -1;
+			jr.error = rc;
+		} else {
+			jr.size += batch->len;
+			jr.durable = target;
+		}
+
+		batch->len = 0;
+		jr.flushing = false;
+		pthread_cond_broadcast(&jr.done_cv);
+	}
+
+	return 0;
+}
+
+static void journal_kick(void)
+{
+	if (jr.tail == NULL && jr.records >= jr.compact_after
+	    && jr.records > 2 * avltree_size(&jr.live))
+		pthread_cond_signal(&jr.work_cv);
+}
+
+/**
+ * @brief Rewrite the journal with just the live clients
+ *
+ * The live set is encoded under the lock, then written out without
+ * it.  Records appended meanwhile are also kept aside and written
+ * after, with writers held off, before the new file replaces the
+ * journal.  Called, and returns, with jr.mtx held.
+ */
+static void journal_compact(void)
+{
+	struct jbuf snap = { NULL, 0, 0 };
+	struct jbuf tail = { NULL, 0, 0 };
+	char tmp[PATH_MAX];
+	uint64_t snap_seq;
+	int64_t records;
+	int fd = -1;
+
+	/* Not the .tmp of journal_write_file, which may be replacing
+	 * the journal while this runs unlocked */
+	if (snprintf(tmp, sizeof(tmp), "%s.compact", jr.path)
+	    >= (int)sizeof(tmp))
+		goto fail;
+
+	records = jmap_encode(&jr.live, &snap);
+	if (records < 0)
+		goto fail;
+
+	snap_seq = jr.appended;
+	jr.tail = &tail;
+
+	pthread_mutex_unlock(&jr.mtx);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0
+	    || write_all(fd, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) < 0
+	    || write_all(fd, snap.data, snap.len) < 0
+	    || fdatasync(fd) < 0) {
+		pthread_mutex_lock(&jr.mtx);
+		goto fail;
+	}
+
+	pthread_mutex_lock(&jr.mtx);
+
+	while (jr.flushing)
+		pthread_cond_wait(&jr.done_cv, &jr.mtx);
+
+	/* Out of memory for the tail, or the journal was started over
+	 * or given up meanwhile */
+	if (jr.tail == NULL || jr.fd < 0)
+		goto fail;
+
+	if (write_all(fd, tail.data, tail.len) < 0
+	    || fdatasync(fd) < 0
+	    || rename(tmp, jr.path) < 0)
+		goto fail;
+
+	sync_dir();
+
+	close(jr.fd);
+	jr.fd = fd;
+	jr.records = records + (jr.appended - snap_seq);
+	jr.compact_after = JOURNAL_COMPACT_MIN;
+
+	/* Everything appended is in the new file */
+	jr.pending->len = 0;
+	jr.durable = jr.appended;
+	jr.size = JOURNAL_MAGIC_LEN + snap.len + tail.len;
+	pthread_cond_broadcast(&jr.done_cv);
+
+	jr.tail = NULL;
+	jbuf_free(&tail);
+	jbuf_free(&snap);
+
+	LogDebug(COMPONENT_CLIENTID,
+		 "Compacted recovery journal to %" PRIu64 " records",
+		 jr.records);
+	return;
+
+ fail:
+	LogCrit(COMPONENT_CLIENTID,
+		"Failed to compact recovery journal (%s), errno=%d",
+		jr.path, errno);
+	if (fd >= 0) {
+		close(fd);
+		unlink(tmp);
+	}
+	jr.tail = NULL;
+	jbuf_free(&tail);
+	jbuf_free(&snap);
+	/* Try again once it has grown some more */
+	jr.compact_after = 2 * jr.records > JOURNAL_COMPACT_MIN
+				? 2 * jr.records : JOURNAL_COMPACT_MIN;
+}
+
+/**
+ * @brief Write out unwaited records and compact the journal
+ */
+static void *journal_thread(void *arg)
+{
+	struct timespec ts;
+
+	SetNameFunction("recov_journal");
+
+	pthread_mutex_lock(&jr.mtx);
+
+	while (!jr.shutdown) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += 1;
+		pthread_cond_timedwait(&jr.work_cv, &jr.mtx, &ts);
+
+		/* Removals don't wait to be written */
+		if (jr.fd >= 0 && jr.durable < jr.appended)
+			(void) journal_commit(jr.appended);
+
+		if (jr.fd >= 0 && jr.records >= jr.compact_after
+		    && jr.records > 2 * avltree_size(&jr.live))
+			journal_compact();
+	}
+
+	pthread_mutex_unlock(&jr.mtx);
+	return NULL;
+}
+
+/*
+ * Backend operations
+ */
+
+/**
+ * @brief Open the journal and start the background thread
+ */
+static void journal_init(void)
+{
+	uint64_t records;
+	size_t valid;
+	int err;
+
+	err = mkdir(NFS_V4_RECOV_ROOT, 0755);
+	if (err == -1 && errno != EEXIST) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create v4 recovery dir (%s), errno=%d",
+			 NFS_V4_RECOV_ROOT, errno);
+	}
+
+	if (nfs_param.core_param.clustered)
+		snprintf(jr.path, sizeof(jr.path), "%s/%s.node%d",
+			 NFS_V4_RECOV_ROOT, JOURNAL_NAME, g_nodeid);
+	else
+		snprintf(jr.path, sizeof(jr.path), "%s/%s",
+			 NFS_V4_RECOV_ROOT, JOURNAL_NAME);
+	snprintf(jr.old_path, sizeof(jr.old_path), "%s.old", jr.path);
+
+	jmap_init(&jr.live);
+	jr.pending = &jr.bufs[0];
+	jr.spare = &jr.bufs[1];
+	jr.compact_after = JOURNAL_COMPACT_MIN;
+
+	journal_load(jr.path, &jr.live, &records, &valid);
+	jr.records = records;
+
+	jr.size = JOURNAL_MAGIC_LEN + valid;
+
+	jr.fd = open(jr.path, O_WRONLY | O_CREAT, 0600);
+	if (jr.fd >= 0 && valid == 0) {
+		/* New, or not a journal: start it over */
+		close(jr.fd);
+		jr.fd = journal_write_file(jr.path, NULL, 0);
+	} else if (jr.fd >= 0) {
+		/* Drop any torn record at the end */
+		if (ftruncate(jr.fd, JOURNAL_MAGIC_LEN + valid) < 0
+		    || lseek(jr.fd, 0, SEEK_END) < 0) {
+			close(jr.fd);
+			jr.fd = -1;
+		}
+	}
+
+	if (jr.fd < 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to open recovery journal (%s), errno=%d, clients will not be able to reclaim after a restart",
+			jr.path, errno);
+		return;
+	}
+
+	err = pthread_create(&jr.thread, NULL, journal_thread, NULL);
+	if (err != 0)
+		LogCrit(COMPONENT_CLIENTID,
+			"Could not start recovery journal thread: %s",
+			strerror(err));
+	else
+		jr.running = true;
+
+	LogInfo(COMPONENT_CLIENTID,
+		"NFSv4 recovery journal %s, %" PRIu64 " clients",
+		jr.path, (uint64_t) avltree_size(&jr.live));
+}
+
+static void journal_shutdown(void)
+{
+	pthread_mutex_lock(&jr.mtx);
+	jr.shutdown = true;
+	pthread_cond_signal(&jr.work_cv);
+	pthread_mutex_unlock(&jr.mtx);
+
+	if (jr.running)
+		pthread_join(jr.thread, NULL);
+
+	pthread_mutex_lock(&jr.mtx);
+	(void) journal_commit(jr.appended);
+	if (jr.fd >= 0) {
+		close(jr.fd);
+		jr.fd = -1;
+	}
+	jmap_free(&jr.live);
+	jbuf_free(&jr.bufs[0]);
+	jbuf_free(&jr.bufs[1]);
+	pthread_mutex_unlock(&jr.mtx);
+}
+
+/**
+ * @brief Add clients to the previous instance's, for grace
+ *
+ * @param[in] map Clients to add
+ *
+ * @return true if the .old file now holds them.
+ */
+static bool journal_merge_old(struct avltree *map)
+{
+	struct avltree old;
+	struct jbuf buf = { NULL, 0, 0 };
+	uint64_t records;
+	size_t valid;
+	bool saved = false;
+	int fd;
+
+	jmap_init(&old);
+	journal_load(jr.old_path, &old, &records, &valid);
+
+	if (!jmap_merge(&old, map) || jmap_encode(&old, &buf) < 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Unable to allocate memory to save %s", jr.old_path);
+	} else {
+		fd = journal_write_file(jr.old_path, buf.data, buf.len);
+		if (fd >= 0) {
+			close(fd);
+			saved = true;
+		}
+	}
+
+	jbuf_free(&buf);
+	jmap_free(&old);
+	return saved;
+}
+
+static void journal_report(struct avltree *map,
+			   add_clid_entry_hook add_clid_entry,
+			   add_rfh_entry_hook add_rfh_entry)
+{
+	struct avltree_node *node;
+	struct glist_head *glist;
+	struct jclient *jc;
+	clid_entry_t *clid_ent;
+
+	for (node = avltree_first(map); node != NULL;
+	     node = avltree_next(node)) {
+		jc = avltree_container_of(node, struct jclient, node);
+
+		clid_ent = add_clid_entry(jc->name);
+		if (clid_ent == NULL)
+			continue;
+
+		glist_for_each(glist, &jc->revokes)
+			(void) add_rfh_entry(clid_ent,
+					     glist_entry(glist, struct jrevoke,
+							 list)->fh);
+	}
+}
+
+/**
+ * @brief Load clients for recovery
+ *
+ * @param[in] gsp            Grace start information, NULL at startup
+ * @param[in] add_clid_entry Function to add a client
+ * @param[in] add_rfh_entry  Function to add a revoked handle
+ */
+static void journal_read_clids(nfs_grace_start_t *gsp,
+			       add_clid_entry_hook add_clid_entry,
+			       add_rfh_entry_hook add_rfh_entry)
+{
+	struct avltree map;
+	char path[PATH_MAX + 1];
+	uint64_t records;
+	size_t valid;
+	bool merged;
+	int fd;
+
+	jmap_init(&map);
+
+	if (gsp == NULL) {
+		/* Start a new instance: the clients of the old one and
+		 * those journalled since may reclaim, and the journal
+		 * starts over.
+		 */
+		pthread_mutex_lock(&jr.mtx);
+
+		(void) journal_commit(jr.appended);
+		merged = journal_merge_old(&jr.live);
+		journal_load(jr.old_path, &map, &records, &valid);
+
+		if (!merged) {
+			/* Both files still hold what they did, so the
+			 * journal must not start over; grace covers
+			 * the clients of either.
+			 */
+			LogCrit(COMPONENT_CLIENTID,
+				"Unable to save clients to %s, keeping %s",
+				jr.old_path, jr.path);
+			if (!jmap_merge(&map, &jr.live))
+				LogCrit(COMPONENT_CLIENTID,
+					"Unable to allocate memory.");
+		} else if (jr.fd >= 0) {
+			fd = journal_write_file(jr.path, NULL, 0);
+			if (fd >= 0) {
+				close(jr.fd);
+				jr.fd = fd;
+				jmap_free(&jr.live);
+				jr.records = 0;
+				jr.size = JOURNAL_MAGIC_LEN;
+				/* A compaction in progress is of the
+				 * journal just replaced */
+				if (jr.tail != NULL) {
+					jbuf_free(jr.tail);
+					jr.tail = NULL;
+				}
+			}
+		}
+
+		pthread_mutex_unlock(&jr.mtx);
+	} else {
+		if (gsp->event == EVENT_UPDATE_CLIENTS) {
+			pthread_mutex_lock(&jr.mtx);
+			if (!jmap_merge(&map, &jr.live))
+				LogCrit(COMPONENT_CLIENTID,
+					"Unable to allocate memory.");
+			pthread_mutex_unlock(&jr.mtx);
+		} else if (gsp->event == EVENT_TAKE_NODEID) {
+			snprintf(path, sizeof(path), "%s/%s.node%d",
+				 NFS_V4_RECOV_ROOT, JOURNAL_NAME,
+				 gsp->nodeid);
+
+			LogEvent(COMPONENT_CLIENTID,
+				 "Recovery for nodeid %d journal (%s)",
+				 gsp->nodeid, path);
+
+			journal_load(path, &map, &records, &valid);
+		} else {
+			/* The journal is kept per node, not per address,
+			 * so there is nothing to take over with an IP.
+			 */
+			if (gsp->event == EVENT_TAKE_IP)
+				LogEvent(COMPONENT_CLIENTID,
+					 "Recovery journal keeps no clients by address, nothing to recover for %s",
+					 gsp->ipaddr);
+			return;
+		}
+
+		/* Keep them with ours until grace ends */
+		pthread_mutex_lock(&jr.mtx);
+		if (!journal_merge_old(&map))
+			LogCrit(COMPONENT_CLIENTID,
+				"Clients recovered from another node are not saved in %s",
+				jr.old_path);
+		pthread_mutex_unlock(&jr.mtx);
+	}
+
+	journal_report(&map, add_clid_entry, add_rfh_entry);
+	jmap_free(&map);
+}
+
+static void journal_add_clid(nfs_client_id_t *clientid)
+{
+	const char *name = clientid->cid_recov_dir;
+	uint64_t seq;
+
+	pthread_mutex_lock(&jr.mtx);
+
+	if (jmap_add(&jr.live, name, strlen(name)) == NULL)
+		LogCrit(COMPONENT_CLIENTID, "Unable to allocate memory.");
+
+	seq = journal_append(JREC_ADD, name, NULL);
+	if (seq != 0 && journal_commit(seq) == 0) {
+		pthread_mutex_unlock(&jr.mtx);
+		LogDebug(COMPONENT_CLIENTID, "Journalled client [%s]", name);
+		return;
+	}
+
+	pthread_mutex_unlock(&jr.mtx);
+
+	LogEvent(COMPONENT_CLIENTID,
+		 "Failed to journal client [%s], it will not be able to reclaim after a restart",
+		 name);
+}
+
+static void journal_rm_clid(nfs_client_id_t *clientid)
+{
+	const char *name = clientid->cid_recov_dir;
+
+	pthread_mutex_lock(&jr.mtx);
+
+	jmap_rm(&jr.live, name, strlen(name));
+
+	/* Written with the next batch, no need to wait */
+	(void) journal_append(JREC_RM, name, NULL);
+	journal_kick();
+
+	pthread_mutex_unlock(&jr.mtx);
+
+	LogDebug(COMPONENT_CLIENTID, "Journalled removal of [%s]", name);
+}
+
+static void journal_add_revoke_fh(nfs_client_id_t *clientid,
+				  const char *rhdlstr)
+{
+	const char *name = clientid->cid_recov_dir;
+	struct jclient *jc;
+	uint64_t seq;
+
+	pthread_mutex_lock(&jr.mtx);
+
+	jc = jmap_lookup(&jr.live, name, strlen(name));
+	if (jc == NULL) {
+		pthread_mutex_unlock(&jr.mtx);
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to record revoke, client %s not journalled",
+			 name);
+		return;
+	}
+
+	if (!jclient_revoke(jc, rhdlstr, strlen(rhdlstr)))
+		LogCrit(COMPONENT_CLIENTID, "Unable to allocate memory.");
+
+	seq = journal_append(JREC_REVOKE, name, rhdlstr);
+	if (seq == 0 || journal_commit(seq) != 0) {
+		pthread_mutex_unlock(&jr.mtx);
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to journal revoke of %s for client %s",
+			 rhdlstr, name);
+		return;
+	}
+
+	pthread_mutex_unlock(&jr.mtx);
+}
+
+static void journal_end_grace(void)
+{
+	if (unlink(jr.old_path) < 0 && errno != ENOENT)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove %s, errno=%d", jr.old_path, errno);
+	else
+		sync_dir();
+}
+
+static struct nfs4_recovery_backend journal_backend = {
+	.recovery_init = journal_init,
+	.recovery_shutdown = journal_shutdown,
+	.recovery_read_clids = journal_read_clids,
+	.add_clid = journal_add_clid,
+	.rm_clid = journal_rm_clid,
+	.add_revoke_fh = journal_add_revoke_fh,
+	.end_grace = journal_end_grace,
+};
+
+void journal_backend_init(struct nfs4_recovery_backend **backend)
+{
+	*backend = &journal_backend;
+}
+
+/** @} */
@@ -1031,6 +1031,14 @@ void free_nlm_client(state_nlm_client_t *client)
 	if (client->slc_nlm_caller_name != NULL)
 		gsh_free(client->slc_nlm_caller_name);
 
+	if (client->slc_callback_clnt != NULL)
+		gsh_clnt_destroy(client->slc_callback_clnt);
+
+	if (client->slc_callback_auth != NULL)
+		AUTH_DESTROY(client->slc_callback_auth);
+
+	pthread_rwlock_destroy(&client->slc_callback_lock);
+
 	gsh_free(client);
 }
 
@@ -1245,6 +1253,8 @@ state_nlm_client_t *get_nlm_client(care_t care, SVCXPRT *xprt,
 	/* Copy everything over */
 	memcpy(pclient, &key, sizeof(key));
 
+	pthread_rwlock_init(&pclient->slc_callback_lock, NULL);
+
 	pclient->slc_nlm_caller_name = gsh_strdup(key.slc_nlm_caller_name);
 
 	/* Take a reference to the NSM Client */
@@ -40,6 +40,7 @@
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "log.h"
@@ -680,6 +681,100 @@ void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 	}
 }
 
+/**
+ * @brief Put a lock entry on a list of locks
+ *
+ * Entries going on their file's lock_list are also indexed by range
+ * in its lock_tree, so the locks overlapping a range can be found
+ * without walking them all.
+ *
+ * @param[in]     entry      File the lock is on
+ * @param[in,out] list       List to add to
+ * @param[in,out] lock_entry Entry to add
+ */
+static void locklist_add(cache_entry_t *entry, struct glist_head *list,
+			 state_lock_entry_t *lock_entry)
+{
+	if (list == &entry->object.file.lock_list) {
+		if (glist_empty(list))
+			entry->object.file.lock_export =
+			    lock_entry->sle_export;
+		else if (entry->object.file.lock_export !=
+			 lock_entry->sle_export)
+			entry->object.file.lock_export = NULL;
+
+		lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+		lock_entry->sle_range.last = lock_end(&lock_entry->sle_lock);
+		itree_insert(&entry->object.file.lock_tree,
+			     &lock_entry->sle_range);
+		lock_entry->sle_indexed = true;
+		lock_entry->sle_seq = entry->object.file.lock_seq++;
+	}
+
+	glist_add_tail(list, &lock_entry->sle_list);
+}
+
+/**
+ * @brief Take a lock entry off the list it is on
+ *
+ * @param[in,out] lock_entry Entry to remove
+ */
+static void locklist_del(state_lock_entry_t *lock_entry)
+{
+	if (lock_entry->sle_indexed) {
+		itree_remove(&lock_entry->sle_entry->object.file.lock_tree,
+			     &lock_entry->sle_range);
+		lock_entry->sle_indexed = false;
+	}
+
+	glist_del(&lock_entry->sle_list);
+}
+
+/**
+ * @brief Reindex a lock entry whose range was changed
+ *
+ * @param[in,out] lock_entry Entry that was changed
+ */
+static void locklist_moved(state_lock_entry_t *lock_entry)
+{
+	struct itree *tree = &lock_entry->sle_entry->object.file.lock_tree;
+
+	if (!lock_entry->sle_indexed)
+		return;
+
+	itree_remove(tree, &lock_entry->sle_range);
+	lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+	lock_entry->sle_range.last = lock_end(&lock_entry->sle_lock);
+	itree_insert(tree, &lock_entry->sle_range);
+}
+
+/**
+ * @brief Walk the locks on a file that overlap a range
+ *
+ * Locks come out in order of their start.  Locks may be removed from
+ * the file, or have their range changed, between steps.
+ *
+ * @param[in]     entry File
+ * @param[in,out] iter  Walk position, set up with itree_iter_init
+ * @param[in]     start First byte of the range
+ * @param[in]     last  Last byte of the range
+ *
+ * @return The next lock, or NULL when done.
+ */
+static state_lock_entry_t *locklist_next(cache_entry_t *entry,
+					 struct itree_iter *iter,
+					 uint64_t start, uint64_t last)
+{
+	struct itree_node *node;
+
+	node = itree_iter_next(&entry->object.file.lock_tree, iter,
+			       start, last);
+	if (node == NULL)
+		return NULL;
+
+	return container_of(node, state_lock_entry_t, sle_range);
+}
+
 /**
  * @brief Remove an entry from the lock lists
  *
@@ -733,7 +828,7 @@ static void remove_from_locklist(state_lock_entry_t *lock_entry)
 	}
 
 	lock_entry->sle_owner = NULL;
-	glist_del(&lock_entry->sle_list);
+	locklist_del(lock_entry);
 	lock_entry_dec_ref(lock_entry);
 }
 
@@ -750,13 +845,13 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 						 state_owner_t *owner,
 						 fsal_lock_param_t *lock)
 {
-	struct glist_head *glist;
+	struct itree_iter iter;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
-
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	uint64_t range_end = lock_end(lock);
 
+	itree_iter_init(&iter);
+	while ((found_entry = locklist_next(entry, &iter, lock->lock_start,
+					    range_end)) != NULL) {
 		LogEntry("Checking", found_entry);
 
 		/* Skip blocked or cancelled locks */
@@ -765,21 +860,15 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 		    || found_entry->sle_blocked == STATE_CANCELED)
 			continue;
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
-			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner, owner)
-			    ) {
-				/* found a conflicting lock, return it */
-				return found_entry;
-			}
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
+		     || lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* found a conflicting lock, return it */
+			return found_entry;
 		}
 	}
 
@@ -803,17 +892,37 @@ static void merge_lock_entry(cache_entry_t *entry,
 	state_lock_entry_t *check_entry_right;
 	uint64_t check_entry_end;
 	uint64_t lock_entry_end;
-	struct glist_head *glist;
-	struct glist_head *glistn;
+	uint64_t range_start, range_end;
+	struct itree_iter iter;
+	bool indexed = lock_entry->sle_indexed;
 
 	/* lock_entry might be STATE_NON_BLOCKING or STATE_GRANTING */
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	/* If lock_entry is in the list, keep it out of the index while
+	 * its range grows.
+	 */
+	if (indexed) {
+		itree_remove(&entry->object.file.lock_tree,
+			     &lock_entry->sle_range);
+		lock_entry->sle_indexed = false;
+	}
 
-		/* Skip entry being merged - it could be in the list */
-		if (check_entry == lock_entry)
-			continue;
+	/* Look at locks touching or overlapping lock_entry, the range
+	 * being recomputed as lock_entry grows.
+	 */
+	itree_iter_init(&iter);
+	for (;;) {
+		range_start = lock_entry->sle_lock.lock_start;
+		if (range_start > 0)
+			range_start--;
+		range_end = lock_end(&lock_entry->sle_lock);
+		if (range_end < UINT64_MAX)
+			range_end++;
+
+		check_entry = locklist_next(entry, &iter, range_start,
+					    range_end);
+		if (check_entry == NULL)
+			break;
 
 		if (different_owners
 		    (check_entry->sle_owner, lock_entry->sle_owner))
@@ -860,8 +969,6 @@ static void merge_lock_entry(cache_entry_t *entry,
 						 "Memory allocation failure during lock upgrade/downgrade");
 					continue;
 				}
-				glist_add_tail(&entry->object.file.lock_list,
-					       &(check_entry_right->sle_list));
 			} else {
 				/* No split, just shrink, make the logic below
 				 * work on original lock
@@ -881,6 +988,10 @@ static void merge_lock_entry(cache_entry_t *entry,
 				LogEntry("Merge shrunk right",
 					 check_entry_right);
 			}
+			if (check_entry_right != check_entry)
+				locklist_add(entry,
+					     &entry->object.file.lock_list,
+					     check_entry_right);
 			if (check_entry->sle_lock.lock_start <
 			    lock_entry->sle_lock.lock_start) {
 				/* Need to shrink old lock from end
@@ -892,6 +1003,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 				    check_entry->sle_lock.lock_start;
 				LogEntry("Merge shrunk left", check_entry);
 			}
+			locklist_moved(check_entry);
 			/* Done splitting/shrinking old lock */
 			continue;
 		}
@@ -918,6 +1030,14 @@ static void merge_lock_entry(cache_entry_t *entry,
 		LogEntry("Merging removing", check_entry);
 		remove_from_locklist(check_entry);
 	}
+
+	if (indexed) {
+		lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+		lock_entry->sle_range.last = lock_end(&lock_entry->sle_lock);
+		itree_insert(&entry->object.file.lock_tree,
+			     &lock_entry->sle_range);
+		lock_entry->sle_indexed = true;
+	}
 }
 
 /**
@@ -1022,7 +1142,7 @@ static state_status_t subtract_lock_from_entry(cache_entry_t *entry,
 	/* Remove the lock from the list it's
 	 * on and put it on the remove_list
 	 */
-	glist_del(&found_entry->sle_list);
+	locklist_del(found_entry);
 	glist_add_tail(remove_list, &(found_entry->sle_list));
 
 	*removed = true;
@@ -1063,6 +1183,60 @@ static bool remove_deleg_lock(cache_entry_t *entry,
 	return false;
 }
 
+/**
+ * @brief Subtract a lock from one lock entry of a list
+ *
+ * @param[in,out] entry       Cache entry on which to operate
+ * @param[in]     owner       Lock owner
+ * @param[in]     state       Associated lock state
+ * @param[in]     lock        Lock to remove
+ * @param[in,out] found_entry Lock entry to subtract from
+ * @param[out]    split_list  Remaining fragments of found_entry
+ * @param[out]    remove_list Removed lock entries
+ * @param[in,out] removed     Set if an entry was removed
+ *
+ * @return State status.
+ */
+static state_status_t subtract_lock_from_one(cache_entry_t *entry,
+					     state_owner_t *owner,
+					     state_t *state,
+					     fsal_lock_param_t *lock,
+					     state_lock_entry_t *found_entry,
+					     struct glist_head *split_list,
+					     struct glist_head *remove_list,
+					     bool *removed)
+{
+	state_status_t status;
+	bool removed_one = false;
+
+	if (owner != NULL
+	    && different_owners(found_entry->sle_owner, owner))
+		return STATE_SUCCESS;
+
+	/* Only care about granted locks */
+	if (found_entry->sle_blocked != STATE_NON_BLOCKING)
+		return STATE_SUCCESS;
+
+	/* Skip locks owned by this NLM state.
+	 * This protects NLM locks from the current iteration of an NLM
+	 * client from being released by SM_NOTIFY.
+	 */
+	if (state != NULL && lock_owner_is_nlm(found_entry)
+	    && found_entry->sle_state == state)
+		return STATE_SUCCESS;
+
+	/* We have matched owner. Even though we are taking a reference
+	 * to found_entry, we don't inc the ref count because we want
+	 * to drop the lock entry.
+	 */
+	status =
+	    subtract_lock_from_entry(entry, found_entry, lock, split_list,
+				     remove_list, &removed_one);
+	*removed |= removed_one;
+
+	return status;
+}
+
 /**
  * @brief Subtract a lock from a list of locks
  *
@@ -1087,48 +1261,40 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 	state_lock_entry_t *found_entry;
 	struct glist_head split_lock_list, remove_list;
 	struct glist_head *glist, *glistn;
+	struct itree_iter iter;
 	state_status_t status = STATE_SUCCESS;
-	bool removed_one = false;
 
 	*removed = false;
 
 	glist_init(&split_lock_list);
 	glist_init(&remove_list);
 
-	glist_for_each_safe(glist, glistn, list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
-
-		if (owner != NULL
-		    && different_owners(found_entry->sle_owner, owner))
-			continue;
-
-		/* Only care about granted locks */
-		if (found_entry->sle_blocked != STATE_NON_BLOCKING)
-			continue;
-
-		/* Skip locks owned by this NLM state.
-		 * This protects NLM locks from the current iteration of an NLM
-		 * client from being released by SM_NOTIFY.
-		 */
-		if (state != NULL && lock_owner_is_nlm(found_entry)
-		    && found_entry->sle_state == state)
-			continue;
+	if (list == &entry->object.file.lock_list) {
+		/* Only the locks overlapping the range can be affected */
+		itree_iter_init(&iter);
+		while ((found_entry = locklist_next(entry, &iter,
+						    lock->lock_start,
+						    lock_end(lock))) != NULL) {
+			status =
+			    subtract_lock_from_one(entry, owner, state, lock,
+						   found_entry,
+						   &split_lock_list,
+						   &remove_list, removed);
+			if (status != STATE_SUCCESS)
+				break;
+		}
+	} else {
+		glist_for_each_safe(glist, glistn, list) {
+			found_entry =
+			    glist_entry(glist, state_lock_entry_t, sle_list);
 
-		/* We have matched owner. Even though we are taking a reference
-		 * to found_entry, we don't inc the ref count because we want
-		 * to drop the lock entry.
-		 */
-		status =
-		    subtract_lock_from_entry(entry, found_entry, lock,
-					     &split_lock_list, &remove_list,
-					     &removed_one);
-		*removed |= removed_one;
-
-		if (status != STATE_SUCCESS) {
-			/* We ran out of memory while splitting,
-			 * deal with it outside loop
-			 */
-			break;
+			status =
+			    subtract_lock_from_one(entry, owner, state, lock,
+						   found_entry,
+						   &split_lock_list,
+						   &remove_list, removed);
+			if (status != STATE_SUCCESS)
+				break;
 		}
 	}
 
@@ -1142,14 +1308,19 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 			found_entry =
 			    glist_entry(glist, state_lock_entry_t, sle_list);
 			glist_del(&found_entry->sle_list);
-			glist_add_tail(list, &(found_entry->sle_list));
+			locklist_add(entry, list, found_entry);
 		}
 	} else {
 		/* free the enttries on the remove_list */
 		free_list(&remove_list);
 
 		/* now add the split lock list */
-		glist_add_list_tail(list, &split_lock_list);
+		glist_for_each_safe(glist, glistn, &split_lock_list) {
+			found_entry =
+			    glist_entry(glist, state_lock_entry_t, sle_list);
+			glist_del(&found_entry->sle_list);
+			locklist_add(entry, list, found_entry);
+		}
 	}
 
 	LogFullDebug(COMPONENT_STATE,
@@ -1197,7 +1368,8 @@ static state_status_t subtract_list_from_list(cache_entry_t *entry,
  *
  ******************************************************************************/
 
-static void grant_blocked_locks(cache_entry_t *entry);
+static void grant_blocked_locks(cache_entry_t *entry,
+				fsal_lock_param_t *freed);
 
 /**
  * @brief Display lock cookie in hash table
@@ -1665,7 +1837,7 @@ void grant_blocked_lock_immediate(cache_entry_t *entry,
 	LogEntry("Immediate Granted entry", lock_entry);
 
 	/* A lock downgrade could unblock blocked locks */
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, &lock_entry->sle_lock);
 }
 
 /**
@@ -1704,7 +1876,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 		LogEntry("Granted entry", lock_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, &lock_entry->sle_lock);
 	}
 
 	/* Free cookie and unblock lock.
@@ -1764,10 +1936,12 @@ void try_to_grant_lock(state_lock_entry_t *lock_entry)
 		put_gsh_export(export);
 
 		release_root_op_context();
+		lock_entry->sle_entry->object.file.grant_attempts++;
 		if (status == STATE_LOCK_BLOCKED) {
 			/* The lock is still blocked,
 			 * restore it's type and leave it in the list
 			 */
+			lock_entry->sle_entry->object.file.grant_futile++;
 			lock_entry->sle_blocked = blocked;
 			return;
 		}
@@ -1815,15 +1989,37 @@ void process_blocked_lock_upcall(state_block_data_t *block_data)
 }
 
 /**
- * @brief Attempt to grant all blocked locks on a file
- *
- * @param[in] entry Cache entry for the file
+ * @brief Order blocked locks by when they joined the lock list
  */
+static int blocked_seq_cmp(const void *a, const void *b)
+{
+	const state_lock_entry_t *la = *(state_lock_entry_t * const *)a;
+	const state_lock_entry_t *lb = *(state_lock_entry_t * const *)b;
 
-static void grant_blocked_locks(cache_entry_t *entry)
+	if (la->sle_seq < lb->sle_seq)
+		return -1;
+	return la->sle_seq > lb->sle_seq;
+}
+
+/**
+ * @brief Attempt to grant blocked locks waiting on a freed range
+ *
+ * Only blocked locks overlapping the range that was unlocked (or
+ * downgraded) can have become grantable, so only those are tried,
+ * oldest first so that waiters are served in the order they came.
+ *
+ * @param[in] entry File on which to grant locks
+ * @param[in] freed Range that was released
+ */
+static void grant_blocked_locks(cache_entry_t *entry,
+				fsal_lock_param_t *freed)
 {
 	state_lock_entry_t *found_entry;
-	struct glist_head *glist, *glistn;
+	state_lock_entry_t **waiters;
+	struct itree_iter iter;
+	uint64_t freed_end = lock_end(freed);
+	uint64_t futile = entry->object.file.grant_futile;
+	size_t nwaiters = 0, i;
 	struct fsal_export *export = op_ctx->export->fsal_export;
 
 	/* If FSAL supports async blocking locks,
@@ -1832,24 +2028,74 @@ static void grant_blocked_locks(cache_entry_t *entry)
 	if (export->ops->fs_supports(export, fso_lock_support_async_block))
 		return;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	itree_iter_init(&iter);
+	while ((found_entry = locklist_next(entry, &iter, freed->lock_start,
+					    freed_end)) != NULL) {
+		if (found_entry->sle_blocked == STATE_NLM_BLOCKING
+		    || found_entry->sle_blocked == STATE_NFSV4_BLOCKING)
+			nwaiters++;
+	}
+
+	if (nwaiters == 0)
+		return;
+
+	waiters = gsh_malloc(nwaiters * sizeof(*waiters));
+	if (waiters == NULL) {
+		LogMajor(COMPONENT_STATE,
+			 "Could not allocate blocked lock list for entry=%p",
+			 entry);
+		return;
+	}
 
+	/* Granting one lock can remove others from the list, so hold a
+	 * reference on each while we go.
+	 */
+	nwaiters = 0;
+	itree_iter_init(&iter);
+	while ((found_entry = locklist_next(entry, &iter, freed->lock_start,
+					    freed_end)) != NULL) {
 		if (found_entry->sle_blocked != STATE_NLM_BLOCKING
 		    && found_entry->sle_blocked != STATE_NFSV4_BLOCKING)
 			continue;
 
+		lock_entry_inc_ref(found_entry);
+		waiters[nwaiters++] = found_entry;
+	}
+
+	qsort(waiters, nwaiters, sizeof(*waiters), blocked_seq_cmp);
+
+	for (i = 0; i < nwaiters; i++) {
+		found_entry = waiters[i];
+
+		/* Skip locks granted, cancelled or removed meanwhile */
+		if (!found_entry->sle_indexed
+		    || (found_entry->sle_blocked != STATE_NLM_BLOCKING
+			&& found_entry->sle_blocked != STATE_NFSV4_BLOCKING))
+			goto next;
+
 		/* Found a blocked entry for this file,
 		 * see if we can place the lock.
 		 */
 		if (get_overlapping_entry
 		    (entry, found_entry->sle_owner,
 		     &found_entry->sle_lock) != NULL)
-			continue;
+			goto next;
 
 		/* Found an entry that might work, try to grant it. */
 		try_to_grant_lock(found_entry);
+ next:
+		lock_entry_dec_ref(found_entry);
 	}
+
+	gsh_free(waiters);
+
+	if (entry->object.file.grant_futile != futile)
+		LogDebug(COMPONENT_STATE,
+			 "entry=%p %" PRIu64 " futile grant attempts, %"
+			 PRIu64 " of %" PRIu64 " since the file was cached",
+			 entry, entry->object.file.grant_futile - futile,
+			 entry->object.file.grant_futile,
+			 entry->object.file.grant_attempts);
 }
 
 /**
@@ -1959,13 +2205,12 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 				state_owner_t *owner, state_t *state,
 				fsal_lock_param_t *lock)
 {
-	struct glist_head *glist, *glistn;
+	struct itree_iter iter;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
-
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
+	itree_iter_init(&iter);
+	while ((found_entry = locklist_next(entry, &iter, lock->lock_start,
+					    lock_end(lock))) != NULL) {
 		/* Skip locks not owned by owner */
 		if (owner != NULL
 		    && different_owners(found_entry->sle_owner, owner))
@@ -1985,13 +2230,8 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 
 		LogEntry("Checking", found_entry);
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps, cancel it. */
-			cancel_blocked_lock(entry, found_entry);
-		}
+		/* lock overlaps, cancel it. */
+		cancel_blocked_lock(entry, found_entry);
 	}
 }
 
@@ -2006,11 +2246,15 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 {
 	state_lock_entry_t *lock_entry;
 	cache_entry_t *entry;
+	fsal_lock_param_t freed;
 	state_status_t status = STATE_SUCCESS;
 
 	lock_entry = cookie_entry->sce_lock_entry;
 	entry = cookie_entry->sce_entry;
 
+	/* The lock entry may be gone by the time we look for waiters */
+	freed = lock_entry->sle_lock;
+
 	/* This routine does not call cache_inode_inc_pin_ref() because there
 	 * MUST be at least one lock present for there to be a cookie_entry
 	 * to even allow this routine to be called, and therefor the cache
@@ -2058,7 +2302,7 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	free_cookie(cookie_entry, true);
 
 	/* Check to see if we can grant any blocked locks. */
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, &freed);
 
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
@@ -2521,6 +2765,7 @@ state_status_t state_lock_locked(cache_entry_t *entry,
 {
 	bool allow = true, overlap = false;
 	struct glist_head *glist;
+	struct itree_iter iter;
 	state_lock_entry_t *found_entry;
 	uint64_t found_entry_end;
 	uint64_t range_end = lock_end(lock);
@@ -2569,39 +2814,48 @@ state_status_t state_lock_locked(cache_entry_t *entry,
 		return status;
 	}
 
+	/* Need to reject lock request if this lock owner already has
+	 * a lock on this file via a different export.  That can only be
+	 * if some lock on the file came through another export.
+	 */
+	if (entry->object.file.lock_export != op_ctx->export) {
+		glist_for_each(glist, &entry->object.file.lock_list) {
+			found_entry =
+			    glist_entry(glist, state_lock_entry_t, sle_list);
+
+			if (found_entry->sle_export == op_ctx->export
+			    || different_owners(found_entry->sle_owner, owner))
+				continue;
+
+			cache_inode_dec_pin_ref(entry, false);
+
+			LogEvent(COMPONENT_STATE,
+				 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
+				 found_entry->sle_export->export_id,
+				 found_entry->sle_export->fullpath,
+				 op_ctx->export->export_id,
+				 op_ctx->export->fullpath);
+
+			LogEntry("Found lock entry belonging to another export",
+				 found_entry);
+			status = STATE_INVALID_ARGUMENT;
+			return status;
+		}
+	}
+
 	if (blocking != STATE_NON_BLOCKING) {
 		/* First search for a blocked request. Client can ignore the
 		 * blocked request and keep sending us new lock request again
 		 * and again. So if we have a mapping blocked request return
 		 * that
 		 */
-		glist_for_each(glist, &entry->object.file.lock_list) {
-			found_entry =
-			    glist_entry(glist, state_lock_entry_t, sle_list);
-
+		itree_iter_init(&iter);
+		while ((found_entry = locklist_next(entry, &iter,
+						    lock->lock_start,
+						    range_end)) != NULL) {
 			if (different_owners(found_entry->sle_owner, owner))
 				continue;
 
-			/* Need to reject lock request if this lock owner
-			 * already has a lock on this file via a different
-			 * export.
-			 */
-			if (found_entry->sle_export != op_ctx->export) {
-				cache_inode_dec_pin_ref(entry, false);
-
-				LogEvent(COMPONENT_STATE,
-					 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-					 found_entry->sle_export->export_id,
-					 found_entry->sle_export->fullpath,
-					 op_ctx->export->export_id,
-					 op_ctx->export->fullpath);
-				LogEntry(
-					"Found lock entry belonging to another export",
-					found_entry);
-				status = STATE_INVALID_ARGUMENT;
-				return status;
-			}
-
 			if (found_entry->sle_blocked != blocking)
 				continue;
 
@@ -2620,53 +2874,29 @@ state_status_t state_lock_locked(cache_entry_t *entry,
 		}
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
-		/* Need to reject lock request if this lock owner already has
-		 * a lock on this file via a different export.
-		 */
-		if (found_entry->sle_export != op_ctx->export
-		    && !different_owners(found_entry->sle_owner, owner)) {
-			cache_inode_dec_pin_ref(entry, false);
-
-			LogEvent(COMPONENT_STATE,
-				 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-				 found_entry->sle_export->export_id,
-				 found_entry->sle_export->fullpath,
-				 op_ctx->export->export_id,
-				 op_ctx->export->fullpath);
-
-			LogEntry("Found lock entry belonging to another export",
-				 found_entry);
-
-			status = STATE_INVALID_ARGUMENT;
-			return status;
-		}
-
+	/* Only locks overlapping the new one can conflict with or cover it */
+	itree_iter_init(&iter);
+	while ((found_entry = locklist_next(entry, &iter, lock->lock_start,
+					    range_end)) != NULL) {
 		/* Don't skip blocked locks for fairness */
 		found_entry_end = lock_end(&found_entry->sle_lock);
 
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
+		     || lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* Found a conflicting lock, break out of loop.
+			 * Also indicate overlap hint.
 			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner,
-						owner)) {
-				/* Found a conflicting lock, break out of loop.
-				 * Also indicate overlap hint.
-				 */
-				LogEntry("Conflicts with", found_entry);
-				LogList("Locks", entry,
-					&entry->object.file.lock_list);
-				copy_conflict(found_entry, holder, conflict);
-				allow = false;
-				overlap = true;
-				break;
-			}
+			LogEntry("Conflicts with", found_entry);
+			LogList("Locks", entry, &entry->object.file.lock_list);
+			copy_conflict(found_entry, holder, conflict);
+			allow = false;
+			overlap = true;
+			break;
 		}
 
 		if (found_entry_end >= range_end
@@ -2834,11 +3064,11 @@ state_status_t state_lock_locked(cache_entry_t *entry,
 		if (glist_empty(&entry->object.file.lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		locklist_add(entry, &entry->object.file.lock_list,
+			     found_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, &found_entry->sle_lock);
 		/* Don't need to unpin, we know there is state on file. */
 	} else if (status == STATE_LOCK_CONFLICT) {
 		LogEntry("Conflict in FSAL for", found_entry);
@@ -2860,8 +3090,8 @@ state_status_t state_lock_locked(cache_entry_t *entry,
 		if (glist_empty(&entry->object.file.lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		locklist_add(entry, &entry->object.file.lock_list,
+			     found_entry);
 
 		cache_inode_dec_pin_ref(entry, false);
 
@@ -3014,7 +3244,7 @@ state_status_t state_unlock_locked(cache_entry_t *entry,
 		empty =
 		    LogList("Lock List", entry, &entry->object.file.lock_list);
 
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, lock);
 
 	cache_inode_dec_pin_ref(entry, false);
 
@@ -3097,7 +3327,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 		cancel_blocked_lock(entry, found_entry);
 
 		/* Check to see if we can grant any blocked locks. */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, lock);
 
 		break;
 	}
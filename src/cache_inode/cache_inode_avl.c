@@ -53,6 +53,153 @@
 #include <pthread.h>
 #include <assert.h>
 
+/*
+ * Blocked Bloom filter over the names in avl.t
+ *
+ * A directory holding many names gets a Bloom filter, so a lookup
+ * of a name it does not hold need not walk the tree once per probe.
+ * Each name sets BLOOM_K bits in one 512 bit block chosen by its
+ * hash, so a test touches a single cache line.
+ *
+ * The filter is built once the tree holds Dir_Bloom_Threshold names,
+ * sized for twice as many at BLOOM_BITS_PER_NAME bits each, and
+ * rebuilt twice the size whenever that many have been added, up to
+ * Dir_Bloom_Max_Size bytes.  Past that it just rules out fewer
+ * names.  Removed names stay set until the next rebuild; they only
+ * cost a tree walk.  Protected by the content_lock like the tree.
+ */
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_BYTES (BLOOM_BLOCK_WORDS * sizeof(uint64_t))
+#define BLOOM_BITS_PER_NAME 16
+#define BLOOM_NAMES_PER_BLOCK (BLOOM_BLOCK_WORDS * 64 / BLOOM_BITS_PER_NAME)
+#define BLOOM_K 6
+
+/* Odd multiplier spreading the hash over the bits within a block */
+#define BLOOM_MIX 0x9e3779b97f4a7c15ULL
+
+/**
+ * @brief Hash a name the way the tree is keyed, before probing
+ */
+
+static inline uint64_t avl_dirent_name_hash(const char *name)
+{
+#if AVL_HASH_MURMUR3
+	uint32_t hk[4];
+	uint64_t k;
+
+	MurmurHash3_x64_128(name, strlen(name), 67, hk);
+	memcpy(&k, hk, 8);
+	return k;
+#else
+	return CityHash64WithSeed(name, strlen(name), 67);
+#endif
+}
+
+static inline uint64_t *bloom_block(uint64_t *bits, uint32_t blocks,
+				    uint64_t hk)
+{
+	/* The high half of the hash picks the block */
+	return bits + (((hk >> 32) * blocks) >> 32) * BLOOM_BLOCK_WORDS;
+}
+
+static inline void bloom_set(uint64_t *bits, uint32_t blocks, uint64_t hk)
+{
+	uint64_t *block = bloom_block(bits, blocks, hk);
+	uint64_t m = hk * BLOOM_MIX;
+	int i;
+
+	for (i = 0; i < BLOOM_K; i++, m >>= 9)
+		block[(m >> 6) & 7] |= 1ULL << (m & 63);
+}
+
+static inline bool bloom_test(uint64_t *bits, uint32_t blocks, uint64_t hk)
+{
+	uint64_t *block = bloom_block(bits, blocks, hk);
+	uint64_t m = hk * BLOOM_MIX;
+	int i;
+
+	for (i = 0; i < BLOOM_K; i++, m >>= 9)
+		if (!(block[(m >> 6) & 7] & (1ULL << (m & 63))))
+			return false;
+
+	return true;
+}
+
+/* Replace the filter with one of blocks blocks over the whole tree */
+static void bloom_build(cache_entry_t *entry, uint32_t blocks)
+{
+	struct avltree_node *node;
+	cache_inode_dir_entry_t *v;
+	uint64_t *bits;
+
+	bits = gsh_calloc(blocks, BLOOM_BLOCK_BYTES);
+	if (bits == NULL) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "No memory for a %u block Bloom filter on entry=%p",
+			 blocks, entry);
+		return;
+	}
+
+	for (node = avltree_first(&entry->object.dir.avl.t); node != NULL;
+	     node = avltree_next(node)) {
+		v = avltree_container_of(node, cache_inode_dir_entry_t,
+					 node_hk);
+		bloom_set(bits, blocks, avl_dirent_name_hash(v->name));
+	}
+
+	gsh_free(entry->object.dir.avl.bloom.bits);
+	entry->object.dir.avl.bloom.bits = bits;
+	entry->object.dir.avl.bloom.blocks = blocks;
+	entry->object.dir.avl.bloom.names =
+		avltree_size(&entry->object.dir.avl.t);
+
+	LogDebug(COMPONENT_CACHE_INODE,
+		 "built %u block Bloom filter over %u names on entry=%p",
+		 blocks, entry->object.dir.avl.bloom.names, entry);
+}
+
+/* Note a name just inserted in the tree */
+static void bloom_add(cache_entry_t *entry, uint64_t hk)
+{
+	uint64_t size = avltree_size(&entry->object.dir.avl.t);
+	uint32_t max_blocks = cache_param.dir_bloom_max_size /
+			      BLOOM_BLOCK_BYTES;
+	uint64_t blocks;
+
+	if (entry->object.dir.avl.bloom.bits != NULL) {
+		bloom_set(entry->object.dir.avl.bloom.bits,
+			  entry->object.dir.avl.bloom.blocks, hk);
+		entry->object.dir.avl.bloom.names++;
+		if (entry->object.dir.avl.bloom.names <=
+		    (uint64_t) entry->object.dir.avl.bloom.blocks *
+		    BLOOM_NAMES_PER_BLOCK ||
+		    entry->object.dir.avl.bloom.blocks >= max_blocks)
+			return;
+	} else if (cache_param.dir_bloom_threshold == 0 ||
+		   size < cache_param.dir_bloom_threshold) {
+		return;
+	}
+
+	/* Room for as many names again */
+	blocks = 2 * size / BLOOM_NAMES_PER_BLOCK + 1;
+	bloom_build(entry, MIN(blocks, max_blocks));
+}
+
+/**
+ * @brief Free a directory's Bloom filter, with its names
+ *
+ * @param[in,out] entry The directory
+ */
+
+void cache_inode_avl_bloom_release(cache_entry_t *entry)
+{
+	gsh_free(entry->object.dir.avl.bloom.bits);
+	entry->object.dir.avl.bloom.bits = NULL;
+	entry->object.dir.avl.bloom.blocks = 0;
+	entry->object.dir.avl.bloom.names = 0;
+}
+
 void
 cache_inode_avl_init(cache_entry_t *entry)
 {
@@ -60,6 +207,10 @@ cache_inode_avl_init(cache_entry_t *entry)
 		     0 /* flags */);
 	avltree_init(&entry->object.dir.avl.c, avl_dirent_hk_cmpf,
 		     0 /* flags */);
+	entry->object.dir.avl.bloom.bits = NULL;
+	entry->object.dir.avl.bloom.blocks = 0;
+	entry->object.dir.avl.bloom.names = 0;
+	cache_inode_neg_init(entry);
 }
 
 static inline struct avltree_node *
@@ -214,18 +365,11 @@ int
 cache_inode_avl_qp_insert(cache_entry_t *entry,
 			  cache_inode_dir_entry_t *v)
 {
-#if AVL_HASH_MURMUR3
-	uint32_t hk[4];
-#endif
+	uint64_t hk = avl_dirent_name_hash(v->name);
 	int j, j2, code = -1;
 
 	/* don't permit illegal cookies */
-#if AVL_HASH_MURMUR3
-	MurmurHash3_x64_128(v->name, strlen(v->name), 67, hk);
-	memcpy(&v->hk.k, hk, 8);
-#else
-	v->hk.k = CityHash64WithSeed(v->name, strlen(v->name), 67);
-#endif
+	v->hk.k = hk;
 
 #ifdef _USE_9P
 	/* tmp hook : it seems like client running v9fs dislike "negative"
@@ -246,7 +390,7 @@ cache_inode_avl_qp_insert(cache_entry_t *entry,
 
 		code = cache_inode_avl_insert_impl(entry, v, j, 0);
 		if (code >= 0)
-			return code;
+			goto out;
 	}
 
 	LogCrit(COMPONENT_CACHE_INODE,
@@ -262,7 +406,7 @@ cache_inode_avl_qp_insert(cache_entry_t *entry,
 		v->hk.k = v->hk.k + j2;
 		code = cache_inode_avl_insert_impl(entry, v, j, j2);
 		if (code >= 0)
-			return code;
+			goto out;
 		j2++;
 	}
 
@@ -271,6 +415,10 @@ cache_inode_avl_qp_insert(cache_entry_t *entry,
 		v->name);
 
 	return -1;
+
+ out:
+	bloom_add(entry, hk);
+	return code;
 }
 
 cache_inode_dir_entry_t *
@@ -323,22 +471,23 @@ cache_inode_avl_qp_lookup_s(cache_entry_t *entry, const char *name, int maxj)
 	struct avltree *t = &entry->object.dir.avl.t;
 	struct avltree_node *node;
 	cache_inode_dir_entry_t *v2;
-#if AVL_HASH_MURMUR3
-	uint32_t hashbuff[4];
-#endif
+	uint64_t hk = avl_dirent_name_hash(name);
 	int j;
-	size_t namelen = strlen(name);
 	cache_inode_dir_entry_t v;
 
-#if AVL_HASH_MURMUR3
-	MurmurHash3_x64_128(name, namelen, 67, hashbuff);
-	/* This seems to be correct.  The avltree_lookup function looks
-	   as hk.k, but does no namecmp on its own, so there's no need to
-	   allocate space for or copy the name in the key. */
-	memcpy(&v.hk.k, hashbuff, 8);
-#else
-	v.hk.k = CityHash64WithSeed(name, namelen, 67);
-#endif
+	if (entry->object.dir.avl.bloom.bits != NULL &&
+	    !bloom_test(entry->object.dir.avl.bloom.bits,
+			entry->object.dir.avl.bloom.blocks, hk)) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "cache_inode_avl_qp_lookup_s: %s ruled out by Bloom filter",
+			     name);
+		return NULL;
+	}
+
+	/* The avltree_lookup function looks at hk.k, but does no
+	   namecmp on its own, so there's no need to allocate space for
+	   or copy the name in the key. */
+	v.hk.k = hk;
 
 #ifdef _USE_9P
 	/* tmp hook : it seems like client running v9fs dislike "negative"
@@ -169,6 +169,11 @@ cache_inode_create(cache_entry_t *parent,
 				 "FSAL returned STALE on create type %d", type);
 			cache_inode_kill_entry(parent);
 		} else if (fsal_status.major == ERR_FSAL_EXIST) {
+			/* It may be remembered as not existing */
+			PTHREAD_RWLOCK_wrlock(&parent->content_lock);
+			cache_inode_neg_remove(parent, name);
+			PTHREAD_RWLOCK_unlock(&parent->content_lock);
+
 			/* Already exists. Check if type if correct */
 			status =
 			    cache_inode_lookup(parent, name, entry);
@@ -64,6 +64,8 @@ cache_inode_init(void)
 	}
 
 	cih_pkginit();
+	cache_inode_wgather_pkginit();
+	cache_inode_readahead_pkginit();
 
 	return status;
 }				/* cache_inode_init */
@@ -100,6 +100,11 @@ cache_inode_invalidate(cache_entry_t *entry, uint32_t flags)
 	if (!(flags & CACHE_INODE_INVALIDATE_GOT_LOCK))
 		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
 
+	/* Someone else may have changed the data under any buffers */
+	if (flags & (CACHE_INODE_INVALIDATE_ATTRS |
+		     CACHE_INODE_INVALIDATE_CONTENT))
+		cache_inode_readahead_invalidate(entry);
+
 	if (((flags & CACHE_INODE_INVALIDATE_CLOSE) != 0)
 	    && (entry->type == REGULAR_FILE))
 		status = cache_inode_close(entry, CACHE_INODE_FLAG_REALLYCLOSE);
@@ -144,6 +144,14 @@ cache_inode_lookup_impl(cache_entry_t *parent,
 						status = CACHE_INODE_NOT_FOUND;
 						goto out;
 					}
+					if (cache_inode_neg_lookup(parent,
+								   name)) {
+						/* A recent LOOKUP did not
+						 * find it either. */
+						*entry = NULL;
+						status = CACHE_INODE_NOT_FOUND;
+						goto out;
+					}
 					/* XXX keep going? */
 				}
 			} else if (write_locked
@@ -176,6 +184,8 @@ cache_inode_lookup_impl(cache_entry_t *parent,
 			cache_inode_kill_entry(parent);
 		}
 		status = cache_inode_error_convert(fsal_status);
+		if (status == CACHE_INODE_NOT_FOUND)
+			cache_inode_neg_add(parent, name);
 		LogFullDebug(COMPONENT_CACHE_INODE,
 			     "FSAL %d %s returned %s",
 			     (int) op_ctx->export->export_id,
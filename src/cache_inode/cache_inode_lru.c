@@ -407,6 +407,8 @@ cache_inode_lru_clean(cache_entry_t *entry)
 
 	if (entry->type == DIRECTORY)
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+	else if (entry->type == REGULAR_FILE)
+		cache_inode_readahead_free(entry);
 
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
@@ -852,6 +854,15 @@ lru_run(struct fridgethr_context *ctx)
 							++totalclosed;
 							++closed;
 						}
+						/* Nobody is streaming it */
+						cache_inode_readahead_invalidate(
+							entry);
+					} else if (entry->type == DIRECTORY) {
+						/* The FSAL's own descriptor */
+						entry->obj_handle->ops->
+						    lru_cleanup(
+							entry->obj_handle,
+							LRU_CLOSE_FILES);
 					}
 					PTHREAD_RWLOCK_unlock(&entry->
 							      content_lock);
@@ -1543,4 +1554,23 @@ lru_wake_thread(void)
 	fridgethr_wake(lru_fridge);
 }
 
+/**
+ * @brief Check whether an FSAL may keep a descriptor of its own
+ *
+ * FSALs that hold descriptors on objects for their own use, such as
+ * directories they read, count them in open_fd_count and give them
+ * back when the LRU thread calls their lru_cleanup method.  They
+ * should only keep one while we are caching descriptors and have not
+ * reached the high water mark.
+ *
+ * @return true if the descriptor may be kept.
+ */
+
+bool
+cache_inode_lru_fds_spare(void)
+{
+	return lru_state.caching_fds &&
+	       atomic_fetch_size_t(&open_fd_count) < lru_state.fds_hiwat;
+}
+
 /** @} */
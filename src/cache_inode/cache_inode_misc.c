@@ -337,10 +337,18 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		/* No shares or locks, yet. */
 		glist_init(&nentry->object.file.deleg_list);
 		glist_init(&nentry->object.file.lock_list);
+		itree_init(&nentry->object.file.lock_tree);
+		nentry->object.file.lock_export = NULL;
+		nentry->object.file.lock_seq = 0;
+		nentry->object.file.grant_attempts = 0;
+		nentry->object.file.grant_futile = 0;
 		glist_init(&nentry->object.file.nlm_share_list);
 		memset(&nentry->object.file.share_state, 0,
 		       sizeof(cache_inode_share_t));
 		nentry->object.file.write_delegated = false;
+		nentry->object.file.wgather = NULL;
+		nentry->object.file.writers = 0;
+		nentry->object.file.ra = NULL;
 
 		/* Init statistics used for intelligently granting delegations*/
 		init_deleg_heuristics(nentry);
@@ -823,6 +831,7 @@ cache_inode_release_dirents(cache_entry_t *entry,
 	case CACHE_INODE_AVL_BOTH:
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_NAMES);
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_COOKIES);
+		cache_inode_neg_release(entry);
 		/* tree == NULL */
 		break;
 
@@ -848,6 +857,7 @@ cache_inode_release_dirents(cache_entry_t *entry,
 		}
 
 		if (tree == &entry->object.dir.avl.t) {
+			cache_inode_avl_bloom_release(entry);
 			entry->object.dir.nbactive = 0;
 			atomic_clear_uint32_t_bits(&entry->flags,
 						   CACHE_INODE_DIR_POPULATED);
@@ -44,6 +44,7 @@
 #include "nfs_core.h"
 #include "nfs_exports.h"
 #include "export_mgr.h"
+#include "fridgethr.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -51,6 +52,7 @@
 #include <sys/param.h>
 #include <time.h>
 #include <pthread.h>
+#include <string.h>
 #include <assert.h>
 
 /**
@@ -66,20 +68,25 @@
  * @param[in]     io_size      Amount of data to be read or written
  * @param[out]    bytes_moved  The length of data successfuly read or written
  * @param[in,out] buffer       Where in memory to read or write data
+ * @param[in]     iov          Data to write, instead of @c buffer, for
+ *                             vectored writes.  NULL otherwise.
+ * @param[in]     iovcnt       Number of elements in @c iov
  * @param[out]    eof          Whether a READ encountered the end of file.  May
  *                             be NULL for writes.
  * @param[in]     sync         Whether the write is synchronous or not
+ * @param[in,out] info         READ_PLUS/WRITE_PLUS information
  *
  * @return CACHE_INODE_SUCCESS or various errors
  */
 
-cache_inode_status_t
-cache_inode_rdwr_plus(cache_entry_t *entry,
-		      cache_inode_io_direction_t io_direction,
-		      uint64_t offset, size_t io_size,
-		      size_t *bytes_moved, void *buffer,
-		      bool *eof,
-		      bool *sync, struct io_info *info)
+static cache_inode_status_t
+cache_inode_rdwr_int(cache_entry_t *entry,
+		     cache_inode_io_direction_t io_direction,
+		     uint64_t offset, size_t io_size,
+		     size_t *bytes_moved, void *buffer,
+		     const struct iovec *iov, int iovcnt,
+		     bool *eof,
+		     bool *sync, struct io_info *info)
 {
 	/* Error return from FSAL calls */
 	fsal_status_t fsal_status = { 0, 0 };
@@ -165,7 +172,11 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 					    buffer, bytes_moved, eof, info);
 	} else {
 		bool fsal_sync = *sync;
-		if (io_direction == CACHE_INODE_WRITE)
+		if (iov != NULL)
+			fsal_status =
+			  obj_hdl->ops->write_iov(obj_hdl, offset, iov, iovcnt,
+						  bytes_moved, &fsal_sync);
+		else if (io_direction == CACHE_INODE_WRITE)
 			fsal_status =
 			  obj_hdl->ops->write(obj_hdl, offset,
 					      io_size, buffer, bytes_moved,
@@ -264,6 +275,10 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		content_locked = false;
 	}
 
+	if (io_direction != CACHE_INODE_READ &&
+	    io_direction != CACHE_INODE_READ_PLUS)
+		cache_inode_readahead_invalidate(entry);
+
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 	attributes_locked = true;
 	if (io_direction == CACHE_INODE_WRITE ||
@@ -293,6 +308,517 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 	return status;
 }
 
+/**
+ * @brief Sequential read-ahead
+ *
+ * Each file read through the cache keeps track of where a client
+ * reading it sequentially would read next.  Once RA_TRIGGER reads
+ * in a row have followed on from each other, we stay up to
+ * Read_Ahead_Window bytes ahead of the reader.  The FSAL is first
+ * asked to prefetch with io_advise.  If it does not take the hint
+ * and says nothing but this server changes its files' data
+ * (fso_readahead_buffer), a Read_Ahead thread reads the window into
+ * memory and the READs that follow are served from there without
+ * going to the FSAL.
+ *
+ * Clients keep several READs in flight and they arrive slightly out
+ * of order, so a read counts as sequential if it starts within a few
+ * read sizes of the expected offset.
+ *
+ * Buffered data is dropped on any write or truncate through the
+ * cache and whenever an upcall invalidates the entry, and is not
+ * served once the change attribute, refreshed if no longer trusted,
+ * moves on.  All of a file's read-ahead state is protected by its
+ * mutex; no other lock is taken while it is held.
+ */
+
+#define RA_TRIGGER 2		/*< Sequential reads before we read ahead */
+#define RA_SLACK 4		/*< Read sizes a read may stray and count */
+#define RA_BUFS 2		/*< Windows buffered per file */
+#define RA_THREADS 4		/*< Prefetches in flight at once */
+#define RA_MAX_BYTES (256 * 1024 * 1024)	/*< All buffered data */
+
+struct cache_inode_rabuf {
+	char *data;		/*< NULL if the slot is free */
+	uint64_t off;
+	size_t len;
+	bool eof;		/*< Ends at end of file */
+	uint64_t change;	/*< File's change attribute when read */
+};
+
+struct cache_inode_readahead {
+	pthread_mutex_t mtx;
+	uint64_t next;		/*< Where the reader is expected next */
+	uint64_t ahead;		/*< Read ahead or advised up to here */
+	uint32_t run;		/*< Sequential reads in a row */
+	uint32_t gen;		/*< Bumped when buffered data goes stale */
+	bool buffered;		/*< FSAL took no hint, read into memory */
+	bool filling;		/*< A prefetch is in flight */
+	struct cache_inode_rabuf buf[RA_BUFS];
+};
+
+/**
+ * @brief A prefetch handed to the Read_Ahead fridge
+ */
+
+struct cache_inode_rafill {
+	cache_entry_t *entry;	/*< Referenced */
+	struct gsh_export *export;	/*< Referenced */
+	uint64_t off;
+	size_t len;
+	uint32_t gen;		/*< Discard the data if this moved on */
+	uint64_t change;
+};
+
+static struct fridgethr *ra_fridge;
+static size_t ra_bytes;		/*< Buffered or being read, all files */
+
+/**
+ * @brief Set up read-ahead
+ */
+
+void cache_inode_readahead_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (cache_param.read_ahead_window == 0)
+		return;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = RA_THREADS;
+	frp.deferment = fridgethr_defer_fail;
+	rc = fridgethr_init(&ra_fridge, "Read_Ahead", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize read-ahead thread fridge: %d, read-ahead is limited to FSAL hints",
+			 rc);
+		ra_fridge = NULL;
+	}
+}
+
+static void ra_buf_free(struct cache_inode_rabuf *b)
+{
+	if (b->data == NULL)
+		return;
+	gsh_free(b->data);
+	b->data = NULL;
+	(void)atomic_sub_size_t(&ra_bytes, b->len);
+}
+
+/**
+ * @brief Drop a file's buffered data
+ *
+ * Called with its mutex held.
+ */
+
+static void ra_drop(struct cache_inode_readahead *ra)
+{
+	int i;
+
+	for (i = 0; i < RA_BUFS; i++)
+		ra_buf_free(&ra->buf[i]);
+	ra->gen++;
+	ra->ahead = 0;
+}
+
+/**
+ * @brief Get a file's read-ahead state, setting it up on first use
+ *
+ * @return The state, NULL on allocation failure.
+ */
+
+static struct cache_inode_readahead *ra_get(cache_entry_t *entry)
+{
+	struct cache_inode_readahead *ra = entry->object.file.ra;
+
+	if (ra != NULL)
+		return ra;
+
+	ra = gsh_calloc(1, sizeof(*ra));
+	if (ra == NULL)
+		return NULL;
+	pthread_mutex_init(&ra->mtx, NULL);
+
+	/* Once set it stays until the entry is cleaned */
+	PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+	if (entry->object.file.ra == NULL) {
+		entry->object.file.ra = ra;
+		ra = NULL;
+	}
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+	if (ra != NULL) {
+		/* Lost the race */
+		pthread_mutex_destroy(&ra->mtx);
+		gsh_free(ra);
+	}
+	return entry->object.file.ra;
+}
+
+/**
+ * @brief Forget what has been read ahead of a file
+ *
+ * Called after the file's data changed through the cache, or when
+ * nobody seems to be reading it any more.
+ *
+ * @param[in] entry The file
+ */
+
+void cache_inode_readahead_invalidate(cache_entry_t *entry)
+{
+	struct cache_inode_readahead *ra;
+
+	if (entry->type != REGULAR_FILE)
+		return;
+	ra = entry->object.file.ra;
+	if (ra == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	ra_drop(ra);
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+}
+
+/**
+ * @brief Free a file's read-ahead state as the entry is cleaned
+ *
+ * @param[in] entry The file, unreferenced
+ */
+
+void cache_inode_readahead_free(cache_entry_t *entry)
+{
+	struct cache_inode_readahead *ra = entry->object.file.ra;
+	int i;
+
+	if (ra == NULL)
+		return;
+
+	for (i = 0; i < RA_BUFS; i++)
+		ra_buf_free(&ra->buf[i]);
+	pthread_mutex_destroy(&ra->mtx);
+	gsh_free(ra);
+	entry->object.file.ra = NULL;
+}
+
+/**
+ * @brief Read a prefetch window into memory
+ *
+ * Runs in the Read_Ahead fridge.
+ */
+
+static void ra_fill(struct fridgethr_context *ctx)
+{
+	struct cache_inode_rafill *fill = ctx->arg;
+	cache_entry_t *entry = fill->entry;
+	struct cache_inode_readahead *ra = entry->object.file.ra;
+	struct cache_inode_rabuf *b;
+	struct root_op_context root_op_context;
+	cache_inode_status_t status;
+	size_t moved = 0;
+	bool eof = false, sync = false;
+	char *data;
+	int i;
+
+	init_root_op_context(&root_op_context, fill->export,
+			     fill->export->fsal_export, 0, 0,
+			     UNKNOWN_REQUEST);
+
+	data = gsh_malloc(fill->len);
+	if (data == NULL)
+		status = CACHE_INODE_MALLOC_ERROR;
+	else
+		status = cache_inode_rdwr_int(entry, CACHE_INODE_READ,
+					      fill->off, fill->len, &moved,
+					      data, NULL, 0, &eof, &sync,
+					      NULL);
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	ra->filling = false;
+	if (status != CACHE_INODE_SUCCESS || moved == 0 ||
+	    fill->gen != ra->gen) {
+		/* Failed, or stale already: let the reader go to the
+		 * FSAL and try again later. */
+		if (ra->ahead > fill->off)
+			ra->ahead = fill->off;
+		gsh_free(data);
+		(void)atomic_sub_size_t(&ra_bytes, fill->len);
+		goto out;
+	}
+
+	/* Take a free slot, or the one furthest behind */
+	b = &ra->buf[0];
+	for (i = 0; i < RA_BUFS && b->data != NULL; i++)
+		if (ra->buf[i].data == NULL || ra->buf[i].off < b->off)
+			b = &ra->buf[i];
+	ra_buf_free(b);
+
+	b->data = data;
+	b->off = fill->off;
+	b->len = moved;
+	b->eof = eof;
+	b->change = fill->change;
+	(void)atomic_sub_size_t(&ra_bytes, fill->len - moved);
+	(void)atomic_add_uint64_t(&fill->export->readahead.prefetched, moved);
+
+	LogFullDebug(COMPONENT_CACHE_INODE,
+		     "Read ahead entry %p offset=%" PRIu64 " size=%zu%s",
+		     entry, fill->off, moved, eof ? " eof" : "");
+
+ out:
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+	release_root_op_context();
+	put_gsh_export(fill->export);
+	cache_inode_put(entry);
+	gsh_free(fill);
+}
+
+/**
+ * @brief Serve a read from buffered data
+ *
+ * Called with the file's read-ahead mutex held.
+ *
+ * @return true if the read was served.
+ */
+
+static bool ra_copy(struct cache_inode_readahead *ra, uint64_t change,
+		    uint64_t offset, size_t io_size, void *buffer,
+		    size_t *bytes_moved, bool *eof)
+{
+	struct cache_inode_rabuf *b;
+	uint64_t end;
+	size_t n;
+	int i;
+
+	for (i = 0; i < RA_BUFS; i++) {
+		b = &ra->buf[i];
+		if (b->data == NULL)
+			continue;
+		if (b->change != change) {
+			ra_buf_free(b);
+			continue;
+		}
+		end = b->off + b->len;
+		if (offset < b->off || offset >= end ||
+		    (offset + io_size > end && !b->eof))
+			continue;
+
+		n = MIN(io_size, end - offset);
+		memcpy(buffer, b->data + (offset - b->off), n);
+		*bytes_moved = n;
+		*eof = b->eof && offset + n == end;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Stay ahead of a sequential reader
+ *
+ * Notes where a read ended and, if the reader is streaming and
+ * getting close to the end of what was read ahead, asks the FSAL
+ * to prefetch the next window or starts reading it into memory.
+ */
+
+static void ra_advance(cache_entry_t *entry, struct cache_inode_readahead *ra,
+		       uint64_t change, uint64_t end, bool eof)
+{
+	uint64_t window = cache_param.read_ahead_window;
+	struct cache_inode_rafill *fill;
+	struct io_hints hints;
+	fsal_status_t fsal_status;
+	uint64_t start;
+	int i, rc;
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	if (end > ra->next)
+		ra->next = end;
+
+	/* Data the reader is past */
+	for (i = 0; i < RA_BUFS; i++)
+		if (ra->buf[i].data != NULL &&
+		    ra->buf[i].off + ra->buf[i].len <= ra->next)
+			ra_buf_free(&ra->buf[i]);
+
+	if (eof || ra->run < RA_TRIGGER || ra->filling ||
+	    ra->ahead >= ra->next + window / 2) {
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+		return;
+	}
+
+	start = MAX(ra->ahead, ra->next);
+	ra->ahead = start + window;
+
+	if (!ra->buffered) {
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+
+		hints.offset = start;
+		hints.count = window;
+		hints.hints = (1 << IO_ADVISE4_WILLNEED) |
+			      (1 << IO_ADVISE4_SEQUENTIAL);
+		fsal_status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+		/* The FSAL wants the file open to take hints */
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		if (is_open(entry))
+			fsal_status = entry->obj_handle->ops->io_advise(
+				entry->obj_handle, &hints);
+		else
+			hints.hints = 0;
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+		if (!FSAL_IS_ERROR(fsal_status) &&
+		    (hints.hints & (1 << IO_ADVISE4_WILLNEED))) {
+			(void)atomic_inc_uint64_t(
+				&op_ctx->export->readahead.advised);
+			return;
+		}
+
+		PTHREAD_MUTEX_lock(&ra->mtx);
+		if (ra_fridge != NULL && !FSAL_IS_ERROR(fsal_status) &&
+		    is_open(entry) &&
+		    op_ctx->fsal_export->ops->fs_supports(
+			    op_ctx->fsal_export, fso_readahead_buffer)) {
+			/* The FSAL just does not take hints */
+			LogFullDebug(COMPONENT_CACHE_INODE,
+				     "FSAL took no read-ahead hint for entry %p, buffering",
+				     entry);
+			ra->buffered = true;
+		}
+		ra->ahead = start;
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+		return;
+	}
+
+	if (ra_fridge == NULL ||
+	    atomic_add_size_t(&ra_bytes, window) > RA_MAX_BYTES) {
+		(void)atomic_sub_size_t(&ra_bytes, window);
+		ra->ahead = start;
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+		return;
+	}
+
+	fill = gsh_malloc(sizeof(*fill));
+	if (fill == NULL) {
+		(void)atomic_sub_size_t(&ra_bytes, window);
+		ra->ahead = start;
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+		return;
+	}
+	fill->entry = entry;
+	fill->export = op_ctx->export;
+	fill->off = start;
+	fill->len = window;
+	fill->gen = ra->gen;
+	fill->change = change;
+	ra->filling = true;
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+
+	cache_inode_lru_ref(entry, LRU_FLAG_NONE);
+	get_gsh_export_ref(fill->export);
+
+	rc = fridgethr_submit(ra_fridge, ra_fill, fill);
+	if (rc != 0) {
+		/* All threads busy, try again on the next read */
+		PTHREAD_MUTEX_lock(&ra->mtx);
+		ra->filling = false;
+		if (ra->ahead > start)
+			ra->ahead = start;
+		PTHREAD_MUTEX_unlock(&ra->mtx);
+		(void)atomic_sub_size_t(&ra_bytes, window);
+		put_gsh_export(fill->export);
+		cache_inode_put(entry);
+		gsh_free(fill);
+	}
+}
+
+/**
+ * @brief Read, spotting sequential readers and reading ahead of them
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+static cache_inode_status_t
+cache_inode_read_ahead(cache_entry_t *entry, uint64_t offset, size_t io_size,
+		       size_t *bytes_moved, void *buffer, bool *eof,
+		       bool *sync)
+{
+	struct cache_inode_readahead *ra = ra_get(entry);
+	uint64_t slack = RA_SLACK * (uint64_t) io_size;
+	cache_inode_status_t status;
+	uint64_t change;
+	bool served = false, streaming;
+
+	if (ra == NULL)
+		return cache_inode_rdwr_int(entry, CACHE_INODE_READ, offset,
+					    io_size, bytes_moved, buffer,
+					    NULL, 0, eof, sync, NULL);
+
+	/* Buffered data is only as good as the change attribute it is
+	 * checked against */
+	status = cache_inode_lock_trust_attrs(entry, false);
+	if (status != CACHE_INODE_SUCCESS)
+		return cache_inode_rdwr_int(entry, CACHE_INODE_READ, offset,
+					    io_size, bytes_moved, buffer,
+					    NULL, 0, eof, sync, NULL);
+	change = entry->obj_handle->attributes.change;
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	PTHREAD_MUTEX_lock(&ra->mtx);
+	if (offset + slack >= ra->next && offset <= ra->next + slack) {
+		ra->run++;
+	} else {
+		/* Jumped elsewhere, what we have is of no use */
+		ra->run = 0;
+		ra->next = offset;
+		ra_drop(ra);
+	}
+	streaming = ra->run >= RA_TRIGGER;
+	if (streaming && ra->buffered)
+		served = ra_copy(ra, change, offset, io_size, buffer,
+				 bytes_moved, eof);
+	PTHREAD_MUTEX_unlock(&ra->mtx);
+
+	if (served) {
+		(void)atomic_inc_uint64_t(&op_ctx->export->readahead.hits);
+		PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+		cache_inode_set_time_current(
+			&entry->obj_handle->attributes.atime);
+		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+	} else {
+		if (streaming && ra->buffered)
+			(void)atomic_inc_uint64_t(
+				&op_ctx->export->readahead.misses);
+		status = cache_inode_rdwr_int(entry, CACHE_INODE_READ, offset,
+					      io_size, bytes_moved, buffer,
+					      NULL, 0, eof, sync, NULL);
+		if (status != CACHE_INODE_SUCCESS)
+			return status;
+	}
+
+	ra_advance(entry, ra, change, offset + *bytes_moved, *eof);
+	return CACHE_INODE_SUCCESS;
+}
+
+cache_inode_status_t
+cache_inode_rdwr_plus(cache_entry_t *entry,
+		      cache_inode_io_direction_t io_direction,
+		      uint64_t offset, size_t io_size,
+		      size_t *bytes_moved, void *buffer,
+		      bool *eof,
+		      bool *sync, struct io_info *info)
+{
+	if (io_direction == CACHE_INODE_READ &&
+	    cache_param.read_ahead_window != 0 &&
+	    entry->type == REGULAR_FILE)
+		return cache_inode_read_ahead(entry, offset, io_size,
+					      bytes_moved, buffer, eof, sync);
+
+	return cache_inode_rdwr_int(entry, io_direction, offset, io_size,
+				    bytes_moved, buffer, NULL, 0, eof, sync,
+				    info);
+}
+
 cache_inode_status_t
 cache_inode_rdwr(cache_entry_t *entry,
 		 cache_inode_io_direction_t io_direction,
@@ -305,4 +831,297 @@ cache_inode_rdwr(cache_entry_t *entry,
 				     bytes_moved, buffer, eof, sync, NULL);
 }
 
+/**
+ * @brief UNSTABLE writes gathered into one FSAL write
+ *
+ * Clients stream UNSTABLE writes to a file back to back, several in
+ * flight at once.  When one arrives while others to the same file
+ * are in progress it becomes the leader of a batch: it waits up to
+ * Write_Gather_Window for writes that continue or overlap the end
+ * of its range, then issues them all as one vectored write and
+ * hands each writer its result.  Writers block in their worker
+ * threads meanwhile, so their buffers stay valid.
+ *
+ * A batch lives on its leader's stack.  It is open for joining
+ * while its file's object.file.wgather points at it; all of it is
+ * protected by its file's stripe of wgather_mtx.  Only writes
+ * through the same export join, and the write is made in the
+ * leader's context: access was checked for every writer before
+ * it got here.
+ */
+
+#define WGATHER_LOCKS 127	/*< Prime, to spread entries */
+#define WGATHER_IOV 64		/*< Most buffers in one batch */
+#define WGATHER_BYTES (4 * 1024 * 1024)	/*< Largest batch */
+
+struct cache_inode_wgather {
+	struct gsh_export *export;	/*< Only its writes can join */
+	const struct user_cred *creds;	/*< The leader's, which the batch
+					    is written with */
+	uint64_t start;
+	uint64_t end;		/*< Exclusive */
+	struct iovec iov[WGATHER_IOV];
+	int iovcnt;
+	uint32_t nwrites;	/*< Writes in the batch */
+	uint32_t waiters;	/*< Joiners yet to take their result */
+	bool done;		/*< Write issued, results below set */
+	pthread_cond_t cv;
+	cache_inode_status_t status;
+	size_t written;
+	bool sync;
+};
+
+static pthread_mutex_t wgather_mtx[WGATHER_LOCKS];
+
+static pthread_mutex_t *wgather_lock(cache_entry_t *entry)
+{
+	return &wgather_mtx[((uintptr_t) entry / sizeof(cache_entry_t)) %
+			    WGATHER_LOCKS];
+}
+
+/**
+ * @brief Set up write gathering
+ */
+
+void cache_inode_wgather_pkginit(void)
+{
+	int i;
+
+	for (i = 0; i < WGATHER_LOCKS; i++)
+		pthread_mutex_init(&wgather_mtx[i], NULL);
+}
+
+/**
+ * @brief Whether a write may go out with the batch leader's credentials
+ *
+ * The FSAL checks permissions, quotas and ownership of new blocks
+ * against the caller, so only writes by the same user with the same
+ * groups may share a call.
+ */
+
+static bool wgather_same_creds(const struct user_cred *a,
+			       const struct user_cred *b)
+{
+	if (a == b)
+		return true;
+	if (a == NULL || b == NULL)
+		return false;
+	return a->caller_uid == b->caller_uid &&
+	       a->caller_gid == b->caller_gid &&
+	       a->caller_glen == b->caller_glen &&
+	       (a->caller_glen == 0 ||
+		memcmp(a->caller_garray, b->caller_garray,
+		       a->caller_glen * sizeof(gid_t)) == 0);
+}
+
+/**
+ * @brief Add a write to an open batch if it continues it
+ *
+ * The write must come from the same export and credentials as the
+ * batch, start within or right at the end of it and reach at least
+ * its end.  Data it overlaps is cut from the batch,
+ * as the later write would have overwritten it anyway.
+ *
+ * @return true if the write joined.
+ */
+
+static bool wgather_join(struct cache_inode_wgather *wg, uint64_t offset,
+			 const struct iovec *iov, int iovcnt, size_t io_size)
+{
+	uint64_t cut;
+	int i;
+
+	if (wg->export != op_ctx->export ||
+	    !wgather_same_creds(wg->creds, op_ctx->creds) ||
+	    offset < wg->start ||
+	    offset > wg->end || offset + io_size < wg->end ||
+	    offset + io_size - wg->start > WGATHER_BYTES ||
+	    wg->iovcnt + iovcnt > WGATHER_IOV)
+		return false;
+
+	for (cut = wg->end - offset; cut > 0; wg->iovcnt--) {
+		struct iovec *last = &wg->iov[wg->iovcnt - 1];
+
+		if (last->iov_len > cut) {
+			last->iov_len -= cut;
+			break;
+		}
+		cut -= last->iov_len;
+	}
+
+	for (i = 0; i < iovcnt; i++)
+		wg->iov[wg->iovcnt++] = iov[i];
+	wg->end = offset + io_size;
+	wg->nwrites++;
+	return true;
+}
+
+/**
+ * @brief What a short batch write did for one writer's range
+ */
+
+static size_t wgather_moved(struct cache_inode_wgather *wg,
+			    uint64_t offset, size_t io_size)
+{
+	uint64_t reached = wg->start + wg->written;
+
+	if (reached <= offset)
+		return 0;
+	return MIN(reached - offset, io_size);
+}
+
+/**
+ * @brief Write, gathering with concurrent UNSTABLE writes to the file
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+static cache_inode_status_t
+cache_inode_write_gather(cache_entry_t *entry, uint64_t offset,
+			 const struct iovec *iov, int iovcnt, size_t io_size,
+			 size_t *bytes_moved, bool *sync)
+{
+	pthread_mutex_t *mtx = wgather_lock(entry);
+	struct cache_inode_wgather wg, *open;
+	struct timespec start, deadline, end;
+	cache_inode_status_t status;
+	bool busy;
+
+	PTHREAD_MUTEX_lock(mtx);
+	busy = entry->object.file.writers++ > 0;
+	open = entry->object.file.wgather;
+
+	if (open != NULL &&
+	    wgather_join(open, offset, iov, iovcnt, io_size)) {
+		open->waiters++;
+		if (open->iovcnt == WGATHER_IOV)
+			pthread_cond_broadcast(&open->cv);	/* full */
+		while (!open->done)
+			pthread_cond_wait(&open->cv, mtx);
+
+		status = open->status;
+		*sync = open->sync;
+		if (status != CACHE_INODE_SUCCESS)
+			*bytes_moved = 0;
+		else if (open->written == open->end - open->start)
+			*bytes_moved = io_size;
+		else
+			*bytes_moved = wgather_moved(open, offset, io_size);
+
+		if (--open->waiters == 0)
+			pthread_cond_broadcast(&open->cv);
+		entry->object.file.writers--;
+		PTHREAD_MUTEX_unlock(mtx);
+		return status;
+	}
+
+	if (!busy || open != NULL || iovcnt > WGATHER_IOV) {
+		/* Nothing to wait for, or a batch we cannot join is
+		 * still collecting: write on our own. */
+		PTHREAD_MUTEX_unlock(mtx);
+		status = cache_inode_rdwr_int(entry, CACHE_INODE_WRITE, offset,
+					      io_size, bytes_moved, NULL,
+					      iov, iovcnt, NULL, sync, NULL);
+		PTHREAD_MUTEX_lock(mtx);
+		entry->object.file.writers--;
+		PTHREAD_MUTEX_unlock(mtx);
+		return status;
+	}
+
+	/* Lead a batch */
+	memset(&wg, 0, sizeof(wg));
+	wg.export = op_ctx->export;
+	wg.creds = op_ctx->creds;
+	wg.start = offset;
+	wg.end = offset + io_size;
+	memcpy(wg.iov, iov, iovcnt * sizeof(struct iovec));
+	wg.iovcnt = iovcnt;
+	wg.nwrites = 1;
+	pthread_cond_init(&wg.cv, NULL);
+	entry->object.file.wgather = &wg;
+
+	now(&start);
+	deadline = start;
+	timespec_add_nsecs(cache_param.write_gather_window * NS_PER_USEC,
+			   &deadline);
+	while (wg.iovcnt < WGATHER_IOV &&
+	       pthread_cond_timedwait(&wg.cv, mtx, &deadline) != ETIMEDOUT)
+		;
+	now(&end);
+
+	/* Close it, so later writes start another */
+	entry->object.file.wgather = NULL;
+	PTHREAD_MUTEX_unlock(mtx);
+
+	(void)atomic_inc_uint64_t(&cache_stp->wgather_batches);
+	(void)atomic_add_uint64_t(&cache_stp->wgather_writes, wg.nwrites);
+	(void)atomic_add_uint64_t(&cache_stp->wgather_wait,
+				  timespec_diff(&start, &end));
+
+	if (wg.nwrites > 1)
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "Gathered %" PRIu32 " writes to entry %p, %d buffers, offset=%" PRIu64 " size=%" PRIu64,
+			     wg.nwrites, entry, wg.iovcnt, wg.start,
+			     wg.end - wg.start);
+
+	wg.sync = false;
+	status = cache_inode_rdwr_int(entry, CACHE_INODE_WRITE, wg.start,
+				      wg.end - wg.start, &wg.written, NULL,
+				      wg.iov, wg.iovcnt, NULL, &wg.sync, NULL);
+
+	PTHREAD_MUTEX_lock(mtx);
+	wg.status = status;
+	wg.done = true;
+	pthread_cond_broadcast(&wg.cv);
+	while (wg.waiters > 0)
+		pthread_cond_wait(&wg.cv, mtx);
+	entry->object.file.writers--;
+	PTHREAD_MUTEX_unlock(mtx);
+	pthread_cond_destroy(&wg.cv);
+
+	*sync = wg.sync;
+	if (status != CACHE_INODE_SUCCESS)
+		*bytes_moved = 0;
+	else if (wg.written == wg.end - wg.start)
+		*bytes_moved = io_size;
+	else
+		*bytes_moved = wgather_moved(&wg, offset, io_size);
+	return status;
+}
+
+/**
+ * @brief Write a vector of buffers through the cache layer
+ *
+ * Like cache_inode_rdwr with CACHE_INODE_WRITE, but the data is
+ * handed to the FSAL's write_iov method as supplied, without first
+ * being gathered into one buffer.  UNSTABLE writes may be gathered
+ * with others to the same file, see cache_inode_write_gather.
+ *
+ * @param[in]     entry       File to be written
+ * @param[in]     offset      Absolute file position for I/O
+ * @param[in]     iov         Data to be written
+ * @param[in]     iovcnt      Number of elements in @c iov
+ * @param[in]     io_size     Total length of @c iov
+ * @param[out]    bytes_moved The length of data successfuly written
+ * @param[in,out] sync        Whether the write is synchronous or not
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+cache_inode_status_t
+cache_inode_write_iov(cache_entry_t *entry, uint64_t offset,
+		      const struct iovec *iov, int iovcnt, size_t io_size,
+		      size_t *bytes_moved, bool *sync)
+{
+	if (cache_param.write_gather_window != 0 && !*sync &&
+	    entry->type == REGULAR_FILE &&
+	    !(op_ctx->export->export_perms.options & EXPORT_OPTION_COMMIT))
+		return cache_inode_write_gather(entry, offset, iov, iovcnt,
+						io_size, bytes_moved, sync);
+
+	return cache_inode_rdwr_int(entry, CACHE_INODE_WRITE, offset, io_size,
+				    bytes_moved, NULL, iov, iovcnt, NULL, sync,
+				    NULL);
+}
+
 /** @} */
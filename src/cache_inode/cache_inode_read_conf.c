@@ -81,6 +81,19 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_UI32("Write_Gather_Window", 0, 100000, 0,
+		       cache_inode_parameter, write_gather_window),
+	CONF_ITEM_UI32("Read_Ahead_Window", 0, 16 * 1024 * 1024, 0,
+		       cache_inode_parameter, read_ahead_window),
+	CONF_ITEM_UI32("Negative_Cache_Timeout", 0, 3600, 0,
+		       cache_inode_parameter, neg_cache_timeout),
+	CONF_ITEM_UI32("Negative_Cache_Size", 0, 65536, 256,
+		       cache_inode_parameter, neg_cache_size),
+	CONF_ITEM_UI32("Dir_Bloom_Threshold", 0, UINT32_MAX, 10000,
+		       cache_inode_parameter, dir_bloom_threshold),
+	CONF_ITEM_UI32("Dir_Bloom_Max_Size", 4096, 64 * 1024 * 1024,
+		       1024 * 1024,
+		       cache_inode_parameter, dir_bloom_max_size),
 	CONFIG_EOL
 };
 
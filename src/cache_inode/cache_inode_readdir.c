@@ -46,6 +46,8 @@
 #include "cache_inode.h"
 #include "cache_inode_lru.h"
 #include "cache_inode_avl.h"
+#include "export_mgr.h"
+#include "city.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -140,6 +142,9 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 		     CACHE_INODE_DIRENT_OP_REMOVE ? "REMOVE" : "RENAME",
 		     directory, name, newname);
 
+	if (dirent_op == CACHE_INODE_DIRENT_OP_RENAME)
+		cache_inode_neg_remove(directory, newname);
+
 	/* If no active entry, do nothing */
 	if (directory->object.dir.nbactive == 0) {
 		if (!
@@ -282,6 +287,8 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 		return status;
 	}
 
+	cache_inode_neg_remove(parent, name);
+
 	/* in cache inode avl, we always insert on pentry_parent */
 	new_dir_entry = gsh_malloc(sizeof(cache_inode_dir_entry_t) + namesize);
 	if (new_dir_entry == NULL) {
@@ -347,6 +354,237 @@ cache_inode_remove_cached_dirent(cache_entry_t *directory,
 
 }
 
+/**
+ * @brief A name LOOKUP did not find in a directory
+ *
+ * Remembered for Negative_Cache_Timeout seconds, and only while the
+ * directory's change attribute stays what it was, so that a name
+ * created behind our back shows up once the directory's attributes
+ * are refreshed.  Names created through Ganesha are dropped as they
+ * are added to the directory.
+ */
+
+struct cache_inode_neg_dirent {
+	struct avltree_node node_k;	/*< In dir.neg.t */
+	struct glist_head lru;	/*< In dir.neg.lru */
+	uint64_t hk;		/*< Hash of the name */
+	uint64_t change;	/*< Change attribute of the directory */
+	time_t expires;
+	const char *name;	/*< Points at buf, or the name looked up */
+	char buf[];
+};
+
+static int neg_dirent_cmpf(const struct avltree_node *lhs,
+			   const struct avltree_node *rhs)
+{
+	struct cache_inode_neg_dirent *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct cache_inode_neg_dirent, node_k);
+	rk = avltree_container_of(rhs, struct cache_inode_neg_dirent, node_k);
+
+	if (lk->hk != rk->hk)
+		return lk->hk < rk->hk ? -1 : 1;
+	return strcmp(lk->name, rk->name);
+}
+
+/**
+ * @brief Set up the negative cache of a new directory entry
+ */
+
+void cache_inode_neg_init(cache_entry_t *parent)
+{
+	avltree_init(&parent->object.dir.neg.t, neg_dirent_cmpf, 0);
+	glist_init(&parent->object.dir.neg.lru);
+	parent->object.dir.neg.count = 0;
+}
+
+static struct cache_inode_neg_dirent *neg_find(cache_entry_t *parent,
+					       const char *name)
+{
+	struct cache_inode_neg_dirent key;
+	struct avltree_node *node;
+
+	key.name = name;
+	key.hk = CityHash64WithSeed(name, strlen(name), 67);
+
+	node = avltree_lookup(&key.node_k, &parent->object.dir.neg.t);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct cache_inode_neg_dirent,
+				    node_k);
+}
+
+static void neg_drop(cache_entry_t *parent,
+		     struct cache_inode_neg_dirent *neg)
+{
+	avltree_remove(&neg->node_k, &parent->object.dir.neg.t);
+	glist_del(&neg->lru);
+	parent->object.dir.neg.count--;
+	gsh_free(neg);
+}
+
+static inline uint64_t neg_dir_change(cache_entry_t *parent)
+{
+	/* Attributes are under the attr_lock, which may not be taken
+	 * inside the content_lock.  A stale value only delays the
+	 * flush to the next lookup.
+	 */
+	return atomic_fetch_uint64_t(&parent->obj_handle->attributes.change);
+}
+
+static inline struct export_negative_cache *neg_stats(void)
+{
+	if (op_ctx == NULL || op_ctx->export == NULL)
+		return NULL;
+	return &op_ctx->export->negcache;
+}
+
+/**
+ * @brief Check whether a name is remembered as not existing
+ *
+ * The caller must hold the content lock, for read at least.
+ *
+ * @param[in] parent The directory
+ * @param[in] name   The name looked up
+ *
+ * @return true if LOOKUP may answer ENOENT without asking the FSAL.
+ */
+
+bool cache_inode_neg_lookup(cache_entry_t *parent, const char *name)
+{
+	struct cache_inode_neg_dirent *neg;
+	struct export_negative_cache *stats;
+
+	if (parent->object.dir.neg.count == 0)
+		return false;
+
+	neg = neg_find(parent, name);
+	if (neg == NULL || neg->expires <= time(NULL) ||
+	    neg->change != neg_dir_change(parent))
+		return false;
+
+	stats = neg_stats();
+	if (stats != NULL)
+		atomic_inc_uint64_t(&stats->hits);
+	return true;
+}
+
+/**
+ * @brief Remember that a name does not exist
+ *
+ * Expired names and names from before the directory last changed
+ * are dropped first, then the oldest ones while the directory is
+ * over Negative_Cache_Size.  The caller must hold the content lock
+ * for write.
+ *
+ * @param[in,out] parent The directory
+ * @param[in]     name   The name LOOKUP did not find
+ */
+
+void cache_inode_neg_add(cache_entry_t *parent, const char *name)
+{
+	struct cache_inode_neg_dirent *neg;
+	struct glist_head *lru = &parent->object.dir.neg.lru;
+	struct export_negative_cache *stats = neg_stats();
+	size_t namesize = strlen(name) + 1;
+	uint64_t change = neg_dir_change(parent);
+	time_t now = time(NULL);
+	uint64_t flushed = 0;
+
+	if (cache_param.neg_cache_timeout == 0 ||
+	    cache_param.neg_cache_size == 0)
+		return;
+
+	/* Changes only grow, and names are in the order added, so once
+	 * the newest is stale all are.
+	 */
+	neg = glist_empty(lru) ? NULL :
+		glist_entry(lru->prev, struct cache_inode_neg_dirent, lru);
+	if (neg != NULL && neg->change != change) {
+		flushed = parent->object.dir.neg.count;
+		cache_inode_neg_release(parent);
+	}
+
+	while ((neg = glist_first_entry(lru, struct cache_inode_neg_dirent,
+					lru)) != NULL &&
+	       (neg->change != change || neg->expires <= now ||
+		parent->object.dir.neg.count >= cache_param.neg_cache_size)) {
+		if (neg->change != change)
+			flushed++;
+		neg_drop(parent, neg);
+	}
+
+	if (stats != NULL && flushed != 0)
+		(void) atomic_add_uint64_t(&stats->flushed, flushed);
+
+	neg = neg_find(parent, name);
+	if (neg != NULL) {
+		/* Remembered already, but expired, so renew it */
+		neg->change = change;
+		neg->expires = now + cache_param.neg_cache_timeout;
+		glist_del(&neg->lru);
+		glist_add_tail(lru, &neg->lru);
+		return;
+	}
+
+	neg = gsh_malloc(sizeof(*neg) + namesize);
+	if (neg == NULL)
+		return;
+
+	memcpy(neg->buf, name, namesize);
+	neg->name = neg->buf;
+	neg->hk = CityHash64WithSeed(name, namesize - 1, 67);
+	neg->change = change;
+	neg->expires = now + cache_param.neg_cache_timeout;
+
+	avltree_insert(&neg->node_k, &parent->object.dir.neg.t);
+	glist_add_tail(lru, &neg->lru);
+	parent->object.dir.neg.count++;
+
+	if (stats != NULL)
+		atomic_inc_uint64_t(&stats->added);
+}
+
+/**
+ * @brief Forget that a name does not exist
+ *
+ * The caller must hold the content lock for write.
+ *
+ * @param[in,out] parent The directory
+ * @param[in]     name   The name now in the directory
+ */
+
+void cache_inode_neg_remove(cache_entry_t *parent, const char *name)
+{
+	struct cache_inode_neg_dirent *neg;
+
+	if (parent->object.dir.neg.count == 0)
+		return;
+
+	neg = neg_find(parent, name);
+	if (neg != NULL)
+		neg_drop(parent, neg);
+}
+
+/**
+ * @brief Forget every name remembered as not existing
+ *
+ * The caller must hold the content lock for write.
+ *
+ * @param[in,out] parent The directory
+ */
+
+void cache_inode_neg_release(cache_entry_t *parent)
+{
+	struct cache_inode_neg_dirent *neg;
+
+	while ((neg = glist_first_entry(&parent->object.dir.neg.lru,
+					struct cache_inode_neg_dirent,
+					lru)) != NULL)
+		neg_drop(parent, neg);
+}
+
 /**
  * @brief State to be passed to FSAL readdir callbacks
  */
@@ -358,32 +596,26 @@ struct cache_inode_populate_cb_state {
 };
 
 /**
- * @brief Populate a single dir entry
- *
- * This callback serves to populate a single dir entry from the
- * readdir.
+ * @brief Cache a single dir entry once it has been looked up
  *
- * @param[in]     name      Name of the directory entry
- * @param[in,out] dir_state Callback state
- * @param[in]     cookie    Directory cookie
+ * @param[in,out] state        Callback state
+ * @param[in]     name         Name of the directory entry
+ * @param[in]     fsal_status  Result of looking it up
+ * @param[in]     entry_hdl    Its handle, consumed, if that succeeded
  *
  * @retval true if more entries are requested
- * @retval false if no more should be sent and the last was not processed
+ * @retval false if no more should be sent
  */
 
 static bool
-populate_dirent(const char *name, void *dir_state,
-		fsal_cookie_t cookie)
+populate_dirent_hdl(struct cache_inode_populate_cb_state *state,
+		    const char *name, fsal_status_t fsal_status,
+		    struct fsal_obj_handle *entry_hdl)
 {
-	struct cache_inode_populate_cb_state *state =
-	    (struct cache_inode_populate_cb_state *)dir_state;
-	struct fsal_obj_handle *entry_hdl;
 	cache_inode_dir_entry_t *new_dir_entry = NULL;
 	cache_entry_t *cache_entry = NULL;
-	fsal_status_t fsal_status = { 0, 0 };
 	struct fsal_obj_handle *dir_hdl = state->directory->obj_handle;
 
-	fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		*state->status = cache_inode_error_convert(fsal_status);
 		if (*state->status == CACHE_INODE_FSAL_XDEV) {
@@ -438,6 +670,74 @@ populate_dirent(const char *name, void *dir_state,
 	return true;
 }
 
+/**
+ * @brief Populate a single dir entry
+ *
+ * This callback serves to populate a single dir entry from the
+ * readdir.
+ *
+ * @param[in]     name      Name of the directory entry
+ * @param[in,out] dir_state Callback state
+ * @param[in]     cookie    Directory cookie
+ *
+ * @retval true if more entries are requested
+ * @retval false if no more should be sent and the last was not processed
+ */
+
+static bool
+populate_dirent(const char *name, void *dir_state,
+		fsal_cookie_t cookie)
+{
+	struct cache_inode_populate_cb_state *state =
+	    (struct cache_inode_populate_cb_state *)dir_state;
+	struct fsal_obj_handle *entry_hdl = NULL;
+	fsal_status_t fsal_status = { 0, 0 };
+	struct fsal_obj_handle *dir_hdl = state->directory->obj_handle;
+
+	fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
+	return populate_dirent_hdl(state, name, fsal_status, entry_hdl);
+}
+
+/**
+ * @brief Populate a batch of dir entries
+ *
+ * This callback receives entries already looked up by the FSAL's
+ * readdir_plus and creates cache entries for them in one pass.
+ *
+ * @param[in]     entries   Entries, with their handles
+ * @param[in]     count     Number of entries
+ * @param[in,out] dir_state Callback state
+ *
+ * @retval true if more entries are requested
+ * @retval false if no more should be sent
+ */
+
+static bool
+populate_dirents(struct fsal_readdir_entry *entries, unsigned int count,
+		 void *dir_state)
+{
+	struct cache_inode_populate_cb_state *state =
+	    (struct cache_inode_populate_cb_state *)dir_state;
+	unsigned int ix;
+
+	for (ix = 0; ix < count; ix++) {
+		if (!populate_dirent_hdl(state, entries[ix].name,
+					 entries[ix].status,
+					 entries[ix].hdl))
+			break;
+	}
+
+	if (ix == count)
+		return true;
+
+	/* We own the handles we did not get to */
+	for (ix++; ix < count; ix++) {
+		if (entries[ix].hdl != NULL)
+			entries[ix].hdl->ops->release(entries[ix].hdl);
+	}
+	return false;
+}
+
 /**
  *
  * @brief Cache complete directory contents
@@ -490,12 +790,22 @@ cache_inode_readdir_populate(cache_entry_t *directory)
 	state.status = &status;
 	state.offset_cookie = 0;
 
+	/* Prefer having the FSAL look entries up in batches as it reads
+	 * them, over a lookup for every name afterwards */
 	fsal_status =
-		directory->obj_handle->ops->readdir(directory->obj_handle,
-						    NULL,
-						    (void *)&state,
-						    populate_dirent,
-						    &eod);
+		directory->obj_handle->ops->readdir_plus(directory->obj_handle,
+							 NULL,
+							 (void *)&state,
+							 populate_dirents,
+							 &eod);
+	if (fsal_status.major == ERR_FSAL_NOTSUPP)
+		fsal_status =
+			directory->obj_handle->ops->readdir(
+						directory->obj_handle,
+						NULL,
+						(void *)&state,
+						populate_dirent,
+						&eod);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		if (fsal_status.major == ERR_FSAL_STALE) {
 			LogEvent(COMPONENT_NFS_READDIR,
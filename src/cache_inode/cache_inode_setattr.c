@@ -138,6 +138,10 @@ cache_inode_setattr(cache_entry_t *entry,
 
 	cache_inode_fixup_md(entry);
 
+	/* A truncated file's read-ahead data is stale */
+	if (content_locked)
+		cache_inode_readahead_invalidate(entry);
+
 	/* Copy the complete set of new attributes out. */
 
 	*attr = entry->obj_handle->attributes;
@@ -31,8 +31,13 @@
 #if HAVE_STRING_H
 #include <string.h>
 #endif
+#include <strings.h>
+#include <ctype.h>
 #include "abstract_mem.h"
 
+/* Blocks with fewer sub nodes than this are searched linearly */
+#define CONFIG_INDEX_MIN 8
+
 /**
  *  Displays the content of a list of blocks.
  */
@@ -84,6 +89,8 @@ static void free_node(struct config_node *node)
 			glist_del(&sub_node->node);
 			free_node(sub_node);
 		}
+		if (node->u.blk.index != NULL)
+			gsh_free(node->u.blk.index);
 	} else {
 		gsh_free(node->u.varvalue);
 	}
@@ -102,6 +109,8 @@ void free_parse_tree(struct config_root *tree)
 		glist_del(&node->node);
 		free_node(node);
 	}
+	if (tree->root.u.blk.index != NULL)
+		gsh_free(tree->root.u.blk.index);
 	if(tree->conf_dir != NULL)
 		gsh_free(tree->conf_dir);
 	file = tree->files;
@@ -114,3 +123,130 @@ void free_parse_tree(struct config_root *tree)
 	gsh_free(tree);
 	return;
 }
+
+/* FNV-1a of the name, folded to lower case like strcasecmp */
+static uint32_t name_hash(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	while (*name != '\0') {
+		h ^= (unsigned char)tolower((unsigned char)*name++);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void index_node(struct config_node *blk)
+{
+	struct config_node *node, **pp;
+	struct glist_head *ns;
+	size_t count = 0;
+	uint32_t size;
+
+	glist_for_each(ns, &blk->u.blk.sub_nodes) {
+		node = glist_entry(ns, struct config_node, node);
+		if (node->type == TYPE_BLOCK)
+			index_node(node);
+		count++;
+	}
+	if (count < CONFIG_INDEX_MIN)
+		return;
+
+	for (size = CONFIG_INDEX_MIN; size < count; size *= 2)
+		;
+	blk->u.blk.index = gsh_calloc(size, sizeof(struct config_node *));
+	if (blk->u.blk.index == NULL)
+		return;	/* first_sub_node falls back to the list */
+	blk->u.blk.index_mask = size - 1;
+
+	/* Walk backwards so each name's dup chain ends up in file order */
+	for (ns = blk->u.blk.sub_nodes.prev;
+	     ns != &blk->u.blk.sub_nodes;
+	     ns = ns->prev) {
+		node = glist_entry(ns, struct config_node, node);
+		pp = &blk->u.blk.index[name_hash(node->name) &
+				       blk->u.blk.index_mask];
+		while (*pp != NULL && strcasecmp((*pp)->name, node->name) != 0)
+			pp = &(*pp)->next_hash;
+		if (*pp != NULL) {
+			node->next_dup = *pp;
+			node->next_hash = (*pp)->next_hash;
+		} else {
+			node->next_dup = NULL;
+			node->next_hash = NULL;
+		}
+		*pp = node;
+	}
+}
+
+/**
+ * @brief Index the sub nodes of every block by name
+ *
+ * Loading a block looks up each of its parameters by name, and a
+ * configuration with thousands of EXPORT blocks is searched by
+ * export for each one, so blocks with more than a handful of sub
+ * nodes get a hash table of them.  The tree must not change after.
+ */
+
+void index_parse_tree(struct config_root *tree)
+{
+	index_node(&tree->root);
+}
+
+/**
+ * @brief Find the first sub node of a block with a given name
+ *
+ * @param blk  [IN] TYPE_BLOCK or TYPE_ROOT node
+ * @param name [IN] name of interest, compared ignoring case
+ *
+ * @return first matching node in file order or NULL
+ */
+
+struct config_node *first_sub_node(struct config_node *blk,
+				   const char *name)
+{
+	struct config_node *node;
+	struct glist_head *ns;
+
+	if (blk->u.blk.index != NULL) {
+		node = blk->u.blk.index[name_hash(name) &
+					blk->u.blk.index_mask];
+		while (node != NULL && strcasecmp(name, node->name) != 0)
+			node = node->next_hash;
+		return node;
+	}
+
+	glist_for_each(ns, &blk->u.blk.sub_nodes) {
+		node = glist_entry(ns, struct config_node, node);
+		if (strcasecmp(name, node->name) == 0)
+			return node;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Find the next sub node of a block with the same name
+ *
+ * @param blk  [IN] TYPE_BLOCK or TYPE_ROOT node
+ * @param node [IN] node returned by first_sub_node or next_sub_node
+ * @param name [IN] its name
+ *
+ * @return next matching node in file order or NULL
+ */
+
+struct config_node *next_sub_node(struct config_node *blk,
+				  struct config_node *node,
+				  const char *name)
+{
+	struct glist_head *ns;
+
+	if (blk->u.blk.index != NULL)
+		return node->next_dup;
+
+	glist_for_each_next(&node->node, ns, &blk->u.blk.sub_nodes) {
+		node = glist_entry(ns, struct config_node, node);
+		if (strcasecmp(name, node->name) == 0)
+			return node;
+	}
+	return NULL;
+}
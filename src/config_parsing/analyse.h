@@ -46,11 +46,18 @@ struct config_node {
 	int linenumber;
 	bool found;		/* use accounting private in do_block_load */
 	enum node_type type;	/* switches union contents */
+	struct config_node *next_hash;	/* next name in parent's bucket */
+	struct config_node *next_dup;	/* next sibling of this name */
 	union {			/* sub_nodes are always struct config_node */
 		char *varvalue;			/* TYPE_STMT */
 		struct {				/* TYPE_BLOCK */
 			struct config_node *parent;
 			struct glist_head sub_nodes;
+			/* first sub_node of each name, by hash of the
+			 * name, or NULL if there are too few to bother
+			 */
+			struct config_node **index;
+			uint32_t index_mask;
 		} blk;
 	}u;
 };
@@ -109,4 +116,18 @@ void print_parse_tree(FILE * output, struct config_root *tree);
  */
 void free_parse_tree(struct config_root *tree);
 
+/**
+ * Build the name indexes of every block in the parse tree
+ */
+void index_parse_tree(struct config_root *tree);
+
+/**
+ * Find the first and next sub node of a block with a given name
+ */
+struct config_node *first_sub_node(struct config_node *blk,
+				   const char *name);
+struct config_node *next_sub_node(struct config_node *blk,
+				  struct config_node *node,
+				  const char *name);
+
 #endif
@@ -0,0 +1,255 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Config parsing benchmark: writes a configuration with many EXPORT
+ * blocks, then times parsing it, loading every EXPORT block against
+ * a description shaped like the real one, and finding each block by
+ * Export_Id the way an export update does.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include "config_parsing.h"
+#include "abstract_mem.h"
+#include "log.h"
+
+struct bench_fsal {
+	char *name;
+};
+
+struct bench_export {
+	uint32_t export_id;
+	char *path;
+	char *pseudo;
+	char *tag;
+	uint32_t access_type;
+	uint32_t squash;
+	uint32_t anon_uid;
+	uint32_t maxread;
+	uint32_t maxwrite;
+	bool manage_gids;
+	bool disable_acl;
+	struct bench_fsal fsal;
+};
+
+static int loaded;
+
+static void *fsal_init(void *link_mem, void *self_struct)
+{
+	return self_struct == NULL ? link_mem : NULL;
+}
+
+static int fsal_commit(void *node, void *link_mem, void *self_struct,
+		       struct config_error_type *err_type)
+{
+	return 0;
+}
+
+static void *export_init(void *link_mem, void *self_struct)
+{
+	struct bench_export *exp = self_struct;
+
+	if (exp == NULL)
+		return gsh_calloc(1, sizeof(struct bench_export));
+
+	gsh_free(exp->path);
+	gsh_free(exp->pseudo);
+	gsh_free(exp->tag);
+	gsh_free(exp->fsal.name);
+	gsh_free(exp);
+	return NULL;
+}
+
+static int export_commit(void *node, void *link_mem, void *self_struct,
+			 struct config_error_type *err_type)
+{
+	loaded++;
+	(void) export_init(link_mem, self_struct);
+	return 0;
+}
+
+static struct config_item fsal_params[] = {
+	CONF_ITEM_STR("Name", 1, 32, NULL, bench_fsal, name),
+	CONFIG_EOL
+};
+
+static struct config_item export_params[] = {
+	CONF_ITEM_UI32("Export_Id", 0, UINT16_MAX, 1,
+		       bench_export, export_id),
+	CONF_ITEM_PATH("Path", 1, MAXPATHLEN, NULL,
+		       bench_export, path),
+	CONF_ITEM_PATH("Pseudo", 1, MAXPATHLEN, NULL,
+		       bench_export, pseudo),
+	CONF_ITEM_STR("Tag", 1, MAXPATHLEN, NULL,
+		      bench_export, tag),
+	CONF_ITEM_UI32("Access_Type", 0, 3, 0,
+		       bench_export, access_type),
+	CONF_ITEM_UI32("Squash", 0, 3, 0,
+		       bench_export, squash),
+	CONF_ITEM_UI32("Anonymous_uid", 0, UINT32_MAX, 65534,
+		       bench_export, anon_uid),
+	CONF_ITEM_UI32("MaxRead", 512, 64 * 1024 * 1024, 1024 * 1024,
+		       bench_export, maxread),
+	CONF_ITEM_UI32("MaxWrite", 512, 64 * 1024 * 1024, 1024 * 1024,
+		       bench_export, maxwrite),
+	CONF_ITEM_BOOL("Manage_Gids", false,
+		       bench_export, manage_gids),
+	CONF_ITEM_BOOL("Disable_ACL", false,
+		       bench_export, disable_acl),
+	CONF_RELAX_BLOCK("FSAL", fsal_params,
+			 fsal_init, fsal_commit,
+			 bench_export, fsal),
+	CONFIG_EOL
+};
+
+static struct config_block export_param = {
+	.blk_desc.name = "EXPORT",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = export_init,
+	.blk_desc.u.blk.params = export_params,
+	.blk_desc.u.blk.commit = export_commit
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int write_config(const char *path, int nexports)
+{
+	FILE *fp = fopen(path, "w");
+	int i;
+
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(fp, "NFS_CORE_PARAM {\n\tNb_Worker = 64;\n}\n\n");
+	for (i = 1; i <= nexports; i++)
+		fprintf(fp,
+			"EXPORT {\n"
+			"\tExport_Id = %d;\n"
+			"\tPath = /export/vol%d;\n"
+			"\tPseudo = /vol%d;\n"
+			"\tTag = vol%d;\n"
+			"\tAccess_Type = 1;\n"
+			"\tSquash = 0;\n"
+			"\tAnonymous_uid = 65534;\n"
+			"\tMaxRead = 1048576;\n"
+			"\tMaxWrite = 1048576;\n"
+			"\tManage_Gids = false;\n"
+			"\tDisable_ACL = true;\n"
+			"\tFSAL {\n\t\tName = VFS;\n\t}\n"
+			"}\n\n",
+			i, i, i, i);
+
+	return fclose(fp);
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/bench_parse.XXXXXX";
+	struct config_error_type err_type;
+	struct config_node_list *list, *next;
+	config_file_t config;
+	char expr[64];
+	int nexports = 10000, nfinds, i, fd, found;
+	double start, parse_ms, load_ms, find_ms;
+
+	SetNamePgm("bench_parse");
+	SetNameFunction("main");
+	init_logging(NULL, NIV_CRIT);
+
+	if (argc > 1)
+		nexports = atoi(argv[1]);
+	if (nexports < 1) {
+		fprintf(stderr, "Usage: %s [exports]\n", argv[0]);
+		return 1;
+	}
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+
+	if (write_config(path, nexports) != 0) {
+		unlink(path);
+		return 1;
+	}
+
+	start = now_ms();
+	config = config_ParseFile(path, &err_type);
+	parse_ms = now_ms() - start;
+	unlink(path);
+
+	if (config == NULL || !config_error_is_harmless(&err_type)) {
+		fprintf(stderr, "Parsing the generated config failed\n");
+		return 1;
+	}
+
+	start = now_ms();
+	found = load_config_from_parse(config, &export_param, NULL, false,
+				       &err_type);
+	load_ms = now_ms() - start;
+
+	if (found != nexports || loaded != nexports) {
+		fprintf(stderr, "Loaded %d of %d exports\n", loaded, nexports);
+		return 1;
+	}
+
+	/* Spread the finds over the ids, as many as needed to time */
+	nfinds = nexports < 1000 ? nexports : 1000;
+	start = now_ms();
+	for (i = 0; i < nfinds; i++) {
+		snprintf(expr, sizeof(expr), "EXPORT(Export_Id=%d)",
+			 1 + (int)((uint64_t)i * nexports / nfinds));
+		if (find_config_nodes(config, expr, &list) != 0) {
+			fprintf(stderr, "No block for %s\n", expr);
+			return 1;
+		}
+		for (; list != NULL; list = next) {
+			next = list->next;
+			gsh_free(list);
+		}
+	}
+	find_ms = now_ms() - start;
+
+	printf("%d exports: parse %.1f ms, load %.1f ms (%.2f us/export), find %.1f us/export\n",
+	       nexports, parse_ms, load_ms, load_ms * 1000.0 / nexports,
+	       find_ms * 1000.0 / nfinds);
+
+	config_Free(config);
+	return 0;
+}
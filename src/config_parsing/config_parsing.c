@@ -59,6 +59,8 @@ config_file_t config_ParseFile(char *file_path,
 	rc = ganesha_yyparse(&st);
 	root = st.root_node;
 	ganeshun_yy_cleanup_parser(&st);
+	if (rc == 0 && root != NULL)
+		index_parse_tree(root);
 	return (config_file_t)root;
 }
 
@@ -450,56 +452,43 @@ static int convert_inet_addr(struct config_node *node,
 }
 
 /**
- * @brief Lookup the first node in the list by this name
+ * @brief Lookup the first node in the block by this name
  *
- * @param list - head of the glist
+ * @param blk - block node whose sub_nodes to search
  * @param name - node name of interest
  *
  * @return first matching node or NULL
  */
 
-static struct config_node *lookup_node(struct glist_head *list,
+static struct config_node *lookup_node(struct config_node *blk,
 				       const char *name)
 {
-	struct config_node *node;
-	struct glist_head *ns;
-	
-	glist_for_each(ns, list) {
-		node = glist_entry(ns, struct config_node, node);
-		if (strcasecmp(name, node->name) == 0) {
-			node->found = true;
-			return node;
-		}
-	}
-	return NULL;
+	struct config_node *node = first_sub_node(blk, name);
+
+	if (node != NULL)
+		node->found = true;
+	return node;
 }
 
 /**
- * @brief Lookup the next node in list
+ * @brief Lookup the next node in the block
  *
- * @param list - head of the glist
+ * @param blk - block node whose sub_nodes to search
  * @param start - continue the lookup from here
  * @param name - node name of interest
  *
- * @return first matching node or NULL
+ * @return next matching node or NULL
  */
 
-
-static struct config_node *lookup_next_node(struct glist_head *list,
-				     struct glist_head *start,
-				     const char *name)
+static struct config_node *lookup_next_node(struct config_node *blk,
+					    struct config_node *start,
+					    const char *name)
 {
-	struct config_node *node;
-	struct glist_head *ns;
+	struct config_node *node = next_sub_node(blk, start, name);
 
-	glist_for_each_next(start, ns, list) {
-		node = glist_entry(ns, struct config_node, node);
-		if (strcasecmp(name, node->name) == 0) {
-			node->found = true;
-			return node;
-		}
-	}
-	return NULL;
+	if (node != NULL)
+		node->found = true;
+	return node;
 }
 
 static const char *config_type_str(enum config_type type)
@@ -758,10 +747,9 @@ static int do_block_load(struct config_node *blk,
 		uint32_t flags;
 		bool bval;
 
-		node = lookup_node(&blk->u.blk.sub_nodes, item->name);
+		node = lookup_node(blk, item->name);
 		while (node != NULL) {
-			next_node = lookup_next_node(&blk->u.blk.sub_nodes,
-						     &node->node, item->name);
+			next_node = lookup_next_node(blk, node, item->name);
 			if (next_node != NULL &&
 			    (item->flags & CONFIG_UNIQUE)) {
 				LogMajor(COMPONENT_CONFIG,
@@ -1216,6 +1204,71 @@ err_out:
 	return errors;
 }
 
+/**
+ * @brief Append the text of a block's contents to a buffer
+ *
+ * With a NULL buffer just counts.
+ *
+ * @return Length of the text.
+ */
+
+static size_t block_text(struct config_node *blk, char *buf)
+{
+	struct config_node *node;
+	struct glist_head *ns;
+	size_t len = 0;
+
+	glist_for_each(ns, &blk->u.blk.sub_nodes) {
+		node = glist_entry(ns, struct config_node, node);
+		if (node->type == TYPE_BLOCK) {
+			if (buf != NULL)
+				sprintf(buf + len, "%s{", node->name);
+			len += strlen(node->name) + 1;
+			len += block_text(node, buf ? buf + len : NULL);
+			if (buf != NULL)
+				buf[len] = '}';
+			len++;
+		} else {
+			if (buf != NULL)
+				sprintf(buf + len, "%s=%s;", node->name,
+					node->u.varvalue);
+			len += strlen(node->name) + strlen(node->u.varvalue)
+				+ 2;
+		}
+	}
+	return len;
+}
+
+/**
+ * @brief Flatten the contents of a block into a string.
+ *
+ * Parameters and sub-blocks appear in the order they were parsed,
+ * without file names or line numbers, so that two blocks give the
+ * same string exactly when they say the same thing in the same way.
+ *
+ * @param node [IN] pointer to a TYPE_BLOCK node.
+ *
+ * @return the string, to be freed with gsh_free, or NULL if out of
+ *         memory.
+ */
+
+char *config_block_text(void *node)
+{
+	struct config_node *blk = node;
+	size_t len;
+	char *text;
+
+	assert(blk->type == TYPE_BLOCK);
+	len = block_text(blk, NULL);
+	text = gsh_malloc(len + 1);
+	if (text == NULL)
+		return NULL;
+	text[0] = '\0';
+	(void) block_text(blk, text);
+	text[len] = '\0';
+	return text;
+}
+
 /**
  * @brief Find the root of the parse tree given a node.
  *
@@ -1511,17 +1564,16 @@ static char *parse_expr(char *expr, struct expr_parse **expr_node)
 static bool match_block(struct config_node *blk,
 			struct expr_parse *expr)
 {
-	struct glist_head *ns;
 	struct config_node *sub_node;
 	struct expr_parse_arg *arg;
 	bool found = false;
 
 	assert(blk->type == TYPE_BLOCK);
 	for (arg = expr->arg; arg != NULL; arg = arg->next) {
-		glist_for_each(ns, &blk->u.blk.sub_nodes) {
-			sub_node = glist_entry(ns, struct config_node, node);
-			if (sub_node->type == TYPE_STMT &&
-			    strcasecmp(arg->name, sub_node->name) == 0) {
+		for (sub_node = first_sub_node(blk, arg->name);
+		     sub_node != NULL;
+		     sub_node = next_sub_node(blk, sub_node, arg->name)) {
+			if (sub_node->type == TYPE_STMT) {
 				found = true;
 				if (expr->next == NULL &&
 				    strcasecmp(arg->value, "*") == 0)
@@ -1563,7 +1615,6 @@ int find_config_nodes(config_file_t config, char *expr_str,
 		     struct config_node_list **node_list)
 {
 	struct config_root *tree = (struct config_root *)config;
-	struct glist_head *ns;
 	struct config_node *sub_node;
 	struct config_node *top;
 	struct expr_parse *expr, *expr_head;
@@ -1585,10 +1636,10 @@ int find_config_nodes(config_file_t config, char *expr_str,
 	expr = expr_head;
 	*node_list = NULL;
 again:
-	glist_for_each(ns, &top->u.blk.sub_nodes) {
-		sub_node = glist_entry(ns, struct config_node, node);
-		if (strcasecmp(expr->name, sub_node->name) == 0 &&
-		    sub_node->type == TYPE_BLOCK &&
+	for (sub_node = first_sub_node(top, expr->name);
+	     sub_node != NULL;
+	     sub_node = next_sub_node(top, sub_node, expr->name)) {
+		if (sub_node->type == TYPE_BLOCK &&
 		    match_block(sub_node, expr)) {
 			if (expr->next != NULL) {
 				top = sub_node;
@@ -1701,8 +1752,7 @@ int load_config_from_parse(config_file_t config,
 			   struct config_error_type *err_type)
 {
 	struct config_root *tree = (struct config_root *)config;
-	struct config_node *node = NULL;
-	struct glist_head *ns;
+	struct config_node *node = NULL, *last = NULL;
 	char *blkname = conf_blk->blk_desc.name;
 	int found = 0;
 	int rc, cum_errs = 0;
@@ -1726,10 +1776,11 @@ int load_config_from_parse(config_file_t config,
 			return -1;
 		}
 	}
-	glist_for_each(ns, &tree->root.u.blk.sub_nodes) {
-		node = glist_entry(ns, struct config_node, node);
-		if (node->type == TYPE_BLOCK &&
-		    strcasecmp(blkname, node->name) == 0) {
+	for (node = first_sub_node(&tree->root, blkname);
+	     node != NULL;
+	     node = next_sub_node(&tree->root, node, blkname)) {
+		last = node;
+		if (node->type == TYPE_BLOCK) {
 			if (found > 0 &&
 			    (conf_blk->blk_desc.flags & CONFIG_UNIQUE)) {
 				LogWarn(COMPONENT_CONFIG,
@@ -1777,9 +1828,9 @@ int load_config_from_parse(config_file_t config,
 		int lineno;
 		char *errstr = err_type_str(err_type);;
 
-		if (node != NULL) {
-			file = node->filename;
-			lineno = node->linenumber;
+		if (last != NULL) {
+			file = last->filename;
+			lineno = last->linenumber;
 		} else {
 			file = "<unknown file>";
 			lineno = 0;
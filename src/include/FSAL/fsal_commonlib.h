@@ -72,6 +72,27 @@ void fsal_ds_handle_init(struct fsal_ds_handle *, struct fsal_ds_ops *,
 			 struct fsal_module *);
 void fsal_ds_handle_uninit(struct fsal_ds_handle *ds);
 
+/*
+ * readdir_plus batching helpers
+ */
+
+struct fsal_readdir_batch {
+	fsal_readdir_plus_cb cb;	/*< Callback to flush to */
+	void *dir_state;		/*< Its opaque state */
+	unsigned int count;		/*< Entries pending */
+	struct fsal_readdir_entry entries[FSAL_READDIR_BATCH];
+	char names[FSAL_READDIR_BATCH][MAXNAMLEN + 1];
+};
+
+struct fsal_readdir_batch *fsal_readdir_batch_alloc(fsal_readdir_plus_cb cb,
+						    void *dir_state);
+bool fsal_readdir_batch_add(struct fsal_readdir_batch *batch,
+			    const char *name, fsal_cookie_t cookie,
+			    fsal_status_t status,
+			    struct fsal_obj_handle *hdl);
+bool fsal_readdir_batch_flush(struct fsal_readdir_batch *batch);
+void fsal_readdir_batch_free(struct fsal_readdir_batch *batch);
+
 int open_dir_by_path_walk(int first_fd, const char *path, struct stat *stat);
 
 struct avltree avl_fsid;
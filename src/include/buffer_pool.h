@@ -0,0 +1,121 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup buffer_pool Size-classed I/O buffer pools
+ *
+ * READ replies, READDIR entries and fattr4 encoding all need large
+ * scratch buffers that live exactly as long as one request.  Rather
+ * than hit the allocator for each of them, buffers are drawn from a
+ * set of power-of-two size classes, each backed by a @c pool_t using
+ * the cached substrate below, with a small per-thread cache in front
+ * so the common case takes no lock at all.
+ *
+ * Buffers handed out by gsh_buf_alloc are ordinary heap blocks: it
+ * is always safe to release one with gsh_free, it simply will not be
+ * recycled.  Conversely gsh_buf_free accepts any heap block and only
+ * caches it if it is large enough (and aligned enough) to satisfy a
+ * size class.
+ *
+ * @{
+ */
+
+/**
+ * @file buffer_pool.h
+ * @brief Size-classed, per-thread cached buffer pools
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#ifdef USE_DBUS
+#include "ganesha_dbus.h"
+#endif
+
+/** Smallest size class (fits an NFS4_ATTRVALS_BUFFLEN buffer) */
+#define GSH_BUF_MIN_SHIFT 10
+/** Largest size class (1MiB, the usual MaxRead/MaxWrite) */
+#define GSH_BUF_MAX_SHIFT 20
+#define GSH_BUF_NCLASSES (GSH_BUF_MAX_SHIFT - GSH_BUF_MIN_SHIFT + 1)
+
+/** Classes at or above this size are page aligned, for O_DIRECT */
+#define GSH_BUF_ALIGN 4096
+
+/** Per-thread cached buffers for small and large classes */
+#define GSH_BUF_TCACHE_SMALL 8
+#define GSH_BUF_TCACHE_LARGE 2
+/** Seconds between releases of buffers left idle in the shared lists */
+#define GSH_BUF_TRIM_INTERVAL 30
+
+/**
+ * @brief Per size class statistics
+ */
+
+struct gsh_buf_stats {
+	uint64_t hits;		/*< Allocations satisfied from a cache */
+	uint64_t misses;	/*< Allocations that went to the allocator */
+	uint64_t returns;	/*< Buffers recycled into a cache */
+	uint64_t releases;	/*< Buffers handed back to the allocator */
+};
+
+void gsh_buf_pkginit(void);
+void *gsh_buf_alloc(size_t size);
+void gsh_buf_free(void *buf);
+void gsh_buf_stats(unsigned int class, size_t *size,
+		   struct gsh_buf_stats *stats);
+
+/**
+ * @brief Get a zeroed buffer for an array of @c n objects
+ *
+ * @param[in] n Number of objects
+ * @param[in] s Size of each object
+ *
+ * @return the buffer, or NULL on failure.
+ */
+
+static inline void *gsh_buf_calloc(size_t n, size_t s)
+{
+	void *buf = gsh_buf_alloc(n * s);
+
+	if (buf != NULL)
+		memset(buf, 0, n * s);
+	return buf;
+}
+
+#ifdef USE_DBUS
+
+#define BUFFER_POOL_REPLY	\
+{				\
+	.name = "pools",	\
+	.type = "a(ttttt)",	\
+	.direction = "out"	\
+}
+
+void gsh_buf_dbus_show(DBusMessageIter *iter);
+#endif				/* USE_DBUS */
+
+#endif				/* BUFFER_POOL_H */
+
+/** @} */
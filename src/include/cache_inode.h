@@ -53,6 +53,7 @@
 #include "nfs4.h"
 #include "nlm4.h"
 #include "ganesha_list.h"
+#include "interval_tree.h"
 #include "nfs4_acls.h"
 
 
@@ -121,6 +122,29 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Microseconds an UNSTABLE write waits for other writes to
+	    the same file to merge with while some are in progress.
+	    Defaults to 0, which disables gathering, settable with
+	    Write_Gather_Window */
+	uint32_t write_gather_window;
+	/** Bytes read ahead of a client reading a file sequentially.
+	    Defaults to 0, which disables read-ahead, settable with
+	    Read_Ahead_Window */
+	uint32_t read_ahead_window;
+	/** Seconds a name a LOOKUP did not find is remembered as not
+	    existing.  Defaults to 0, which disables the negative
+	    cache, settable with Negative_Cache_Timeout */
+	uint32_t neg_cache_timeout;
+	/** Names remembered as not existing per directory, oldest
+	    dropped first.  Settable with Negative_Cache_Size */
+	uint32_t neg_cache_size;
+	/** Cached names a directory must hold before a Bloom filter
+	    is kept over them.  0 disables the filter, settable with
+	    Dir_Bloom_Threshold */
+	uint32_t dir_bloom_threshold;
+	/** Bytes a directory's Bloom filter may grow to, settable
+	    with Dir_Bloom_Max_Size */
+	uint32_t dir_bloom_max_size;
 };
 
 /** @} */
@@ -183,6 +207,9 @@ struct cache_stats {
 	uint64_t inode_conf;
 	uint64_t inode_added;
 	uint64_t inode_mapping;
+	uint64_t wgather_batches;	/*< Gathered writes sent to the FSAL */
+	uint64_t wgather_writes;	/*< Writes that went into them */
+	uint64_t wgather_wait;		/*< Nanoseconds leaders waited */
 };
 
 extern struct cache_stats *cache_stp;
@@ -484,6 +511,17 @@ struct cache_entry_t {
 		struct cache_inode_file {
 			/** Pointers for lock list */
 			struct glist_head lock_list;
+			/** The same locks indexed by range */
+			struct itree lock_tree;
+			/** Export all of lock_list was taken through, NULL
+			    once locks from several exports were added */
+			struct gsh_export *lock_export;
+			/** Next sle_seq for lock_list */
+			uint64_t lock_seq;
+			/** Blocked locks we tried to grant */
+			uint64_t grant_attempts;
+			/** Of those, the ones the FSAL still refused */
+			uint64_t grant_futile;
 			/** Pointers for delegation list */
 			struct glist_head deleg_list;
 			/** Pointers for NLM share list */
@@ -493,6 +531,14 @@ struct cache_entry_t {
 			bool write_delegated; /* true iff write delegated */
 			/** Delegation statistics */
 			struct file_deleg_stats fdeleg_stats;
+			/** Batch of UNSTABLE writes still open for others
+			    to join, see cache_inode_rdwr.c */
+			struct cache_inode_wgather *wgather;
+			/** Writes in progress, under the same lock */
+			uint32_t writers;
+			/** Sequential read detection and read-ahead
+			    buffers, see cache_inode_rdwr.c */
+			struct cache_inode_readahead *ra;
 		} file;		/*< REGULAR_FILE data */
 
 		struct {
@@ -507,7 +553,27 @@ struct cache_entry_t {
 				struct avltree c;
 				/** Heuristic. Expect 0. */
 				uint32_t collisions;
+				/** Bloom filter over the names in t, see
+				    cache_inode_avl.c */
+				struct {
+					/** NULL while t is small */
+					uint64_t *bits;
+					/** 512 bit blocks in bits */
+					uint32_t blocks;
+					/** Names added since built */
+					uint32_t names;
+				} bloom;
 			} avl;
+			/** Names LOOKUP did not find, see
+			    cache_inode_readdir.c.  Protected by the
+			    content_lock. */
+			struct {
+				/** By hash and name */
+				struct avltree t;
+				/** Oldest first */
+				struct glist_head lru;
+				uint32_t count;
+			} neg;
 			/** If this is a junction, the export this node points
 			    to. Protected by the attr_lock. */
 			struct gsh_export *junction_export;
@@ -847,6 +913,16 @@ cache_inode_status_t cache_inode_rdwr_plus(cache_entry_t *entry,
 				      bool *eof,
 				      bool *sync, struct io_info *info);
 
+cache_inode_status_t cache_inode_write_iov(cache_entry_t *entry,
+					   uint64_t offset,
+					   const struct iovec *iov, int iovcnt,
+					   size_t io_size, size_t *bytes_moved,
+					   bool *sync);
+void cache_inode_wgather_pkginit(void);
+void cache_inode_readahead_pkginit(void);
+void cache_inode_readahead_invalidate(cache_entry_t *entry);
+void cache_inode_readahead_free(cache_entry_t *entry);
+
 cache_inode_status_t cache_inode_commit(cache_entry_t *entry, uint64_t offset,
 					size_t count);
 
@@ -875,6 +951,12 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(
 void cache_inode_release_dirents(cache_entry_t *entry,
 				 cache_inode_avl_which_t which);
 
+void cache_inode_neg_init(cache_entry_t *parent);
+bool cache_inode_neg_lookup(cache_entry_t *parent, const char *name);
+void cache_inode_neg_add(cache_entry_t *parent, const char *name);
+void cache_inode_neg_remove(cache_entry_t *parent, const char *name);
+void cache_inode_neg_release(cache_entry_t *parent);
+
 void cache_inode_kill_entry(cache_entry_t *entry);
 
 cache_inode_status_t cache_inode_invalidate(cache_entry_t *entry,
@@ -77,6 +77,7 @@ void avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v);
 void avl_dirent_clear_deleted(cache_entry_t *entry,
 			      cache_inode_dir_entry_t *v);
 void cache_inode_avl_init(cache_entry_t *entry);
+void cache_inode_avl_bloom_release(cache_entry_t *entry);
 int cache_inode_avl_qp_insert(cache_entry_t *entry,
 			      cache_inode_dir_entry_t *v);
 
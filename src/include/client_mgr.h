@@ -55,6 +55,7 @@ void dbus_client_init(void);
 #endif
 struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only);
 void put_gsh_client(struct gsh_client *client);
+void inc_gsh_client_refcount(struct gsh_client *client);
 int foreach_gsh_client(bool(*cb) (struct gsh_client *cl, void *state),
 		       void *state);
 
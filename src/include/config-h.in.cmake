@@ -27,6 +27,7 @@
 #cmakedefine _USE_9P 1
 #cmakedefine _USE_9P_RDMA 1
 #cmakedefine USE_FSAL_SHOOK 1
+#cmakedefine USE_IO_URING 1
 #cmakedefine DEBUG_SAL 1
 #cmakedefine USE_NODELIST 1
 #cmakedefine _NO_MOUNT_LIST 1
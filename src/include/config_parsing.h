@@ -855,6 +855,9 @@ void config_Free(config_file_t config);
 /* Find the root of the parse tree given a TYPE_BLOCK node */
 config_file_t get_parse_root(void *node);
 
+/* Flatten the contents of a TYPE_BLOCK node, for comparing blocks */
+char *config_block_text(void *node);
+
 struct config_node_list {
 	void *tree_node;
 	struct config_node_list *next;
@@ -49,6 +49,62 @@ typedef enum export_state {
 	EXPORT_RELEASE		/*< No references, ready for reaping */
 } export_state_t;
 
+/**
+ * @brief A token bucket, refilled at its rate up to a second's worth
+ */
+
+struct token_bucket {
+	uint64_t rate;		/*< Tokens per second, 0 for no limit */
+	int64_t credit;		/*< Millionths of a token available */
+	uint64_t stamp;		/*< Time of the last refill, in usec */
+};
+
+/**
+ * @brief Rate limits on an export
+ *
+ * An operation may start while its buckets hold any credit at all,
+ * and then takes its full due, so a request larger than a second's
+ * worth of bandwidth still goes through, and pays for it after.
+ */
+
+/** Largest operation rate limit, per second */
+#define EXPORT_QOS_MAX_OPS UINT32_MAX
+/** Largest bandwidth limit, bytes per second */
+#define EXPORT_QOS_MAX_BANDWIDTH (1ULL << 40)
+
+struct export_qos {
+	pthread_spinlock_t sp;	/*< Protects the buckets */
+	struct token_bucket read_ops;	/*< Requests that read */
+	struct token_bucket write_ops;	/*< Requests that write */
+	struct token_bucket read_bytes;	/*< Bytes read */
+	struct token_bucket write_bytes;	/*< Bytes written */
+};
+
+/**
+ * @brief Read-ahead counters of an export
+ *
+ * Updated atomically, see cache_inode_rdwr.c.
+ */
+
+struct export_readahead {
+	uint64_t hits;		/*< READs served from read-ahead buffers */
+	uint64_t misses;	/*< Sequential READs that had to go to the FSAL */
+	uint64_t advised;	/*< Windows the FSAL took an io_advise hint for */
+	uint64_t prefetched;	/*< Bytes read ahead into memory */
+};
+
+/**
+ * @brief Negative lookup cache counters of an export
+ *
+ * Updated atomically, see cache_inode_readdir.c.
+ */
+
+struct export_negative_cache {
+	uint64_t hits;		/*< LOOKUPs answered ENOENT from the cache */
+	uint64_t added;		/*< ENOENT results remembered */
+	uint64_t flushed;	/*< Names dropped because a directory changed */
+};
+
 /**
  * @brief Represents an export.
  *
@@ -67,6 +123,10 @@ struct gsh_export {
 	struct glist_head exp_lock_list;
 	/** List of NLM shares belonging to this export */
 	struct glist_head exp_nlm_share_list;
+	/** Exports with the same fullpath, in the path index */
+	struct glist_head exp_path_link;
+	/** Exports with the same pseudopath, in the pseudo path index */
+	struct glist_head exp_pseudo_link;
 	/** List of exports rooted on the same inode */
 	struct glist_head exp_root_list;
 	/** List of exports to be mounted or cleaned up */
@@ -77,7 +137,10 @@ struct gsh_export {
 	struct glist_head mounted_exports_node;
 	/** Entry for the root of this export, protected by lock */
 	cache_entry_t *exp_root_cache_inode;
-	/** Allowed clients */
+	/** Whether the root is still to be looked up on first use,
+	    see init_export_root_lazy */
+	uint32_t exp_root_pending;
+	/** Allowed clients.  Protected by clients_lock */
 	struct glist_head clients;
 	/** Entry for the junction of this export.  Protected by lock */
 	cache_entry_t *exp_junction_inode;
@@ -85,6 +148,9 @@ struct gsh_export {
 	struct gsh_export *exp_parent_exp;
 	/** Pointer to the fsal_export associated with this export */
 	struct fsal_export *fsal_export;
+	/** The FSAL sub-block it was created from, flattened by
+	    config_block_text, so that a reload can tell it changed */
+	char *fsal_config;
 	/** Exported path */
 	char *fullpath;
 	/** PseudoFS path for export */
@@ -107,12 +173,27 @@ struct gsh_export {
 	uint64_t MaxOffsetWrite;
 	/** Maximum Offset allowed for read */
 	uint64_t MaxOffsetRead;
+	/** Share of request service given to each client of this
+	    export, relative to other exports.  Settable with
+	    Sched_Weight. */
+	uint32_t sched_weight;
+	/** Rate limits.  Settable with Max_Read_Ops, Max_Write_Ops,
+	    Max_Read_Bandwidth and Max_Write_Bandwidth, and over DBus. */
+	struct export_qos qos;
+	/** Sequential read-ahead statistics */
+	struct export_readahead readahead;
+	/** Negative lookup cache statistics */
+	struct export_negative_cache negcache;
 	/** Filesystem ID for overriding fsid from FSAL*/
 	fsal_fsid_t filesystem_id;
 	/** References to this export */
 	int64_t refcnt;
 	/** Read/Write lock protecting export */
 	pthread_rwlock_t lock;
+	/** Read/Write lock protecting clients and export_perms.  Kept
+	    apart from lock since matching a client may wait on DNS or
+	    netgroup lookups. */
+	pthread_rwlock_t clients_lock;
 	/** available mount options */
 	struct export_perms export_perms;
 	/** The last time the export stats were updated */
@@ -130,6 +211,11 @@ struct gsh_export {
 	uint16_t export_id;
 };
 
+bool export_qos_admit(struct export_qos *qos, uint32_t io,
+		      uint64_t rbytes, uint64_t wbytes, uint64_t *ready);
+void export_qos_set(struct export_qos *qos, uint64_t read_ops,
+		    uint64_t write_ops, uint64_t read_bw, uint64_t write_bw);
+
 void export_pkginit(void);
 #ifdef USE_DBUS
 void dbus_export_init(void);
@@ -0,0 +1,150 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup fair_queue Deficit round robin queue
+ *
+ * Items are queued on flows, each identified by a client and an
+ * export, and flows with work are served in turn.  Each turn adds
+ * FQ_QUANTUM times the flow's weight to its deficit, and the flow is
+ * served for as long as its deficit covers the cost of its next item,
+ * so that over time each busy flow receives a share of service
+ * proportional to its weight, whatever the size of its requests.
+ *
+ * A flow may also carry an owner, which the queue's admit callback
+ * is asked about before each item is served; an item it refuses stays
+ * queued and its flow loses its turn without being credited, so that
+ * rate limits are enforced without holding up other flows.  Items
+ * so held back are marked, so that callers can tell time spent
+ * waiting to be admitted from time spent waiting to be served.
+ *
+ * A flow exists only while it has queued items.  The queue does no
+ * locking of its own.
+ *
+ * @{
+ */
+
+/**
+ * @file fair_queue.h
+ * @brief Deficit round robin queue
+ */
+
+#ifndef FAIR_QUEUE_H
+#define FAIR_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ganesha_list.h"
+
+/** Buckets in the flow hash, a power of two */
+#define FQ_HASH_SIZE 64
+
+/** Cost units credited per unit of weight on each turn */
+#define FQ_QUANTUM 16
+
+/** Bytes of data per cost unit, beyond the one every request costs */
+#define FQ_COST_BYTES 4096
+
+/** The item reads data */
+#define FQ_IO_READ 0x01
+/** The item writes data */
+#define FQ_IO_WRITE 0x02
+
+/**
+ * @brief An item on a fair queue, embedded in the queued object
+ */
+
+struct fq_item {
+	struct glist_head q;	/*< On its flow's queue */
+	uint32_t cost;		/*< Cost of serving the item */
+	uint32_t io;		/*< FQ_IO_READ and/or FQ_IO_WRITE */
+	uint32_t rbytes;	/*< Bytes read */
+	uint32_t wbytes;	/*< Bytes written */
+	const void *client;	/*< Flow key, for callers that queue
+				    the item later */
+	int32_t export_id;	/*< Flow key */
+	bool held;		/*< The admit callback refused it at
+				    least once */
+};
+
+/**
+ * @brief Decide whether an item may be served now
+ *
+ * Called with the queue locked.
+ *
+ * @param[in] owner Owner of the item's flow
+ * @param[in] item  Item at the head of the flow
+ *
+ * @return true to serve it, false to skip the flow this turn.
+ */
+
+typedef bool (*fq_admit_t)(void *owner, struct fq_item *item);
+
+/**
+ * @brief A flow of items from one client to one export
+ */
+
+struct fq_flow {
+	struct glist_head active;	/*< On the queue's round */
+	struct glist_head hash;	/*< On its hash chain */
+	const void *client;	/*< Client, NULL if unknown */
+	int32_t export_id;	/*< Export, -1 if unknown */
+	uint32_t weight;	/*< Share of service relative to others */
+	int64_t deficit;	/*< Cost the flow may still consume */
+	void *owner;		/*< Passed to the admit callback */
+	struct glist_head q;	/*< Queued items, oldest first */
+};
+
+struct fair_queue {
+	struct glist_head active;	/*< Flows with items, in turn */
+	struct glist_head hash[FQ_HASH_SIZE];	/*< Flows by key */
+	uint32_t size;		/*< Items queued */
+	uint32_t nflows;	/*< Flows with items */
+	uint32_t held;		/*< Items queued when every flow was
+				    last refused, 0 once one is served */
+	fq_admit_t admit;	/*< Admission check, NULL for none */
+};
+
+/**
+ * @brief Cost of an item carrying some data
+ *
+ * @param[in] bytes Data read or written
+ *
+ * @return Cost units.
+ */
+
+static inline uint32_t fq_cost(uint64_t bytes)
+{
+	return 1 + bytes / FQ_COST_BYTES;
+}
+
+void fq_init(struct fair_queue *fq, fq_admit_t admit);
+bool fq_enqueue(struct fair_queue *fq, struct fq_item *item,
+		const void *client, int32_t export_id);
+struct fq_flow *fq_flow_alloc(const void *client, int32_t export_id,
+			      uint32_t weight, void *owner);
+bool fq_enqueue_flow(struct fair_queue *fq, struct fq_item *item,
+		     struct fq_flow *flow);
+struct fq_item *fq_dequeue(struct fair_queue *fq, void **owner);
+
+#endif				/* FAIR_QUEUE_H */
+
+/** @} */
@@ -202,6 +202,8 @@ struct fridgethr {
 	uint32_t nthreads;	/*< Number of threads in fridge */
 	struct glist_head idle_q;	/*< Idle threads */
 	uint32_t nidle;		/*< Number of idle threads */
+	uint32_t retiring;	/*< Threads asked to exit by
+				    fridgethr_shrink */
 	uint32_t flags;		/*< Fridge-wide flags */
 	fridgethr_comm_t command;	/*< Command state */
 	void (*cb_func) (void *);	/*< Callback on command completion */
@@ -246,6 +248,9 @@ int fridgethr_sync_command(struct fridgethr *, fridgethr_comm_t, time_t);
 bool fridgethr_you_should_break(struct fridgethr_context *);
 int fridgethr_populate(struct fridgethr *, void (*)(struct fridgethr_context *),
 		      void *);
+int fridgethr_grow(struct fridgethr *, uint32_t,
+		   void (*)(struct fridgethr_context *), void *);
+uint32_t fridgethr_shrink(struct fridgethr *, uint32_t);
 
 void fridgethr_setwait(struct fridgethr_context *ctx, time_t thread_delay);
 time_t fridgethr_getwait(struct fridgethr_context *ctx);
@@ -43,6 +43,7 @@
 #include "fsal_pnfs.h"
 #include "avltree.h"
 #include "abstract_atomic.h"
+#include <sys/uio.h>
 
 /**
  * @page newapi New FSAL API
@@ -309,7 +310,7 @@
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 2
 
 /* Forward references for object methods */
 
@@ -1209,6 +1210,44 @@ typedef uint64_t fsal_cookie_t;
 
 typedef bool(*fsal_readdir_cb) (const char *name, void *dir_state,
 				fsal_cookie_t cookie);
+
+/**
+ * @brief One entry of a readdir_plus batch
+ *
+ * If @c status is an error, @c hdl is NULL and the entry could not
+ * be looked up; otherwise @c hdl is the entry's handle, with its
+ * attributes filled in, as lookup would have returned it.
+ */
+
+struct fsal_readdir_entry {
+	const char *name;		/*< Name of the entry */
+	fsal_cookie_t cookie;		/*< Cookie to resume after it */
+	fsal_status_t status;		/*< Result of looking it up */
+	struct fsal_obj_handle *hdl;	/*< Its handle, or NULL */
+};
+
+/**
+ * @brief Most entries passed to a readdir_plus callback at once
+ */
+
+#define FSAL_READDIR_BATCH 64
+
+/**
+ * @brief Callback receiving a batch of readdir_plus entries
+ *
+ * The callback takes over every handle in the batch, whether or not
+ * it consumes the entry.
+ *
+ * @param[in] entries   Entries, in directory order
+ * @param[in] count     Number of entries
+ * @param[in] dir_state Opaque pointer passed to readdir_plus
+ *
+ * @retval true if more entries are wanted.
+ * @retval false to stop reading.
+ */
+
+typedef bool(*fsal_readdir_plus_cb) (struct fsal_readdir_entry *entries,
+				     unsigned int count, void *dir_state);
 /**
  * @brief FSAL objectoperations vector
  */
@@ -2045,6 +2084,71 @@ struct fsal_obj_ops {
 				  const struct fsal_layoutcommit_arg *arg,
 				  struct fsal_layoutcommit_res *res);
 /**@}*/
+
+/**
+ * I/O extensions
+ */
+/**@{*/
+
+/**
+ * @brief Write a vector of buffers to a file
+ *
+ * This function writes the concatenation of the supplied buffers at
+ * the given offset, so large WRITE payloads can be passed down as
+ * the segments they were received in rather than being gathered
+ * into one buffer first.  The default implementation calls @c write
+ * once per segment.
+ *
+ * @param[in]     obj_hdl      File to be written
+ * @param[in]     offset       Position at which to write
+ * @param[in]     iov          Data to be written
+ * @param[in]     iovcnt       Number of elements in @c iov
+ * @param[out]    wrote_amount Number of bytes written
+ * @param[in,out] fsal_stable  In, if on, the fsal is requested to write
+ *                             data to stable store. Out, the fsal
+ *                             reports what it did.
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t(*write_iov) (struct fsal_obj_handle *obj_hdl,
+				    uint64_t offset,
+				    const struct iovec *iov,
+				    int iovcnt,
+				    size_t *wrote_amount,
+				    bool *fsal_stable);
+/**@}*/
+
+/**
+ * Directory extensions
+ */
+/**@{*/
+
+/**
+ * @brief Read a directory with handles and attributes
+ *
+ * This function reads directory entries like @c readdir, but looks
+ * each one up as it goes and hands names, handles and attributes to
+ * the callback in batches of up to FSAL_READDIR_BATCH, so an FSAL
+ * can fetch them together rather than being asked for one lookup
+ * per name afterwards.  The default implementation returns
+ * ERR_FSAL_NOTSUPP, and callers then fall back on @c readdir and
+ * @c lookup.
+ *
+ * @param[in]  dir_hdl   Directory to read
+ * @param[in]  whence    Point at which to start reading.  NULL to
+ *                       start at beginning.
+ * @param[in]  dir_state Opaque pointer to be passed to callback
+ * @param[in]  cb        Callback to receive batches
+ * @param[out] eof       true if the last entry was reached
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t(*readdir_plus) (struct fsal_obj_handle *dir_hdl,
+				       fsal_cookie_t *whence,
+				       void *dir_state,
+				       fsal_readdir_plus_cb cb,
+				       bool *eof);
+/**@}*/
 };
 
 /**
@@ -87,6 +87,7 @@ const char *object_file_type_to_str(object_file_type_t type);
 #define my_low32m(a) ((unsigned int)a)
 
 extern size_t open_fd_count;
+bool cache_inode_lru_fds_spare(void);
 
 fsal_dev_t posix2fsal_devt(dev_t posix_devid);
 
@@ -644,7 +644,8 @@ typedef enum enum_fsal_fsinfo_options {
 	fso_share_support,
 	fso_share_support_owner,
 	fso_pnfs_ds_supported,
-	fso_reopen_method
+	fso_reopen_method,
+	fso_readahead_buffer
 } fsal_fsinfo_options_t;
 
 /* The largest maxread and maxwrite value */
@@ -694,6 +695,14 @@ struct fsal_staticfsinfo_t {
 	bool pnfs_file;		/*< fsal supports file pnfs */
 	bool reopen_method;	/* fsal supports reopen method */
 	bool fsal_trace;	/*< fsal trace supports */
+	uint32_t io_uring_depth;	/*< VFS: io_uring entries per ring,
+					   0 for synchronous I/O */
+	uint32_t io_uring_rings;	/*< VFS: number of io_uring rings */
+	bool range_commit;	/*< VFS: COMMIT starts writeback of the
+				   range before its fdatasync */
+	bool readahead_buffer;	/*< File data changes only through this
+				   server, so the cache may read ahead
+				   into its own buffers */
 };
 
 /**
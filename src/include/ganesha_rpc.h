@@ -149,12 +149,16 @@ const char *str_gc_proc(rpc_gss_proc_t);
 #define XPRT_PRIVATE_FLAG_STALLED 0x0010	/* ie, -on stallq- */
 
 struct drc;
+struct gsh_client;
 typedef struct gsh_xprt_private {
 	SVCXPRT *xprt;
 	uint32_t flags;
 	uint32_t req_cnt; /*< outstanding requests counter */
 	struct drc *drc; /*< TCP DRC */
 	struct glist_head stallq;
+	sockaddr_t addr; /*< peer address, valid if client is set */
+	struct gsh_client *client; /*< peer client, pinned at accept (TCP) */
+	uint32_t node; /*< NUMA node whose workers serve this xprt */
 } gsh_xprt_private_t;
 
 static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
@@ -166,11 +170,14 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 	xu->flags = XPRT_PRIVATE_FLAG_NONE;
 	xu->req_cnt = 0;
 	xu->drc = NULL;
+	xu->client = NULL;
+	xu->node = 0;
 
 	return xu;
 }
 
 void nfs_dupreq_put_drc(SVCXPRT *, struct drc *, uint32_t);
+void put_gsh_client(struct gsh_client *client);
 
 #ifndef DRC_FLAG_RELEASE
 #define DRC_FLAG_RELEASE 0x0040
@@ -182,6 +189,8 @@ static inline void free_gsh_xprt_private(SVCXPRT *xprt)
 	if (xu) {
 		if (xu->drc)
 			nfs_dupreq_put_drc(xprt, xu->drc, DRC_FLAG_RELEASE);
+		if (xu->client)
+			put_gsh_client(xu->client);
 		gsh_free(xu);
 		xprt->xp_u1 = NULL;
 	}
@@ -188,6 +188,29 @@ typedef struct nfs_core_param {
 	/** Number of worker threads.  Set to NB_WORKER_DEFAULT by
 	    default and changed with the Nb_Worker option. */
 	uint32_t nb_worker;
+	/** Whether to split workers and request queues by NUMA node,
+	    pinning each pool to its node's CPUs and serving each TCP
+	    connection on the node that receives its traffic.  False
+	    by default and settable with NUMA_Affinity. */
+	bool numa_affinity;
+	/** Whether to resize the worker pools from the queue wait and
+	    service times observed, between Nb_Worker_Min and
+	    Nb_Worker_Max.  False by default and settable with
+	    Worker_Autotune. */
+	bool worker_autotune;
+	/** Fewest workers to run when tuning.  Settable with
+	    Nb_Worker_Min. */
+	uint32_t nb_worker_min;
+	/** Most workers to run when tuning.  Settable with
+	    Nb_Worker_Max. */
+	uint32_t nb_worker_max;
+	/** Average queue wait, in microseconds, above which tuning
+	    adds workers.  Settable with Worker_Wait_Target. */
+	uint32_t worker_wait_target;
+	/** Times an idle worker looks at the queues again, yielding
+	    the CPU in between, before it parks.  Defaults to 0 and
+	    settable with Worker_Spins. */
+	uint32_t worker_spins;
 	/** For NFSv3, whether to drop rather than reply to requests
 	    yielding I/O errors.  True by default and settable with
 	    Drop_IO_Errors.  As this generally results in client
@@ -307,6 +330,9 @@ typedef struct nfs_core_param {
 		    200 and settable by RPC_Ioq_ThrdMax. */
 		uint32_t ioq_thrd_max;
 	} rpc;
+	/** Bytes each buffer pool size class may keep free for reuse.
+	    Defaults to 4MiB and settable with Buffer_Pool_Size. */
+	uint32_t buffer_pool_size;
 	/** How long (in seconds) to let unused decoder threads wait before
 	    exiting.  Settable with Decoder_Fridge_Expiration_Delay. */
 	time_t decoder_fridge_expiration_delay;
@@ -314,6 +340,13 @@ typedef struct nfs_core_param {
 	    accept a task before erroring.  Settable with
 	    Decoder_Fridge_Block_Timeout. */
 	time_t decoder_fridge_block_timeout;
+	/** Threads looking up export roots at startup.  Defaults to
+	    16 and settable with Export_Root_Threads. */
+	uint32_t export_root_threads;
+	/** Whether to look up each export's root on first use rather
+	    than at startup.  Defaults to false and settable with
+	    Lazy_Export_Roots. */
+	bool lazy_export_roots;
 	/** Protocols to support.  Should probably be renamed.
 	    Defaults to CORE_OPTION_ALL_VERS and is settable with
 	    NFS_Protocols (as a comma-separated list of 3 and 4.) */
@@ -329,6 +362,10 @@ typedef struct nfs_core_param {
 	/** Whether to support the Network Lock Manager protocol.
 	    Defaults to true and is settable with Enable_NLM. */
 	bool enable_NLM;
+	/** Threads sending NLM callbacks (GRANTED and the _RES replies
+	    to _MSG requests).  Defaults to 16 and settable with
+	    NLM_Callback_Threads. */
+	uint32_t nlm_callback_threads;
 	/** Whether to support the Remote Quota protocol.  Defaults
 	    to true and is settable with Enable_RQUOTA. */
 	bool enable_RQUOTA;
@@ -376,6 +413,14 @@ typedef struct nfs_core_param {
  */
 #define DELEG_RECALL_RETRY_DELAY_DEFAULT 1
 
+/**
+ * @brief Where NFSv4 client records for reclaim are kept
+ */
+typedef enum recovery_backend {
+	RECOVERY_BACKEND_FS,	/*< A directory per client */
+	RECOVERY_BACKEND_JOURNAL	/*< An append-only journal file */
+} recovery_backend_t;
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -410,6 +455,10 @@ typedef struct nfs_version4_parameter {
 	bool allow_delegations;
 	/** Delay after which server will retry a recall in case of failures */
 	uint32_t deleg_recall_retry_delay;
+	/** Where client records for reclaim are kept, one of
+	    recovery_backend_t.  Defaults to RECOVERY_BACKEND_FS and is
+	    settable with RecoveryBackend. */
+	uint32_t recovery_backend;
 } nfs_version4_parameter_t;
 
 /** @} */
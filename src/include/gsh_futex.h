@@ -0,0 +1,89 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file gsh_futex.h
+ * @brief Waiting on a 32 bit word
+ *
+ * gsh_futex_wait sleeps only while the word still holds the value
+ * the caller last saw, so a waker that changes the word before
+ * calling gsh_futex_wake can never be missed.
+ */
+
+#ifndef GSH_FUTEX_H
+#define GSH_FUTEX_H
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef LINUX
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/**
+ * @brief Sleep while a word holds a value
+ *
+ * @param[in] addr    Word
+ * @param[in] val     Value last seen in it
+ * @param[in] timeout Longest wait, relative, or NULL
+ */
+
+static inline void gsh_futex_wait(uint32_t *addr, uint32_t val,
+				  const struct timespec *timeout)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+/**
+ * @brief Wake threads sleeping on a word
+ *
+ * @param[in] addr Word
+ * @param[in] n    Most threads to wake
+ */
+
+static inline void gsh_futex_wake(uint32_t *addr, int n)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+#elif defined(FREEBSD)
+#include <sys/types.h>
+#include <sys/umtx.h>
+
+static inline void gsh_futex_wait(uint32_t *addr, uint32_t val,
+				  const struct timespec *timeout)
+{
+	_umtx_op(addr, UMTX_OP_WAIT_UINT_PRIVATE, val,
+		 timeout ? (void *)sizeof(*timeout) : NULL,
+		 (void *)timeout);
+}
+
+static inline void gsh_futex_wake(uint32_t *addr, int n)
+{
+	_umtx_op(addr, UMTX_OP_WAKE_PRIVATE, n, NULL, NULL);
+}
+
+#else
+#error "No futex equivalent for this platform"
+#endif
+
+#endif				/* GSH_FUTEX_H */
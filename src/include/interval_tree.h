@@ -0,0 +1,100 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup interval_tree Intrusive interval tree
+ *
+ * Closed ranges of 64 bit offsets kept in a treap ordered by start,
+ * ties broken by node address, each node also carrying the largest
+ * end in its subtree.  Finding every range that overlaps a given
+ * one then costs O(log n) per range found rather than a walk over
+ * all of them.  Ranges may overlap each other freely.
+ *
+ * The tree does no locking of its own.
+ *
+ * @{
+ */
+
+/**
+ * @file interval_tree.h
+ * @brief Intrusive interval tree
+ */
+
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct itree_node {
+	struct itree_node *left;
+	struct itree_node *right;
+	uint64_t start;		/*< First offset in the range */
+	uint64_t last;		/*< Last offset in the range, inclusive */
+	uint64_t max_last;	/*< Largest last in this subtree */
+	uint32_t prio;		/*< Heap order */
+};
+
+struct itree {
+	struct itree_node *root;
+	uint64_t count;		/*< Nodes in the tree */
+	uint32_t seed;		/*< For node priorities */
+};
+
+/**
+ * @brief Position of a walk over overlapping ranges
+ *
+ * Holds the key of the last node returned rather than the node, so
+ * that node may be removed, or others inserted, between steps.
+ */
+
+struct itree_iter {
+	uint64_t start;
+	uintptr_t node;
+	bool started;
+};
+
+static inline void itree_init(struct itree *tree)
+{
+	tree->root = NULL;
+	tree->count = 0;
+	tree->seed = 2463534242U;
+}
+
+static inline bool itree_empty(const struct itree *tree)
+{
+	return tree->root == NULL;
+}
+
+static inline void itree_iter_init(struct itree_iter *iter)
+{
+	iter->started = false;
+}
+
+void itree_insert(struct itree *tree, struct itree_node *node);
+void itree_remove(struct itree *tree, struct itree_node *node);
+struct itree_node *itree_iter_next(struct itree *tree,
+				   struct itree_iter *iter,
+				   uint64_t start, uint64_t last);
+
+#endif				/* INTERVAL_TREE_H */
+
+/** @} */
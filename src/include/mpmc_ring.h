@@ -0,0 +1,160 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup mpmc_ring Bounded lock-free MPMC ring
+ *
+ * A fixed array of cells, each carrying a sequence number that tells
+ * producers and consumers whose turn it is.  A producer claims the
+ * slot at @c head with a compare and swap, fills it and publishes it
+ * by advancing its sequence; consumers do the same at @c tail.
+ * Neither side ever waits on the other except when the ring is full
+ * or empty, which push and pop report rather than block on.
+ *
+ * @{
+ */
+
+/**
+ * @file mpmc_ring.h
+ * @brief Bounded lock-free multi-producer multi-consumer ring
+ */
+
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gsh_intrinsic.h"
+
+struct mpmc_cell {
+	uint64_t seq;		/*< Position the cell is next ready for */
+	void *data;		/*< Queued pointer */
+};
+
+struct mpmc_ring {
+	struct mpmc_cell *cells;	/*< Ring of mask + 1 cells */
+	uint64_t mask;		/*< Size - 1, size a power of two */
+	CACHE_PAD(0);
+	uint64_t head;		/*< Next position to fill */
+	CACHE_PAD(1);
+	uint64_t tail;		/*< Next position to empty */
+	CACHE_PAD(2);
+};
+
+int mpmc_ring_init(struct mpmc_ring *ring, uint32_t size);
+void mpmc_ring_destroy(struct mpmc_ring *ring);
+
+/**
+ * @brief Append a pointer to the ring
+ *
+ * @param[in] ring Ring
+ * @param[in] data Pointer to queue
+ *
+ * @return false if the ring is full.
+ */
+
+static inline bool mpmc_ring_push(struct mpmc_ring *ring, void *data)
+{
+	uint64_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	struct mpmc_cell *cell;
+	int64_t dif;
+
+	for (;;) {
+		cell = &ring->cells[pos & ring->mask];
+		dif = (int64_t) (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE)
+				 - pos);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->data = data;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/**
+ * @brief Take the oldest pointer from the ring
+ *
+ * @param[in] ring Ring
+ *
+ * @return The pointer, or NULL if the ring is empty.
+ */
+
+static inline void *mpmc_ring_pop(struct mpmc_ring *ring)
+{
+	uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	struct mpmc_cell *cell;
+	int64_t dif;
+	void *data;
+
+	for (;;) {
+		cell = &ring->cells[pos & ring->mask];
+		dif = (int64_t) (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE)
+				 - (pos + 1));
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&ring->tail, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	data = cell->data;
+	__atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+	return data;
+}
+
+/**
+ * @brief Count the pointers in the ring
+ *
+ * Slots claimed but not yet filled are counted, so this is only a
+ * hint, though never 0 while something is queued.
+ *
+ * @param[in] ring Ring
+ *
+ * @return Approximate number of queued pointers.
+ */
+
+static inline uint32_t mpmc_ring_count(struct mpmc_ring *ring)
+{
+	uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+
+	return head > tail ? head - tail : 0;
+}
+
+#endif				/* MPMC_RING_H */
+
+/** @} */
@@ -47,6 +47,7 @@
 #include "mount.h"
 #include "nfs_proto_functions.h"
 #include "wait_queue.h"
+#include "fair_queue.h"
 #include "gsh_config.h"
 #include "cache_inode.h"
 #ifdef _USE_9P
@@ -142,7 +143,7 @@ typedef enum request_type {
 } request_type_t;
 
 typedef struct request_data {
-	struct glist_head req_q;	/* chaining of pending requests */
+	struct fq_item req_q;	/* chaining of pending requests */
 	request_type_t rtype;
 	union request_content {
 		rpc_call_t *call;
@@ -214,7 +215,7 @@ extern pool_t *dupreq_pool;	/* XXX hide */
 
 struct nfs_worker_data {
 	unsigned int worker_index;	/*< Index for log messages */
-	wait_q_entry_t wqe;	/*< Queue for coordinating with decoder */
+	uint32_t node;		/*< NUMA node whose queues we serve */
 
 	sockaddr_t hostaddr;	/*< Client address */
 	struct fridgethr_context *ctx;	/*< Link back to thread context */
@@ -283,7 +284,7 @@ extern struct config_block version4_param;
 /* Admin thread control */
 
 void nfs_Init_admin_thread(void);
-void admin_replace_exports(void);
+bool admin_replace_exports(void);
 void admin_halt(void);
 
 /* Tools */
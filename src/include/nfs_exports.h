@@ -318,6 +318,7 @@ void LogClientListEntry(log_components_t component,
 			exportlist_client_entry_t *entry);
 
 bool init_export_root(struct gsh_export *exp);
+void init_export_root_lazy(struct gsh_export *exp);
 
 cache_inode_status_t nfs_export_get_root_entry(struct gsh_export *exp,
 					       cache_entry_t **entry);
@@ -326,6 +327,7 @@ void kill_export_root_entry(cache_entry_t *entry);
 void kill_export_junction_entry(cache_entry_t *entry);
 
 int ReadExports(config_file_t in_config);
+int reload_exports(config_file_t in_config);
 void free_export_resources(struct gsh_export *export);
 void exports_pkginit(void);
 
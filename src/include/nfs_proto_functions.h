@@ -186,6 +186,7 @@ typedef struct nfs_function_desc__ {
 	unsigned int dispatch_behaviour;
 } nfs_function_desc_t;
 
+extern const nfs_function_desc_t invalid_funcdesc;
 extern const nfs_function_desc_t nfs3_func_desc[];
 extern const nfs_function_desc_t nfs4_func_desc[];
 extern const nfs_function_desc_t mnt1_func_desc[];
@@ -35,8 +35,15 @@
 #ifndef NFS_REQ_QUEUE_H
 #define NFS_REQ_QUEUE_H
 
+#include <limits.h>
 #include "ganesha_list.h"
-#include "wait_queue.h"
+#include "abstract_atomic.h"
+#include "fair_queue.h"
+#include "mpmc_ring.h"
+#include "gsh_futex.h"
+#ifdef USE_DBUS
+#include "ganesha_dbus.h"
+#endif
 
 /* XXX moving to gsh_intrinsic.h */
 #ifndef CACHE_LINE_SIZE
@@ -44,23 +51,31 @@
 #endif
 #define CACHE_PAD(_n) char __pad ## _n [CACHE_LINE_SIZE]
 
-struct req_q {
-	pthread_spinlock_t sp;
-	struct glist_head q;	/* LIFO */
-	uint32_t size;
-	uint32_t max;
-	uint32_t waiters;
-};
+/**
+ * @brief One class of requests
+ *
+ * Requests are queued on flows by client and export and served by
+ * deficit round robin (see fair_queue.h), so that no one client or
+ * export can monopolize the class.
+ *
+ * Decoders do not touch the fair queue: they push onto the lock-free
+ * intake ring, and workers move the ring onto the flows under the
+ * spinlock when they come to dequeue.  Only when the ring is full
+ * does a decoder take the lock.
+ */
 
-struct req_q_pair {
+struct req_q {
 	const char *s;
+	struct mpmc_ring intake;	/*< Requests not yet on a flow */
 	 CACHE_PAD(0);
-	struct req_q producer;	/* from decoder */
+	pthread_spinlock_t sp;
+	struct fair_queue fq;
 	 CACHE_PAD(1);
-	struct req_q consumer;	/* to executor */
-	 CACHE_PAD(2);
 };
 
+/** Slots in each class's intake ring */
+#define REQ_Q_RING_SIZE 1024
+
 #define REQ_Q_MOUNT 0
 #define REQ_Q_CALL 1
 #define REQ_Q_LOW_LATENCY 2	/*< GETATTR, RENEW, etc */
@@ -70,18 +85,42 @@ struct req_q_pair {
 extern const char *req_q_s[N_REQ_QUEUES];	/* for debug prints */
 
 struct req_q_set {
-	struct req_q_pair qset[N_REQ_QUEUES];
+	struct req_q qset[N_REQ_QUEUES];
+};
+
+/** Most NUMA nodes given their own queues and workers */
+#define REQ_MAX_NODES 8
+
+/**
+ * @brief Request queues and waiting workers of one NUMA node
+ *
+ * With NUMA_Affinity off there is just the one.
+ */
+
+struct req_node_st {
+	uint32_t ctr;
+	struct req_q_set nfs_request_q;
+	uint64_t size;
+	uint32_t wake_seq;	/*< Bumped to wake parked workers */
+	uint32_t parked;	/*< Workers sleeping on wake_seq */
+	uint64_t enqueued;	/*< Requests queued to this node */
+	uint64_t dequeued;	/*< Requests taken from this node's queues */
+	uint64_t steals;	/*< Requests this node's workers took from
+				    other nodes */
+	uint64_t served;	/*< Requests this node's workers executed,
+				    counted with Worker_Autotune only */
+	uint64_t waited;	/*< Those of them not held back by an export
+				    rate limit */
+	uint64_t wait_ns;	/*< Time those spent queued */
+	uint32_t running;	/*< Requests being executed right now */
+	uint64_t busy_ns;	/*< Time spent executing them */
+	uint64_t cpu_ns;	/*< CPU time spent executing them */
+	 CACHE_PAD(0);
 };
 
 struct nfs_req_st {
-	struct {
-		uint32_t ctr;
-		struct req_q_set nfs_request_q;
-		uint64_t size;
-		pthread_spinlock_t sp;
-		struct glist_head wait_list;
-		uint32_t waiters;
-	} reqs;
+	uint32_t n_nodes;
+	struct req_node_st reqs[REQ_MAX_NODES];
 	 CACHE_PAD(1);
 	struct {
 		pthread_mutex_t mtx;
@@ -94,36 +133,59 @@ struct nfs_req_st {
 extern struct nfs_req_st nfs_req_st;
 
 void nfs_rpc_queue_init(void);
+uint32_t nfs_rpc_cpu_node(int cpu);
+int nfs_rpc_bind_node(uint32_t node);
+uint32_t nfs_rpc_node_ncpus(uint32_t node);
 
-static inline void nfs_rpc_q_init(struct req_q *q)
+#ifdef USE_DBUS
+
+#define REQ_NODES_REPLY		\
+{				\
+	.name = "nodes",	\
+	.type = "a(utttt)",	\
+	.direction = "out"	\
+}
+
+void nfs_rpc_dbus_show_nodes(DBusMessageIter *iter);
+#endif				/* USE_DBUS */
+
+static inline int nfs_rpc_q_init(struct req_q *q, fq_admit_t admit)
 {
-	glist_init(&q->q);
 	pthread_spin_init(&q->sp, PTHREAD_PROCESS_PRIVATE);
-	q->size = 0;
-	q->waiters = 0;
+	fq_init(&q->fq, admit);
+	return mpmc_ring_init(&q->intake, REQ_Q_RING_SIZE);
 }
 
-static inline uint32_t nfs_rpc_q_next_slot(void)
+/**
+ * @brief Requests waiting in one class, on the ring or on flows
+ */
+
+static inline uint32_t nfs_rpc_q_size(struct req_q *q)
+{
+	return atomic_fetch_uint32_t(&q->fq.size) +
+	       mpmc_ring_count(&q->intake);
+}
+
+/* Queued requests the admit callback held back on the last dequeue */
+static inline uint32_t nfs_rpc_q_held(struct req_q *q)
 {
-	uint32_t ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+	return atomic_fetch_uint32_t(&q->fq.held);
+}
+
+static inline uint32_t nfs_rpc_q_next_slot(struct req_node_st *st)
+{
+	uint32_t ix = atomic_inc_uint32_t(&st->ctr);
 	if (!ix)
-		ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+		ix = atomic_inc_uint32_t(&st->ctr);
 	return ix;
 }
 
 static inline void nfs_rpc_queue_awaken(void *arg)
 {
-	struct nfs_req_st *st = arg;
-	struct glist_head *g = NULL;
-	struct glist_head *n = NULL;
-
-	pthread_spin_lock(&st->reqs.sp);
-	glist_for_each_safe(g, n, &st->reqs.wait_list) {
-		wait_q_entry_t *wqe = glist_entry(g, wait_q_entry_t, waitq);
-		pthread_cond_signal(&wqe->lwe.cv);
-		pthread_cond_signal(&wqe->rwe.cv);
-	}
-	pthread_spin_unlock(&st->reqs.sp);
+	struct req_node_st *st = arg;
+
+	atomic_inc_uint32_t(&st->wake_seq);
+	gsh_futex_wake(&st->wake_seq, INT_MAX);
 }
 
 #endif				/* NFS_REQ_QUEUE_H */
@@ -35,7 +35,9 @@
 extern pthread_mutex_t nlm_async_resp_mutex;
 extern pthread_cond_t nlm_async_resp_cond;
 
-int nlm_async_callback_init();
+int nlm_async_callback_init(void);
+int nlm_async_callback_shutdown(void);
+state_status_t nlm_async_schedule(state_async_queue_t *arg);
 
 int nlm_send_async_res_nlm4(state_nlm_client_t *host, state_async_func_t func,
 			    nfs_res_t *pres);
@@ -0,0 +1,83 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup path_trie Path component trie
+ *
+ * Maps slash separated paths to lists of intrusive links, one node
+ * per path component, each node's children kept in an AVL tree by
+ * name.  Finding the longest indexed prefix of a path then costs a
+ * tree lookup per component of the path rather than a string
+ * comparison per indexed path.  Empty components are ignored, so
+ * "/a//b/" and "/a/b" are the same path.
+ *
+ * The trie does no locking of its own.
+ *
+ * @{
+ */
+
+/**
+ * @file path_trie.h
+ * @brief Path component trie
+ */
+
+#ifndef PATH_TRIE_H
+#define PATH_TRIE_H
+
+#include <stdbool.h>
+#include "avltree.h"
+#include "ganesha_list.h"
+
+struct ptrie_node {
+	struct avltree_node node_k;	/*< In the parent's children */
+	struct avltree children;	/*< By name */
+	struct ptrie_node *parent;
+	struct glist_head values;	/*< Links at exactly this path */
+	const char *name;	/*< Component, not NUL terminated */
+	size_t len;		/*< Length of name */
+	char buf[];
+};
+
+struct ptrie {
+	struct ptrie_node *root;	/*< "/", NULL while empty */
+};
+
+/**
+ * @brief Decide whether a link may be returned by a lookup
+ */
+
+typedef bool (*ptrie_accept_t)(struct glist_head *link);
+
+static inline void ptrie_init(struct ptrie *trie)
+{
+	trie->root = NULL;
+}
+
+bool ptrie_insert(struct ptrie *trie, const char *path,
+		  struct glist_head *link);
+void ptrie_remove(struct ptrie *trie, const char *path,
+		  struct glist_head *link);
+struct glist_head *ptrie_lookup(struct ptrie *trie, const char *path,
+				bool exact, ptrie_accept_t accept);
+
+#endif				/* PATH_TRIE_H */
+
+/** @} */
@@ -234,8 +234,10 @@ typedef struct clid_entry {
 	char cl_name[PATH_MAX];	/*< Client name */
 } clid_entry_t;
 
-extern char v4_old_dir[PATH_MAX+1];
-extern char v4_recov_dir[PATH_MAX + 1];
+/**
+ * @brief Where the recovery backends keep client records
+ */
+#define NFS_V4_RECOV_ROOT "/var/lib/nfs/ganesha"
 
 /******************************************************************************
  *
@@ -481,6 +483,9 @@ struct state_nlm_client_t {
 	char *slc_nlm_caller_name;	/*< Client name */
 	CLIENT *slc_callback_clnt;	/*< Callback for blocking locks */
 	AUTH *slc_callback_auth;	/*< Authentication for callback */
+	pthread_rwlock_t slc_callback_lock; /*< Read to call back, write
+						to create or destroy the
+						callback client */
 };
 
 /**
@@ -869,6 +874,9 @@ struct state_lock_entry_t {
 	state_blocking_t sle_blocked;	/*< Blocking status */
 	int sle_ref_count;	/*< Reference count */
 	fsal_lock_param_t sle_lock;	/*< Lock description */
+	struct itree_node sle_range;	/*< Node in the file's lock_tree */
+	bool sle_indexed;	/*< On the file's lock_list and lock_tree */
+	uint64_t sle_seq;	/*< Order in which it joined the lock_list */
 	pthread_mutex_t sle_mutex;	/*< Mutex to protect the structure */
 	lock_type_t sle_type;	/*< Type of lock */
 };
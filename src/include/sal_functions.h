@@ -695,6 +695,40 @@ void process_blocked_lock_upcall(state_block_data_t *block_data);
  *
  ******************************************************************************/
 
+typedef clid_entry_t *(*add_clid_entry_hook)(char *);
+typedef rdel_fh_t *(*add_rfh_entry_hook)(clid_entry_t *, char *);
+
+/**
+ * @brief Stable storage for the clients allowed to reclaim state
+ *
+ * Clients are recorded when confirmed and removed when they expire.
+ * At grace start the records of the previous server instance are
+ * loaded, and kept until the grace period ends in case the server
+ * restarts again during it.
+ */
+struct nfs4_recovery_backend {
+	/** Set up stable storage */
+	void (*recovery_init)(void);
+	/** Write out anything buffered and close stable storage */
+	void (*recovery_shutdown)(void);
+	/** Load the clients allowed to reclaim, passing each to the
+	    hooks; gsp is NULL at startup */
+	void (*recovery_read_clids)(nfs_grace_start_t *gsp,
+				    add_clid_entry_hook add_clid_entry,
+				    add_rfh_entry_hook add_rfh_entry);
+	/** Record a client, which may then be granted state */
+	void (*add_clid)(nfs_client_id_t *);
+	/** Remove an expired client */
+	void (*rm_clid)(nfs_client_id_t *);
+	/** Record a delegation revoked from a client */
+	void (*add_revoke_fh)(nfs_client_id_t *, const char *);
+	/** Drop the previous instance's clients, grace being over */
+	void (*end_grace)(void);
+};
+
+void fs_backend_init(struct nfs4_recovery_backend **);
+void journal_backend_init(struct nfs4_recovery_backend **);
+
 void nfs4_init_grace(void);
 void nfs4_start_grace(nfs_grace_start_t *gsp);
 int nfs_in_grace(void);
@@ -702,11 +736,12 @@ int fsal_grace(void);
 void nfs4_create_clid_name(nfs_client_record_t *, nfs_client_id_t *,
 			   struct svc_req *);
 void nfs4_add_clid(nfs_client_id_t *);
-void nfs4_rm_clid(const char *, char *, int);
+void nfs4_rm_clid(nfs_client_id_t *);
 void nfs4_chk_clid(nfs_client_id_t *);
 void nfs4_load_recov_clids(nfs_grace_start_t *gsp);
-void nfs4_clean_old_recov_dir(char *);
-void nfs4_create_recov_dir(void);
+void nfs4_end_grace(void);
+void nfs4_recovery_init(void);
+void nfs4_recovery_shutdown(void);
 void nfs4_record_revoke(nfs_client_id_t *, nfs_fh4 *);
 bool nfs4_can_deleg_reclaim_prev(nfs_client_id_t *, nfs_fh4 *);
 
@@ -209,6 +209,10 @@ void server_dbus_total_ops(struct export_stats *export_st,
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void server_dbus_readahead(struct export_readahead *rap,
+			   DBusMessageIter *iter);
+void server_dbus_negcache(struct export_negative_cache *ncp,
+			  DBusMessageIter *iter);
 
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
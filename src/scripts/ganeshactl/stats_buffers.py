@@ -0,0 +1,38 @@
+#!/usr/bin/python
+
+# You must initialize the gobject/dbus support for threading
+# before doing anything.
+import gobject
+import sys
+
+gobject.threads_init()
+
+from dbus import glib
+glib.init_threads()
+
+# Create a session bus.
+import dbus
+bus = dbus.SystemBus()
+
+# Create an object that will proxy for a particular remote object.
+try:
+	admin = bus.get_object("org.ganesha.nfsd",
+                       "/org/ganesha/nfsd/ExportMgr")
+except: # catch *all* exceptions
+      print "Error: Can't talk to ganesha service on d-bus. Looks like Ganesha is down"
+      exit(1) 
+
+# call method
+ganesha_nfsstats_ops = admin.get_dbus_method('ShowBufferPools',
+                               'org.ganesha.nfsd.exportstats')
+
+pools=ganesha_nfsstats_ops()
+if pools[1] != "OK":
+	print "No buffer pool statistics"
+else:
+	print "%10s %12s %12s %12s %12s" % ("size", "hits", "misses",
+					     "returns", "releases")
+	for stat in pools[3]:
+		print "%10d %12d %12d %12d %12d" % tuple(stat)
+
+exit(0)
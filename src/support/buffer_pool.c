@@ -0,0 +1,486 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup buffer_pool
+ * @{
+ */
+
+/**
+ * @file buffer_pool.c
+ * @brief Size-classed, per-thread cached buffer pools
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <pthread.h>
+#ifdef LINUX
+#include <malloc.h>
+#endif
+#include "log.h"
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "gsh_intrinsic.h"
+#include "delayed_exec.h"
+#include "nfs_core.h"
+#include "buffer_pool.h"
+
+/**
+ * @brief Substrate data for one cached pool
+ *
+ * Free buffers are chained through their first word, so the shared
+ * free list costs no memory of its own.
+ */
+
+struct buf_pool_cache {
+	pthread_mutex_t lock;	/*< Protects free and count */
+	void *free;		/*< Singly linked list of free buffers */
+	unsigned int count;	/*< Number of buffers on the list */
+	unsigned int low;	/*< Fewest on the list since last trim */
+	unsigned int max;	/*< Most buffers we will keep */
+	struct gsh_buf_stats stats;	/*< Hit/miss counters */
+};
+
+#define buf_pool_cache_of(pool) \
+	((struct buf_pool_cache *)(pool)->substrate_data)
+
+/**
+ * @brief Initialize a cached pool
+ *
+ * @param[in] size  Size of the buffers in the pool
+ * @param[in] param Pointer to the maximum number of cached buffers
+ *
+ * @return the allocated pool_t structure.
+ */
+
+static pool_t *pool_cached_initializer(size_t size, void *param)
+{
+	pool_t *pool = gsh_calloc(1, sizeof(pool_t) +
+				  sizeof(struct buf_pool_cache));
+	struct buf_pool_cache *cache;
+
+	if (pool == NULL)
+		return NULL;
+
+	cache = buf_pool_cache_of(pool);
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->max = *(unsigned int *)param;
+	return pool;
+}
+
+/**
+ * @brief Destroy a cached pool, releasing every cached buffer
+ *
+ * @param[in] pool The pool to destroy
+ */
+
+static void pool_cached_destroy(pool_t *pool)
+{
+	struct buf_pool_cache *cache = buf_pool_cache_of(pool);
+	void *buf;
+
+	while (cache->free != NULL) {
+		buf = cache->free;
+		cache->free = *(void **)buf;
+		gsh_free(buf);
+	}
+	pthread_mutex_destroy(&cache->lock);
+	gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Take a buffer from the shared list, or allocate a new one
+ *
+ * @param[in] pool The pool from which to allocate.
+ *
+ * @return the buffer or NULL.
+ */
+
+static void *pool_cached_alloc(pool_t *pool)
+{
+	struct buf_pool_cache *cache = buf_pool_cache_of(pool);
+	void *buf;
+
+	PTHREAD_MUTEX_lock(&cache->lock);
+	buf = cache->free;
+	if (buf != NULL) {
+		cache->free = *(void **)buf;
+		cache->count--;
+		if (cache->count < cache->low)
+			cache->low = cache->count;
+	}
+	PTHREAD_MUTEX_unlock(&cache->lock);
+
+	if (buf != NULL) {
+		atomic_inc_uint64_t(&cache->stats.hits);
+		return buf;
+	}
+
+	atomic_inc_uint64_t(&cache->stats.misses);
+	if (pool->object_size >= GSH_BUF_ALIGN)
+		return gsh_malloc_aligned(GSH_BUF_ALIGN, pool->object_size);
+	return gsh_malloc(pool->object_size);
+}
+
+/**
+ * @brief Put a buffer on the shared list, or free it if the list is full
+ *
+ * @param[in] pool   The pool to which to return the buffer
+ * @param[in] object The buffer
+ */
+
+static void pool_cached_free(pool_t *pool, void *object)
+{
+	struct buf_pool_cache *cache = buf_pool_cache_of(pool);
+
+	PTHREAD_MUTEX_lock(&cache->lock);
+	if (cache->count < cache->max) {
+		*(void **)object = cache->free;
+		cache->free = object;
+		cache->count++;
+		object = NULL;
+	}
+	PTHREAD_MUTEX_unlock(&cache->lock);
+
+	if (object != NULL) {
+		atomic_inc_uint64_t(&cache->stats.releases);
+		gsh_free(object);
+	} else {
+		atomic_inc_uint64_t(&cache->stats.returns);
+	}
+}
+
+/**
+ * @brief Release the buffers a pool has not needed lately
+ *
+ * As many buffers as stayed on the shared list throughout the last
+ * interval were not needed in it, so that many are freed.
+ *
+ * @param[in] pool The pool to trim
+ */
+
+static void pool_cached_trim(pool_t *pool)
+{
+	struct buf_pool_cache *cache = buf_pool_cache_of(pool);
+	void *idle = NULL, *buf;
+	unsigned int n;
+
+	PTHREAD_MUTEX_lock(&cache->lock);
+	for (n = cache->low; n > 0; n--) {
+		buf = cache->free;
+		cache->free = *(void **)buf;
+		*(void **)buf = idle;
+		idle = buf;
+	}
+	cache->count -= cache->low;
+	cache->low = cache->count;
+	PTHREAD_MUTEX_unlock(&cache->lock);
+
+	while (idle != NULL) {
+		buf = idle;
+		idle = *(void **)buf;
+		atomic_inc_uint64_t(&cache->stats.releases);
+		gsh_free(buf);
+	}
+}
+
+static const struct pool_substrate_vector pool_cached_substrate[] = {
+	{
+		.initializer = pool_cached_initializer,
+		.destroyer = pool_cached_destroy,
+		.allocator = pool_cached_alloc,
+		.freer = pool_cached_free
+	}
+};
+
+/**
+ * @brief One pool per size class
+ */
+
+static pool_t *buf_pools[GSH_BUF_NCLASSES];
+
+/**
+ * @brief Per-thread front cache
+ */
+
+struct buf_thread_cache {
+	unsigned int count[GSH_BUF_NCLASSES];
+	void *bufs[GSH_BUF_NCLASSES][GSH_BUF_TCACHE_SMALL];
+};
+
+static __thread struct buf_thread_cache *buf_tcache;
+
+/**
+ * @brief Key used only to flush a thread's cache when it exits
+ */
+
+static pthread_key_t buf_tcache_key;
+
+static inline unsigned int tcache_depth(unsigned int class)
+{
+	return (class + GSH_BUF_MIN_SHIFT) <= 16 ?
+		GSH_BUF_TCACHE_SMALL : GSH_BUF_TCACHE_LARGE;
+}
+
+static void buf_tcache_flush(void *arg)
+{
+	struct buf_thread_cache *tc = arg;
+	unsigned int class;
+
+	for (class = 0; class < GSH_BUF_NCLASSES; class++)
+		while (tc->count[class] > 0)
+			pool_free(buf_pools[class],
+				  tc->bufs[class][--tc->count[class]]);
+	gsh_free(tc);
+}
+
+static struct buf_thread_cache *get_tcache(void)
+{
+	if (unlikely(buf_tcache == NULL)) {
+		buf_tcache = gsh_calloc(1, sizeof(struct buf_thread_cache));
+		if (buf_tcache != NULL)
+			pthread_setspecific(buf_tcache_key, buf_tcache);
+	}
+	return buf_tcache;
+}
+
+/**
+ * @brief Smallest class that holds @c size bytes
+ *
+ * @return the class index, or GSH_BUF_NCLASSES if too large.
+ */
+
+static inline unsigned int size_to_class(size_t size)
+{
+	unsigned int shift = GSH_BUF_MIN_SHIFT;
+
+	while (shift <= GSH_BUF_MAX_SHIFT && ((size_t)1 << shift) < size)
+		shift++;
+	return shift - GSH_BUF_MIN_SHIFT;
+}
+
+/**
+ * @brief Largest class a heap block can stand in for
+ *
+ * @return the class index, or GSH_BUF_NCLASSES if it fits none.
+ */
+
+static inline unsigned int buf_to_class(void *buf)
+{
+#ifdef LINUX
+	size_t usable = malloc_usable_size(buf);
+	unsigned int shift = GSH_BUF_MAX_SHIFT;
+
+	if (usable < ((size_t)1 << GSH_BUF_MIN_SHIFT))
+		return GSH_BUF_NCLASSES;
+	while (((size_t)1 << shift) > usable)
+		shift--;
+	if (shift >= 12 && ((uintptr_t)buf & (GSH_BUF_ALIGN - 1)) != 0)
+		return GSH_BUF_NCLASSES;
+	return shift - GSH_BUF_MIN_SHIFT;
+#else
+	return GSH_BUF_NCLASSES;
+#endif
+}
+
+static void buf_trim(void *arg)
+{
+	unsigned int class;
+
+	for (class = 0; class < GSH_BUF_NCLASSES; class++)
+		pool_cached_trim(buf_pools[class]);
+
+	(void) delayed_submit(buf_trim, NULL,
+			      GSH_BUF_TRIM_INTERVAL * NS_PER_SEC);
+}
+
+/**
+ * @brief Initialize the buffer pools
+ *
+ * Each class keeps up to Buffer_Pool_Size bytes of free buffers.
+ * Buffers idle on the shared lists are released every
+ * GSH_BUF_TRIM_INTERVAL seconds.
+ */
+
+void gsh_buf_pkginit(void)
+{
+	unsigned int class;
+	unsigned int max;
+	size_t size;
+
+	if (pthread_key_create(&buf_tcache_key, buf_tcache_flush) != 0)
+		LogFatal(COMPONENT_INIT,
+			 "Could not create buffer pool thread key");
+
+	for (class = 0; class < GSH_BUF_NCLASSES; class++) {
+		size = (size_t)1 << (class + GSH_BUF_MIN_SHIFT);
+		max = nfs_param.core_param.buffer_pool_size / size;
+		buf_pools[class] = pool_init("I/O buffer pool", size,
+					     pool_cached_substrate, &max,
+					     NULL, NULL);
+		if (buf_pools[class] == NULL)
+			LogFatal(COMPONENT_INIT,
+				 "Error while allocating %zu byte buffer pool",
+				 size);
+	}
+
+	if (delayed_submit(buf_trim, NULL,
+			   GSH_BUF_TRIM_INTERVAL * NS_PER_SEC) != 0)
+		LogMajor(COMPONENT_INIT,
+			 "Could not schedule buffer pool trimming");
+}
+
+/**
+ * @brief Get a buffer of at least @c size bytes
+ *
+ * Buffers of 4KiB or more are page aligned.  Requests larger than
+ * the biggest class go straight to the allocator.
+ *
+ * @param[in] size Number of bytes needed
+ *
+ * @return the buffer, or NULL on failure.
+ */
+
+void *gsh_buf_alloc(size_t size)
+{
+	unsigned int class = size_to_class(size);
+	struct buf_thread_cache *tc;
+	struct buf_pool_cache *cache;
+
+	if (class >= GSH_BUF_NCLASSES || buf_pools[class] == NULL)
+		return gsh_malloc_aligned(GSH_BUF_ALIGN, size);
+
+	tc = get_tcache();
+	if (tc != NULL && tc->count[class] > 0) {
+		cache = buf_pool_cache_of(buf_pools[class]);
+		atomic_inc_uint64_t(&cache->stats.hits);
+		return tc->bufs[class][--tc->count[class]];
+	}
+
+	return pool_alloc(buf_pools[class], NULL);
+}
+
+/**
+ * @brief Release a buffer, recycling it if possible
+ *
+ * Any heap block may be passed here, not just ones from
+ * gsh_buf_alloc.  NULL is ignored.
+ *
+ * @param[in] buf The buffer
+ */
+
+void gsh_buf_free(void *buf)
+{
+	unsigned int class;
+	struct buf_thread_cache *tc;
+	struct buf_pool_cache *cache;
+
+	if (buf == NULL)
+		return;
+
+	class = buf_to_class(buf);
+	if (class >= GSH_BUF_NCLASSES || buf_pools[class] == NULL) {
+		gsh_free(buf);
+		return;
+	}
+
+	tc = get_tcache();
+	if (tc != NULL && tc->count[class] < tcache_depth(class)) {
+		cache = buf_pool_cache_of(buf_pools[class]);
+		atomic_inc_uint64_t(&cache->stats.returns);
+		tc->bufs[class][tc->count[class]++] = buf;
+		return;
+	}
+
+	pool_free(buf_pools[class], buf);
+}
+
+/**
+ * @brief Fetch the statistics of one size class
+ *
+ * @param[in]  class Class index, less than GSH_BUF_NCLASSES
+ * @param[out] size  Buffer size of the class
+ * @param[out] stats Counters
+ */
+
+void gsh_buf_stats(unsigned int class, size_t *size,
+		   struct gsh_buf_stats *stats)
+{
+	struct buf_pool_cache *cache = buf_pool_cache_of(buf_pools[class]);
+
+	*size = buf_pools[class]->object_size;
+	stats->hits = atomic_fetch_uint64_t(&cache->stats.hits);
+	stats->misses = atomic_fetch_uint64_t(&cache->stats.misses);
+	stats->returns = atomic_fetch_uint64_t(&cache->stats.returns);
+	stats->releases = atomic_fetch_uint64_t(&cache->stats.releases);
+}
+
+#ifdef USE_DBUS
+
+/**
+ * @brief Report buffer pool statistics as an array of structs
+ *
+ * Each entry is (size, hits, misses, returns, releases).
+ *
+ * @param[in] iter DBus reply iterator
+ */
+
+void gsh_buf_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	struct gsh_buf_stats st;
+	unsigned int class;
+	size_t size;
+	uint64_t val;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(ttttt)",
+					 &array_iter);
+	for (class = 0; class < GSH_BUF_NCLASSES; class++) {
+		if (buf_pools[class] == NULL)
+			continue;
+		gsh_buf_stats(class, &size, &st);
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		val = size;
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &val);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.hits);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.misses);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.returns);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.releases);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+#endif				/* USE_DBUS */
+
+/** @} */
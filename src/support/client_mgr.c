@@ -234,9 +234,25 @@ void put_gsh_client(struct gsh_client *client)
 	assert(new_refcnt >= 0);
 }
 
+/**
+ * @brief Take another reference on a client
+ *
+ * For callers that already hold a reference, e.g. one pinned on a
+ * transport, and want to hand one out without a lookup.
+ */
+
+void inc_gsh_client_refcount(struct gsh_client *client)
+{
+	atomic_inc_int64_t(&client->refcnt);
+}
+
 /**
  * @brief Remove a client from the AVL and free its resources
  *
+ * A client is busy, and stays, while anything holds a reference to
+ * it.  That includes every open TCP connection from it, which pins
+ * its client until the connection is closed.
+ *
  * @param client_ipaddr [IN] sockaddr (key) to remove
  *
  * @return true if removed or was not found, false if busy.
@@ -432,9 +448,11 @@ static bool gsh_client_removeclient(DBusMessageIter *args,
 
 	dbus_message_iter_init_append(reply, &iter);
 	success = arg_ipaddr(args, &sockaddr, &errormsg);
-	if (success)
+	if (success) {
 		success = remove_gsh_client(&sockaddr);
-	errormsg = success ? "OK" : "Client with that address not found";
+		errormsg = success ? "OK"
+		    : "Client is in use, by open connections or requests in progress; retry once its connections are closed";
+	}
 	dbus_status_reply(&iter, success, errormsg);
 	return true;
 }
@@ -62,6 +62,9 @@
 #include "abstract_atomic.h"
 #include "gsh_intrinsic.h"
 #include "sal_functions.h"
+#include "buffer_pool.h"
+#include "nfs_req_queue.h"
+#include "path_trie.h"
 
 /**
  * @brief Exports are stored in an AVL tree with front-end cache.
@@ -81,6 +84,12 @@ static struct export_by_id export_by_id;
   */
 static struct glist_head exportlist;
 
+/** Exports indexed by fullpath and by pseudopath,
+  * protected by export_by_id.lock
+  */
+static struct ptrie export_by_path;
+static struct ptrie export_by_pseudo;
+
 /** List of exports to be mounted in PseudoFS,
   * protected by export_by_id.lock
   */
@@ -177,6 +186,150 @@ static int export_id_cmpf(const struct avltree_node *lhs,
 		return 0;
 }
 
+/** Credit units per token */
+#define TB_SCALE 1000000
+
+/**
+ * @brief Refill a token bucket for the time since it was last refilled
+ *
+ * @param[in,out] tb   Bucket
+ * @param[in]     usec Current time
+ */
+static void tb_refill(struct token_bucket *tb, uint64_t usec)
+{
+	int64_t burst = tb->rate * TB_SCALE;
+	uint64_t elapsed = usec - tb->stamp;
+
+	tb->stamp = usec;
+	/* rate is tokens per second, so rate * usec is in millionths */
+	if (elapsed >= TB_SCALE ||
+	    tb->credit + (int64_t) (tb->rate * elapsed) >= burst)
+		tb->credit = burst;
+	else
+		tb->credit += tb->rate * elapsed;
+}
+
+static inline bool tb_ready(struct token_bucket *tb)
+{
+	return tb->rate == 0 || tb->credit > 0;
+}
+
+/* When a just refilled bucket will next hold credit, in usec */
+static inline uint64_t tb_ready_at(struct token_bucket *tb, uint64_t usec)
+{
+	if (tb_ready(tb))
+		return usec;
+	return usec + (uint64_t) (-tb->credit) / tb->rate + 1;
+}
+
+static inline void tb_take(struct token_bucket *tb, uint64_t tokens)
+{
+	if (tb->rate != 0)
+		tb->credit -= tokens * TB_SCALE;
+}
+
+/**
+ * @brief Check an operation against an export's rate limits
+ *
+ * If every bucket the operation draws on has credit, the operation
+ * is charged to them all and may go ahead.
+ *
+ * @param[in]  qos    Export's limits
+ * @param[in]  io     FQ_IO_READ and/or FQ_IO_WRITE
+ * @param[in]  rbytes Bytes to read
+ * @param[in]  wbytes Bytes to write
+ * @param[out] ready  If refused, when it may start, in CLOCK_MONOTONIC
+ *                    microseconds
+ *
+ * @return true if the operation may start now.
+ */
+
+bool export_qos_admit(struct export_qos *qos, uint32_t io,
+		      uint64_t rbytes, uint64_t wbytes, uint64_t *ready)
+{
+	bool rd = (io & FQ_IO_READ) &&
+		  (qos->read_ops.rate != 0 || qos->read_bytes.rate != 0);
+	bool wr = (io & FQ_IO_WRITE) &&
+		  (qos->write_ops.rate != 0 || qos->write_bytes.rate != 0);
+	struct timespec ts;
+	uint64_t usec;
+	bool ok = true;
+
+	if (!rd && !wr)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	usec = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+
+	pthread_spin_lock(&qos->sp);
+	if (rd) {
+		tb_refill(&qos->read_ops, usec);
+		tb_refill(&qos->read_bytes, usec);
+		ok = tb_ready(&qos->read_ops) && tb_ready(&qos->read_bytes);
+	}
+	if (ok && wr) {
+		tb_refill(&qos->write_ops, usec);
+		tb_refill(&qos->write_bytes, usec);
+		ok = tb_ready(&qos->write_ops) && tb_ready(&qos->write_bytes);
+	}
+	if (ok && rd) {
+		tb_take(&qos->read_ops, 1);
+		tb_take(&qos->read_bytes, rbytes);
+	}
+	if (ok && wr) {
+		tb_take(&qos->write_ops, 1);
+		tb_take(&qos->write_bytes, wbytes);
+	}
+	if (!ok) {
+		/* every bucket drawn on must be refilled to tell */
+		*ready = usec;
+		if (rd) {
+			*ready = MAX(*ready, tb_ready_at(&qos->read_ops, usec));
+			*ready = MAX(*ready,
+				     tb_ready_at(&qos->read_bytes, usec));
+		}
+		if (wr) {
+			tb_refill(&qos->write_ops, usec);
+			tb_refill(&qos->write_bytes, usec);
+			*ready = MAX(*ready,
+				     tb_ready_at(&qos->write_ops, usec));
+			*ready = MAX(*ready,
+				     tb_ready_at(&qos->write_bytes, usec));
+		}
+	}
+	pthread_spin_unlock(&qos->sp);
+
+	return ok;
+}
+
+/**
+ * @brief Change an export's rate limits
+ *
+ * The buckets start again full.  A rate of 0 removes the limit.
+ *
+ * @param[in,out] qos       Export's limits
+ * @param[in]     read_ops  Reads per second
+ * @param[in]     write_ops Writes per second
+ * @param[in]     read_bw   Bytes read per second
+ * @param[in]     write_bw  Bytes written per second
+ */
+
+void export_qos_set(struct export_qos *qos, uint64_t read_ops,
+		    uint64_t write_ops, uint64_t read_bw, uint64_t write_bw)
+{
+	pthread_spin_lock(&qos->sp);
+	qos->read_ops.rate = read_ops;
+	qos->write_ops.rate = write_ops;
+	qos->read_bytes.rate = read_bw;
+	qos->write_bytes.rate = write_bw;
+	/* a zero stamp refills on next use */
+	qos->read_ops.stamp = 0;
+	qos->write_ops.stamp = 0;
+	qos->read_bytes.stamp = 0;
+	qos->write_bytes.stamp = 0;
+	pthread_spin_unlock(&qos->sp);
+}
+
 /**
  * @brief Allocate a gsh_export entry.
  *
@@ -194,6 +347,7 @@ struct gsh_export *alloc_export(void)
 	if (export_st == NULL)
 		return NULL;
 
+	pthread_spin_init(&export_st->export.qos.sp, PTHREAD_PROCESS_PRIVATE);
 	return &export_st->export;
 }
 
@@ -209,6 +363,7 @@ void free_export(struct gsh_export *export)
 	struct export_stats *export_st;
 
 	free_export_resources(export);
+	pthread_spin_destroy(&export->qos.sp);
 	export_st = container_of(export, struct export_stats, export);
 	gsh_free(export_st);
 }
@@ -239,7 +394,18 @@ bool insert_gsh_export(struct gsh_export *export)
 		PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 		return false;	/* somebody beat us to it */
 	}
+	if (!ptrie_insert(&export_by_path, export->fullpath,
+			  &export->exp_path_link))
+		goto nomem;
+	if (export->pseudopath != NULL &&
+	    !ptrie_insert(&export_by_pseudo, export->pseudopath,
+			  &export->exp_pseudo_link)) {
+		ptrie_remove(&export_by_path, export->fullpath,
+			     &export->exp_path_link);
+		goto nomem;
+	}
 	pthread_rwlock_init(&export->lock, NULL);
+	pthread_rwlock_init(&export->clients_lock, NULL);
 	/* update cache */
 	cache_slot = (void **)
 		&(export_by_id.cache[eid_cache_offsetof(&export_by_id,
@@ -250,6 +416,14 @@ bool insert_gsh_export(struct gsh_export *export)
 	glist_init(&export->entry_list);
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 	return true;
+
+ nomem:
+	avltree_remove(&export->node_k, &export_by_id.t);
+	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
+	LogCrit(COMPONENT_EXPORT,
+		"Unable to allocate memory to index export %d",
+		export->export_id);
+	return false;
 }
 
 /**
@@ -257,7 +431,9 @@ bool insert_gsh_export(struct gsh_export *export)
  *
  * Lookup the export manager struct by export id.
  * Export ids are assigned by the config file and carried about
- * by file handles.
+ * by file handles.  The export's root may still be unknown with
+ * Lazy_Export_Roots; callers about to use the export for a request
+ * call init_export_root_lazy.
  *
  * @param export_id   [IN] the export id extracted from the handle
  *
@@ -341,13 +517,25 @@ void set_gsh_export_state(struct gsh_export *export, export_state_t state)
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 }
 
+static bool export_path_ready(struct glist_head *link)
+{
+	return glist_entry(link, struct gsh_export,
+			   exp_path_link)->state == EXPORT_READY;
+}
+
+static bool export_pseudo_ready(struct glist_head *link)
+{
+	return glist_entry(link, struct gsh_export,
+			   exp_pseudo_link)->state == EXPORT_READY;
+}
+
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list, assumes being called with
- * export manager lock held (such as from within foreach_gsh_export.
- * If path has a trailing '/', ignore it.
+ * Gets the export whose path is the longest prefix of path, ending at
+ * a component boundary, from the path index.  Assumes being called
+ * with export manager lock held (such as from within
+ * foreach_gsh_export.  If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
  * @param exact_match [IN] the path must match exactly
@@ -358,65 +546,16 @@ void set_gsh_export_state(struct gsh_export *export, export_state_t state)
 struct gsh_export *get_gsh_export_by_path_locked(char *path,
 						 bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
-
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->state != EXPORT_READY)
-			continue;
-
-		len_export = strlen(export->fullpath);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
-
-		/* if the char in fullpath just after the end of path is not '/'
-		 * it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
+	struct glist_head *link;
+	struct gsh_export *ret_exp;
 
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->fullpath, path, len_export) == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
+	link = ptrie_lookup(&export_by_path, path, exact_match,
+			    export_path_ready);
+	if (link == NULL)
+		return NULL;
 
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
+	ret_exp = glist_entry(link, struct gsh_export, exp_path_link);
+	get_gsh_export_ref(ret_exp);
 
 	return ret_exp;
 }
@@ -424,8 +563,7 @@ struct gsh_export *get_gsh_export_by_path_locked(char *path,
 /**
  * @brief Lookup the export manager struct by export path
  *
- * Gets an export entry from its path using a substring match and
- * linear search of the export list.
+ * Gets the export whose path is the longest prefix of path.
  * If path has a trailing '/', ignore it.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -450,8 +588,9 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 /**
  * @brief Lookup the export manager struct by export pseudo path
  *
- * Gets an export entry from its pseudo (if it exists), assumes
- * being called with export manager lock held (such as from within
+ * Gets the export whose pseudo path (if it exists) is the longest
+ * prefix of path from the pseudo path index, assumes being called
+ * with export manager lock held (such as from within
  * foreach_gsh_export.
  *
  * @param path        [IN] the path for the entry to be found.
@@ -463,75 +602,20 @@ struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match)
 struct gsh_export *get_gsh_export_by_pseudo_locked(char *path,
 						   bool exact_match)
 {
-	struct gsh_export *export;
-	struct glist_head *glist;
-	int len_path = strlen(path);
-	int len_export;
-	struct gsh_export *ret_exp = NULL;
-	int len_ret = 0;
-
-	/* Ignore trailing slash in path */
-	if (len_path > 1 && path[len_path - 1] == '/')
-		len_path--;
+	struct glist_head *link;
+	struct gsh_export *ret_exp;
 
-	glist_for_each(glist, &exportlist) {
-		export = glist_entry(glist, struct gsh_export, exp_list);
-
-		if (export->state != EXPORT_READY)
-			continue;
-
-		if (export->pseudopath == NULL)
-			continue;
-
-		len_export = strlen(export->pseudopath);
-
-		LogFullDebug(COMPONENT_EXPORT,
-			     "Comparing %s %d to %s %d",
-			     path, len_path,
-			     export->pseudopath, len_export);
-
-		if (len_path == 0 && len_export == 1) {
-			/* Special case for Pseudo root match */
-			ret_exp = export;
-			len_ret = len_export;
-			break;
-		}
-
-		/* A path shorter than the full path cannot match.
-		 * Also skip if this export has a shorter path than
-		 * the previous match.
-		 */
-		if (len_path < len_export ||
-		    len_export < len_ret)
-			continue;
-
-		/* If partial match is not allowed, lengths must be the same */
-		if (exact_match && len_path != len_export)
-			continue;
+	link = ptrie_lookup(&export_by_pseudo, path, exact_match,
+			    export_pseudo_ready);
+	if (link == NULL)
+		return NULL;
 
-		/* if the char in pseudopath just after the end of path is not
-		 * '/' it is a name token longer, i.e. /mnt/foo != /mnt/foob/
-		 */
-		if (len_export > 1 &&
-		    path[len_export] != '/' &&
-		    path[len_export] != '\0')
-			continue;
+	ret_exp = glist_entry(link, struct gsh_export, exp_pseudo_link);
 
-		/* we agree on size, now compare the leading substring
-		 */
-		if (strncmp(export->pseudopath, path, len_export)
-		    == 0) {
-			ret_exp = export;
-			len_ret = len_export;
-
-			/* If we have found an exact match, exit loop. */
-			if (len_export == len_path)
-				break;
-		}
-	}
+	LogFullDebug(COMPONENT_EXPORT,
+		     "Found %s for %s", ret_exp->pseudopath, path);
 
-	if (ret_exp != NULL)
-		get_gsh_export_ref(ret_exp);
+	get_gsh_export_ref(ret_exp);
 
 	return ret_exp;
 }
@@ -651,6 +735,8 @@ void put_gsh_export(struct gsh_export *export)
 	/* free resources */
 	free_export_resources(export);
 	pthread_rwlock_destroy(&export->lock);
+	pthread_rwlock_destroy(&export->clients_lock);
+	pthread_spin_destroy(&export->qos.sp);
 	export_st = container_of(export, struct export_stats, export);
 	server_stats_free(&export_st->st);
 	gsh_free(export_st);
@@ -687,6 +773,13 @@ void remove_gsh_export(uint16_t export_id)
 			atomic_store_voidptr(cache_slot, NULL);
 		avltree_remove(node, &export_by_id.t);
 
+		/* Remove the export from the path indexes */
+		ptrie_remove(&export_by_path, export->fullpath,
+			     &export->exp_path_link);
+		if (export->pseudopath != NULL)
+			ptrie_remove(&export_by_pseudo, export->pseudopath,
+				     &export->exp_pseudo_link);
+
 		/* Remove the export from the export list */
 		glist_del(&export->exp_list);
 	}
@@ -1150,11 +1243,149 @@ static struct gsh_dbus_method export_show_exports = {
 		 END_ARG_LIST}
 };
 
+#define QOS_ARGS(dir)			\
+{					\
+	.name = "read_ops",		\
+	.type = "t",			\
+	.direction = dir		\
+},					\
+{					\
+	.name = "write_ops",		\
+	.type = "t",			\
+	.direction = dir		\
+},					\
+{					\
+	.name = "read_bandwidth",	\
+	.type = "t",			\
+	.direction = dir		\
+},					\
+{					\
+	.name = "write_bandwidth",	\
+	.type = "t",			\
+	.direction = dir		\
+}
+
+/**
+ * @brief Change the rate limits of an export
+ *
+ * Takes the export id followed by the reads and writes per second and
+ * the bytes read and written per second, 0 meaning no limit.  The
+ * limits are bounded as in the EXPORT block.
+ */
+
+static bool gsh_export_setqos(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	uint64_t rates[4];
+	static const uint64_t max_rates[4] = {
+		EXPORT_QOS_MAX_OPS, EXPORT_QOS_MAX_OPS,
+		EXPORT_QOS_MAX_BANDWIDTH, EXPORT_QOS_MAX_BANDWIDTH
+	};
+	char *errormsg;
+	int ix;
+
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		LogDebug(COMPONENT_EXPORT, "lookup_export failed with %s",
+			errormsg);
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+			       "lookup_export failed with %s",
+			       errormsg);
+		return false;
+	}
+
+	for (ix = 0; ix < 4; ix++) {
+		if (!dbus_message_iter_next(args) ||
+		    dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT64) {
+			dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				       "rate %d is not a 64 bit integer", ix);
+			put_gsh_export(export);
+			return false;
+		}
+		dbus_message_iter_get_basic(args, &rates[ix]);
+		if (rates[ix] > max_rates[ix]) {
+			dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				       "rate %d is %"PRIu64", above the limit of %"
+				       PRIu64, ix, rates[ix], max_rates[ix]);
+			put_gsh_export(export);
+			return false;
+		}
+	}
+
+	export_qos_set(&export->qos, rates[0], rates[1], rates[2], rates[3]);
+	LogInfo(COMPONENT_EXPORT,
+		"Export %d limits set to %"PRIu64" reads/s %"PRIu64
+		" writes/s %"PRIu64" read B/s %"PRIu64" write B/s",
+		export->export_id, rates[0], rates[1], rates[2], rates[3]);
+
+	put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_set_qos = {
+	.name = "SetExportQoS",
+	.method = gsh_export_setqos,
+	.args = {ID_ARG,
+		 QOS_ARGS("in"),
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief Report the rate limits of an export
+ */
+
+static bool gsh_export_getqos(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	DBusMessageIter iter;
+	struct gsh_export *export = NULL;
+	uint64_t rates[4];
+	char *errormsg;
+	int ix;
+
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		LogDebug(COMPONENT_EXPORT, "lookup_export failed with %s",
+			errormsg);
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+			       "lookup_export failed with %s",
+			       errormsg);
+		return false;
+	}
+
+	pthread_spin_lock(&export->qos.sp);
+	rates[0] = export->qos.read_ops.rate;
+	rates[1] = export->qos.write_ops.rate;
+	rates[2] = export->qos.read_bytes.rate;
+	rates[3] = export->qos.write_bytes.rate;
+	pthread_spin_unlock(&export->qos.sp);
+	put_gsh_export(export);
+
+	dbus_message_iter_init_append(reply, &iter);
+	for (ix = 0; ix < 4; ix++)
+		dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64,
+					       &rates[ix]);
+	return true;
+}
+
+static struct gsh_dbus_method export_get_qos = {
+	.name = "GetExportQoS",
+	.method = gsh_export_getqos,
+	.args = {ID_ARG,
+		 QOS_ARGS("out"),
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_mgr_methods[] = {
 	&export_add_export,
 	&export_remove_export,
 	&export_display_export,
 	&export_show_exports,
+	&export_set_qos,
+	&export_get_qos,
 	NULL
 };
 
@@ -1418,6 +1649,42 @@ static bool show_cache_inode_stats(DBusMessageIter *args,
 	return true;
 }
 
+static bool show_buffer_pool_stats(DBusMessageIter *args,
+				   DBusMessage *reply,
+				   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	gsh_buf_dbus_show(&iter);
+
+	return true;
+}
+
+/**
+ * DBUS method to report request queue depth and steals per NUMA node
+ *
+ */
+static bool show_worker_node_stats(DBusMessageIter *args,
+				   DBusMessage *reply,
+				   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	nfs_rpc_dbus_show_nodes(&iter);
+
+	return true;
+}
+
 static struct gsh_dbus_method export_show_v41_layouts = {
 	.name = "GetNFSv41Layouts",
 	.method = get_nfsv41_export_layouts,
@@ -1502,6 +1769,78 @@ static struct gsh_dbus_method global_show_fast_ops = {
 		 END_ARG_LIST}
 };
 
+/**
+ * DBUS method to report an export's read-ahead statistics
+ */
+
+static bool get_export_readahead(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+		dbus_status_reply(&iter, success, errormsg);
+		return true;
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	server_dbus_readahead(&export->readahead, &iter);
+	put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_readahead = {
+	.name = "GetReadAhead",
+	.method = get_export_readahead,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report an export's negative lookup cache statistics
+ */
+
+static bool get_export_negcache(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+		dbus_status_reply(&iter, success, errormsg);
+		return true;
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	server_dbus_negcache(&export->negcache, &iter);
+	put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_negcache = {
+	.name = "GetNegativeCache",
+	.method = get_export_negcache,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method cache_inode_show = {
 	.name = "ShowCacheInode",
 	.method = show_cache_inode_stats,
@@ -1512,6 +1851,24 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method buffer_pool_show = {
+	.name = "ShowBufferPools",
+	.method = show_buffer_pool_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 BUFFER_POOL_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method worker_nodes_show = {
+	.name = "ShowWorkerNodes",
+	.method = show_worker_node_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 REQ_NODES_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v3_io,
 	&export_show_v40_io,
@@ -1519,9 +1876,13 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v41_layouts,
 	&export_show_total_ops,
 	&export_show_9p_io,
+	&export_show_readahead,
+	&export_show_negcache,
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&buffer_pool_show,
+	&worker_nodes_show,
 	NULL
 };
 
@@ -1565,6 +1926,8 @@ void export_pkginit(void)
 	export_by_id.cache =
 	    gsh_calloc(export_by_id.cache_sz, sizeof(struct avltree_node *));
 	glist_init(&exportlist);
+	ptrie_init(&export_by_path);
+	ptrie_init(&export_by_pseudo);
 	glist_init(&mount_work);
 	glist_init(&unexport_work);
 }
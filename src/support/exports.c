@@ -547,6 +547,27 @@ static void *fsal_init(void *link_mem, void *self_struct)
 	}
 }
 
+/**
+ * @brief Chomp trailing slashes off an export's path
+ *
+ * Some admins stuff a '/' at  the end for some reason.
+ * chomp it so we have a /dir/path/basename to work
+ * with. But only if it's a non-root path starting
+ * with /.
+ */
+
+static void chomp_export_path(struct gsh_export *export)
+{
+	if (export->fullpath[0] == '/') {
+		int pathlen;
+		pathlen = strlen(export->fullpath);
+		while ((export->fullpath[pathlen - 1] == '/') &&
+		       (pathlen > 1))
+			pathlen--;
+		export->fullpath[pathlen] = '\0';
+	}
+}
+
 /**
  * @brief Commit a FSAL sub-block
  *
@@ -614,19 +635,7 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 		}
 	}
 
-	/* Some admins stuff a '/' at  the end for some reason.
-	 * chomp it so we have a /dir/path/basename to work
-	 * with. But only if it's a non-root path starting
-	 * with /.
-	 */
-	if (export->fullpath[0] == '/') {
-		int pathlen;
-		pathlen = strlen(export->fullpath);
-		while ((export->fullpath[pathlen - 1] == '/') &&
-		       (pathlen > 1))
-			pathlen--;
-		export->fullpath[pathlen] = '\0';
-	}
+	chomp_export_path(export);
 	status = fsal->ops->create_export(fsal,
 					  node,
 					  &fsal_up_top);
@@ -646,6 +655,7 @@ static int fsal_commit(void *node, void *link_mem, void *self_struct,
 
 	assert(root_op_context.req_ctx.fsal_export != NULL);
 	export->fsal_export = root_op_context.req_ctx.fsal_export;
+	export->fsal_config = config_block_text(node);
 
 	/* We are connected up to the fsal side.  Now
 	 * validate maxread/write etc with fsal params
@@ -672,6 +682,58 @@ err:
 	return errcnt;
 }
 
+/**
+ * @brief Commit a FSAL sub-block being reloaded
+ *
+ * An export updated in place keeps its fsal_export, so nothing is
+ * created here.  If the export exists and the sub-block is exactly the
+ * one it was created with, borrow its fsal_export so that
+ * update_export_commit can tell.  Any other change to the sub-block
+ * leaves it unborrowed, and the export is replaced.
+ */
+
+static int fsal_update_commit(void *node, void *link_mem, void *self_struct,
+			      struct config_error_type *err_type)
+{
+	struct fsal_export **exp_hdl = link_mem;
+	struct fsal_params *fp = self_struct;
+	struct gsh_export *export, *live;
+	char *text;
+
+	if (fp->name == NULL || strlen(fp->name) == 0) {
+		LogCrit(COMPONENT_CONFIG,
+			"Name of FSAL is empty");
+		err_type->missing = true;
+		return 1;
+	}
+
+	export = container_of(exp_hdl, struct gsh_export, fsal_export);
+	chomp_export_path(export);
+
+	live = get_gsh_export(export->export_id);
+	if (live == NULL)
+		return 0;
+
+	text = config_block_text(node);
+	if (live->fsal_export == NULL || live->fsal_config == NULL ||
+	    text == NULL ||
+	    strcasecmp(live->fsal_export->fsal->name, fp->name) != 0)
+		goto out;
+
+	if (strcmp(live->fsal_config, text) == 0)
+		*exp_hdl = live->fsal_export;
+	else
+		LogInfo(COMPONENT_CONFIG,
+			"FSAL parameters of export %d changed, replacing it",
+			live->export_id);
+
+ out:
+	if (text != NULL)
+		gsh_free(text);
+	put_gsh_export(live);
+	return 0;
+}
+
 /**
  * @brief EXPORT block handlers
  */
@@ -704,37 +766,29 @@ static void *export_init(void *link_mem, void *self_struct)
 }
 
 /**
- * @brief Commit an export block
+ * @brief Validate the export level parameters of an export block
  *
- * Validate the export level parameters.  fsal and client
- * parameters are already done.
+ * @return 0 if valid, else the error count.
  */
 
-static int export_commit(void *node, void *link_mem, void *self_struct,
-			 struct config_error_type *err_type)
+static int check_export_params(struct gsh_export *export,
+			       struct config_error_type *err_type)
 {
-	struct gsh_export *export, *probe_exp;
 	int errcnt = 0;
-	char perms[1024];
 
-	export = self_struct;
-
-	/* validate the export now */
 	if (export->export_perms.options & EXPORT_OPTION_NFSV4) {
 		if (export->pseudopath == NULL) {
 			LogCrit(COMPONENT_CONFIG,
 				"Exporting to NFSv4 but not Pseudo path defined");
 			err_type->invalid = true;
-			errcnt++;
-			goto err_out;
+			return 1;
 		} else if (export->export_id == 0 &&
 			   strcmp(export->pseudopath, "/") != 0) {
 			LogCrit(COMPONENT_CONFIG,
 				"Export id 0 can only export \"/\" not (%s)",
 				export->pseudopath);
 			err_type->invalid = true;
-			errcnt++;
-			goto err_out;
+			return 1;
 		}
 	}
 	if (export->pseudopath != NULL &&
@@ -764,6 +818,26 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 			errcnt++;
 		}
 	}
+	return errcnt;
+}
+
+/**
+ * @brief Commit an export block
+ *
+ * Validate the export level parameters.  fsal and client
+ * parameters are already done.
+ */
+
+static int export_commit(void *node, void *link_mem, void *self_struct,
+			 struct config_error_type *err_type)
+{
+	struct gsh_export *export, *probe_exp;
+	int errcnt = 0;
+	char perms[1024];
+
+	export = self_struct;
+
+	errcnt = check_export_params(export, err_type);
 	if (errcnt)
 		goto err_out;  /* have basic errors. don't even try more... */
 	probe_exp = get_gsh_export(export->export_id);
@@ -906,6 +980,167 @@ err_out:
 	return errcnt;
 }
 
+/**
+ * @brief What reload_exports is to do with an EXPORT block
+ */
+
+enum export_reload_action {
+	EXPORT_RELOAD_NONE,	/*< Nothing, the block is in error */
+	EXPORT_RELOAD_UPDATED,	/*< Updated in place, nothing more */
+	EXPORT_RELOAD_ADD,	/*< No such export, add it */
+	EXPORT_RELOAD_REPLACE	/*< Not updatable in place, remove and add */
+};
+
+/* Serializes reloads, and protects export_reload_action */
+static pthread_mutex_t export_reload_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Set by update_export_commit for the block being reloaded */
+static enum export_reload_action export_reload_action;
+static uint16_t export_reload_id;
+
+/**
+ * @brief Initialize an export block being reloaded
+ *
+ * As export_init, but the fsal_export, if any, is borrowed from the
+ * live export by fsal_update_commit and must not be released.
+ */
+
+static void *update_export_init(void *link_mem, void *self_struct)
+{
+	struct gsh_export *export = self_struct;
+
+	if (export != NULL)
+		export->fsal_export = NULL;
+	return export_init(link_mem, self_struct);
+}
+
+static bool same_str(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return strcmp(a, b) == 0;
+}
+
+/**
+ * @brief Whether a reloaded export block can update an export in place
+ *
+ * Anything that decides where the export is found, or what it is
+ * mounted on in the PseudoFS, takes a new export, as does any change
+ * to the FSAL sub-block (see fsal_update_commit).
+ */
+
+static bool export_updatable(struct gsh_export *live,
+			     struct gsh_export *export)
+{
+	return export->fsal_export == live->fsal_export &&
+	       strcmp(export->fullpath, live->fullpath) == 0 &&
+	       same_str(export->pseudopath, live->pseudopath) &&
+	       same_str(export->FS_tag, live->FS_tag) &&
+	       (export->options_set & EXPORT_OPTION_FSID_SET) ==
+			(live->options_set & EXPORT_OPTION_FSID_SET) &&
+	       memcmp(&export->filesystem_id, &live->filesystem_id,
+		      sizeof(live->filesystem_id)) == 0 &&
+	       (export->export_perms.options & EXPORT_OPTION_NFSV4) ==
+			(live->export_perms.options & EXPORT_OPTION_NFSV4);
+}
+
+/**
+ * @brief Commit an export block being reloaded
+ *
+ * If the export exists and can be updated in place, swap in its new
+ * client list under its clients lock and its options under the
+ * export lock, keeping its cache
+ * entries, state and statistics.  Otherwise leave it to
+ * reload_exports, through export_reload_action.  Either way the
+ * block's own export is freed here.
+ */
+
+static int update_export_commit(void *node, void *link_mem,
+				void *self_struct,
+				struct config_error_type *err_type)
+{
+	struct gsh_export *export = self_struct;
+	struct gsh_export *live;
+	struct glist_head old_clients;
+	uint64_t MaxRead, MaxWrite;
+	char perms[1024];
+	int errcnt;
+
+	export_reload_action = EXPORT_RELOAD_NONE;
+	export_reload_id = export->export_id;
+
+	errcnt = check_export_params(export, err_type);
+	if (errcnt)
+		return errcnt;
+
+	live = get_gsh_export(export->export_id);
+	if (live == NULL) {
+		export_reload_action = EXPORT_RELOAD_ADD;
+		goto out;
+	}
+
+	if (!export_updatable(live, export)) {
+		export_reload_action = EXPORT_RELOAD_REPLACE;
+		put_gsh_export(live);
+		goto out;
+	}
+
+	MaxRead = live->fsal_export->ops->fs_maxread(live->fsal_export);
+	MaxWrite = live->fsal_export->ops->fs_maxwrite(live->fsal_export);
+	if (export->MaxRead > MaxRead && MaxRead != 0)
+		export->MaxRead = MaxRead;
+	if (export->MaxWrite > MaxWrite && MaxWrite != 0)
+		export->MaxWrite = MaxWrite;
+	if ((export->options_set & EXPORT_OPTION_EXPIRE_SET) == 0)
+		export->expire_time_attr = cache_param.expire_time_attr;
+
+	glist_init(&old_clients);
+
+	PTHREAD_RWLOCK_wrlock(&live->clients_lock);
+
+	glist_splice_tail(&old_clients, &live->clients);
+	glist_splice_tail(&live->clients, &export->clients);
+	live->export_perms = export->export_perms;
+
+	PTHREAD_RWLOCK_unlock(&live->clients_lock);
+
+	PTHREAD_RWLOCK_wrlock(&live->lock);
+
+	live->options = export->options;
+	live->options_set = export->options_set;
+	live->MaxRead = export->MaxRead;
+	live->MaxWrite = export->MaxWrite;
+	live->PrefRead = export->PrefRead;
+	live->PrefWrite = export->PrefWrite;
+	live->PrefReaddir = export->PrefReaddir;
+	live->MaxOffsetRead = export->MaxOffsetRead;
+	live->MaxOffsetWrite = export->MaxOffsetWrite;
+	live->expire_time_attr = export->expire_time_attr;
+	live->sched_weight = export->sched_weight;
+
+	PTHREAD_RWLOCK_unlock(&live->lock);
+
+	export_qos_set(&live->qos,
+		       export->qos.read_ops.rate, export->qos.write_ops.rate,
+		       export->qos.read_bytes.rate,
+		       export->qos.write_bytes.rate);
+
+	/* The old clients go with the block's export */
+	glist_splice_tail(&export->clients, &old_clients);
+
+	StrExportOptions(&live->export_perms, perms);
+	LogEvent(COMPONENT_CONFIG,
+		 "Export %d at pseudo (%s) with path (%s) updated perms (%s)",
+		 live->export_id, live->pseudopath, live->fullpath, perms);
+
+	export_reload_action = EXPORT_RELOAD_UPDATED;
+	put_gsh_export(live);
+
+ out:
+	(void) update_export_init(link_mem, export);
+	return 0;
+}
+
 /**
  * @brief Initialize an EXPORT_DEFAULTS block
  *
@@ -1124,6 +1359,60 @@ static struct config_item fsal_params[] = {
 	CONFIG_EOL
 };
 
+/**
+ * @brief EXPORT block parameters other than the FSAL sub-block
+ */
+
+#define CONF_EXPORT_PARAMS						\
+	CONF_MAND_UI16("Export_id", 0, UINT16_MAX, 1,			\
+		       gsh_export, export_id),				\
+	CONF_MAND_PATH("Path", 1, MAXPATHLEN, NULL,			\
+		       gsh_export, fullpath), /* must chomp '/' */	\
+	CONF_UNIQ_PATH("Pseudo", 1, MAXPATHLEN, NULL,			\
+		       gsh_export, pseudopath),				\
+	CONF_ITEM_UI64("MaxRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, MaxRead),				\
+	CONF_ITEM_UI64("MaxWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, MaxWrite),				\
+	CONF_ITEM_UI64("PrefRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,	\
+		       gsh_export, PrefRead),				\
+	CONF_ITEM_UI64("PrefWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE, \
+		       gsh_export, PrefWrite),				\
+	CONF_ITEM_UI64("PrefReaddir", 512, FSAL_MAXIOSIZE, 16384,	\
+		       gsh_export, PrefReaddir),			\
+	CONF_ITEM_FSID_SET("Filesystem_id", 666, 666,			\
+		       gsh_export, filesystem_id, /* major.minor */	\
+		       EXPORT_OPTION_FSID_SET, options_set),		\
+	CONF_ITEM_STR("Tag", 1, MAXPATHLEN, NULL,			\
+		      gsh_export, FS_tag),				\
+	CONF_ITEM_UI64("MaxOffsetWrite", 512, UINT64_MAX, UINT64_MAX,	\
+		       gsh_export, MaxOffsetWrite),			\
+	CONF_ITEM_UI64("MaxOffsetRead", 512, UINT64_MAX, UINT64_MAX,	\
+		       gsh_export, MaxOffsetRead),			\
+	CONF_ITEM_UI32("Sched_Weight", 1, 1000, 1,			\
+		       gsh_export, sched_weight),			\
+	CONF_ITEM_UI64("Max_Read_Ops", 0, EXPORT_QOS_MAX_OPS, 0,	\
+		       gsh_export, qos.read_ops.rate),			\
+	CONF_ITEM_UI64("Max_Write_Ops", 0, EXPORT_QOS_MAX_OPS, 0,	\
+		       gsh_export, qos.write_ops.rate),			\
+	CONF_ITEM_UI64("Max_Read_Bandwidth", 0, EXPORT_QOS_MAX_BANDWIDTH, \
+		       0, gsh_export, qos.read_bytes.rate),		\
+	CONF_ITEM_UI64("Max_Write_Bandwidth", 0, EXPORT_QOS_MAX_BANDWIDTH, \
+		       0, gsh_export, qos.write_bytes.rate),		\
+	CONF_ITEM_BOOLBIT_SET("UseCookieVerifier",			\
+		true, EXPORT_OPTION_USE_COOKIE_VERIFIER,		\
+		gsh_export, options, options_set),			\
+	CONF_ITEM_BOOLBIT_SET("Trust_Readdir_Negative_Cache",		\
+		false, EXPORT_OPTION_TRUST_READIR_NEGATIVE_CACHE,	\
+		gsh_export, options, options_set),			\
+	CONF_EXPORT_PERMS(gsh_export, export_perms),			\
+	CONF_ITEM_BLOCK("Client", client_params,			\
+			client_init, client_commit,			\
+			gsh_export, clients),				\
+	CONF_ITEM_I32_SET("Attr_Expiration_Time", -1, INT32_MAX, 60,	\
+		       gsh_export, expire_time_attr,			\
+		       EXPORT_OPTION_EXPIRE_SET,  options_set)
+
 /**
  * @brief Table of EXPORT block parameters
  *
@@ -1134,50 +1423,27 @@ static struct config_item fsal_params[] = {
  */
 
 static struct config_item export_params[] = {
-	CONF_MAND_UI16("Export_id", 0, UINT16_MAX, 1,
-		       gsh_export, export_id),
-	CONF_MAND_PATH("Path", 1, MAXPATHLEN, NULL,
-		       gsh_export, fullpath), /* must chomp '/' */
-	CONF_UNIQ_PATH("Pseudo", 1, MAXPATHLEN, NULL,
-		       gsh_export, pseudopath),
-	CONF_ITEM_UI64("MaxRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, MaxRead),
-	CONF_ITEM_UI64("MaxWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, MaxWrite),
-	CONF_ITEM_UI64("PrefRead", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, PrefRead),
-	CONF_ITEM_UI64("PrefWrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       gsh_export, PrefWrite),
-	CONF_ITEM_UI64("PrefReaddir", 512, FSAL_MAXIOSIZE, 16384,
-		       gsh_export, PrefReaddir),
-	CONF_ITEM_FSID_SET("Filesystem_id", 666, 666,
-		       gsh_export, filesystem_id, /* major.minor */
-		       EXPORT_OPTION_FSID_SET, options_set),
-	CONF_ITEM_STR("Tag", 1, MAXPATHLEN, NULL,
-		      gsh_export, FS_tag),
-	CONF_ITEM_UI64("MaxOffsetWrite", 512, UINT64_MAX, UINT64_MAX,
-		       gsh_export, MaxOffsetWrite),
-	CONF_ITEM_UI64("MaxOffsetRead", 512, UINT64_MAX, UINT64_MAX,
-		       gsh_export, MaxOffsetRead),
-	CONF_ITEM_BOOLBIT_SET("UseCookieVerifier",
-		true, EXPORT_OPTION_USE_COOKIE_VERIFIER,
-		gsh_export, options, options_set),
-	CONF_ITEM_BOOLBIT_SET("Trust_Readdir_Negative_Cache",
-		false, EXPORT_OPTION_TRUST_READIR_NEGATIVE_CACHE,
-		gsh_export, options, options_set),
-	CONF_EXPORT_PERMS(gsh_export, export_perms),
-	CONF_ITEM_BLOCK("Client", client_params,
-			client_init, client_commit,
-			gsh_export, clients),
-	CONF_ITEM_I32_SET("Attr_Expiration_Time", -1, INT32_MAX, 60,
-		       gsh_export, expire_time_attr,
-		       EXPORT_OPTION_EXPIRE_SET,  options_set),
+	CONF_EXPORT_PARAMS,
 	CONF_RELAX_BLOCK("FSAL", fsal_params,
 			 fsal_init, fsal_commit,
 			 gsh_export, fsal_export),
 	CONFIG_EOL
 };
 
+/**
+ * @brief Table of EXPORT block parameters for a reload
+ *
+ * As export_params, but the FSAL sub-block creates nothing.
+ */
+
+static struct config_item update_export_params[] = {
+	CONF_EXPORT_PARAMS,
+	CONF_RELAX_BLOCK("FSAL", fsal_params,
+			 fsal_init, fsal_update_commit,
+			 gsh_export, fsal_export),
+	CONFIG_EOL
+};
+
 /**
  * @brief Top level definition for an EXPORT block
  */
@@ -1207,6 +1473,19 @@ struct config_block add_export_param = {
 };
 
 
+/**
+ * @brief Top level definition for an EXPORT block being reloaded
+ */
+
+static struct config_block update_export_param = {
+	.dbus_interface_name = "org.ganesha.nfsd.config.%d",
+	.blk_desc.name = "EXPORT",
+	.blk_desc.type = CONFIG_BLOCK,
+	.blk_desc.u.blk.init = update_export_init,
+	.blk_desc.u.blk.params = update_export_params,
+	.blk_desc.u.blk.commit = update_export_commit
+};
+
 /**
  * @brief Top level definition for an EXPORT_DEFAULTS block
  */
@@ -1406,6 +1685,169 @@ int ReadExports(config_file_t in_config)
 	return rc + ret;
 }
 
+/**
+ * @brief Exports the configuration being reloaded leaves out
+ */
+
+struct export_reload_state {
+	uint8_t *seen;		/*< Bit per export id in the configuration */
+	struct gsh_export **exports;	/*< Referenced exports to remove */
+	uint32_t count;
+	uint32_t size;
+};
+
+/**
+ * @brief Collect exports a reload has not seen
+ *
+ * Called with the export_by_id.lock held.  Export id 0 may have
+ * been built by build_default_root, so it stays.
+ */
+
+static bool collect_unseen_cb(struct gsh_export *exp, void *state)
+{
+	struct export_reload_state *rs = state;
+	struct gsh_export **exports;
+
+	if (exp->export_id == 0 ||
+	    (rs->seen[exp->export_id / 8] & (1 << (exp->export_id % 8))))
+		return true;
+
+	if (rs->count == rs->size) {
+		exports = gsh_realloc(rs->exports, (rs->size * 2 + 16) *
+				      sizeof(*exports));
+		if (exports == NULL)
+			return false;
+		rs->exports = exports;
+		rs->size = rs->size * 2 + 16;
+	}
+
+	get_gsh_export_ref(exp);
+	rs->exports[rs->count++] = exp;
+	return true;
+}
+
+/**
+ * @brief Bring the exports in line with a reread configuration
+ *
+ * Each EXPORT block is compared with the live export of its
+ * Export_Id.  Where only permissions, client lists and other
+ * options differ, the export is updated in place and keeps its
+ * cache entries, state and statistics, so clients never notice.
+ * Exports whose path, pseudo path, tag, filesystem id or anything
+ * in the FSAL sub-block changed are removed and created anew, new
+ * ones are added, and those the configuration no longer has are
+ * removed, as the AddExport and RemoveExport DBus methods would.
+ * EXPORT_DEFAULTS is not reread.
+ *
+ * @param[in] in_config The reread configuration
+ *
+ * @return The number of exports changed, or -1 if any block was in
+ *         error.  Blocks without errors are applied either way, but
+ *         then no export is removed.
+ */
+
+int reload_exports(config_file_t in_config)
+{
+	struct config_node_list *config_list, *lp, *lp_next;
+	struct config_error_type err_type;
+	struct export_reload_state rs;
+	struct gsh_export *export;
+	uint16_t export_id;
+	int rc, changed = 0, updated = 0, errors = 0;
+	uint32_t i;
+
+	memset(&rs, 0, sizeof(rs));
+	rs.seen = gsh_calloc(UINT16_MAX / 8 + 1, 1);
+	if (rs.seen == NULL)
+		return -1;
+
+	PTHREAD_MUTEX_lock(&export_reload_mtx);
+
+	rc = find_config_nodes(in_config, "EXPORT(Export_Id=*)",
+			       &config_list);
+	if (rc != 0)
+		config_list = NULL;
+
+	for (lp = config_list; lp != NULL; lp = lp_next) {
+		lp_next = lp->next;
+
+		export_reload_action = EXPORT_RELOAD_NONE;
+		rc = load_config_from_node(lp->tree_node,
+					   &update_export_param,
+					   NULL,
+					   false,
+					   &err_type);
+		if (rc != 0 || export_reload_action == EXPORT_RELOAD_NONE) {
+			errors++;
+			goto next;
+		}
+
+		export_id = export_reload_id;
+		rs.seen[export_id / 8] |= 1 << (export_id % 8);
+
+		if (export_reload_action == EXPORT_RELOAD_UPDATED) {
+			updated++;
+			goto next;
+		}
+
+		if (export_reload_action == EXPORT_RELOAD_REPLACE) {
+			if (export_id == 0) {
+				LogCrit(COMPONENT_CONFIG,
+					"Export id 0 can only be updated in place");
+				errors++;
+				goto next;
+			}
+			export = get_gsh_export(export_id);
+			if (export != NULL) {
+				LogEvent(COMPONENT_CONFIG,
+					 "Export %d changed identity, replacing it",
+					 export_id);
+				unexport(export);
+				put_gsh_export(export);
+			}
+		}
+
+		rc = load_config_from_node(lp->tree_node,
+					   &add_export_param,
+					   NULL,
+					   false,
+					   &err_type);
+		if (rc == 0 || config_error_is_harmless(&err_type))
+			changed++;
+		else
+			errors++;
+ next:
+		gsh_free(lp);
+	}
+
+	/* A block in error may be an export that is still wanted */
+	if (errors != 0)
+		LogWarn(COMPONENT_CONFIG,
+			"Not removing exports left out of the configuration because of errors");
+	else if (!foreach_gsh_export(collect_unseen_cb, &rs))
+		LogCrit(COMPONENT_CONFIG,
+			"Out of memory collecting exports to remove");
+
+	for (i = 0; i < rs.count; i++) {
+		LogEvent(COMPONENT_CONFIG,
+			 "Export %d is no longer configured, removing it",
+			 rs.exports[i]->export_id);
+		unexport(rs.exports[i]);
+		put_gsh_export(rs.exports[i]);
+		changed++;
+	}
+
+	PTHREAD_MUTEX_unlock(&export_reload_mtx);
+
+	LogEvent(COMPONENT_CONFIG,
+		 "Reloaded exports: %d updated in place, %d added or removed, %d blocks in error",
+		 updated, changed, errors);
+
+	gsh_free(rs.exports);
+	gsh_free(rs.seen);
+	return errors != 0 ? -1 : updated + changed;
+}
+
 static void FreeClientList(struct glist_head *clients)
 {
 	struct glist_head *glist;
@@ -1447,6 +1889,9 @@ void free_export_resources(struct gsh_export *export)
 	}
 	export->fsal_export = NULL;
 	/* free strings here */
+	if (export->fsal_config != NULL)
+		gsh_free(export->fsal_config);
+	export->fsal_config = NULL;
 	if (export->fullpath != NULL)
 		gsh_free(export->fullpath);
 	if (export->pseudopath != NULL)
@@ -1456,23 +1901,262 @@ void free_export_resources(struct gsh_export *export)
 }
 
 /**
- * @brief pkginit callback to initialize exports from nfs_init
+ * @brief States of exp_root_pending
+ */
+
+enum export_root_state {
+	EXPORT_ROOT_DONE,	/*< Looked up, or not to be */
+	EXPORT_ROOT_PENDING,	/*< To look up on first use */
+	EXPORT_ROOT_BUSY	/*< Being looked up */
+};
+
+/* Serializes lazy root lookups, and waits for them */
+static pthread_mutex_t export_root_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_root_cv = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Exports whose roots exports_pkginit is looking up
+ */
+
+struct export_root_batch {
+	struct gsh_export **exports;	/*< Referenced exports */
+	uint32_t count;
+	uint32_t size;
+	uint32_t next;		/*< Next export to take, atomic */
+	uint32_t failed;	/*< Lookups that failed, atomic */
+	uint32_t running;	/*< Jobs in the fridge, protected by mtx */
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+};
+
+/**
+ * @brief pkginit callback to collect exports from nfs_init
+ *
+ * Called with the export_by_id.lock held.
+ */
+
+static bool collect_export_cb(struct gsh_export *exp, void *state)
+{
+	struct export_root_batch *batch = state;
+	struct gsh_export **exports;
+
+	if (batch->count == batch->size) {
+		batch->size = batch->size ? 2 * batch->size : 64;
+		exports = gsh_realloc(batch->exports,
+				      batch->size * sizeof(*exports));
+		if (exports == NULL)
+			LogFatal(COMPONENT_INIT,
+				 "Unable to allocate memory for export roots");
+		batch->exports = exports;
+	}
+
+	get_gsh_export_ref(exp);
+	batch->exports[batch->count++] = exp;
+	return true;
+}
+
+/**
+ * @brief Look up export roots until none are left
  *
- * Assumes being called with the export_by_id.lock held.
+ * Run by exports_pkginit and its helper threads alike, each taking
+ * the next export not yet taken.
  */
 
-static bool init_export_cb(struct gsh_export *exp, void *state)
+static void init_export_roots(struct export_root_batch *batch)
 {
-	return init_export_root(exp);
+	uint32_t i;
+
+	while ((i = atomic_inc_uint32_t(&batch->next) - 1) < batch->count) {
+		if (!init_export_root(batch->exports[i]))
+			atomic_inc_uint32_t(&batch->failed);
+	}
+}
+
+static void init_export_roots_job(struct fridgethr_context *ctx)
+{
+	struct export_root_batch *batch = ctx->arg;
+
+	init_export_roots(batch);
+
+	PTHREAD_MUTEX_lock(&batch->mtx);
+	if (--batch->running == 0)
+		pthread_cond_signal(&batch->cv);
+	PTHREAD_MUTEX_unlock(&batch->mtx);
 }
 
 /**
  * @brief Initialize exports over a live cache inode and fsal layer
+ *
+ * Each export root costs a path lookup in its FSAL, which for a
+ * network FSAL is a round trip or several, so with many exports they
+ * are looked up Export_Root_Threads at a time.  With
+ * Lazy_Export_Roots they are left to init_export_root_lazy instead.
  */
 
 void exports_pkginit(void)
 {
-	foreach_gsh_export(init_export_cb, NULL);
+	struct export_root_batch batch;
+	struct fridgethr_params frp;
+	struct fridgethr *fr = NULL;
+	struct timespec start, end;
+	uint32_t threads = nfs_param.core_param.export_root_threads;
+	uint32_t i;
+	int rc;
+
+	now(&start);
+
+	memset(&batch, 0, sizeof(batch));
+	pthread_mutex_init(&batch.mtx, NULL);
+	pthread_cond_init(&batch.cv, NULL);
+
+	foreach_gsh_export(collect_export_cb, &batch);
+
+	if (nfs_param.core_param.lazy_export_roots) {
+		for (i = 0; i < batch.count; i++)
+			atomic_store_uint32_t(
+				&batch.exports[i]->exp_root_pending,
+				EXPORT_ROOT_PENDING);
+
+		LogEvent(COMPONENT_INIT,
+			 "Roots of %" PRIu32 " exports will be looked up on first use",
+			 batch.count);
+		goto out;
+	}
+
+	if (threads > batch.count)
+		threads = batch.count;
+
+	if (threads > 1) {
+		memset(&frp, 0, sizeof(struct fridgethr_params));
+		frp.thr_max = threads - 1;
+		frp.deferment = fridgethr_defer_fail;
+		rc = fridgethr_init(&fr, "Export_Root", &frp);
+		if (rc != 0) {
+			LogMajor(COMPONENT_INIT,
+				 "Unable to initialize export root fridge: %d, looking up export roots serially",
+				 rc);
+			fr = NULL;
+			threads = 1;
+		}
+	}
+
+	for (i = 1; i < threads; i++) {
+		PTHREAD_MUTEX_lock(&batch.mtx);
+		batch.running++;
+		PTHREAD_MUTEX_unlock(&batch.mtx);
+
+		rc = fridgethr_submit(fr, init_export_roots_job, &batch);
+		if (rc != 0) {
+			PTHREAD_MUTEX_lock(&batch.mtx);
+			batch.running--;
+			PTHREAD_MUTEX_unlock(&batch.mtx);
+			threads = i;
+			break;
+		}
+	}
+
+	/* This thread takes a share too */
+	init_export_roots(&batch);
+
+	PTHREAD_MUTEX_lock(&batch.mtx);
+	while (batch.running != 0)
+		pthread_cond_wait(&batch.cv, &batch.mtx);
+	PTHREAD_MUTEX_unlock(&batch.mtx);
+
+	if (fr != NULL) {
+		rc = fridgethr_sync_command(fr, fridgethr_comm_stop, 120);
+		if (rc == 0)
+			fridgethr_destroy(fr);
+		else
+			LogMajor(COMPONENT_INIT,
+				 "Failed shutting down export root fridge: %d",
+				 rc);
+	}
+
+	now(&end);
+	LogEvent(COMPONENT_INIT,
+		 "Looked up %" PRIu32 " export roots (%" PRIu32
+		 " failed) with %" PRIu32 " threads in %" PRIu64 " ms",
+		 batch.count, batch.failed, threads,
+		 timespec_diff(&start, &end) / NS_PER_MSEC);
+
+ out:
+	for (i = 0; i < batch.count; i++)
+		put_gsh_export(batch.exports[i]);
+	gsh_free(batch.exports);
+	pthread_cond_destroy(&batch.cv);
+	pthread_mutex_destroy(&batch.mtx);
+}
+
+/**
+ * @brief Look up an export's root if that was left to first use
+ *
+ * With Lazy_Export_Roots, nfs_export_get_root_entry and the
+ * protocol paths that cross into an export by file handle come
+ * through here first; get_gsh_export itself stays a plain lookup, so
+ * that the decoder, QoS and DBus never wait on an FSAL.  Once the
+ * root is looked up, this is a single atomic load.
+ *
+ * @param[in] export The export, referenced by the caller
+ */
+
+void init_export_root_lazy(struct gsh_export *export)
+{
+	if (likely(atomic_fetch_uint32_t(&export->exp_root_pending) ==
+		   EXPORT_ROOT_DONE))
+		return;
+
+	PTHREAD_MUTEX_lock(&export_root_mtx);
+
+	while (export->exp_root_pending == EXPORT_ROOT_BUSY)
+		pthread_cond_wait(&export_root_cv, &export_root_mtx);
+
+	if (export->exp_root_pending == EXPORT_ROOT_PENDING) {
+		atomic_store_uint32_t(&export->exp_root_pending,
+				      EXPORT_ROOT_BUSY);
+		PTHREAD_MUTEX_unlock(&export_root_mtx);
+
+		LogDebug(COMPONENT_EXPORT,
+			 "Looking up root of export_id=%d on first use",
+			 export->export_id);
+
+		/* On failure the export has no root, just as when the
+		 * lookup fails at startup.
+		 */
+		(void) init_export_root(export);
+
+		PTHREAD_MUTEX_lock(&export_root_mtx);
+		atomic_store_uint32_t(&export->exp_root_pending,
+				      EXPORT_ROOT_DONE);
+		pthread_cond_broadcast(&export_root_cv);
+	}
+
+	PTHREAD_MUTEX_unlock(&export_root_mtx);
+}
+
+/**
+ * @brief Forget a root lookup left to first use
+ *
+ * Waits out any lookup in progress, so the export is settled either
+ * way.
+ *
+ * @param[in] export The export
+ */
+
+static void cancel_export_root_lazy(struct gsh_export *export)
+{
+	if (likely(atomic_fetch_uint32_t(&export->exp_root_pending) ==
+		   EXPORT_ROOT_DONE))
+		return;
+
+	PTHREAD_MUTEX_lock(&export_root_mtx);
+
+	while (export->exp_root_pending == EXPORT_ROOT_BUSY)
+		pthread_cond_wait(&export_root_cv, &export_root_mtx);
+
+	atomic_store_uint32_t(&export->exp_root_pending, EXPORT_ROOT_DONE);
+
+	PTHREAD_MUTEX_unlock(&export_root_mtx);
 }
 
 /**
@@ -1516,6 +2200,8 @@ cache_inode_status_t export_get_root_entry(cache_entry_t **entry, void *source)
 cache_inode_status_t nfs_export_get_root_entry(struct gsh_export *export,
 					       cache_entry_t **entry)
 {
+	init_export_root_lazy(export);
+
 	return cache_inode_get_protected(entry,
 					 &export->lock,
 					 export_get_root_entry,
@@ -1525,7 +2211,8 @@ cache_inode_status_t nfs_export_get_root_entry(struct gsh_export *export,
 /**
  * @brief Initialize the root cache inode for an export.
  *
- * Assumes being called with the export_by_id.lock held.
+ * Must be called with the caller holding a reference to the export.
+ * Roots of different exports may be initialized concurrently.
  *
  * @param exp [IN] the export
  *
@@ -1680,6 +2367,9 @@ void release_export_root(struct gsh_export *export)
 	cache_entry_t *entry = NULL;
 	cache_inode_status_t status;
 
+	/* Don't look up a root only to release it */
+	cancel_export_root_lazy(export);
+
 	/* Get a reference to the root entry */
 	status = nfs_export_get_root_entry(export, &entry);
 
@@ -2214,6 +2904,10 @@ void export_check_access(void)
 			    op_ctx->export->fullpath);
 	}
 
+	/* The client list and permissions may be swapped by
+	 * reload_exports */
+	PTHREAD_RWLOCK_rdlock(&op_ctx->export->clients_lock);
+
 	/* Does the client match anyone on the client list? */
 	client = client_match_any(hostaddr, op_ctx->export);
 	if (client != NULL) {
@@ -2310,4 +3004,6 @@ void export_check_access(void)
 			    "Final options   (%s)",
 			    perms);
 	}
+
+	PTHREAD_RWLOCK_unlock(&op_ctx->export->clients_lock);
 }				/* nfs_export_check_access */
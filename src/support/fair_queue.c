@@ -0,0 +1,269 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup fair_queue
+ * @{
+ */
+
+/**
+ * @file fair_queue.c
+ * @brief Deficit round robin queue
+ */
+
+#include <stdint.h>
+#include "abstract_mem.h"
+#include "fair_queue.h"
+
+/**
+ * @brief Hash a flow key
+ *
+ * @param[in] client    Client
+ * @param[in] export_id Export
+ *
+ * @return Bucket index.
+ */
+
+static inline uint32_t fq_hash(const void *client, int32_t export_id)
+{
+	uint64_t h = ((uintptr_t) client >> 4) ^
+		     ((uint64_t) (uint32_t) export_id * 2654435761U);
+
+	return (h ^ (h >> 17)) & (FQ_HASH_SIZE - 1);
+}
+
+/**
+ * @brief Find the flow for a key
+ *
+ * @param[in] fq        Queue
+ * @param[in] client    Client
+ * @param[in] export_id Export
+ *
+ * @return The flow, or NULL if it has no items queued.
+ */
+
+static struct fq_flow *fq_lookup(struct fair_queue *fq, const void *client,
+				 int32_t export_id)
+{
+	struct glist_head *bucket = &fq->hash[fq_hash(client, export_id)];
+	struct glist_head *g;
+	struct fq_flow *flow;
+
+	glist_for_each(g, bucket) {
+		flow = glist_entry(g, struct fq_flow, hash);
+		if (flow->client == client && flow->export_id == export_id)
+			return flow;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Append an item to a flow that is on the round
+ */
+
+static void fq_add(struct fair_queue *fq, struct fq_flow *flow,
+		   struct fq_item *item)
+{
+	item->held = false;
+	glist_add_tail(&flow->q, &item->q);
+	++fq->size;
+}
+
+/**
+ * @brief Initialize an empty queue
+ *
+ * @param[out] fq    Queue
+ * @param[in]  admit Admission check for flows with an owner, or NULL
+ */
+
+void fq_init(struct fair_queue *fq, fq_admit_t admit)
+{
+	int ix;
+
+	glist_init(&fq->active);
+	for (ix = 0; ix < FQ_HASH_SIZE; ++ix)
+		glist_init(&fq->hash[ix]);
+	fq->size = 0;
+	fq->nflows = 0;
+	fq->held = 0;
+	fq->admit = admit;
+}
+
+/**
+ * @brief Queue an item on an existing flow
+ *
+ * @param[in] fq        Queue
+ * @param[in] item      Item, with its cost set
+ * @param[in] client    Client
+ * @param[in] export_id Export
+ *
+ * @return false if the flow has nothing queued, in which case the
+ *         item was not queued and fq_enqueue_flow must be used.
+ */
+
+bool fq_enqueue(struct fair_queue *fq, struct fq_item *item,
+		const void *client, int32_t export_id)
+{
+	struct fq_flow *flow = fq_lookup(fq, client, export_id);
+
+	if (flow == NULL)
+		return false;
+
+	fq_add(fq, flow, item);
+	return true;
+}
+
+/**
+ * @brief Allocate a flow for fq_enqueue_flow
+ *
+ * This may be done without holding the queue's lock.
+ *
+ * @param[in] client    Client
+ * @param[in] export_id Export
+ * @param[in] weight    Share of service, at least 1
+ * @param[in] owner     Owner for the admit callback, or NULL
+ *
+ * @return The flow, or NULL on allocation failure.
+ */
+
+struct fq_flow *fq_flow_alloc(const void *client, int32_t export_id,
+			      uint32_t weight, void *owner)
+{
+	struct fq_flow *flow = gsh_malloc(sizeof(struct fq_flow));
+
+	if (flow == NULL)
+		return NULL;
+
+	flow->client = client;
+	flow->export_id = export_id;
+	flow->weight = weight ? weight : 1;
+	flow->deficit = 0;
+	flow->owner = owner;
+	glist_init(&flow->q);
+	return flow;
+}
+
+/**
+ * @brief Queue an item on a new flow
+ *
+ * If the key got a flow since fq_enqueue failed, the item goes on
+ * that and @c flow is freed.  Otherwise @c flow joins the end of the
+ * round with one quantum of credit.
+ *
+ * @param[in] fq   Queue
+ * @param[in] item Item, with its cost set
+ * @param[in] flow Flow from fq_flow_alloc, consumed
+ *
+ * @return false if @c flow was not needed, in which case its owner
+ *         is still the caller's to release.
+ */
+
+bool fq_enqueue_flow(struct fair_queue *fq, struct fq_item *item,
+		     struct fq_flow *flow)
+{
+	struct fq_flow *old = fq_lookup(fq, flow->client, flow->export_id);
+
+	if (old != NULL) {
+		gsh_free(flow);
+		fq_add(fq, old, item);
+		return false;
+	}
+
+	flow->deficit = (int64_t) FQ_QUANTUM * flow->weight;
+	glist_add_tail(&fq->hash[fq_hash(flow->client, flow->export_id)],
+		       &flow->hash);
+	glist_add_tail(&fq->active, &flow->active);
+	++fq->nflows;
+	fq_add(fq, flow, item);
+	return true;
+}
+
+/**
+ * @brief Take the next item in deficit round robin order
+ *
+ * The flow at the head of the round is served while its deficit
+ * covers its next item; otherwise it is credited another quantum
+ * and goes to the back.  A flow whose item the admit callback refuses
+ * goes to the back uncredited and the item is marked held.  If
+ * every flow is refused, all that is queued is counted in fq->held
+ * until an item is served.  A flow that empties is freed, forfeiting
+ * any remaining deficit, and its owner handed back for the caller to
+ * release once it has dropped the queue's lock.
+ *
+ * @param[in]  fq    Queue
+ * @param[out] owner Owner of a flow freed by this call, else NULL
+ *
+ * @return The item, or NULL if the queue is empty or every flow
+ *         with work was refused.
+ */
+
+struct fq_item *fq_dequeue(struct fair_queue *fq, void **owner)
+{
+	struct fq_flow *flow;
+	struct fq_item *item;
+	uint32_t refused = 0;
+
+	*owner = NULL;
+
+	while (!glist_empty(&fq->active)) {
+		flow = glist_first_entry(&fq->active, struct fq_flow, active);
+		item = glist_first_entry(&flow->q, struct fq_item, q);
+
+		if (flow->deficit < item->cost) {
+			flow->deficit += (int64_t) FQ_QUANTUM * flow->weight;
+			glist_del(&flow->active);
+			glist_add_tail(&fq->active, &flow->active);
+			/* a credited flow may now be served, give the
+			 * refused ones another look too */
+			refused = 0;
+			continue;
+		}
+
+		if (flow->owner != NULL && fq->admit != NULL &&
+		    !fq->admit(flow->owner, item)) {
+			item->held = true;
+			glist_del(&flow->active);
+			glist_add_tail(&fq->active, &flow->active);
+			if (++refused >= fq->nflows) {
+				fq->held = fq->size;
+				break;
+			}
+			continue;
+		}
+
+		flow->deficit -= item->cost;
+		glist_del(&item->q);
+		--fq->size;
+		fq->held = 0;
+
+		if (glist_empty(&flow->q)) {
+			glist_del(&flow->active);
+			glist_del(&flow->hash);
+			--fq->nflows;
+			*owner = flow->owner;
+			gsh_free(flow);
+		}
+		return item;
+	}
+	return NULL;
+}
+
+/** @} */
@@ -104,6 +104,7 @@ int fridgethr_init(struct fridgethr **frout, const char *s,
 	frobj->s = NULL;
 	frobj->nthreads = 0;
 	frobj->nidle = 0;
+	frobj->retiring = 0;
 	frobj->flags = fridgethr_flag_none;
 
 	/* This always succeeds on Linux, but it might fail on other
@@ -341,6 +342,24 @@ static bool fridgethr_getwork(struct fridgethr *fr, struct fridgethr_entry *fe)
 	}
 }
 
+/**
+ * @brief Take up a request to retire from fridgethr_shrink
+ *
+ * @note Call with the fridge mutex held.
+ *
+ * @param[in] fr The fridge
+ *
+ * @retval true if the calling thread should exit.
+ */
+
+static inline bool fridgethr_retire(struct fridgethr *fr)
+{
+	if (fr->retiring == 0)
+		return false;
+	--(fr->retiring);
+	return true;
+}
+
 /**
  * @brief Wait for more work
  *
@@ -379,7 +398,8 @@ static bool fridgethr_freeze(struct fridgethr *fr,
 
 	/* rc would have been set in the while loop below */
 	if (((rc == ETIMEDOUT) && (fr->nthreads > fr->p.thr_min))
-	    || (fr->command == fridgethr_comm_stop)) {
+	    || (fr->command == fridgethr_comm_stop)
+	    || fridgethr_retire(fr)) {
 		/* We do this here since we already have the fridge
 		   lock. */
 		--(fr->nthreads);
@@ -1346,8 +1366,8 @@ int fridgethr_sync_command(struct fridgethr *fr, fridgethr_comm_t command,
 /**
  * @brief Return true if a looper function should return
  *
- * For the moment, this checks if we're in the middle of a state
- * transition.
+ * This checks if we're in the middle of a state transition or if
+ * fridgethr_shrink wants threads to retire.
  *
  * @param[in] ctx The thread context
  *
@@ -1364,51 +1384,38 @@ bool fridgethr_you_should_break(struct fridgethr_context *ctx)
 	bool rc;
 
 	PTHREAD_MUTEX_lock(&fr->mtx);
-	rc = fr->transitioning;
+	rc = fr->transitioning || fr->retiring != 0;
 	PTHREAD_MUTEX_unlock(&fr->mtx);
 	return rc;
 }
 
 /**
- * @brief Populate a fridge with threads all running the same thing
+ * @brief Start threads all running the same thing
  *
- * @param[in,out] fr   Fridge to populate
- * @param[in]     func Function each thread should run
- * @param[in]     arg  Argument supplied for that function
+ * @note Call with the fridge mutex held.
+ *
+ * @param[in,out] fr    Fridge
+ * @param[in]     count Threads to start
+ * @param[in]     func  Function each thread should run
+ * @param[in]     arg   Argument supplied for that function
  *
  * @retval 0 on success.
- * @retval EINVAL if there is no well-defined thread count.
  * @retval Other codes from thread creation.
  */
 
-int fridgethr_populate(struct fridgethr *fr,
-		      void (*func) (struct fridgethr_context *), void *arg)
+static int fridgethr_add_threads(struct fridgethr *fr, uint32_t count,
+				 void (*func) (struct fridgethr_context *),
+				 void *arg)
 {
-	int threads_to_run;
-	int i;
+	uint32_t i;
 
-	PTHREAD_MUTEX_lock(&fr->mtx);
-	if (fr->p.thr_min != 0) {
-		threads_to_run = fr->p.thr_min;
-	} else if (fr->p.thr_max != 0) {
-		threads_to_run = fr->p.thr_max;
-	} else {
-		PTHREAD_MUTEX_unlock(&fr->mtx);
-		LogMajor(COMPONENT_THREAD,
-			 "Cannot populate fridge with undefined number of "
-			 "threads: %s", fr->s);
-		return EINVAL;
-	}
-
-	for (i = 0; i < threads_to_run; ++i) {
+	for (i = 0; i < count; ++i) {
 		struct fridgethr_entry *fe = NULL;
 		int rc = 0;
 
 		fe = gsh_calloc(sizeof(struct fridgethr_entry), 1);
-		if (fe == NULL) {
-			PTHREAD_MUTEX_unlock(&fr->mtx);
+		if (fe == NULL)
 			return ENOMEM;
-		}
 
 		/* Make a new thread */
 		++(fr->nthreads);
@@ -1421,7 +1428,6 @@ int fridgethr_populate(struct fridgethr *fr,
 			LogMajor(COMPONENT_THREAD,
 				 "Unable to initialize mutex for new thread "
 				 "in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
 			return rc;
 		}
 		rc = pthread_cond_init(&fe->ctx.cv, NULL);
@@ -1429,7 +1435,6 @@ int fridgethr_populate(struct fridgethr *fr,
 			LogMajor(COMPONENT_THREAD,
 				 "Unable to initialize condition variable "
 				 "for new thread in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
 			return rc;
 		}
 
@@ -1443,13 +1448,124 @@ int fridgethr_populate(struct fridgethr *fr,
 			LogMajor(COMPONENT_THREAD,
 				 "Unable to create new thread "
 				 "in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
 			return rc;
 		}
 	}
+	return 0;
+}
+
+/**
+ * @brief Populate a fridge with threads all running the same thing
+ *
+ * @param[in,out] fr   Fridge to populate
+ * @param[in]     func Function each thread should run
+ * @param[in]     arg  Argument supplied for that function
+ *
+ * @retval 0 on success.
+ * @retval EINVAL if there is no well-defined thread count.
+ * @retval Other codes from thread creation.
+ */
+
+int fridgethr_populate(struct fridgethr *fr,
+		      void (*func) (struct fridgethr_context *), void *arg)
+{
+	int threads_to_run;
+	int rc;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	if (fr->p.thr_min != 0) {
+		threads_to_run = fr->p.thr_min;
+	} else if (fr->p.thr_max != 0) {
+		threads_to_run = fr->p.thr_max;
+	} else {
+		PTHREAD_MUTEX_unlock(&fr->mtx);
+		LogMajor(COMPONENT_THREAD,
+			 "Cannot populate fridge with undefined number of "
+			 "threads: %s", fr->s);
+		return EINVAL;
+	}
+
+	rc = fridgethr_add_threads(fr, threads_to_run, func, arg);
 	PTHREAD_MUTEX_unlock(&fr->mtx);
 
-	return 0;
+	return rc;
+}
+
+/**
+ * @brief Add threads running the same thing to a running fridge
+ *
+ * Outstanding requests to retire are cancelled first, and no more
+ * than thr_max threads are ever run.
+ *
+ * @param[in,out] fr    Fridge to grow
+ * @param[in]     count Threads to add
+ * @param[in]     func  Function each thread should run
+ * @param[in]     arg   Argument supplied for that function
+ *
+ * @retval 0 on success.
+ * @retval Other codes from thread creation.
+ */
+
+int fridgethr_grow(struct fridgethr *fr, uint32_t count,
+		   void (*func) (struct fridgethr_context *), void *arg)
+{
+	uint32_t reprieve;
+	int rc = 0;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	if (fr->command != fridgethr_comm_run) {
+		PTHREAD_MUTEX_unlock(&fr->mtx);
+		return 0;
+	}
+
+	reprieve = (count < fr->retiring) ? count : fr->retiring;
+	fr->retiring -= reprieve;
+	count -= reprieve;
+
+	if (fr->p.thr_max != 0) {
+		if (fr->nthreads >= fr->p.thr_max)
+			count = 0;
+		else if (count > fr->p.thr_max - fr->nthreads)
+			count = fr->p.thr_max - fr->nthreads;
+	}
+
+	if (count != 0)
+		rc = fridgethr_add_threads(fr, count, func, arg);
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+
+	return rc;
+}
+
+/**
+ * @brief Ask some threads of a looper fridge to exit
+ *
+ * Threads leave as they next return to the fridge, which, for a
+ * function using fridgethr_you_should_break, is promptly.  The fridge
+ * is never taken below thr_min.
+ *
+ * @param[in,out] fr    Fridge to shrink
+ * @param[in]     count Threads to retire
+ *
+ * @return The number of threads asked to exit.
+ */
+
+uint32_t fridgethr_shrink(struct fridgethr *fr, uint32_t count)
+{
+	uint32_t spare = 0;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	if (fr->command == fridgethr_comm_run &&
+	    fr->nthreads > fr->retiring + fr->p.thr_min)
+		spare = fr->nthreads - fr->retiring - fr->p.thr_min;
+	if (count > spare)
+		count = spare;
+	fr->retiring += count;
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+
+	if (count != 0 && fr->p.wake_threads != NULL)
+		fr->p.wake_threads(fr->p.wake_threads_arg);
+
+	return count;
 }
 
 /**
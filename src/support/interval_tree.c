@@ -0,0 +1,231 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup interval_tree
+ * @{
+ */
+
+/**
+ * @file interval_tree.c
+ * @brief Intrusive interval tree
+ *
+ * Insertion splits the treap around the new node's key and removal
+ * merges the removed node's children, both recursing only as deep
+ * as the tree, which is logarithmic in expectation.
+ */
+
+#include <stddef.h>
+#include "interval_tree.h"
+
+static inline bool key_less(const struct itree_node *a,
+			    const struct itree_node *b)
+{
+	return a->start < b->start ||
+	       (a->start == b->start && (uintptr_t) a < (uintptr_t) b);
+}
+
+/* Is the node past the walk's position? */
+static inline bool key_after(const struct itree_node *n,
+			     const struct itree_iter *iter)
+{
+	return !iter->started || n->start > iter->start ||
+	       (n->start == iter->start && (uintptr_t) n > iter->node);
+}
+
+static inline void update(struct itree_node *n)
+{
+	n->max_last = n->last;
+	if (n->left != NULL && n->left->max_last > n->max_last)
+		n->max_last = n->left->max_last;
+	if (n->right != NULL && n->right->max_last > n->max_last)
+		n->max_last = n->right->max_last;
+}
+
+/* xorshift32 */
+static uint32_t next_prio(struct itree *tree)
+{
+	uint32_t x = tree->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	tree->seed = x;
+	return x;
+}
+
+/* Split t into the nodes ordered before key and the rest */
+static void split(struct itree_node *t, const struct itree_node *key,
+		  struct itree_node **l, struct itree_node **r)
+{
+	if (t == NULL) {
+		*l = NULL;
+		*r = NULL;
+	} else if (key_less(t, key)) {
+		split(t->right, key, &t->right, r);
+		update(t);
+		*l = t;
+	} else {
+		split(t->left, key, l, &t->left);
+		update(t);
+		*r = t;
+	}
+}
+
+/* Join two treaps, every node of a ordered before those of b */
+static struct itree_node *merge(struct itree_node *a, struct itree_node *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (a->prio > b->prio) {
+		a->right = merge(a->right, b);
+		update(a);
+		return a;
+	}
+	b->left = merge(a, b->left);
+	update(b);
+	return b;
+}
+
+static struct itree_node *tree_insert(struct itree_node *t,
+				       struct itree_node *n)
+{
+	if (t == NULL)
+		return n;
+	if (n->prio > t->prio) {
+		split(t, n, &n->left, &n->right);
+		update(n);
+		return n;
+	}
+	if (key_less(n, t))
+		t->left = tree_insert(t->left, n);
+	else
+		t->right = tree_insert(t->right, n);
+	update(t);
+	return t;
+}
+
+static struct itree_node *tree_remove(struct itree_node *t,
+				       struct itree_node *n)
+{
+	if (t == NULL)
+		return NULL;	/* not in the tree */
+	if (t == n)
+		return merge(n->left, n->right);
+	if (key_less(n, t))
+		t->left = tree_remove(t->left, n);
+	else
+		t->right = tree_remove(t->right, n);
+	update(t);
+	return t;
+}
+
+/**
+ * @brief Add a range
+ *
+ * The node's start and last must be set, and must not change while
+ * it is in the tree.
+ *
+ * @param[in,out] tree Tree
+ * @param[in,out] node Node to add
+ */
+
+void itree_insert(struct itree *tree, struct itree_node *node)
+{
+	node->left = NULL;
+	node->right = NULL;
+	node->max_last = node->last;
+	node->prio = next_prio(tree);
+	tree->root = tree_insert(tree->root, node);
+	tree->count++;
+}
+
+/**
+ * @brief Remove a range
+ *
+ * @param[in,out] tree Tree
+ * @param[in,out] node Node to remove, which must be in the tree
+ */
+
+void itree_remove(struct itree *tree, struct itree_node *node)
+{
+	tree->root = tree_remove(tree->root, node);
+	node->left = NULL;
+	node->right = NULL;
+	tree->count--;
+}
+
+static struct itree_node *next_overlap(struct itree_node *n,
+				       const struct itree_iter *iter,
+				       uint64_t start, uint64_t last)
+{
+	struct itree_node *found;
+
+	/* Nothing below reaches start */
+	if (n == NULL || n->max_last < start)
+		return NULL;
+
+	if (key_after(n, iter)) {
+		found = next_overlap(n->left, iter, start, last);
+		if (found != NULL)
+			return found;
+		if (n->start > last)
+			return NULL;	/* nor does anything to the right */
+		if (n->last >= start)
+			return n;
+	} else if (n->start > last) {
+		return NULL;
+	}
+
+	return next_overlap(n->right, iter, start, last);
+}
+
+/**
+ * @brief Find the next range overlapping [start, last]
+ *
+ * Ranges come out ordered by start.  The tree may be changed between
+ * calls; ranges inserted behind the walk's position are not seen.
+ *
+ * @param[in]     tree  Tree
+ * @param[in,out] iter  Walk position, set up with itree_iter_init
+ * @param[in]     start First offset of the range to match
+ * @param[in]     last  Last offset of the range to match, inclusive
+ *
+ * @return The next overlapping node, or NULL once there are no more.
+ */
+
+struct itree_node *itree_iter_next(struct itree *tree,
+				   struct itree_iter *iter,
+				   uint64_t start, uint64_t last)
+{
+	struct itree_node *n = next_overlap(tree->root, iter, start, last);
+
+	if (n != NULL) {
+		iter->start = n->start;
+		iter->node = (uintptr_t) n;
+		iter->started = true;
+	}
+	return n;
+}
+
+/** @} */
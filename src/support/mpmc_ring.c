@@ -0,0 +1,81 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup mpmc_ring
+ * @{
+ */
+
+/**
+ * @file mpmc_ring.c
+ * @brief Bounded lock-free MPMC ring setup
+ */
+
+#include <errno.h>
+#include "abstract_mem.h"
+#include "mpmc_ring.h"
+
+/**
+ * @brief Set up an empty ring
+ *
+ * @param[out] ring Ring
+ * @param[in]  size Number of slots, a power of two
+ *
+ * @retval 0 on success.
+ * @retval EINVAL if @c size is not a power of two.
+ * @retval ENOMEM if the slots could not be allocated.
+ */
+
+int mpmc_ring_init(struct mpmc_ring *ring, uint32_t size)
+{
+	uint32_t ix;
+
+	if (size < 2 || (size & (size - 1)) != 0)
+		return EINVAL;
+
+	ring->cells = gsh_malloc_aligned(CACHE_LINE_SIZE,
+					 size * sizeof(struct mpmc_cell));
+	if (ring->cells == NULL)
+		return ENOMEM;
+
+	for (ix = 0; ix < size; ++ix) {
+		ring->cells[ix].seq = ix;
+		ring->cells[ix].data = NULL;
+	}
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+/**
+ * @brief Free a ring's slots
+ *
+ * @param[in,out] ring Ring, which should be empty
+ */
+
+void mpmc_ring_destroy(struct mpmc_ring *ring)
+{
+	gsh_free(ring->cells);
+	ring->cells = NULL;
+}
+
+/** @} */
@@ -85,6 +85,18 @@ static struct config_item core_params[] = {
 		       nfs_core_param, program[P_RQUOTA]),
 	CONF_ITEM_UI32("Nb_Worker", 1, 1024*128, NB_WORKER_THREAD_DEFAULT,
 		       nfs_core_param, nb_worker),
+	CONF_ITEM_BOOL("NUMA_Affinity", false,
+		       nfs_core_param, numa_affinity),
+	CONF_ITEM_BOOL("Worker_Autotune", false,
+		       nfs_core_param, worker_autotune),
+	CONF_ITEM_UI32("Nb_Worker_Min", 1, 1024*128, 4,
+		       nfs_core_param, nb_worker_min),
+	CONF_ITEM_UI32("Nb_Worker_Max", 1, 1024*128, 256,
+		       nfs_core_param, nb_worker_max),
+	CONF_ITEM_UI32("Worker_Wait_Target", 10, 10000000, 2000,
+		       nfs_core_param, worker_wait_target),
+	CONF_ITEM_UI32("Worker_Spins", 0, 10000, 0,
+		       nfs_core_param, worker_spins),
 	CONF_ITEM_BOOL("Drop_IO_Errors", false,
 		       nfs_core_param, drop_io_errors),
 	CONF_ITEM_BOOL("Drop_Inval_Errors", false,
@@ -135,10 +147,17 @@ static struct config_item core_params[] = {
 		       nfs_core_param, rpc.max_recv_buffer_size),
 	CONF_ITEM_UI32("RPC_Ioq_ThrdMax", 1, 1024*128, 200,
 		       nfs_core_param, rpc.ioq_thrd_max),
+	CONF_ITEM_UI32("Buffer_Pool_Size", 0, 1024 * 1024 * 1024,
+		       4 * 1024 * 1024,
+		       nfs_core_param, buffer_pool_size),
 	CONF_ITEM_I64("Decoder_Fridge_Expiration_Delay", 0, 7200, 600,
 		      nfs_core_param, decoder_fridge_expiration_delay),
 	CONF_ITEM_I64("Decoder_Fridge_Block_Timeout", 0, 7200, 600,
 		      nfs_core_param, decoder_fridge_block_timeout),
+	CONF_ITEM_UI32("Export_Root_Threads", 1, 1024, 16,
+		       nfs_core_param, export_root_threads),
+	CONF_ITEM_BOOL("Lazy_Export_Roots", false,
+		       nfs_core_param, lazy_export_roots),
 	CONF_ITEM_LIST("NFS_Protocols", CORE_OPTION_ALL_VERS, protocols,
 		       nfs_core_param, core_options),
 	CONF_ITEM_BOOL("NSM_Use_Caller_Name", false,
@@ -147,6 +166,8 @@ static struct config_item core_params[] = {
 		       nfs_core_param, clustered),
 	CONF_ITEM_BOOL("Enable_NLM", true,
 		       nfs_core_param, enable_NLM),
+	CONF_ITEM_UI32("NLM_Callback_Threads", 1, 256, 16,
+		       nfs_core_param, nlm_callback_threads),
 	CONF_ITEM_BOOL("Enable_RQUOTA", true,
 		       nfs_core_param, enable_RQUOTA),
 	CONF_ITEM_BOOL("Enable_Fast_Stats", false,
@@ -202,6 +223,16 @@ struct config_block krb5_param = {
 #define GETPWNAMDEF true
 #endif
 
+/**
+ * @brief NFSv4 recovery backends
+ */
+
+static struct config_item_list recovery_backends[] = {
+	CONFIG_LIST_TOK("fs", RECOVERY_BACKEND_FS),
+	CONFIG_LIST_TOK("journal", RECOVERY_BACKEND_JOURNAL),
+	CONFIG_LIST_EOL
+};
+
 /**
  * @brief NFSv4 specific parameters
  */
@@ -228,6 +259,9 @@ static struct config_item version4_params[] = {
 	CONF_ITEM_UI32("Deleg_Recall_Retry_Delay", 0, 10,
 			DELEG_RECALL_RETRY_DELAY_DEFAULT,
 			nfs_version4_parameter, deleg_recall_retry_delay),
+	CONF_ITEM_TOKEN("RecoveryBackend", RECOVERY_BACKEND_FS,
+			recovery_backends,
+			nfs_version4_parameter, recovery_backend),
 	CONFIG_EOL
 };
 
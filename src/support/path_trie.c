@@ -0,0 +1,252 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup path_trie
+ * @{
+ */
+
+/**
+ * @file path_trie.c
+ * @brief Path component trie
+ *
+ * Nodes exist only on the way to some link: removing the last link
+ * below a node frees it.
+ */
+
+#include <string.h>
+#include "abstract_mem.h"
+#include "path_trie.h"
+
+static int ptrie_cmpf(const struct avltree_node *lhs,
+		      const struct avltree_node *rhs)
+{
+	struct ptrie_node *lk = avltree_container_of(lhs, struct ptrie_node,
+						     node_k);
+	struct ptrie_node *rk = avltree_container_of(rhs, struct ptrie_node,
+						     node_k);
+	size_t len = lk->len < rk->len ? lk->len : rk->len;
+	int rc = memcmp(lk->name, rk->name, len);
+
+	if (rc != 0)
+		return rc;
+	if (lk->len != rk->len)
+		return lk->len < rk->len ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Step to the next component of a path
+ *
+ * @param[in,out] path Rest of the path
+ * @param[out]    len  Length of the component
+ *
+ * @return The component, or NULL at the end of the path.
+ */
+
+static const char *next_component(const char **path, size_t *len)
+{
+	const char *p = *path;
+	const char *comp;
+
+	while (*p == '/')
+		p++;
+	if (*p == '\0')
+		return NULL;
+
+	comp = p;
+	while (*p != '/' && *p != '\0')
+		p++;
+
+	*len = p - comp;
+	*path = p;
+	return comp;
+}
+
+static struct ptrie_node *node_alloc(struct ptrie_node *parent,
+				     const char *name, size_t len)
+{
+	struct ptrie_node *n = gsh_malloc(sizeof(*n) + len);
+
+	if (n == NULL)
+		return NULL;
+
+	memcpy(n->buf, name, len);
+	n->name = n->buf;
+	n->len = len;
+	n->parent = parent;
+	avltree_init(&n->children, ptrie_cmpf, 0);
+	glist_init(&n->values);
+	return n;
+}
+
+static struct ptrie_node *child(struct ptrie_node *n, const char *name,
+				size_t len)
+{
+	struct ptrie_node key;
+	struct avltree_node *node;
+
+	key.name = name;
+	key.len = len;
+	node = avltree_lookup(&key.node_k, &n->children);
+	if (node == NULL)
+		return NULL;
+
+	return avltree_container_of(node, struct ptrie_node, node_k);
+}
+
+/* Free n and any ancestors left with nothing below them */
+static void prune(struct ptrie *trie, struct ptrie_node *n)
+{
+	struct ptrie_node *parent;
+
+	while (n != NULL && glist_empty(&n->values) &&
+	       avltree_first(&n->children) == NULL) {
+		parent = n->parent;
+		if (parent != NULL)
+			avltree_remove(&n->node_k, &parent->children);
+		else
+			trie->root = NULL;
+		gsh_free(n);
+		n = parent;
+	}
+}
+
+/**
+ * @brief Index a link by path
+ *
+ * Links added at the same path are kept in the order added.
+ *
+ * @param[in,out] trie Trie
+ * @param[in]     path Path
+ * @param[in,out] link Link to add, not in any list
+ *
+ * @return false if memory ran out.
+ */
+
+bool ptrie_insert(struct ptrie *trie, const char *path,
+		  struct glist_head *link)
+{
+	struct ptrie_node *n, *c;
+	const char *comp;
+	size_t len;
+
+	if (trie->root == NULL) {
+		trie->root = node_alloc(NULL, "", 0);
+		if (trie->root == NULL)
+			return false;
+	}
+
+	n = trie->root;
+	while ((comp = next_component(&path, &len)) != NULL) {
+		c = child(n, comp, len);
+		if (c == NULL) {
+			c = node_alloc(n, comp, len);
+			if (c == NULL) {
+				prune(trie, n);
+				return false;
+			}
+			avltree_insert(&c->node_k, &n->children);
+		}
+		n = c;
+	}
+
+	glist_add_tail(&n->values, link);
+	return true;
+}
+
+/**
+ * @brief Remove a link
+ *
+ * @param[in,out] trie Trie
+ * @param[in]     path Path the link was added at
+ * @param[in,out] link Link to remove
+ */
+
+void ptrie_remove(struct ptrie *trie, const char *path,
+		  struct glist_head *link)
+{
+	struct ptrie_node *n = trie->root;
+	const char *comp;
+	size_t len;
+
+	glist_del(link);
+
+	while (n != NULL && (comp = next_component(&path, &len)) != NULL)
+		n = child(n, comp, len);
+
+	prune(trie, n);
+}
+
+static struct glist_head *first_accepted(struct ptrie_node *n,
+					 ptrie_accept_t accept)
+{
+	struct glist_head *glist;
+
+	glist_for_each(glist, &n->values) {
+		if (accept == NULL || accept(glist))
+			return glist;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Find the link at the longest indexed prefix of a path
+ *
+ * Prefixes end at component boundaries, so "/a/b" is a prefix of
+ * "/a/b/c" but not of "/a/bc".  Of the links at one path, the first
+ * added that accept takes is returned.
+ *
+ * @param[in] trie   Trie
+ * @param[in] path   Path to look up
+ * @param[in] exact  Only a link at the path itself will do
+ * @param[in] accept Filter on links, NULL to take any
+ *
+ * @return The link found, or NULL.
+ */
+
+struct glist_head *ptrie_lookup(struct ptrie *trie, const char *path,
+				bool exact, ptrie_accept_t accept)
+{
+	struct ptrie_node *n = trie->root;
+	struct glist_head *best, *found;
+	const char *comp;
+	size_t len;
+
+	if (n == NULL)
+		return NULL;
+
+	best = first_accepted(n, accept);
+
+	while ((comp = next_component(&path, &len)) != NULL) {
+		n = child(n, comp, len);
+		if (n == NULL)
+			return exact ? NULL : best;
+
+		found = first_accepted(n, accept);
+		if (found != NULL)
+			best = found;
+	}
+
+	return exact ? first_accepted(n, accept) : best;
+}
+
+/** @} */
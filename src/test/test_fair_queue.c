@@ -0,0 +1,126 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Synthetic multi-tenant load against the deficit round robin queue.
+ * Every tenant keeps its flow backlogged while the queue is drained
+ * for a while; the cost each tenant got served must then track its
+ * weight, whatever the size of its requests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fair_queue.h"
+
+#define N_TENANTS 4
+#define BACKLOG 64
+#define ROUNDS 200000
+
+/* Served share may stray this far from the weighted share */
+#define TOLERANCE 0.02
+
+struct tenant {
+	const char *name;
+	int32_t export_id;
+	uint32_t weight;
+	uint64_t bytes;		/* Size of each request */
+	uint64_t served;	/* Cost served */
+	uint64_t requests;	/* Requests served */
+};
+
+struct req {
+	struct fq_item item;
+	struct tenant *tenant;
+};
+
+static struct tenant tenants[N_TENANTS] = {
+	{ "1MiB writer", 1, 1, 1024 * 1024, 0, 0 },
+	{ "small ops", 2, 1, 0, 0, 0 },
+	{ "8KiB reader", 3, 2, 8192, 0, 0 },
+	{ "64KiB reader", 4, 4, 65536, 0, 0 },
+};
+
+static void submit(struct fair_queue *fq, struct tenant *t)
+{
+	struct req *r = malloc(sizeof(*r));
+	struct fq_flow *flow;
+
+	memset(r, 0, sizeof(*r));
+	r->tenant = t;
+	r->item.cost = fq_cost(t->bytes);
+	if (fq_enqueue(fq, &r->item, t, t->export_id))
+		return;
+	flow = fq_flow_alloc(t, t->export_id, t->weight, NULL);
+	fq_enqueue_flow(fq, &r->item, flow);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fair_queue fq;
+	struct fq_item *item;
+	struct req *r;
+	void *owner;
+	uint64_t total = 0;
+	uint32_t weights = 0;
+	double share, want;
+	int failed = 0;
+	int i, j;
+
+	fq_init(&fq, NULL);
+	for (i = 0; i < N_TENANTS; i++) {
+		weights += tenants[i].weight;
+		for (j = 0; j < BACKLOG; j++)
+			submit(&fq, &tenants[i]);
+	}
+
+	for (i = 0; i < ROUNDS; i++) {
+		item = fq_dequeue(&fq, &owner);
+		if (item == NULL) {
+			printf("queue ran dry after %d requests\n", i);
+			return 1;
+		}
+		r = (struct req *)item;
+		r->tenant->served += item->cost;
+		r->tenant->requests++;
+		total += item->cost;
+		/* Keep the tenant backlogged */
+		submit(&fq, r->tenant);
+		free(r);
+	}
+
+	for (i = 0; i < N_TENANTS; i++) {
+		share = (double)tenants[i].served / total;
+		want = (double)tenants[i].weight / weights;
+		printf("%-14s weight %u: %8llu requests, share %.4f want %.4f\n",
+		       tenants[i].name, tenants[i].weight,
+		       (unsigned long long)tenants[i].requests, share, want);
+		if (share < want - TOLERANCE || share > want + TOLERANCE)
+			failed = 1;
+	}
+
+	while ((item = fq_dequeue(&fq, &owner)) != NULL)
+		free(item);
+	if (fq.size != 0 || fq.nflows != 0)
+		failed = 1;
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed;
+}
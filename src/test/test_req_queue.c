@@ -0,0 +1,274 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * Request queue micro-benchmark: producers standing in for decoders
+ * and consumers standing in for workers pass items through either a
+ * spinlocked list, as the request queues used to be, the lock-free
+ * MPMC ring alone, or the ring in front of a spinlocked fair queue,
+ * drained by whichever consumer dequeues as nfs_rpc_consume_req
+ * does.  Besides throughput it reports the average time a consumer
+ * spends in each dequeue, lock included.  Every item must come out
+ * exactly once.
+ *
+ * usage: test_req_queue [producers [consumers [items per producer]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "ganesha_list.h"
+#include "mpmc_ring.h"
+#include "fair_queue.h"
+
+struct item {
+	struct fq_item fq;	/* fq.q also links the spinlocked list */
+	uint64_t value;
+};
+
+enum mode {
+	MODE_SPIN,
+	MODE_RING,
+	MODE_RING_FQ
+};
+
+struct spin_q {
+	pthread_spinlock_t sp;
+	struct glist_head q;
+};
+
+static struct spin_q spin_q;
+static struct mpmc_ring ring;
+static pthread_spinlock_t fq_sp;
+static struct fair_queue fq;
+static enum mode mode;
+
+static int n_producers = 4;
+static int n_consumers = 4;
+static long n_items = 1000000;
+
+static uint64_t consumed;
+static uint64_t sum;
+static uint64_t dequeues;
+static uint64_t dequeue_ns;
+
+static void enqueue(struct item *it)
+{
+	if (mode != MODE_SPIN) {
+		while (!mpmc_ring_push(&ring, it))
+			sched_yield();
+		return;
+	}
+	pthread_spin_lock(&spin_q.sp);
+	glist_add_tail(&spin_q.q, &it->fq.q);
+	pthread_spin_unlock(&spin_q.sp);
+}
+
+/* Drain the ring onto the flows, then take one, under the lock */
+static struct item *dequeue_fq(void)
+{
+	struct fq_item *item;
+	void *owner;
+
+	if (mpmc_ring_count(&ring) == 0 &&
+	    __atomic_load_n(&fq.size, __ATOMIC_RELAXED) == 0)
+		return NULL;
+
+	pthread_spin_lock(&fq_sp);
+	while ((item = mpmc_ring_pop(&ring)) != NULL) {
+		if (!fq_enqueue(&fq, item, item->client, item->export_id))
+			fq_enqueue_flow(&fq, item,
+					fq_flow_alloc(item->client,
+						      item->export_id, 1,
+						      NULL));
+	}
+	item = fq_dequeue(&fq, &owner);
+	pthread_spin_unlock(&fq_sp);
+
+	return (struct item *)item;
+}
+
+static struct item *dequeue(void)
+{
+	struct item *it = NULL;
+
+	if (mode == MODE_RING)
+		return mpmc_ring_pop(&ring);
+	if (mode == MODE_RING_FQ)
+		return dequeue_fq();
+
+	pthread_spin_lock(&spin_q.sp);
+	if (!glist_empty(&spin_q.q)) {
+		it = glist_first_entry(&spin_q.q, struct item, fq.q);
+		glist_del(&it->fq.q);
+	}
+	pthread_spin_unlock(&spin_q.sp);
+	return it;
+}
+
+static uint64_t elapsed_ns(const struct timespec *start,
+			   const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000000ULL +
+	       end->tv_nsec - start->tv_nsec;
+}
+
+static void *producer(void *arg)
+{
+	struct item *items = arg;
+	long i;
+
+	for (i = 0; i < n_items; i++)
+		enqueue(&items[i]);
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	uint64_t total = (uint64_t) n_producers * n_items;
+	uint64_t mine = 0, mysum = 0, calls = 0, ns = 0;
+	struct timespec start, end;
+	struct item *it;
+
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		it = dequeue();
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		calls++;
+		ns += elapsed_ns(&start, &end);
+		if (it == NULL) {
+			/* publish what we have so others can finish */
+			__atomic_add_fetch(&consumed, mine, __ATOMIC_RELAXED);
+			mine = 0;
+			sched_yield();
+			continue;
+		}
+		mysum += it->value;
+		if (++mine == 1024) {
+			__atomic_add_fetch(&consumed, mine, __ATOMIC_RELAXED);
+			mine = 0;
+		}
+	}
+	__atomic_add_fetch(&consumed, mine, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&sum, mysum, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&dequeues, calls, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&dequeue_ns, ns, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static int run(const char *name, struct item **items)
+{
+	uint64_t total = (uint64_t) n_producers * n_items;
+	pthread_t thr[n_producers + n_consumers];
+	struct timespec start, end;
+	double secs;
+	int i;
+
+	consumed = 0;
+	sum = 0;
+	dequeues = 0;
+	dequeue_ns = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n_consumers; i++)
+		pthread_create(&thr[i], NULL, consumer, NULL);
+	for (i = 0; i < n_producers; i++)
+		pthread_create(&thr[n_consumers + i], NULL, producer, items[i]);
+	for (i = 0; i < n_producers + n_consumers; i++)
+		pthread_join(thr[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%-8s %d producers %d consumers: %.0f items/s, %.0f ns per dequeue\n",
+	       name, n_producers, n_consumers, total / secs,
+	       dequeues ? (double)dequeue_ns / dequeues : 0.0);
+
+	/* values are 1..total */
+	if (sum != total * (total + 1) / 2) {
+		printf("%s: items lost or duplicated\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct item **items;
+	uint64_t value = 0;
+	int failed = 0;
+	long i;
+	int p;
+
+	if (argc > 1)
+		n_producers = atoi(argv[1]);
+	if (argc > 2)
+		n_consumers = atoi(argv[2]);
+	if (argc > 3)
+		n_items = atol(argv[3]);
+	if (n_producers < 1 || n_consumers < 1 || n_items < 1) {
+		fprintf(stderr,
+			"usage: %s [producers [consumers [items]]]\n",
+			argv[0]);
+		return 2;
+	}
+
+	items = malloc(n_producers * sizeof(*items));
+	for (p = 0; p < n_producers; p++) {
+		items[p] = malloc(n_items * sizeof(struct item));
+		for (i = 0; i < n_items; i++) {
+			items[p][i].fq.cost = fq_cost(0);
+			/* one flow per producer, like one per client */
+			items[p][i].fq.client = items[p];
+			items[p][i].fq.export_id = 1;
+			items[p][i].value = ++value;
+		}
+	}
+
+	pthread_spin_init(&spin_q.sp, PTHREAD_PROCESS_PRIVATE);
+	glist_init(&spin_q.q);
+	pthread_spin_init(&fq_sp, PTHREAD_PROCESS_PRIVATE);
+	fq_init(&fq, NULL);
+	if (mpmc_ring_init(&ring, 1024) != 0) {
+		fprintf(stderr, "cannot set up ring\n");
+		return 2;
+	}
+
+	mode = MODE_SPIN;
+	failed |= run("spinlock", items);
+	mode = MODE_RING;
+	failed |= run("ring", items);
+	mode = MODE_RING_FQ;
+	failed |= run("ring+fq", items);
+	if (fq.size != 0 || fq.nflows != 0)
+		failed = 1;
+
+	mpmc_ring_destroy(&ring);
+	for (p = 0; p < n_producers; p++)
+		free(items[p]);
+	free(items);
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed;
+}
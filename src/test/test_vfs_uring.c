@@ -0,0 +1,233 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/*
+ * VFS io_uring loopback benchmark: worker threads read random blocks
+ * of a local file, either with blocking pread as FSAL_VFS used to, or
+ * by submitting to a shared ring and parking on a futex until a
+ * reaper thread posts the completion, as vfs_uring.c does.  Reports
+ * reads per second, throughput and the deepest I/O queue reached.
+ *
+ * usage: test_vfs_uring file [threads [seconds [block size]]]
+ *
+ * Use a file larger than memory, or O_DIRECT friendly storage, to
+ * measure the device rather than the page cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <liburing.h>
+
+struct op {
+	int32_t res;
+	uint32_t done;
+};
+
+static int fd;
+static off_t nblocks;
+static size_t bsize = 4096;
+static int nthreads = 32;
+static int seconds = 5;
+static bool use_ring;
+static volatile bool stop;
+
+static struct io_uring ring;
+static pthread_mutex_t sq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t total_ops;
+static uint32_t inflight;
+static uint32_t max_inflight;
+
+static void note_submit(void)
+{
+	uint32_t now = __atomic_add_fetch(&inflight, 1, __ATOMIC_RELAXED);
+	uint32_t max = __atomic_load_n(&max_inflight, __ATOMIC_RELAXED);
+
+	while (now > max &&
+	       !__atomic_compare_exchange_n(&max_inflight, &max, now, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static ssize_t ring_pread(void *buf, size_t len, off_t off)
+{
+	struct op op = { 0, 0 };
+	struct io_uring_sqe *sqe;
+
+	pthread_mutex_lock(&sq_lock);
+	while ((sqe = io_uring_get_sqe(&ring)) == NULL)
+		io_uring_submit(&ring);
+	io_uring_prep_read(sqe, fd, buf, len, off);
+	io_uring_sqe_set_data(sqe, &op);
+	while (io_uring_submit(&ring) < 0)
+		;
+	pthread_mutex_unlock(&sq_lock);
+
+	while (__atomic_load_n(&op.done, __ATOMIC_ACQUIRE) == 0)
+		syscall(SYS_futex, &op.done, FUTEX_WAIT_PRIVATE, 0, NULL,
+			NULL, 0);
+
+	if (op.res < 0) {
+		errno = -op.res;
+		return -1;
+	}
+	return op.res;
+}
+
+static void *reaper(void *arg)
+{
+	struct io_uring_cqe *cqe;
+	struct op *op;
+
+	for (;;) {
+		if (io_uring_wait_cqe(&ring, &cqe) < 0)
+			continue;
+		op = io_uring_cqe_get_data(cqe);
+		if (op == NULL) {
+			io_uring_cqe_seen(&ring, cqe);
+			break;
+		}
+		op->res = cqe->res;
+		io_uring_cqe_seen(&ring, cqe);
+		__atomic_store_n(&op->done, 1, __ATOMIC_RELEASE);
+		syscall(SYS_futex, &op->done, FUTEX_WAKE_PRIVATE, 1, NULL,
+			NULL, 0);
+	}
+	return NULL;
+}
+
+static void *worker(void *arg)
+{
+	unsigned int seed = (uintptr_t) arg;
+	uint64_t ops = 0;
+	char *buf;
+	ssize_t rc;
+	off_t off;
+
+	if (posix_memalign((void **)&buf, 4096, bsize) != 0)
+		return NULL;
+
+	while (!stop) {
+		off = (off_t) (rand_r(&seed) % nblocks) * bsize;
+		note_submit();
+		if (use_ring)
+			rc = ring_pread(buf, bsize, off);
+		else
+			rc = pread(fd, buf, bsize, off);
+		__atomic_sub_fetch(&inflight, 1, __ATOMIC_RELAXED);
+		if (rc < 0) {
+			perror("read");
+			break;
+		}
+		ops++;
+	}
+
+	__atomic_add_fetch(&total_ops, ops, __ATOMIC_RELAXED);
+	free(buf);
+	return NULL;
+}
+
+static void run(const char *name)
+{
+	pthread_t thr[nthreads];
+	int i;
+
+	stop = false;
+	total_ops = 0;
+	inflight = 0;
+	max_inflight = 0;
+
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&thr[i], NULL, worker, (void *)(uintptr_t) i);
+	sleep(seconds);
+	stop = true;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(thr[i], NULL);
+
+	printf("%-6s %d threads: %.0f reads/s, %.1f MiB/s, max depth %u\n",
+	       name, nthreads, (double) total_ops / seconds,
+	       (double) total_ops * bsize / seconds / (1024 * 1024),
+	       max_inflight);
+}
+
+int main(int argc, char *argv[])
+{
+	struct io_uring_sqe *sqe;
+	pthread_t reap;
+	struct stat st;
+	int rc;
+
+	if (argc < 2) {
+		fprintf(stderr,
+			"usage: %s file [threads [seconds [block size]]]\n",
+			argv[0]);
+		return 2;
+	}
+	if (argc > 2)
+		nthreads = atoi(argv[2]);
+	if (argc > 3)
+		seconds = atoi(argv[3]);
+	if (argc > 4)
+		bsize = atol(argv[4]);
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(argv[1]);
+		return 2;
+	}
+	nblocks = st.st_size / bsize;
+	if (nblocks == 0 || nthreads < 1 || seconds < 1) {
+		fprintf(stderr, "file too small or bad arguments\n");
+		return 2;
+	}
+
+	use_ring = false;
+	run("sync");
+
+	rc = io_uring_queue_init(256, &ring, 0);
+	if (rc < 0) {
+		fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-rc));
+		return 1;
+	}
+	pthread_create(&reap, NULL, reaper, NULL);
+
+	use_ring = true;
+	run("uring");
+
+	sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_nop(sqe);
+	io_uring_sqe_set_data(sqe, NULL);
+	io_uring_submit(&ring);
+	pthread_join(reap, NULL);
+	io_uring_queue_exit(&ring);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * This software is a server that implements the NFS protocol.
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ *
+ */
+
+/*
+ * Lock heavy benchmark: one process takes many disjoint byte range
+ * locks on a file, timing each LOCK as the number already held grows,
+ * then a second process times TEST (F_GETLK) against all of them.
+ * Run it on a file on an NFS mount to see how the server's lock
+ * processing scales with the locks held on one file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+char options[] = "n:t:h?";
+char usage[] =
+	"Usage: ml_lock_bench [-n locks] [-t tests] file\n" "\n"
+	"  -n locks - number of locks to hold (default 100000)\n"
+	"  -t tests - number of TEST probes from a second process"
+	" (default 1000)\n";
+
+/* Locks are one byte with a byte between, so none of them merge */
+#define LOCK_OFFSET(i) ((off_t) (i) * 2)
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int lock_range(int fd, int cmd, short type, off_t start, off_t len)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = start;
+	fl.l_len = len;
+
+	return fcntl(fd, cmd, &fl);
+}
+
+/* Time TEST of every lock from a different lock owner */
+static int run_tests(const char *path, long nlocks, long ntests)
+{
+	struct flock fl;
+	uint64_t start, total = 0, max = 0, ns;
+	long i, conflicts = 0;
+	int fd;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+
+	for (i = 0; i < ntests; i++) {
+		memset(&fl, 0, sizeof(fl));
+		fl.l_type = F_WRLCK;
+		fl.l_whence = SEEK_SET;
+		fl.l_start = LOCK_OFFSET(random() % nlocks);
+		fl.l_len = 1;
+
+		start = now_ns();
+		if (fcntl(fd, F_GETLK, &fl) < 0) {
+			perror("F_GETLK");
+			close(fd);
+			return 1;
+		}
+		ns = now_ns() - start;
+
+		total += ns;
+		if (ns > max)
+			max = ns;
+		if (fl.l_type != F_UNLCK)
+			conflicts++;
+	}
+
+	printf("TEST   %ld probes: avg %.1f us, max %.1f us, %ld conflicts\n",
+	       ntests, total / 1000.0 / ntests, max / 1000.0, conflicts);
+
+	close(fd);
+	return conflicts == ntests ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	long nlocks = 100000, ntests = 1000, i, bucket;
+	uint64_t start, ns, total = 0, max = 0;
+	const char *path;
+	pid_t pid;
+	int opt, fd, status;
+
+	while ((opt = getopt(argc, argv, options)) != EOF) {
+		switch (opt) {
+		case 'n':
+			nlocks = atol(optarg);
+			break;
+		case 't':
+			ntests = atol(optarg);
+			break;
+		default:
+			fputs(usage, stderr);
+			return opt == 'h' || opt == '?' ? 0 : 1;
+		}
+	}
+
+	if (optind != argc - 1 || nlocks < 10 || ntests < 1) {
+		fputs(usage, stderr);
+		return 1;
+	}
+
+	path = argv[optind];
+	bucket = nlocks / 10;
+
+	fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+
+	for (i = 0; i < nlocks; i++) {
+		start = now_ns();
+		if (lock_range(fd, F_SETLK, F_WRLCK, LOCK_OFFSET(i), 1) < 0) {
+			fprintf(stderr, "LOCK %ld failed: %s\n", i,
+				strerror(errno));
+			close(fd);
+			return 1;
+		}
+		ns = now_ns() - start;
+
+		total += ns;
+		if (ns > max)
+			max = ns;
+
+		if ((i + 1) % bucket == 0) {
+			printf("LOCK   %8ld held: avg %.1f us, max %.1f us\n",
+			       i + 1, total / 1000.0 / bucket, max / 1000.0);
+			total = 0;
+			max = 0;
+		}
+	}
+
+	fflush(stdout);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0)
+		exit(run_tests(path, nlocks, ntests));
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+	    || WEXITSTATUS(status) != 0)
+		fprintf(stderr, "TEST process failed\n");
+
+	start = now_ns();
+	if (lock_range(fd, F_SETLK, F_UNLCK, 0, 0) < 0)
+		perror("UNLOCK");
+	printf("UNLOCK all: %.1f ms\n", (now_ns() - start) / 1000000.0);
+
+	close(fd);
+	return 0;
+}